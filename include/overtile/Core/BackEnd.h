@@ -22,40 +22,95 @@
 
 #include "overtile/Core/Grid.h"
 #include "overtile/Core/Region.h"
+#include "llvm/Support/DataTypes.h"
 #include "llvm/Support/raw_ostream.h"
 #include <list>
 #include <map>
 #include <ostream>
+#include <vector>
 
 namespace overtile {
 
 class CGExpression;
+class ElementType;
 class Field;
+class Function;
+struct BoundExpr;
 
 /**
  * Base class for backend code generators.
  */
 class BackEnd {
 public:
+
+  /// TilingStrategy - The shape of the space-time tiles.
+  enum TilingStrategy {
+    /// Overlapped tiling: every tile redundantly computes the halo it needs,
+    /// so tiles are independent.
+    OverlappedTiling,
+    /// Split tiling: upright trapezoids are computed first, and the inverted
+    /// trapezoids between them afterwards.  No point is computed twice.
+    SplitTiling,
+    /// Wavefront tiling: consecutive time steps are pipelined across
+    /// threads along the outermost dimension.
+    WavefrontTiling,
+    /// 2.5D streaming: overlapped tiles in the inner dimensions that stream
+    /// through the outermost dimension.
+    StreamingTiling
+  };
+
+  /// FunctionList - The functions evaluated by one kernel, in update order.
+  typedef std::list<Function*> FunctionList;
+
+  typedef std::map<const Field*, Region> RegionMap;
+
   BackEnd(Grid *G);
   virtual ~BackEnd();
 
   /// run - Performs initial target-independent code generation.
   void run();
 
+  /// retile - Recomputes the kernels and the regions of the fields after
+  /// the block size, elements, or time tile size changed.  run() must have
+  /// been called before.
+  void retile();
+
   /// codegen - Generate code and write to stream \p OS.
   virtual void codegen(llvm::raw_ostream &OS) = 0;
 
-  virtual std::string getCanonicalPrototype() { return ""; }
+  /// getCanonicalPrototype - Returns the prototype of the generated host
+  /// entry point, ot_program_<name>.
+  virtual std::string getCanonicalPrototype();
+
+  /// getCanonicalInvocation - Returns a call to the generated host entry
+  /// point, using the field, dimension, and parameter names of the program.
   virtual std::string getCanonicalInvocation(llvm::StringRef TimeStepExpr,
-                                             llvm::StringRef ConvTolExpr) {
-    return "";
-  }
+                                             llvm::StringRef ConvTolExpr);
   
   //==-- Accessors --========================================================= //
   
+  /// getTimeTileSize - Returns the time tile size of the generated code.
+  /// It is the requested size, unless a smaller one was needed to fit the
+  /// fused kernel into the scratch budget, see partitionKernels().
   unsigned getTimeTileSize() const { return TimeTileSize; }
-  void setTimeTileSize(unsigned T) { TimeTileSize = T; }
+
+  /// getRequestedTimeTileSize - Returns the time tile size that was set with
+  /// setTimeTileSize().
+  unsigned getRequestedTimeTileSize() const { return RequestedTimeTileSize; }
+  void setTimeTileSize(unsigned T) { RequestedTimeTileSize = TimeTileSize = T; }
+
+  TilingStrategy getTilingStrategy() const { return Tiling; }
+  void setTilingStrategy(TilingStrategy S) { Tiling = S; }
+
+  /// getFastMath - Returns true if expressions may be simplified in ways
+  /// that do not preserve IEEE semantics, see ExprSimplifier.
+  bool getFastMath() const { return FastMath; }
+  void setFastMath(bool F) { FastMath = F; }
+
+  /// getContraction - Returns true if a*b+c may be computed with a single
+  /// rounding, i.e. as a fused multiply-add.
+  bool getContraction() const { return Contraction; }
+  void setContraction(bool C) { Contraction = C; }
 
   unsigned getBlockSize(unsigned Dim) const {
     if (Dim < TheGrid->getNumDimensions()) {
@@ -85,6 +140,12 @@ public:
     }
   }
 
+  /// getScratchBudget - Returns the number of bytes of on-chip scratch a
+  /// kernel may use: shared memory per block for Cuda, and cache per thread
+  /// for CPU targets.  If 0, the scratch size is not limited.
+  unsigned getScratchBudget() const { return ScratchBudget; }
+  void setScratchBudget(unsigned Bytes) { ScratchBudget = Bytes; }
+
   const std::string &getMachine() const { return Machine; }
   void setMachine(llvm::StringRef M) { Machine = M; }
   
@@ -103,24 +164,106 @@ public:
 
   const Field *getConvergeField() const { return ConvergeField; }
 
-  const std::map<const Field*, Region> &getRegionMap() const { return Regions; }
+  /// isCopiedOut - Returns true if the values of field \p F are copied back
+  /// to the host after the last time step.  Fields declared 'in' are not,
+  /// unless they are checked for convergence.
+  bool isCopiedOut(const Field *F) const;
+
+  /// isTemporary - Returns true if field \p F only carries values from one
+  /// function to the next within a time step and is not copied out.  Such a
+  /// field needs neither a second global buffer nor a write-back; its global
+  /// buffer only provides the points outside of the function bounds.
+  virtual bool isTemporary(const Field *F) const;
+
+  /// getKernels - Returns the functions of each kernel, in launch order.
+  /// All functions are fused into a single kernel, unless its scratch does
+  /// not fit into the budget, see partitionKernels().
+  const std::vector<FunctionList> &getKernels() const { return Kernels; }
+
+  /// getRegionMap - Returns the region of every field that kernel \p Kernel
+  /// computes to produce one element.
+  const RegionMap &getRegionMap(unsigned Kernel = 0) const {
+    return Regions[Kernel];
+  }
+
+  /// getKernelScratchBytes - Returns the number of bytes of scratch that
+  /// kernel \p Kernel needs, see getScratchBytes().
+  uint64_t getKernelScratchBytes(unsigned Kernel) const {
+    return getScratchBytes(Kernels[Kernel], TimeTileSize);
+  }
+
+  /// getBlockRegion - Returns the union of the regions of all fields, i.e.
+  /// the region that must be computed by a block of kernel \p Kernel to
+  /// produce one element.
+  Region getBlockRegion(unsigned Kernel = 0) const;
+
+  /// getHalo - Returns in \p Left and \p Right the points that a block of
+  /// kernel \p Kernel computes on either side of an element in dimension
+  /// \p Dim.  Returns false if either is negative, i.e. if the block region
+  /// does not contain offset 0.
+  bool getHalo(unsigned Kernel, unsigned Dim, int &Left, int &Right) const;
+
+  /// getTileSize - Returns the number of points that a block or tile of the
+  /// generated code covers in dimension \p Dim, including its halo, or 0 if
+  /// the code does not tile that dimension.  The default is the elements
+  /// times the block size.
+  virtual unsigned getTileSize(unsigned Dim);
+
+  /// getMaxOffsets - Returns in \p LeftMax and \p RightMax the largest left
+  /// and right offsets in dimension \p Dim over all fields and functions.
+  void getMaxOffsets(unsigned Dim, unsigned &LeftMax, unsigned &RightMax) const;
+
+protected:
+
+  /// getScratchBytes - Returns the number of bytes of scratch that a kernel
+  /// evaluating \p Kernel for \p TimeTile time steps needs.  The default
+  /// does not use scratch that is limited by the budget.
+  virtual uint64_t getScratchBytes(const FunctionList &Kernel,
+                                   unsigned TimeTile) const;
+
+  /// generateTiling - Computes in \p Map the region of every field that
+  /// evaluating \p Functions for \p TimeTile time steps needs to produce one
+  /// element.  The regions are written to stderr if \p Print is set.
+  void generateTiling(const FunctionList &Functions, unsigned TimeTile,
+                      RegionMap &Map, bool Print) const;
+
+  /// getBlockRegion - Returns the union of the regions in \p Map.
+  Region getBlockRegion(const RegionMap &Map) const;
+
+  /// getTypeName - Returns the C type name for the element type \p Ty.
+  static std::string getTypeName(const ElementType *Ty);
+
+  /// getBoundExpr - Returns a C expression for the bound \p Expr in
+  /// dimension \p Dim.
+  std::string getBoundExpr(const BoundExpr &Expr, unsigned Dim) const;
   
 private:
 
-  void generateTiling();
+  /// partitionKernels - Fuses all functions into one kernel, with the
+  /// largest time tile size up to the requested one whose scratch fits into
+  /// the budget.  If not even a time tile size of 1 fits, consecutive
+  /// functions are grouped into kernels that fit.  Each such kernel needs
+  /// the results of the previous one on the whole grid, so the time tile
+  /// size is 1.
+  void partitionKernels();
 
-  typedef std::list<CGExpression*>       CGExpressionList;
-  typedef std::map<const Field*, Region> RegionMap;
+  typedef std::list<CGExpression*> CGExpressionList;
   
-  Grid             *TheGrid;
-  unsigned          TimeTileSize;
-  unsigned         *BlockSize;
-  unsigned         *Elements;
-  CGExpressionList  CGExprs;
-  RegionMap         Regions;
-  bool              Verbose;
-  const Field      *ConvergeField;
-  std::string       Machine;
+  Grid                      *TheGrid;
+  unsigned                   RequestedTimeTileSize;
+  unsigned                   TimeTileSize;
+  TilingStrategy             Tiling;
+  bool                       FastMath;
+  bool                       Contraction;
+  unsigned                  *BlockSize;
+  unsigned                  *Elements;
+  CGExpressionList           CGExprs;
+  unsigned                   ScratchBudget;
+  std::vector<FunctionList>  Kernels;
+  std::vector<RegionMap>     Regions;
+  bool                       Verbose;
+  const Field               *ConvergeField;
+  std::string                Machine;
 };
 
 }
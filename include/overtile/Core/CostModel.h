@@ -0,0 +1,93 @@
+/*
+ * CostModel.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: CostModel.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_CORE_COSTMODEL_H
+#define OVERTILE_CORE_COSTMODEL_H
+
+#include "overtile/Core/Expressions.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace overtile {
+
+class Function;
+class Grid;
+
+/// PointCost - The cost of evaluating a function at one point.
+struct PointCost {
+  PointCost();
+
+  /// Floating-point operations: one per arithmetic operation or call.
+  double   Flops;
+  /// Operations weighted by their cost relative to an addition, see
+  /// CostModel::getOpWeight() and CostModel::getCallWeight().
+  double   WeightedFlops;
+  /// Distinct field values read, i.e. loads from registers or scratch.
+  unsigned Loads;
+  /// Field values written.
+  unsigned Stores;
+  /// Bytes read and written if every field is streamed through memory once,
+  /// by element type.
+  unsigned FP32Bytes;
+  unsigned FP64Bytes;
+
+  unsigned getBytes() const { return FP32Bytes + FP64Bytes; }
+
+  /// getIntensity - Returns the weighted operations per byte of memory
+  /// traffic.
+  double getIntensity() const {
+    return getBytes() ? WeightedFlops / getBytes() : 0.0;
+  }
+
+  PointCost &operator+=(const PointCost &RHS);
+};
+
+/**
+ * Static cost model for stencil point functions.
+ *
+ * The cost of a function is that of its first bounded function, which
+ * covers the interior of the grid and hence almost all points.  Shared
+ * subexpressions are counted once, as the back ends evaluate them once per
+ * point, and subexpressions that do not read fields are not counted at
+ * all, since they are folded or computed once per kernel call.
+ */
+class CostModel {
+public:
+
+  /// getFunctionCost - Returns the cost of evaluating \p F at one point.
+  static PointCost getFunctionCost(const Function *F);
+
+  /// getGridCost - Returns the cost of one time step at one point, with
+  /// every function streaming its fields through memory.
+  static PointCost getGridCost(const Grid *G);
+
+  /// getOpWeight - Returns the cost of \p Op relative to an addition.
+  static double getOpWeight(BinaryOp::Operator Op);
+
+  /// getCallWeight - Returns the cost of a call to the math function
+  /// \p Name relative to an addition.
+  static double getCallWeight(llvm::StringRef Name);
+
+  /// print - Writes the costs of the functions of \p G to \p OS in YAML.
+  static void print(const Grid *G, llvm::raw_ostream &OS);
+};
+
+}
+
+#endif
@@ -21,6 +21,7 @@
 #define OVERTILE_CORE_CUDABACKEND_H
 
 #include "overtile/Core/BackEnd.h"
+#include <map>
 #include <set>
 #include <vector>
 
@@ -32,10 +33,17 @@ class ConstantExpr;
 class ElementType;
 class Expression;
 class FieldRef;
+class Function;
 class FunctionCall;
+class IntConstant;
 
 /**
  * Back-end code generator for Cuda.
+ *
+ * The scratch budget is the shared memory available to a block, 48 KB by
+ * default.  If the Shared_<field> arrays of all functions do not fit into
+ * it, the functions are split into several kernels that are launched one
+ * after the other in every time step, see BackEnd::partitionKernels().
  */
 class CudaBackEnd : public BackEnd {
 public:
@@ -44,23 +52,105 @@ public:
 
   virtual void codegen(llvm::raw_ostream &OS);
 
-  virtual std::string getCanonicalPrototype();
-  virtual std::string getCanonicalInvocation(llvm::StringRef TimeStepExpr,
-                                             llvm::StringRef ConvTolExpr);
+  /// isTemporary - Temporaries live in shared memory, so all functions
+  /// reading or writing them have to be in the same kernel.
+  virtual bool isTemporary(const Field *F) const;
+
+protected:
+
+  /// getScratchBytes - Returns the size of the Shared_<field> arrays of a
+  /// kernel evaluating \p Kernel.
+  virtual uint64_t getScratchBytes(const FunctionList &Kernel,
+                                   unsigned TimeTile) const;
 
 private:
 
   virtual void codegenDevice(llvm::raw_ostream &OS);
   virtual void codegenHost(llvm::raw_ostream &OS);
 
-  bool                  InTS0;
-  std::set<std::string> WrittenFields;
-  std::vector<unsigned> SharedMaxLeft;
-  
-  static std::string getTypeName(const ElementType *Ty);
-
+  /// codegenKernel - Emits the kernel evaluating the functions of kernel
+  /// \p Kernel, see getKernels().
+  void codegenKernel(unsigned Kernel, llvm::raw_ostream &OS);
+  /// codegenRemainingTimeSteps - Emits time steps 1 to TimeTileSize-1 of
+  /// \p Functions, which read the outputs of the previous step from shared
+  /// memory.
+  void codegenRemainingTimeSteps(FunctionList &Functions,
+                                 llvm::raw_ostream &OS);
+
+  /// getKernelSuffix - Returns the suffix of the names of the kernel
+  /// \p Kernel and of its launch configuration.  It is empty if all
+  /// functions are fused into one kernel.
+  std::string getKernelSuffix(unsigned Kernel) const;
+
+  /// getSharedFields - Returns in \p Shared the fields that a kernel
+  /// evaluating \p Kernel for \p TimeTile time steps reads after writing
+  /// them, and hence keeps in shared memory.
+  void getSharedFields(const FunctionList &Kernel, unsigned TimeTile,
+                       std::set<const Field*> &Shared) const;
+
+  /// Extent - The first and last block-local index of the points of a field
+  /// in one dimension.
+  typedef std::pair<int, int> Extent;
+
+  /// getComputeExtent - Returns the points in dimension \p Dim at which a
+  /// block of a kernel with regions \p Map evaluates the function writing
+  /// \p F, i.e. the region of \p F around the points of the block that are
+  /// written back.  In the innermost dimension, the extent is rounded out to
+  /// whole threads, since their elements are evaluated together.
+  Extent getComputeExtent(const RegionMap &Map, const Field *F,
+                          unsigned Dim) const;
+
+  /// getSharedExtent - Returns the points of Shared_<F> in dimension \p Dim:
+  /// the compute extent of \p F and the neighbors that the functions of
+  /// \p Kernel read at their own compute extents.
+  Extent getSharedExtent(const FunctionList &Kernel, const RegionMap &Map,
+                         const Field *F, unsigned Dim) const;
+
+  /// getComputeGuard - Returns a condition on thislocal_<dim> that holds in
+  /// the compute extent of \p F, or an empty string if the extent is the
+  /// whole block.
+  std::string getComputeGuard(const Field *F) const;
+
+  bool                   InTS0;
+  std::set<std::string>  WrittenFields;
+  std::set<const Field*> SharedFields;
+
+  /// Compute and shared extents of the fields of the kernel being
+  /// generated, by dimension.
+  std::map<const Field*, std::vector<Extent> > ComputeExtents;
+  std::map<const Field*, std::vector<Extent> > SharedExtents;
+
+  /// Element of the unrolled innermost element loop being generated, see
+  /// codegenInteriorPoints().  Field references are relative to it.
+  unsigned              JamElement;
+
+  /// Shared subexpressions of the expression being generated, and the
+  /// number of the temporary holding them, see getTempName().
+  std::map<const Expression*, unsigned> TempIndices;
+
+  /// Invariant subexpressions of all functions, and the number of the
+  /// ot_inv_<n> variable holding them.
+  std::map<const Expression*, unsigned> InvariantIndices;
+
+  /// codegenTemps - Emits a temporary for every shared subexpression of
+  /// \p Expr.  Must precede the codegenExpr() call for \p Expr.
+  void codegenTemps(Expression *Expr, llvm::raw_ostream &OS);
+  /// codegenInvariants - Emits a variable for every invariant subexpression
+  /// of the functions, at the start of the kernel.
+  void codegenInvariants(llvm::raw_ostream &OS);
   void codegenExpr(Expression *Expr, llvm::raw_ostream &OS);
   void codegenBinaryOp(BinaryOp *Op, llvm::raw_ostream &OS);
+  /// codegenMultiplyAdd - Emits the sum or difference \p Op as a fused
+  /// multiply-add if contraction is allowed and one of its operands is a
+  /// product.  Returns false if nothing was emitted.
+  bool codegenMultiplyAdd(BinaryOp *Op, llvm::raw_ostream &OS);
+  /// codegenInteriorPoints - Emits the first bounded function of \p F at
+  /// all elements of the thread, for blocks without boundary points.
+  void codegenInteriorPoints(Function *F, llvm::raw_ostream &OS);
+  /// getJammedOffset - Returns offset \p Dim of a field reference relative
+  /// to the first element of the unrolled element loop.
+  int getJammedOffset(const std::vector<IntConstant*> &Offsets,
+                      unsigned Dim) const;
   void codegenFieldRef(FieldRef *Ref, llvm::raw_ostream &OS);
   void codegenFunctionCall(FunctionCall *FC, llvm::raw_ostream &OS);
   void codegenConstant(ConstantExpr *Expr, llvm::raw_ostream &OS);
@@ -68,8 +158,6 @@ private:
   void codegenLoads(Expression *Expr, llvm::raw_ostream &OS, std::set<std::string> &Idents);
   void codegenFieldRefLoad(FieldRef *Ref, llvm::raw_ostream &OS, std::set<std::string> &Idents);
 
-  std::string getBoundExpr(BoundExpr &Expr, unsigned Dim);
-
 
   bool useManualGrid() const {
     llvm::StringRef Machine = getMachine();
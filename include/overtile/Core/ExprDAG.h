@@ -0,0 +1,98 @@
+/*
+ * ExprDAG.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: ExprDAG.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_CORE_EXPRDAG_H
+#define OVERTILE_CORE_EXPRDAG_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace overtile {
+
+class ElementType;
+class Expression;
+class Grid;
+
+/**
+ * Hash-consing of function expressions.
+ *
+ * canonicalize() rewrites an expression so that structurally equal
+ * subexpressions are the same object, turning the expression tree into a
+ * DAG.  Since addition and multiplication are commutative in IEEE
+ * arithmetic, a+b and b+a are considered equal.  Expression nodes are never
+ * freed, so sharing them is safe.
+ */
+class ExprDAG {
+public:
+  ExprDAG();
+
+  /// canonicalize - Returns the canonical node for \p Expr, after
+  /// canonicalizing its operands in place.
+  Expression *canonicalize(Expression *Expr);
+
+  /// canonicalizeGrid - Canonicalizes the expressions of all functions of
+  /// \p G.  Doing so more than once is harmless.
+  static void canonicalizeGrid(Grid *G);
+
+private:
+
+  std::map<std::string, Expression*> Nodes;
+  std::map<Expression*, Expression*> Canonical;
+  std::map<Expression*, unsigned>    Ids;
+};
+
+/// findCommonSubexprs - Returns in \p Temps the subexpressions of \p Expr
+/// that are used more than once or bound by a let, and are worth keeping in
+/// a temporary, with operands before their users.  \p Expr should be
+/// canonical.
+/// Subexpressions that do not read fields are left to
+/// findInvariantSubexprs().
+void findCommonSubexprs(Expression *Expr, std::vector<Expression*> &Temps);
+
+/// getTempName - Returns the name of the \p Index-th temporary, holding
+/// \p Expr: ot_let_<binding>_<Index> for let bindings, and ot_cse_<Index>
+/// otherwise.
+std::string getTempName(const Expression *Expr, unsigned Index);
+
+/// findInvariantSubexprs - Returns in \p Invariants the largest
+/// subexpressions of \p Expr that depend on parameters but not on fields,
+/// and can thus be computed once per kernel call.
+void findInvariantSubexprs(Expression *Expr,
+                           std::vector<Expression*> &Invariants);
+
+/// dependsOnData - Returns true if \p Expr reads a field or a parameter,
+/// i.e. is not folded by the compiler anyway.
+bool dependsOnData(const Expression *Expr);
+
+/// readsFields - Returns true if \p Expr refers to a field.
+bool readsFields(const Expression *Expr);
+
+/// getExprType - Returns the type of the value of \p Expr in C, which is
+/// double if it depends on a double field or parameter of \p G and float
+/// otherwise.  Math functions return the type of their arguments if
+/// \p FloatCalls is set, as in CUDA, and double otherwise, as in C.  Only
+/// valid for expressions returned by findCommonSubexprs() and
+/// findInvariantSubexprs().
+const ElementType *getExprType(const Expression *Expr, const Grid *G,
+                               bool FloatCalls);
+
+}
+
+#endif
@@ -56,10 +56,17 @@ public:
   
   unsigned getClassType() const { return ClassType; }
   static inline bool classof(const Expression*) { return true; }
+
+  /// getBindingName - Returns the name of the let binding whose value this
+  /// expression is, or an empty string.  A bound expression is shared by
+  /// all uses of the binding and is evaluated once per point.
+  llvm::StringRef getBindingName() const { return BindingName; }
+  void setBindingName(llvm::StringRef Name) { BindingName = Name; }
   
 private:
 
-  ExprKind ClassType;
+  ExprKind    ClassType;
+  std::string BindingName;
 };
 
 
@@ -96,6 +103,9 @@ public:
   Expression *getRHS() { return RHS; }
   const Expression *getRHS() const { return RHS; }
 
+  void setLHS(Expression *L) { LHS = L; }
+  void setRHS(Expression *R) { RHS = R; }
+
   static inline bool classof(const BinaryOp*) { return true; }
   static inline bool classof(const Expression* E) {
     return E->getClassType() == Expression::BinOp;
@@ -152,6 +162,7 @@ public:
 
   llvm::StringRef getName() const { return Name; }
   const std::vector<Expression*> &getParameters() const { return Exprs; }
+  void setParameter(unsigned i, Expression *Expr) { Exprs[i] = Expr; }
 
   virtual void getFields(std::set<Field*> &Fields) const;
 
@@ -258,7 +269,7 @@ public:
     PH.push_back(const_cast<PlaceHolderExpr*>(this));
   }
 
-  llvm::StringRef getName() { return Name; }
+  llvm::StringRef getName() const { return Name; }
 
   static inline bool classof(const PlaceHolderExpr*) { return true; }
   static inline bool classof(const Expression* E) {
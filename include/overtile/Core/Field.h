@@ -32,6 +32,15 @@ class Grid;
  */
 class Field {
 public:
+
+  /// CopySemantic - How the values of a field are exchanged with the host,
+  /// as declared in the program.
+  enum CopySemantic {
+    CopyIn,
+    CopyOut,
+    CopyInOut
+  };
+
   Field(Grid *G, ElementType *Ty, const std::string &N);
   ~Field();
 
@@ -44,12 +53,16 @@ public:
   const ElementType *getElementType() const { return ElemTy; }
 
   const std::string &getName() const { return Name; }
+
+  CopySemantic getCopySemantic() const { return Copy; }
+  void setCopySemantic(CopySemantic C) { Copy = C; }
   
 private:
 
-  Grid        *TheGrid;
-  ElementType *ElemTy;
-  std::string  Name;
+  Grid         *TheGrid;
+  ElementType  *ElemTy;
+  std::string   Name;
+  CopySemantic  Copy;
 };
 
 }
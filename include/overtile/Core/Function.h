@@ -74,10 +74,6 @@ public:
   getMaxOffsets(const Field *F, unsigned Dim, unsigned &LeftMax,
                 unsigned &RightMax) const;
 
-  /// countFlops - Returns the number of floating-point ops computed by an
-  /// invocation of this function.
-  double countFlops() const;
-  
   //==-- Accessors --========================================================= //
   Field *getOutput() { return OutField; }
   const Field *getOutput() const { return OutField; }
@@ -89,6 +85,7 @@ public:
   const std::list<BoundedFunction> &getBoundedFunctions() const { 
     return Functions;
   }
+  std::list<BoundedFunction> &getBoundedFunctions() { return Functions; }
 
 private:
 
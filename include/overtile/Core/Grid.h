@@ -45,6 +45,11 @@ public:
   /// appendFunction - Appends the Function \p F to the list of stencil point
   /// functions that act on this grid.
   void appendFunction(Function *F);
+
+  /// isDefinedBeforeUse - Returns true if, in every time step, field \p F is
+  /// written by a function that does not read it before any function reads
+  /// it.  No value of \p F then carries over from one time step to the next.
+  bool isDefinedBeforeUse(const Field *F) const;
   
   //==-- Accessors --========================================================= //
   
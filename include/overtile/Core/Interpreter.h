@@ -0,0 +1,108 @@
+/*
+ * Interpreter.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: Interpreter.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_CORE_INTERPRETER_H
+#define OVERTILE_CORE_INTERPRETER_H
+
+#include "overtile/Core/BackEnd.h"
+#include <vector>
+
+namespace overtile {
+
+class Expression;
+class Function;
+
+/**
+ * Bytecode interpreter for SSP programs.
+ *
+ * Every bounded function is compiled to a flat tape of register
+ * instructions.  Registers hold a chunk of consecutive points along
+ * dimension 0, so each instruction is applied to a whole chunk at once and
+ * the dispatch cost is spread over many points.  Field loads point directly
+ * into the field arrays whenever no type conversion is needed.
+ *
+ * The interpreter works on host arrays laid out as expected by
+ * getCanonicalPrototype() and needs no code generation, which makes it
+ * usable both as a reference for the other back-ends and as a fallback.
+ */
+class Interpreter : public BackEnd {
+public:
+  Interpreter(Grid *G);
+  virtual ~Interpreter();
+
+  /// codegen - Writes a listing of the bytecode to \p OS.
+  virtual void codegen(llvm::raw_ostream &OS);
+
+  /// execute - Runs the program for \p TimeSteps time steps.  \p Fields
+  /// holds one host array per field in grid order, \p Dims the grid size,
+  /// and \p Params the parameter values in grid order.  Returns whether the
+  /// convergence field changed by at most \p Tolerance during the last time
+  /// step, or true if there is no convergence field.
+  bool execute(int TimeSteps, void *const *Fields, const int *Dims,
+               const double *Params, double Tolerance = 0.0);
+
+  /// Chunk of points along dimension 0 evaluated per instruction.
+  static const unsigned ChunkSize = 256;
+
+  enum Opcode {
+    LoadField,
+    LoadConst,
+    LoadParam,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Call1,
+    Call2
+  };
+
+  /// Instruction - A single bytecode instruction.  For loads, A indexes the
+  /// field, constant, or parameter tables and B the field offsets.  For
+  /// calls, C indexes the math function table.
+  struct Instruction {
+    Opcode   Op;
+    unsigned Dst;
+    unsigned A;
+    unsigned B;
+    unsigned C;
+  };
+
+  /// Tape - The compiled form of one bounded function.
+  struct Tape {
+    std::vector<Instruction>        Code;
+    std::vector<std::vector<int> >  Offsets;
+    std::vector<double>             Constants;
+    unsigned                        NumPinned;
+    unsigned                        NumRegs;
+    unsigned                        Result;
+  };
+
+private:
+
+  void compile();
+  void compileTape(Expression *Expr, Tape &T);
+
+  /// Tapes[i][j] is the tape of bounded function j of function i.
+  std::vector<std::vector<Tape> > Tapes;
+  bool                            Compiled;
+};
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * MathBuiltins.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: MathBuiltins.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_CORE_MATHBUILTINS_H
+#define OVERTILE_CORE_MATHBUILTINS_H
+
+#include "llvm/ADT/StringRef.h"
+
+namespace overtile {
+
+/**
+ * A math function that point functions may call.
+ *
+ * Calls are spelled as in C or Cuda: the float variant of a function may
+ * carry an 'f' suffix, as in sqrtf, and Cuda intrinsics a '__' prefix, as
+ * in __expf.  All spellings name the same built-in, which the back ends
+ * evaluate in the precision of its arguments.
+ */
+struct MathBuiltin {
+  /// Canonical name, e.g. "sqrt".
+  const char *Name;
+  /// Number of arguments.
+  unsigned    Arity;
+  /// Cost relative to an addition.
+  double      Weight;
+  /// The double variant in the C library that computes the function, e.g.
+  /// "fmin" for min.
+  const char *LibName;
+  /// If set, the function is the reciprocal of LibName, e.g. rsqrt.
+  bool        Reciprocal;
+};
+
+/// lookupMathBuiltin - Returns the built-in called \p Name in any of its
+/// spellings, or NULL if there is none.
+const MathBuiltin *lookupMathBuiltin(llvm::StringRef Name);
+
+}
+
+#endif
@@ -0,0 +1,223 @@
+/*
+ * OpenMPBackEnd.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: OpenMPBackEnd.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_CORE_OPENMPBACKEND_H
+#define OVERTILE_CORE_OPENMPBACKEND_H
+
+#include "overtile/Core/BackEnd.h"
+#include <map>
+#include <set>
+#include <vector>
+
+namespace overtile {
+
+class BinaryOp;
+class ConstantExpr;
+class ElementType;
+class Expression;
+class Field;
+class FieldRef;
+class Function;
+class FunctionCall;
+struct MathBuiltin;
+
+/**
+ * Back-end code generator for multi-core CPUs using OpenMP.
+ *
+ * The generated code mirrors the Cuda back-end: the grid is split into
+ * overlapping tiles of BlockSize*Elements points per dimension, and each
+ * tile is advanced TimeTileSize time steps in a private scratch buffer
+ * before its valid interior is written back.  Tiles are distributed across
+ * threads with an OpenMP worksharing loop.  If a scratch budget is set, the
+ * tile size is chosen so that the scratch buffers of a thread fit into it,
+ * typically the L2 cache size.  Otherwise, the tile size is given by the
+ * block size and elements per thread.
+ *
+ * With SplitTiling, the outermost dimension is instead cut into upright and
+ * inverted trapezoids that are evaluated in place in the global buffers, so
+ * no point is computed more than once.  With WavefrontTiling, the time steps
+ * form a pipeline over the planes of the outermost dimension, with one
+ * group of threads per time step and function.  With StreamingTiling, only
+ * the inner dimensions are tiled and each tile streams through the
+ * outermost dimension, keeping a small window of planes per time level.
+ *
+ * Away from the grid boundary, dimension 0 is evaluated with explicit SIMD
+ * code using GCC/Clang vector extensions.  The number of lanes follows from
+ * the vector width and the element type of the output field.
+ */
+class OpenMPBackEnd : public BackEnd {
+public:
+  OpenMPBackEnd(Grid *G);
+  virtual ~OpenMPBackEnd();
+
+  virtual void codegen(llvm::raw_ostream &OS);
+
+  /// isTemporary - Split, wavefront, and streaming tiles work in place in the
+  /// global buffers, so only overlapped tiles keep temporaries in scratch.
+  virtual bool isTemporary(const Field *F) const;
+
+  /// getTileSize - Overlapped and streaming tiles are grown to the scratch
+  /// budget, see computeTileSizes().  Split and wavefront tiles are as wide
+  /// as their slopes need, and streaming tiles span the outermost dimension,
+  /// so these are not tiled.
+  virtual unsigned getTileSize(unsigned Dim);
+
+  /// getVectorBits - Returns the width of the vectors used for dimension 0,
+  /// or 0 if the generated code is scalar.  The default is
+  /// getDefaultVectorBits().
+  unsigned getVectorBits() const { return VectorBits; }
+  void setVectorBits(unsigned Bits) { VectorBits = Bits; }
+
+  /// getDefaultVectorBits - Returns the widest vectors that the target
+  /// options otsc was compiled with pass in registers, e.g. 256 bits with
+  /// AVX.  Generated code compiled with the same options then does not
+  /// return vectors wider than the ABI allows (-Wpsabi).
+  static unsigned getDefaultVectorBits();
+
+  /// getUseRuntime - Returns whether the generated code runs on the
+  /// persistent worker pool of the OverTile runtime instead of OpenMP.
+  bool getUseRuntime() const { return UseRuntime; }
+  void setUseRuntime(bool Value) { UseRuntime = Value; }
+
+  /// Largest tile size chosen in any dimension when sizing tiles for the
+  /// scratch budget, so that moderately sized grids still yield enough
+  /// tiles for all threads.
+  static const unsigned MaxTileSize = 1024;
+
+private:
+
+  virtual void codegenKernel(llvm::raw_ostream &OS);
+  virtual void codegenHost(llvm::raw_ostream &OS);
+
+  unsigned              VectorBits;
+  bool                  UseRuntime;
+  bool                  FirstStep;
+  bool                  Guarded;
+  bool                  Split;
+  bool                  Stream;
+  unsigned              VectorLanes;
+  /// Rows of dimension 1 evaluated per iteration of the loop over
+  /// dimension 0, and the row being generated.  Loads and stores are
+  /// relative to the first row.
+  unsigned              JamRows;
+  unsigned              JamRow;
+  const ElementType    *VectorElementType;
+  std::set<std::string> WrittenFields;
+  std::set<std::string> UpdatedFields;
+  std::vector<unsigned> PadLeft;
+  std::vector<unsigned> PadRight;
+  std::vector<unsigned> TileSize;
+
+  /// Shared subexpressions of the expression being generated, and the
+  /// number of the temporary holding them, see getTempName().
+  std::map<const Expression*, unsigned> TempIndices;
+
+  /// Invariant subexpressions of all functions, and the number of the
+  /// ot_inv_<n> variable holding them.
+  std::map<const Expression*, unsigned> InvariantIndices;
+
+  void computeTileSizes();
+  unsigned getPitch(unsigned Dim, unsigned Tile) const;
+
+  void codegenTimeStep(llvm::raw_ostream &OS);
+  void codegenFunction(Function *F, llvm::raw_ostream &OS);
+  void codegenPointIndex(unsigned Dim, llvm::raw_ostream &OS);
+  /// codegenRow - Emits the loops over dimension 0 of a tile, evaluating
+  /// \p F at JamRows rows per iteration.
+  void codegenRow(Function *F, llvm::raw_ostream &OS);
+  void codegenPoint(Function *F, llvm::raw_ostream &OS);
+  void codegenStore(Field *Out, llvm::raw_ostream &OS);
+  void codegenVectorSupport(llvm::raw_ostream &OS);
+  /// codegenVectorMath - Emits the float and double vector implementations
+  /// of \p MB, as ot_v_<name>.  Functions without a vector implementation
+  /// are applied lane by lane; with fast math, exp, log, and rsqrt use
+  /// approximations that are not correctly rounded.
+  void codegenVectorMath(const MathBuiltin *MB, llvm::raw_ostream &OS);
+  void codegenWriteBack(llvm::raw_ostream &OS);
+
+  void codegenOverlappedTiles(llvm::raw_ostream &OS);
+  void codegenSplitTiles(llvm::raw_ostream &OS);
+  void codegenSplitFunction(Function *F, llvm::raw_ostream &OS);
+  void codegenSplitPoint(Function *F, llvm::raw_ostream &OS);
+  void codegenWavefront(llvm::raw_ostream &OS);
+  void codegenStreaming(llvm::raw_ostream &OS);
+  void codegenTileGeometry(unsigned NumTiled, llvm::raw_ostream &OS);
+  /// codegenPlaneLoops - Opens loops over the inner dimensions of a tile.
+  /// \p Range selects the padded tile (< 0), the whole tile (0), or only its
+  /// valid interior (> 0).
+  void codegenPlaneLoops(int Range, unsigned NumTiled, llvm::raw_ostream &OS);
+
+  /// getStreamRadius - Returns the largest offset in the outermost
+  /// dimension, i.e. the lag between two levels when streaming.
+  unsigned getStreamRadius() const;
+
+  /// getVersionDistance - Returns how many functions before function
+  /// \p Func the field \p Name was last written, counting across time steps.
+  unsigned getVersionDistance(const std::string &Name, unsigned Func) const;
+
+  /// getStreamDepth - Returns the number of planes in the windows of field
+  /// \p Name when streaming.
+  unsigned getStreamDepth(const std::string &Name) const;
+
+  /// The parallel constructs below expand to OpenMP pragmas, or to calls
+  /// into the runtime when getUseRuntime() is set.
+  void codegenParallelBegin(llvm::raw_ostream &OS);
+  void codegenParallelEnd(llvm::raw_ostream &OS);
+  /// codegenGroupLoops - Opens the loops over the group_i tile indices of
+  /// the first \p NumTiled dimensions, distributed over the threads.
+  void codegenGroupLoops(unsigned NumTiled, llvm::raw_ostream &OS);
+  void codegenGroupLoopsEnd(unsigned NumTiled, llvm::raw_ostream &OS);
+  /// codegenTileLoop - Opens a loop over tile = First .. num_tiles-1,
+  /// distributed over the threads.
+  void codegenTileLoop(unsigned First, llvm::raw_ostream &OS);
+  const char *getWallClock() const;
+
+  /// codegenTemps - Emits a temporary for every shared subexpression of
+  /// \p Expr.  Must precede the codegenExpr() call for \p Expr.
+  void codegenTemps(Expression *Expr, llvm::raw_ostream &OS);
+  /// codegenInvariants - Emits a variable for every invariant subexpression
+  /// of the functions, at the start of the kernel.
+  void codegenInvariants(llvm::raw_ostream &OS);
+  void codegenExpr(Expression *Expr, llvm::raw_ostream &OS);
+  void codegenBinaryOp(BinaryOp *Op, llvm::raw_ostream &OS);
+  /// codegenMultiplyAdd - Emits the sum or difference \p Op as a fused
+  /// multiply-add if contraction is allowed and one of its operands is a
+  /// product.  Returns false if nothing was emitted.
+  bool codegenMultiplyAdd(BinaryOp *Op, llvm::raw_ostream &OS);
+  void codegenFieldRef(FieldRef *Ref, llvm::raw_ostream &OS);
+  void codegenFunctionCall(FunctionCall *FC, llvm::raw_ostream &OS);
+  void codegenConstant(ConstantExpr *Expr, llvm::raw_ostream &OS);
+
+  void codegenLoads(Expression *Expr, llvm::raw_ostream &OS,
+                    std::set<std::string> &Idents);
+  void codegenFieldRefLoad(FieldRef *Ref, llvm::raw_ostream &OS,
+                           std::set<std::string> &Idents);
+
+  std::string getScratchIndex(const std::vector<int> &Offsets) const;
+  std::string getGlobalIndex(const std::vector<int> &Offsets) const;
+
+  /// getVectorLanes - Returns the number of lanes to use for the interior
+  /// of \p F, or 0 if it has to be evaluated with scalar code.
+  unsigned getVectorLanes(Function *F);
+  static std::string getVectorTypeName(const ElementType *Ty);
+};
+
+}
+
+#endif
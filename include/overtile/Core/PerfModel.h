@@ -0,0 +1,148 @@
+/*
+ * PerfModel.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: PerfModel.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_CORE_PERFMODEL_H
+#define OVERTILE_CORE_PERFMODEL_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+#include <vector>
+
+namespace overtile {
+
+class BackEnd;
+
+/// MachineModel - The resources and peak throughput of a Cuda device.
+struct MachineModel {
+  /// Creates a Fermi-class device, see setPreset().
+  MachineModel();
+
+  std::string Name;
+  unsigned    Multiprocessors;
+  unsigned    WarpSize;
+  unsigned    MaxThreadsPerBlock;
+  unsigned    MaxThreadsPerMultiprocessor;
+  unsigned    MaxBlocksPerMultiprocessor;
+  unsigned    SharedBytesPerMultiprocessor;
+  unsigned    SharedBytesPerBlock;
+  unsigned    RegistersPerMultiprocessor;
+  unsigned    MaxRegistersPerThread;
+  double      PeakGFlopsFP32;
+  double      PeakGFlopsFP64;
+  double      BandwidthGBs;
+  /// Occupancy at which a multiprocessor hides the latency of memory and
+  /// arithmetic.  Below it, throughput drops proportionally.
+  double      SaturationOccupancy;
+
+  /// setPreset - Sets all members to those of the device \p Name: gt200
+  /// (GTX 280), fermi (Tesla C2050), or kepler (Tesla K20).  Returns false
+  /// if the device is not known.
+  bool setPreset(llvm::StringRef Name);
+
+  /// parse - Overrides members from the 'key: value' lines of \p Text, with
+  /// the keys printed by print().  Lines starting with '#' are comments.
+  /// Returns false and sets \p Err if a line cannot be parsed.
+  bool parse(llvm::StringRef Text, std::string &Err);
+
+  /// print - Writes the members to \p OS in the format read by parse().
+  void print(llvm::raw_ostream &OS) const;
+};
+
+/// KernelPrediction - The predicted behavior of one kernel of a program.
+struct KernelPrediction {
+  KernelPrediction();
+
+  /// Halo of a block by dimension, from the union of the field regions.
+  std::vector<int>      HaloLeft;
+  std::vector<int>      HaloRight;
+  unsigned              NumFunctions;
+  unsigned              ThreadsPerBlock;
+  /// Points a block writes back per time step and function.
+  double                UsefulPoints;
+  /// Points at which a block evaluates functions per time step, summed
+  /// over the functions, from the region of each output.
+  double                ComputedPoints;
+  uint64_t              ScratchBytes;
+  unsigned              Registers;
+  unsigned              BlocksPerMultiprocessor;
+  double                Occupancy;
+
+  /// Per useful point and time step: weighted operations, loads from
+  /// registers or scratch, and values and bytes moved to and from global
+  /// memory.
+  double                Flops;
+  double                OnChipLoads;
+  double                GlobalLoads;
+  double                GlobalStores;
+  double                GlobalBytes;
+
+  /// Predicted time per useful point and time step, and whether it is
+  /// limited by arithmetic or by memory bandwidth.
+  double                Seconds;
+  bool                  MemoryBound;
+
+  /// Reason why the kernel cannot be launched, or empty.
+  std::string           Invalid;
+
+  /// getRedundancy - Returns the fraction of evaluations that recompute
+  /// points of neighboring blocks.
+  double getRedundancy() const;
+};
+
+/**
+ * Analytical performance model for Cuda tile configurations.
+ *
+ * The model predicts from the regions that BackEnd::run() computes for the
+ * configured block size, elements per thread, and time tile size, without
+ * generating or compiling code.  It is meant to rank configurations rather
+ * than to predict absolute run times: every kernel runs at the lower of its
+ * arithmetic and memory throughput, scaled by its occupancy and by the
+ * unused lanes of partial warps.
+ */
+class PerfModel {
+public:
+  PerfModel(const BackEnd &B, const MachineModel &M);
+
+  const std::vector<KernelPrediction> &getKernels() const { return Kernels; }
+
+  /// isValid - Returns true if every kernel can be launched.
+  bool isValid() const;
+
+  /// getGStencils - Returns the predicted number of points updated per
+  /// second for all functions, in billions, or 0 if the configuration is
+  /// not valid.
+  double getGStencils() const;
+
+  /// print - Writes the configuration and the prediction to \p OS as a
+  /// JSON object.
+  void print(llvm::raw_ostream &OS) const;
+
+private:
+  void predictKernel(unsigned Kernel, KernelPrediction &KP) const;
+
+  const BackEnd                 &BE;
+  const MachineModel            &Machine;
+  std::vector<KernelPrediction>  Kernels;
+};
+
+}
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Reciprocals.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: Reciprocals.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_CORE_RECIPROCALS_H
+#define OVERTILE_CORE_RECIPROCALS_H
+
+#include <map>
+#include <set>
+
+namespace overtile {
+
+class Expression;
+class Grid;
+
+/**
+ * Strength reduction of divisions into multiplications by reciprocals.
+ *
+ * Division by a power of two becomes multiplication by its reciprocal,
+ * which is exact.  In fast-math mode, so does division by any other
+ * constant, by an expression of parameters only, whose reciprocal the back
+ * ends compute once per kernel call (see findInvariantSubexprs()), and by
+ * an expression that is divided by more than once per point, whose
+ * reciprocal is then computed once and shared by all of the divisions.
+ */
+class DivisionReducer {
+public:
+  DivisionReducer(const Grid *G, bool FastMath);
+
+  /// reduce - Returns \p Expr with divisions reduced.  \p Expr should be
+  /// canonical, so that repeated divisors are the same node.
+  Expression *reduce(Expression *Expr);
+
+  /// reduceGrid - Reduces the divisions of all functions of \p G.
+  static void reduceGrid(Grid *G, bool FastMath);
+
+private:
+
+  void countDivisors(Expression *Expr, std::set<Expression*> &Visited);
+  Expression *reduceNode(Expression *Expr);
+
+  const Grid                        *TheGrid;
+  bool                               FastMath;
+  std::map<Expression*, unsigned>    Divisors;
+  std::map<Expression*, Expression*> Reciprocals;
+  std::map<Expression*, Expression*> Reduced;
+};
+
+}
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * ResourceCheck.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: ResourceCheck.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_CORE_RESOURCECHECK_H
+#define OVERTILE_CORE_RESOURCECHECK_H
+
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+#include <vector>
+
+namespace overtile {
+
+class BackEnd;
+struct MachineModel;
+
+/// KernelResources - The resources that a block of one kernel needs.
+struct KernelResources {
+  KernelResources();
+
+  /// Points of a block by dimension, including the halo on either side.  A
+  /// dimension that is not tiled has a tile size of 0.
+  std::vector<unsigned> TileSize;
+  std::vector<int>      HaloLeft;
+  std::vector<int>      HaloRight;
+
+  /// Cuda only: threads, shared memory, and the estimated registers of a
+  /// thread, of which BufferRegisters hold the Buffer_<field> arrays.
+  unsigned              Threads;
+  uint64_t              ScratchBytes;
+  unsigned              BufferRegisters;
+  unsigned              Registers;
+
+  /// getUsefulPoints - Returns the points of the block in dimension \p Dim
+  /// that are not in its halo, which is not positive if the halo covers the
+  /// whole block.
+  int getUsefulPoints(unsigned Dim) const {
+    return int(TileSize[Dim]) - HaloLeft[Dim] - HaloRight[Dim];
+  }
+};
+
+/**
+ * Static check of the resources that a tile configuration needs.
+ *
+ * The check uses the kernels and regions computed by BackEnd::run(), so no
+ * code is generated.  In every tiled dimension, a block must have points
+ * left once its halo is removed; otherwise the generated code divides by
+ * zero or never covers the grid.  With a device model, a Cuda block must
+ * also stay within the threads and shared memory of a block, and within the
+ * registers of a multiprocessor.  Registers beyond the per-thread limit
+ * only spill to local memory, which is reported as a warning.
+ */
+class ResourceCheck {
+public:
+  /// ResourceCheck - Checks the configuration of \p B against the limits of
+  /// the device \p M, or only the halos if \p M is NULL.
+  ResourceCheck(BackEnd &B, const MachineModel *M);
+
+  /// check - Checks the configuration again, after it has been changed and
+  /// BackEnd::retile() has been called.
+  void check();
+
+  /// isFeasible - Returns true if the configuration has no errors.
+  bool isFeasible() const { return Errors.empty(); }
+
+  const std::vector<KernelResources> &getKernels() const { return Kernels; }
+  const std::vector<std::string> &getErrors() const { return Errors; }
+  const std::vector<std::string> &getWarnings() const { return Warnings; }
+
+  /// clamp - Changes the configuration of the back end to the feasible one
+  /// with the fewest steps from it, where a step halves or doubles the
+  /// block size in one dimension, adds or removes an element per thread, or
+  /// removes a time step from the time tile.  The time tile is never grown.
+  /// Returns false and keeps the configuration if there is none within
+  /// MaxClampStates configurations.
+  bool clamp();
+
+  /// print - Writes the configuration, the resources of every kernel, and
+  /// the errors and warnings to \p OS in YAML.
+  void print(llvm::raw_ostream &OS) const;
+
+  /// getConfiguration - Returns the configuration of \p BE as #pragma sdsl
+  /// begin attributes, e.g. "block:32,8 tile:1,2 time:4".
+  static std::string getConfiguration(const BackEnd &BE);
+
+  /// getRegisters - Returns an estimate of the registers that a thread of
+  /// kernel \p Kernel of \p BE needs for indices and addresses, the values
+  /// it loads for a point, and its Buffer_<field> arrays, whose registers
+  /// are returned in \p BufferRegs.
+  static unsigned getRegisters(const BackEnd &BE, unsigned Kernel,
+                               unsigned &BufferRegs);
+
+  /// Registers a thread needs besides field values: indices, addresses, and
+  /// loop counters.
+  static const unsigned BaseRegisters = 16;
+
+  /// Most configurations that clamp() tries.
+  static const unsigned MaxClampStates = 4096;
+
+private:
+  void checkKernel(unsigned Kernel, KernelResources &KR);
+
+  BackEnd                       &BE;
+  const MachineModel            *Machine;
+  std::vector<KernelResources>   Kernels;
+  std::vector<std::string>       Errors;
+  std::vector<std::string>       Warnings;
+};
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Simplify.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: Simplify.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_CORE_SIMPLIFY_H
+#define OVERTILE_CORE_SIMPLIFY_H
+
+#include "overtile/Core/Expressions.h"
+#include <map>
+
+namespace overtile {
+
+class ConstantExpr;
+class Grid;
+
+/**
+ * Constant folding and algebraic simplification of function expressions.
+ *
+ * In strict mode, only rewrites that give bit-identical results in IEEE
+ * arithmetic are done: constant operations are folded in single precision,
+ * as the generated code would evaluate them, x*1, x/1, and x-0 become x,
+ * constants are moved to the right of + and *, and adding or subtracting a
+ * negative constant becomes subtracting or adding its negation.  Integer
+ * constants are only folded if C and floating-point semantics agree, e.g.
+ * 6/3 but not 1/2.
+ *
+ * In fast-math mode, constants are folded in double precision, x+0, x*0,
+ * x-x, and x/x are removed, chains of constant operations such as
+ * (x*2)*3 are reassociated, and negations written as 0-x are propagated.
+ */
+class ExprSimplifier {
+public:
+  explicit ExprSimplifier(bool FastMath);
+
+  /// simplify - Returns the simplified form of \p Expr.  Operands are
+  /// simplified in place, so shared subexpressions stay shared.
+  Expression *simplify(Expression *Expr);
+
+  /// simplifyGrid - Simplifies the expressions of all functions of \p G.
+  static void simplifyGrid(Grid *G, bool FastMath);
+
+private:
+
+  Expression *simplifyBinaryOp(BinaryOp *Op);
+  Expression *reassociate(BinaryOp *Op);
+  ConstantExpr *fold(BinaryOp::Operator Op, const ConstantExpr *L,
+                     const ConstantExpr *R) const;
+
+  bool                               FastMath;
+  std::map<Expression*, Expression*> Simplified;
+};
+
+}
+
+#endif
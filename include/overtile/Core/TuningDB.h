@@ -0,0 +1,105 @@
+/*
+ * TuningDB.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: TuningDB.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_CORE_TUNINGDB_H
+#define OVERTILE_CORE_TUNINGDB_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+#include <vector>
+
+namespace overtile {
+
+class Grid;
+
+/// TuningEntry - The best tile configuration found for a program on a
+/// target and machine, for problems of one size bucket.
+struct TuningEntry {
+  TuningEntry();
+
+  /// Key, see TuningDB::getGridHash() and TuningDB::getSizeBucket().  An
+  /// empty machine string is written as '-'.
+  std::string           Hash;
+  std::string           Target;
+  std::string           Machine;
+  int                   SizeBucket;
+
+  std::vector<unsigned> Block;
+  std::vector<unsigned> Elements;
+  unsigned              Time;
+
+  /// Name of the program, kept as a comment for readers of the file.
+  std::string           Program;
+
+  /// getAttributes - Returns the configuration as #pragma sdsl begin
+  /// attributes, e.g. "block:32,8 tile:1,2 time:4".
+  std::string getAttributes() const;
+};
+
+/**
+ * Database of tuned tile configurations.
+ *
+ * Every line of the file holds one entry: the hash of the program, the
+ * target, the machine, the size bucket, and the block:, tile:, and time:
+ * attributes, separated by whitespace.  Text after '#' is a comment.
+ * Programs are identified by the hash of a normalized form, so that
+ * formatting, comments, and the names of the program, its fields, and its
+ * parameters do not matter.
+ */
+class TuningDB {
+public:
+
+  /// getGridHash - Returns the hash of the normalized form of \p G, as 16
+  /// hexadecimal digits.  \p G must not have been run through a back end,
+  /// which simplifies its expressions.
+  static std::string getGridHash(const Grid *G);
+
+  /// getSizeBucket - Returns the size bucket of a problem with \p Points
+  /// grid points, the integral part of its base 2 logarithm.
+  static int getSizeBucket(uint64_t Points);
+
+  /// parse - Adds the entries in \p Text.  Returns false and sets \p Err if
+  /// a line cannot be parsed.
+  bool parse(llvm::StringRef Text, std::string &Err);
+
+  /// print - Writes all entries to \p OS in the format read by parse().
+  void print(llvm::raw_ostream &OS) const;
+
+  /// lookup - Returns the entry for the program with hash \p Hash on
+  /// \p Target and \p Machine whose size bucket is closest to
+  /// \p SizeBucket, preferring the larger of two, or NULL if there is none.
+  /// If \p SizeBucket is negative, the size is not known and the entry of
+  /// the largest size is returned.
+  const TuningEntry *lookup(llvm::StringRef Hash, llvm::StringRef Target,
+                            llvm::StringRef Machine, int SizeBucket) const;
+
+  /// insert - Adds \p E, replacing the entry with the same key.
+  void insert(const TuningEntry &E);
+
+  bool empty() const { return Entries.empty(); }
+
+private:
+  std::vector<TuningEntry> Entries;
+};
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * JITEngine.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: JITEngine.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_JIT_JITENGINE_H
+#define OVERTILE_JIT_JITENGINE_H
+
+#include "overtile/Core/BackEnd.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+class ExecutionEngine;
+class LLVMContext;
+class Module;
+}
+
+namespace overtile {
+
+/**
+ * In-process execution engine for SSP programs.
+ *
+ * The grid is lowered directly to LLVM IR, optimized, and compiled with the
+ * LLVM JIT.  The resulting host entry point has the same signature as
+ * getCanonicalPrototype(), so it can be called exactly like the code
+ * generated by the other back-ends:
+ *
+ *   JITEngine JE(G);
+ *   JE.run();
+ *   typedef void (*ProgramTy)(int, float*, int, int);
+ *   ProgramTy P = reinterpret_cast<ProgramTy>(JE.compile(Err));
+ *
+ * Unlike the source back-ends, the JIT engine does not tile the iteration
+ * space.  Time steps and functions are evaluated in order over the whole
+ * grid, which gives the same results as the tiled code.
+ */
+class JITEngine : public BackEnd {
+public:
+  JITEngine(Grid *G);
+  virtual ~JITEngine();
+
+  /// codegen - Writes the optimized LLVM IR for the program to \p OS.
+  virtual void codegen(llvm::raw_ostream &OS);
+
+  /// compile - Lowers, optimizes, and JIT compiles the program, returning a
+  /// pointer to the host entry point.  Returns NULL and sets \p ErrMsg if
+  /// the program could not be compiled, e.g. if it calls a function that is
+  /// not a math built-in.  The code is only compiled once; subsequent calls
+  /// return the same entry point.
+  void *compile(std::string &ErrMsg);
+
+  /// specializeDimension - Generate code for a grid that is always \p Size
+  /// points wide in dimension \p Dim.  The Dim_<n> argument is still part of
+  /// the entry point signature, but the program traps if it does not match.
+  void specializeDimension(unsigned Dim, unsigned Size);
+
+  unsigned getSpecializedDimension(unsigned Dim) const {
+    return Dim < DimSizes.size() ? DimSizes[Dim] : 0;
+  }
+
+  /// getOptLevel - Returns the optimization level (0-3) used for the IR.
+  unsigned getOptLevel() const { return OptLevel; }
+  void setOptLevel(unsigned L) { OptLevel = L; }
+
+private:
+
+  /// buildModule - Returns the module for the program, or NULL with the
+  /// reason in \p ErrMsg.
+  llvm::Module *buildModule(llvm::LLVMContext &Ctx, std::string &ErrMsg);
+  void optimizeModule(llvm::Module *M);
+
+  std::vector<unsigned>  DimSizes;
+  unsigned               OptLevel;
+  llvm::LLVMContext     *Context;
+  llvm::ExecutionEngine *Engine;
+  void                  *EntryPoint;
+};
+
+}
+
+#endif
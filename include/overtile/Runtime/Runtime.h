@@ -0,0 +1,115 @@
+/*
+ * Runtime.h: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: Runtime.h
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#ifndef OVERTILE_RUNTIME_RUNTIME_H
+#define OVERTILE_RUNTIME_RUNTIME_H
+
+#include <stddef.h>
+
+/*
+ * Runtime support for generated CPU code.
+ *
+ * The runtime keeps a pool of persistent worker threads, pinned to cores,
+ * that is started on first use.  A call to ot_rt_run() hands a task to all
+ * workers and returns once every worker has finished it, so no threads are
+ * created per kernel invocation.  The calling thread acts as worker 0.
+ *
+ * Inside of a task, workers synchronize with ot_rt_barrier() and share
+ * tiles through a work-stealing queue:
+ *
+ *   ot_rt_tiles_reset(Worker, NumTiles);
+ *   for (long Tile; (Tile = ot_rt_next_tile(Worker)) >= 0; ) {
+ *     ...
+ *   }
+ *
+ * Memory from ot_rt_alloc() is first touched in parallel, with worker w
+ * touching the w-th of NumWorkers equal parts.  This is the part holding
+ * the tiles that worker w initially owns in a loop over the outermost
+ * dimension, so on NUMA machines every worker mostly accesses memory of its
+ * own socket.
+ *
+ * The number of workers is the number of online cores, or the value of the
+ * OT_NUM_THREADS environment variable.  The threads of the pool are pinned
+ * so that consecutive workers share a socket; setting OT_PIN_THREADS=0
+ * disables pinning.  The affinity of the calling thread is never changed.
+ * Tasks must not call ot_rt_run(), ot_rt_alloc(), or ot_rt_copy().
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// ot_rt_task - A task run by every worker.
+typedef void (*ot_rt_task)(void *Arg, int Worker);
+
+/// ot_rt_init - Starts the worker pool with NumWorkers workers, or one per
+/// core if NumWorkers is 0.  Does nothing if the pool is already running.
+void ot_rt_init(int NumWorkers);
+
+/// ot_rt_shutdown - Stops the worker pool.  Called automatically at exit.
+void ot_rt_shutdown(void);
+
+/// ot_rt_num_workers - Returns the number of workers, starting the pool if
+/// needed.
+int ot_rt_num_workers(void);
+
+/// ot_rt_run - Runs Task(Arg, Worker) on every worker and waits for all of
+/// them to finish.
+void ot_rt_run(ot_rt_task Task, void *Arg);
+
+/// ot_rt_barrier - Waits until all workers have reached the barrier.
+void ot_rt_barrier(int Worker);
+
+/// ot_rt_tiles_reset - Collectively starts a new loop over NumTiles tiles.
+/// Every worker initially owns a contiguous range of tiles.
+void ot_rt_tiles_reset(int Worker, long NumTiles);
+
+/// ot_rt_next_tile - Returns the next tile for Worker, stealing from other
+/// workers once its own range is empty, or -1 if no tiles are left.
+long ot_rt_next_tile(int Worker);
+
+/// ot_rt_shared - Collectively returns a zero-initialized buffer of at least
+/// Bytes bytes that is shared by all workers for the current task.
+void *ot_rt_shared(int Worker, size_t Bytes);
+
+/// ot_rt_alloc - Returns a page-aligned, zero-initialized buffer of Bytes
+/// bytes placed by the workers, or NULL on failure.  Free with ot_rt_free().
+void *ot_rt_alloc(size_t Bytes);
+
+/// ot_rt_copy - Copies Bytes bytes from Src to Dst, split over the workers
+/// like ot_rt_alloc(), so that Dst keeps its placement.
+void ot_rt_copy(void *Dst, const void *Src, size_t Bytes);
+
+/// ot_rt_part - Returns the offset of the part of a buffer of Bytes bytes
+/// that Worker touches in ot_rt_alloc() and ot_rt_copy().  The part of
+/// Worker ends where the part of Worker+1 begins, and the part of
+/// NumWorkers begins at Bytes.
+size_t ot_rt_part(size_t Bytes, int Worker);
+
+/// ot_rt_free - Frees a buffer returned by ot_rt_alloc().
+void ot_rt_free(void *Ptr);
+
+/// ot_rt_wtime - Returns the wall clock time in seconds.
+double ot_rt_wtime(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -18,19 +18,30 @@
  */
 
 #include "overtile/Core/BackEnd.h"
+#include "overtile/Core/ExprDAG.h"
 #include "overtile/Core/Field.h"
 #include "overtile/Core/Function.h"
 #include "overtile/Core/Grid.h"
+#include "overtile/Core/Reciprocals.h"
+#include "overtile/Core/Simplify.h"
+#include "overtile/Core/Types.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <set>
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
 
+using namespace llvm;
+
 namespace overtile {
 
 BackEnd::BackEnd(Grid *G)
-  : TheGrid(G), TimeTileSize(1), ConvergeField(NULL) {
+  : TheGrid(G), RequestedTimeTileSize(1), TimeTileSize(1), Tiling(OverlappedTiling), FastMath(false),
+    Contraction(false), ScratchBudget(0), Verbose(false),
+    ConvergeField(NULL) {
   assert(G != NULL && "G cannot be NULL");
 
   BlockSize = new unsigned[G->getNumDimensions()];
@@ -41,15 +52,6 @@ BackEnd::BackEnd(Grid *G)
     BlockSize[i] = 8;
     Elements[i]  = 1;
   }
-  
-  const std::list<Field*> &Fields     = G->getFieldList();
-  unsigned                 Dimensions = G->getNumDimensions();
-
-  // Create initial region for each field.
-  for (std::list<Field*>::const_iterator I = Fields.begin(),
-         E = Fields.end(); I != E; ++I) {
-    Regions.insert(std::make_pair<Field*, Region>(*I, Region(Dimensions)));
-  }
 }
 
 BackEnd::~BackEnd() {
@@ -67,27 +69,115 @@ void BackEnd::run() {
       llvm::errs() << "Tile Size (" << i << "): " << Elements[i] << "\n";
     }
   }
-  
-  generateTiling();
+
+  // Constant arithmetic is folded before the regions are computed, since
+  // simplification in fast-math mode may drop field references.
+  ExprSimplifier::simplifyGrid(TheGrid, FastMath);
+  DivisionReducer::reduceGrid(TheGrid, FastMath);
+
+  // Structurally equal subexpressions become shared nodes, which the code
+  // generators evaluate only once per point.
+  ExprDAG::canonicalizeGrid(TheGrid);
+
+  retile();
+}
+
+void BackEnd::retile() {
+  partitionKernels();
+
+  Regions.clear();
+  Regions.resize(Kernels.size());
+  for (unsigned i = 0, e = Kernels.size(); i != e; ++i) {
+    generateTiling(Kernels[i], TimeTileSize, Regions[i], Verbose);
+  }
 }
 
-void BackEnd::generateTiling() {
+void BackEnd::partitionKernels() {
+  const std::list<Function*> &Functions = TheGrid->getFunctionList();
+
+  Kernels.assign(1, FunctionList(Functions.begin(), Functions.end()));
+  TimeTileSize = RequestedTimeTileSize;
+
+  if (ScratchBudget == 0) {
+    return;
+  }
+
+  // Keep the functions fused with fewer time steps per tile if that fits.
+  uint64_t Bytes = getScratchBytes(Kernels[0], TimeTileSize);
+  while (Bytes > ScratchBudget && TimeTileSize > 1) {
+    if (Verbose) {
+      llvm::errs() << "Fused kernel needs " << Bytes << " bytes of scratch "
+                   << "with time tile " << TimeTileSize << ", budget is "
+                   << ScratchBudget << "\n";
+    }
+    --TimeTileSize;
+    Bytes = getScratchBytes(Kernels[0], TimeTileSize);
+  }
+
+  if (Bytes <= ScratchBudget) {
+    return;
+  }
+
+  if (Verbose) {
+    llvm::errs() << "Fused kernel needs " << Bytes << " bytes of scratch, "
+                 << "budget is " << ScratchBudget << "\n";
+  }
+
+  // Grow each kernel by the next function as long as it fits.  A function
+  // that does not fit on its own still gets a kernel of its own.
+  Kernels.clear();
+  for (std::list<Function*>::const_iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    if (!Kernels.empty()) {
+      FunctionList Fused(Kernels.back());
+      Fused.push_back(*I);
+      if (getScratchBytes(Fused, 1) <= ScratchBudget) {
+        Kernels.back().push_back(*I);
+        continue;
+      }
+    }
+    Kernels.push_back(FunctionList(1, *I));
+  }
+
   if (Verbose) {
+    for (unsigned i = 0, e = Kernels.size(); i != e; ++i) {
+      llvm::errs() << "Kernel " << i << ": <";
+      for (FunctionList::const_iterator I = Kernels[i].begin(),
+             B = I, E = Kernels[i].end(); I != E; ++I) {
+        if (I != B) llvm::errs() << ", ";
+        llvm::errs() << (*I)->getOutput()->getName();
+      }
+      llvm::errs() << "> (" << getScratchBytes(Kernels[i], 1) << " bytes)\n";
+    }
+  }
+}
+
+void BackEnd::generateTiling(const FunctionList &Functions,
+                             unsigned TimeTile, RegionMap &Map,
+                             bool Print) const {
+  const std::list<Field*> &Fields     = TheGrid->getFieldList();
+  unsigned                 Dimensions = TheGrid->getNumDimensions();
+
+  // Create initial region for each field.
+  for (std::list<Field*>::const_iterator I = Fields.begin(),
+         E = Fields.end(); I != E; ++I) {
+    Map.insert(std::make_pair<Field*, Region>(*I, Region(Dimensions)));
+  }
+
+  if (Print) {
     llvm::errs() << "Initial Regions:\n";
     const std::list<Field*> &Fields = TheGrid->getFieldList();
 
     for (std::list<Field*>::const_iterator I = Fields.begin(),
            E = Fields.end(); I != E; ++I) {
-      const Field *F = Regions.find(*I)->first;
-      Region &R = Regions.find(*I)->second;
+      const Field *F = Map.find(*I)->first;
+      Region &R = Map.find(*I)->second;
       llvm::errs() << "Field `" << F->getName() << "': ";
       R.dump(llvm::errs());
       llvm::errs() << "\n";
     }
   }
 
-  const std::list<Function*> &Functions = TheGrid->getFunctionList();
-  
   // Generate list of fields in update order
   std::list<Field*> UpdateOrder;
   
@@ -97,7 +187,7 @@ void BackEnd::generateTiling() {
     UpdateOrder.push_back((*I)->getOutput());
   }
 
-  if (Verbose) {
+  if (Print) {
     llvm::errs() << "Field update order: <";
     for (std::list<Field*>::iterator I = UpdateOrder.begin(),
            B = I, E = UpdateOrder.end(); I != E; ++I) {
@@ -110,40 +200,40 @@ void BackEnd::generateTiling() {
 
   
   // Iterate for T time steps
-  for (unsigned i = 0; i < TimeTileSize; ++i) {
-    unsigned T = TimeTileSize - i - 1;
-    if (Verbose) llvm::errs() << "Iterating time step " << T << "\n";
+  for (unsigned i = 0; i < TimeTile; ++i) {
+    unsigned T = TimeTile - i - 1;
+    if (Print) llvm::errs() << "Iterating time step " << T << "\n";
 
     // Get list of stencil point functions
-    for (std::list<Function*>::const_reverse_iterator I = Functions.rbegin(),
+    for (FunctionList::const_reverse_iterator I = Functions.rbegin(),
            E = Functions.rend(); I != E; ++I) {
       const Function *F = *I;
       const Field *Out = F->getOutput();
-      Region &OutRegion = Regions.find(Out)->second;
+      Region &OutRegion = Map.find(Out)->second;
       std::set<Field*> Input = F->getInputFields();
 
-      if (Verbose) {
+      if (Print) {
         llvm::errs() << "Looking at output field " << Out->getName() << "\n";
       }
       
       // For each input field, make sure we are producing enough elements
       for (std::set<Field*>::iterator FI = Input.begin(), FE  = Input.end();
              FI                                              != FE; ++FI) {
-        Region &FRegion                                       = Regions.find(*FI)->second;
+        Region &FRegion                                       = Map.find(*FI)->second;
         Region  OriginalOut(OutRegion);
-        F->adjustRegion(*FI, FRegion, OriginalOut, UpdateOrder, (i == TimeTileSize-1));
+        F->adjustRegion(*FI, FRegion, OriginalOut, UpdateOrder, (i == TimeTile-1));
       }
     }
   }
 
-  if (Verbose) {
+  if (Print) {
     llvm::errs() << "Final Regions:\n";
     const std::list<Field*> &Fields = TheGrid->getFieldList();
 
     for (std::list<Field*>::const_iterator I = Fields.begin(),
            E = Fields.end(); I != E; ++I) {
-      const Field *F = Regions.find(*I)->first;
-      Region &R = Regions.find(*I)->second;
+      const Field *F = Map.find(*I)->first;
+      Region &R = Map.find(*I)->second;
       llvm::errs() << "Field `" << F->getName() << "': ";
       R.dump(llvm::errs());
       llvm::errs() << "\n";
@@ -151,4 +241,194 @@ void BackEnd::generateTiling() {
   }
 }
 
+
+Region BackEnd::getBlockRegion(unsigned Kernel) const {
+  return getBlockRegion(Regions[Kernel]);
+}
+
+Region BackEnd::getBlockRegion(const RegionMap &Map) const {
+  Region BlockRegion(TheGrid->getNumDimensions());
+
+  for (RegionMap::const_iterator I = Map.begin(), E = Map.end();
+       I != E; ++I) {
+    BlockRegion = Region::makeUnion(BlockRegion, I->second);
+  }
+
+  return BlockRegion;
+}
+
+bool BackEnd::getHalo(unsigned Kernel, unsigned Dim, int &Left,
+                      int &Right) const {
+  std::pair<int, unsigned> Bound = getBlockRegion(Kernel).getBound(Dim);
+
+  // The region spans [first, first+second-1] around the element.
+  Left  = -Bound.first;
+  Right = Bound.first + int(Bound.second) - 1;
+
+  return Left >= 0 && Right >= 0;
+}
+
+unsigned BackEnd::getTileSize(unsigned Dim) {
+  return getElements(Dim)*getBlockSize(Dim);
+}
+
+void BackEnd::getMaxOffsets(unsigned Dim, unsigned &LeftMax,
+                            unsigned &RightMax) const {
+  const std::list<Field*>    &Fields    = TheGrid->getFieldList();
+  const std::list<Function*> &Functions = TheGrid->getFunctionList();
+
+  LeftMax  = 0;
+  RightMax = 0;
+
+  for (std::list<Field*>::const_iterator I = Fields.begin(),
+         E = Fields.end(); I != E; ++I) {
+    for (std::list<Function*>::const_iterator FI = Functions.begin(),
+           FE = Functions.end(); FI != FE; ++FI) {
+      unsigned Left  = 0;
+      unsigned Right = 0;
+      (*FI)->getMaxOffsets(*I, Dim, Left, Right);
+      LeftMax  = std::max(LeftMax, Left);
+      RightMax = std::max(RightMax, Right);
+    }
+  }
+}
+
+uint64_t BackEnd::getScratchBytes(const FunctionList &Kernel,
+                                  unsigned TimeTile) const {
+  return 0;
+}
+
+bool BackEnd::isCopiedOut(const Field *F) const {
+  return F->getCopySemantic() != Field::CopyIn || F == ConvergeField;
+}
+
+bool BackEnd::isTemporary(const Field *F) const {
+  return !isCopiedOut(F) && TheGrid->isDefinedBeforeUse(F);
+}
+
+std::string BackEnd::getCanonicalPrototype() {
+
+  std::string              Ret;
+  llvm::raw_string_ostream OS(Ret);
+  
+  Grid                 *G         = getGrid();
+  std::list<Function*>  Functions = G->getFunctionList();
+
+  if (getConvergeField()) {
+    OS << "bool ";
+  } else {
+    OS << "void ";
+  }
+
+  OS << "ot_program_" << G->getName() << "(int timesteps";
+    
+  // Generate in/out parameters for each field
+  std::list<Field*> Fields = G->getFieldList();
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E  = Fields.end();
+       I                                                 != E; ++I) {
+    Field *F                                              = *I;
+    OS << ", ";
+    OS << getTypeName(F->getElementType()) << " *Host_" << F->getName();
+  }
+  for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
+    OS << ", int Dim_" << i;
+  }
+
+  typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+  const ParamList Params = G->getParameters();
+
+  for (ParamList::const_iterator I = Params.begin(), E = Params.end(); I != E;
+       ++I) {
+    OS << ", " << getTypeName(I->second) << " " << I->first;
+  }
+
+  if (getConvergeField()) {
+    OS << ", " << getTypeName(getConvergeField()->getElementType()) << " Tolerance";
+  }
+
+  OS << ");\n";
+
+  OS.flush();
+  return Ret;
+}
+
+std::string BackEnd::getCanonicalInvocation(StringRef TimeStepExpr,
+                                                StringRef ConvTolExpr) {
+
+  std::string              Ret;
+  llvm::raw_string_ostream OS(Ret);
+  
+  Grid                 *G         = getGrid();
+  std::list<Function*>  Functions = G->getFunctionList();
+
+  if (getConvergeField()) {
+    OS << "bool Converged = ";
+  }
+
+  OS << "ot_program_" << G->getName() << "(" << TimeStepExpr;
+    
+  // Generate in/out parameters for each field
+  std::list<Field*> Fields = G->getFieldList();
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E  = Fields.end();
+       I                                                 != E; ++I) {
+    Field *F                                              = *I;
+    OS << ", ";
+    OS << F->getName();
+  }
+  for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
+    OS << ", Dim_" << i;
+  }
+
+  typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+  const ParamList Params = G->getParameters();
+
+  for (ParamList::const_iterator I = Params.begin(), E = Params.end(); I != E;
+       ++I) {
+    OS << ", " << I->first;
+  }
+
+  if (getConvergeField()) {
+    OS << ", " << ConvTolExpr;
+  }
+
+  OS << ");\n";
+
+  OS.flush();
+  return Ret;
+}
+
+
+std::string BackEnd::getTypeName(const ElementType *Ty) {
+  if (isa<FP32Type>(Ty)) {
+    return "float";
+  } else if (isa<FP64Type>(Ty)) {
+    return "double";
+  } else {
+    report_fatal_error("Unknown type");
+  }
+}
+
+std::string BackEnd::getBoundExpr(const BoundExpr &Expr, unsigned Dim) const {
+  std::string Ret;
+  raw_string_ostream Str(Ret);
+
+  Str << "(";
+  if (Expr.Base == (unsigned)(-1)) {
+    Str << "Dim_" << Dim;
+    Str << "-";
+    Str << Expr.Constant;
+    Str << "-1";
+  } else {
+    Str << Expr.Base;
+    Str << "+";
+    Str << Expr.Constant;
+  }
+  Str << ")";
+
+  Str.flush();
+  return Ret;
+}
+
 }
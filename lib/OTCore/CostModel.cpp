@@ -0,0 +1,210 @@
+/*
+ * CostModel.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: CostModel.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Core/CostModel.h"
+#include "overtile/Core/Field.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Grid.h"
+#include "overtile/Core/MathBuiltins.h"
+#include "overtile/Core/Types.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
+#include <map>
+#include <set>
+#include <string>
+
+using namespace llvm;
+
+namespace overtile {
+
+namespace {
+
+/// Weight of calls to functions that are not built-ins.
+const double UnknownCallWeight = 8.0;
+
+/// getSize - Returns the size in bytes of a value of type \p Ty.
+unsigned getSize(const ElementType *Ty) {
+  return isa<FP64Type>(Ty) ? 8 : 4;
+}
+
+/// addBytes - Adds the size of a value of type \p Ty to the memory traffic
+/// of \p Cost.
+void addBytes(PointCost &Cost, const ElementType *Ty) {
+  if (isa<FP64Type>(Ty)) {
+    Cost.FP64Bytes += getSize(Ty);
+  } else {
+    Cost.FP32Bytes += getSize(Ty);
+  }
+}
+
+/// CostVisitor - Accumulates the cost of an expression.
+class CostVisitor {
+public:
+  CostVisitor(PointCost &C)
+    : Cost(C) {}
+
+  /// visitExpr - Adds the cost of \p Expr, and returns true if it reads
+  /// fields.
+  bool visitExpr(const Expression *Expr) {
+    // Shared subexpressions, e.g. let bindings, are evaluated only once.
+    std::map<const Expression*, bool>::iterator Memo = Visited.find(Expr);
+    if (Memo != Visited.end()) {
+      return Memo->second;
+    }
+
+    bool Reads = false;
+
+    if (const BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+      Reads = visitExpr(Op->getLHS());
+      Reads = visitExpr(Op->getRHS()) || Reads;
+      if (Reads) {
+        Cost.Flops         += 1.0;
+        Cost.WeightedFlops += CostModel::getOpWeight(Op->getOperator());
+      }
+    } else if (const FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+      const std::vector<Expression*> &Params = FC->getParameters();
+      for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+        Reads = visitExpr(Params[i]) || Reads;
+      }
+      if (Reads) {
+        Cost.Flops         += 1.0;
+        Cost.WeightedFlops += CostModel::getCallWeight(FC->getName());
+      }
+    } else if (const FieldRef *Ref = dyn_cast<FieldRef>(Expr)) {
+      const std::vector<IntConstant*> &Offsets = Ref->getOffsets();
+
+      std::string Key = Ref->getField()->getName();
+      for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
+        Key += "," + Offsets[i]->getStringValue();
+      }
+      if (Refs.insert(Key).second) ++Cost.Loads;
+
+      if (Fields.insert(Ref->getField()).second) {
+        addBytes(Cost, Ref->getField()->getElementType());
+      }
+      Reads = true;
+    } else if (!isa<ConstantExpr>(Expr) && !isa<PlaceHolderExpr>(Expr)) {
+      report_fatal_error("Unhandled expression type");
+    }
+
+    Visited[Expr] = Reads;
+    return Reads;
+  }
+
+private:
+  PointCost                         &Cost;
+  std::map<const Expression*, bool>  Visited;
+  std::set<std::string>              Refs;
+  std::set<const Field*>             Fields;
+};
+
+}
+
+PointCost::PointCost()
+  : Flops(0.0), WeightedFlops(0.0), Loads(0), Stores(0), FP32Bytes(0),
+    FP64Bytes(0) {
+}
+
+PointCost &PointCost::operator+=(const PointCost &RHS) {
+  Flops         += RHS.Flops;
+  WeightedFlops += RHS.WeightedFlops;
+  Loads         += RHS.Loads;
+  Stores        += RHS.Stores;
+  FP32Bytes     += RHS.FP32Bytes;
+  FP64Bytes     += RHS.FP64Bytes;
+  return *this;
+}
+
+PointCost CostModel::getFunctionCost(const Function *F) {
+  PointCost Cost;
+
+  const std::list<BoundedFunction> &BFuncs = F->getBoundedFunctions();
+  if (BFuncs.empty()) {
+    return Cost;
+  }
+
+  CostVisitor V(Cost);
+  V.visitExpr(BFuncs.front().Expr);
+
+  Cost.Stores = 1;
+  addBytes(Cost, F->getOutput()->getElementType());
+  return Cost;
+}
+
+PointCost CostModel::getGridCost(const Grid *G) {
+  const std::list<Function*> &Functions = G->getFunctionList();
+  PointCost                   Cost;
+
+  for (std::list<Function*>::const_iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    Cost += getFunctionCost(*I);
+  }
+  return Cost;
+}
+
+double CostModel::getOpWeight(BinaryOp::Operator Op) {
+  switch (Op) {
+  case BinaryOp::ADD:
+  case BinaryOp::SUB:
+  case BinaryOp::MUL:
+    return 1.0;
+  case BinaryOp::DIV:
+    return 4.0;
+  }
+  report_fatal_error("Unknown operator");
+}
+
+double CostModel::getCallWeight(StringRef Name) {
+  if (const MathBuiltin *MB = lookupMathBuiltin(Name)) {
+    return MB->Weight;
+  }
+  return UnknownCallWeight;
+}
+
+namespace {
+/// printCost - Writes the members of \p Cost with indentation \p Indent.
+void printCost(const PointCost &Cost, StringRef Indent, raw_ostream &OS) {
+  OS << Indent << "flops: " << format("%g", Cost.Flops) << "\n";
+  OS << Indent << "weighted-flops: " << format("%g", Cost.WeightedFlops)
+     << "\n";
+  OS << Indent << "loads: " << Cost.Loads << "\n";
+  OS << Indent << "stores: " << Cost.Stores << "\n";
+  OS << Indent << "bytes-fp32: " << Cost.FP32Bytes << "\n";
+  OS << Indent << "bytes-fp64: " << Cost.FP64Bytes << "\n";
+  OS << Indent << "bytes: " << Cost.getBytes() << "\n";
+  OS << Indent << "intensity: " << format("%g", Cost.getIntensity()) << "\n";
+}
+}
+
+void CostModel::print(const Grid *G, raw_ostream &OS) {
+  const std::list<Function*> &Functions = G->getFunctionList();
+
+  OS << "program: " << G->getName() << "\n";
+  OS << "functions:\n";
+  for (std::list<Function*>::const_iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    OS << "  - output: " << (*I)->getOutput()->getName() << "\n";
+    printCost(getFunctionCost(*I), "    ", OS);
+  }
+  OS << "total:\n";
+  printCost(getGridCost(G), "  ", OS);
+}
+
+}
@@ -18,13 +18,17 @@
  */
 
 #include "overtile/Core/CudaBackEnd.h"
+#include "overtile/Core/CostModel.h"
+#include "overtile/Core/ExprDAG.h"
 #include "overtile/Core/Expressions.h"
 #include "overtile/Core/Field.h"
 #include "overtile/Core/Function.h"
 #include "overtile/Core/Grid.h"
 #include "overtile/Core/Types.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/ErrorHandling.h"
+#include <algorithm>
 #include <cmath>
 
 using namespace llvm;
@@ -44,7 +48,8 @@ char getDimensionIndex(unsigned Dim) {
 namespace overtile {
 
 CudaBackEnd::CudaBackEnd(Grid *G)
-  : BackEnd(G) {
+  : BackEnd(G), JamElement(0) {
+  setScratchBudget(48*1024);
 }
 
 CudaBackEnd::~CudaBackEnd() {
@@ -55,14 +60,137 @@ void CudaBackEnd::codegen(llvm::raw_ostream &OS) {
   codegenHost(OS);
 }
 
-void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
+bool CudaBackEnd::isTemporary(const Field *F) const {
+  if (!BackEnd::isTemporary(F)) return false;
 
-  WrittenFields.clear();
+  const std::vector<FunctionList> &Kernels = getKernels();
+  unsigned                         Users   = 0;
 
-  std::set<std::string> Idents;
-  
-  Grid                 *G         = getGrid();
-  std::list<Function*>  Functions = G->getFunctionList();
+  for (unsigned k = 0, e = Kernels.size(); k != e; ++k) {
+    bool Uses = false;
+    for (FunctionList::const_iterator I = Kernels[k].begin(),
+           E = Kernels[k].end(); I != E; ++I) {
+      Uses |= (*I)->getOutput() == F ||
+              (*I)->getInputFields().count(const_cast<Field*>(F)) > 0;
+    }
+    if (Uses) ++Users;
+  }
+  return Users <= 1;
+}
+
+uint64_t CudaBackEnd::getScratchBytes(const FunctionList &Kernel,
+                                      unsigned TimeTile) const {
+  std::set<const Field*> Shared;
+  getSharedFields(Kernel, TimeTile, Shared);
+
+  RegionMap Map;
+  generateTiling(Kernel, TimeTile, Map, false);
+
+  uint64_t Bytes = 0;
+  for (std::set<const Field*>::const_iterator I = Shared.begin(),
+         E = Shared.end(); I != E; ++I) {
+    uint64_t Points = 1;
+    for (unsigned i = 0, e = getGrid()->getNumDimensions(); i < e; ++i) {
+      Extent Ext = getSharedExtent(Kernel, Map, *I, i);
+      Points *= Ext.second - Ext.first + 1;
+    }
+    Bytes += Points * (isa<FP32Type>((*I)->getElementType()) ? 4 : 8);
+  }
+  return Bytes;
+}
+
+std::string CudaBackEnd::getKernelSuffix(unsigned Kernel) const {
+  if (getKernels().size() == 1) return "";
+  return "_" + utostr(Kernel);
+}
+
+void CudaBackEnd::getSharedFields(const FunctionList &Kernel,
+                                  unsigned TimeTile,
+                                  std::set<const Field*> &Shared) const {
+  std::set<const Field*> Written;
+
+  Shared.clear();
+
+  // After the first time step, the kernel reads all of its outputs from
+  // shared memory.
+  if (TimeTile > 1) {
+    for (FunctionList::const_iterator I = Kernel.begin(), E = Kernel.end();
+         I != E; ++I) {
+      Written.insert((*I)->getOutput());
+    }
+  }
+
+  for (FunctionList::const_iterator I = Kernel.begin(), E = Kernel.end();
+       I != E; ++I) {
+    std::set<Field*> Inputs = (*I)->getInputFields();
+    for (std::set<Field*>::iterator FI = Inputs.begin(), FE = Inputs.end();
+         FI != FE; ++FI) {
+      if (Written.count(*FI)) Shared.insert(*FI);
+    }
+    Written.insert((*I)->getOutput());
+  }
+}
+
+CudaBackEnd::Extent CudaBackEnd::getComputeExtent(const RegionMap &Map,
+                                                  const Field *F,
+                                                  unsigned Dim) const {
+  unsigned                 NumDims = getGrid()->getNumDimensions();
+  std::pair<int, unsigned> Block   = getBlockRegion(Map).getBound(Dim);
+  std::pair<int, unsigned> Own     = Map.find(F)->second.getBound(Dim);
+  int                      Size    = getElements(Dim)*getBlockSize(Dim);
+
+  // The block region is the union of all regions, so a field needs fewer
+  // points on either side of the written-back points than the halo has.
+  int First = Own.first - Block.first;
+  int Last  = Size - 1 - (int)(Block.first + Block.second)
+                       + (int)(Own.first + Own.second);
+
+  if (NumDims > 1 && Dim == NumDims-1) {
+    int Elems = getElements(Dim);
+    First = (First / Elems) * Elems;
+    Last  = (Last / Elems + 1) * Elems - 1;
+  }
+
+  return Extent(std::max(First, 0), std::min(Last, Size-1));
+}
+
+CudaBackEnd::Extent CudaBackEnd::getSharedExtent(const FunctionList &Kernel,
+                                                 const RegionMap &Map,
+                                                 const Field *F,
+                                                 unsigned Dim) const {
+  Extent Ext = getComputeExtent(Map, F, Dim);
+
+  for (FunctionList::const_iterator I = Kernel.begin(), E = Kernel.end();
+       I != E; ++I) {
+    if ((*I)->getInputFields().count(const_cast<Field*>(F)) == 0) continue;
+
+    unsigned Left  = 0;
+    unsigned Right  = 0;
+    (*I)->getMaxOffsets(F, Dim, Left, Right);
+
+    Extent Reader = getComputeExtent(Map, (*I)->getOutput(), Dim);
+    Ext.first  = std::min(Ext.first, Reader.first - (int)Left);
+    Ext.second = std::max(Ext.second, Reader.second + (int)Right);
+  }
+  return Ext;
+}
+
+std::string CudaBackEnd::getComputeGuard(const Field *F) const {
+  const std::vector<Extent> &Exts = ComputeExtents.find(F)->second;
+  std::string                Guard;
+
+  for (unsigned i = 0, e = Exts.size(); i != e; ++i) {
+    int Size = getElements(i)*getBlockSize(i);
+    if (Exts[i].first == 0 && Exts[i].second == Size-1) continue;
+
+    if (!Guard.empty()) Guard += " && ";
+    Guard += "thislocal_" + utostr(i) + " >= " + itostr(Exts[i].first) +
+             " && thislocal_" + utostr(i) + " <= " + itostr(Exts[i].second);
+  }
+  return Guard;
+}
+
+void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
 
   OS << "//\n"
      << "// Generated by OverTile\n"
@@ -71,8 +199,25 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
      << "// CUDA device code\n"
      << "//\n";
 
+  for (unsigned i = 0, e = getKernels().size(); i != e; ++i) {
+    codegenKernel(i, OS);
+  }
+}
+
+void CudaBackEnd::codegenKernel(unsigned Kernel, llvm::raw_ostream &OS) {
+
+  WrittenFields.clear();
+
+  std::set<std::string> Idents;
+  
+  Grid                 *G         = getGrid();
+  FunctionList          Functions = getKernels()[Kernel];
+
+  getSharedFields(Functions, getTimeTileSize(), SharedFields);
+
   OS << "__global__\n"
-     << "static void ot_kernel_" << G->getName() << "(";
+     << "static void ot_kernel_" << G->getName() << getKernelSuffix(Kernel)
+     << "(";
 
   // Generate in/out parameters for each field
   std::list<Field*> Fields = G->getFieldList();
@@ -120,56 +265,40 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
     OS << "  const int GridDim_z = gridDim.z;\n";
   }
   
-  std::string        SharedSizeDecl;
-  raw_string_ostream SharedSizeStr(SharedSizeDecl);
+  codegenInvariants(OS);
 
-  SharedMaxLeft.resize(G->getNumDimensions(), 0);
-  
-  for (int i = G->getNumDimensions()-1, e = 0; i >= e; --i) {
-    // Find max offsets for all fields.
-    unsigned MaxLeft                      = 0;
-    unsigned MaxRight                     = 0;
-    
-    for (std::list<Field*>::iterator I = Fields.begin(), E  = Fields.end();
-         I                                                 != E; ++I) {
-      Field      *InField                                   = *I;
-      for (std::list<Function*>::iterator FI = Functions.begin(),
-             FE                                             = Functions.end(); FI != FE; ++FI) {
-        Function *F                                         = *FI;
-        unsigned  LeftOffset                                = 0;
-        unsigned  RightOffset                               = 0;
-        F->getMaxOffsets(InField, i, LeftOffset, RightOffset);
-        MaxLeft                                             = std::max(MaxLeft, LeftOffset);
-        MaxRight                                            = std::max(MaxRight, RightOffset);
-      }
-    }
+  // Every field is computed only where the kernel needs it, and its shared
+  // array only covers the points that are computed or read.
+  const RegionMap &Map = getRegionMap(Kernel);
 
-    SharedMaxLeft[i] = MaxLeft;
-
-    SharedSizeStr << '[' << getElements(i)*getBlockSize(i) << "+" << MaxLeft << "+" << MaxRight << ']';
+  ComputeExtents.clear();
+  SharedExtents.clear();
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
+      ComputeExtents[*I].push_back(getComputeExtent(Map, *I, i));
+      SharedExtents[*I].push_back(getSharedExtent(Functions, Map, *I, i));
+    }
   }
-  SharedSizeStr.flush();
 
   for (std::list<Field*>::iterator I = Fields.begin(), E  = Fields.end(), B = I;
        I                                                 != E; ++I) {
     Field *F                                              = *I;
-    OS << "  __shared__ " << getTypeName(F->getElementType()) << " Shared_" << F->getName()
-       << SharedSizeDecl << ";\n";
+    if (SharedFields.count(F) == 0) continue;
+    OS << "  __shared__ " << getTypeName(F->getElementType()) << " Shared_" << F->getName();
+    for (int i = G->getNumDimensions()-1, e = 0; i >= e; --i) {
+      const Extent &Ext = SharedExtents[F][i];
+      OS << '[' << (Ext.second - Ext.first + 1) << ']';
+    }
+    OS << ";\n";
   }
   
-  Region          BlockRegion(G->getNumDimensions());
-  // Determine region for an entire block
-  for (std::map<const Field*, Region>::const_iterator
-         I          = getRegionMap().begin(),
-         E          = getRegionMap().end(); I != E; ++I) {
-    const Region &R = I->second;
-    BlockRegion     = Region::makeUnion(BlockRegion, R);
-  }
-    
+  // Determine the halo of an entire block
   for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-    std::pair<int, unsigned> Bound     = BlockRegion.getBound(i);
-    int                      LeftHalo  = Bound.first < 0 ? -Bound.first : Bound.first;
-    int                      RightHalo = Bound.second - LeftHalo - 1;
+    int LeftHalo, RightHalo;
+    if (!getHalo(Kernel, i, LeftHalo, RightHalo)) {
+      report_fatal_error("Negative halo in dimension " + utostr(i));
+    }
     OS << "  const int Halo_Left_" << i << " = " << LeftHalo << ";\n";
     OS << "  const int Halo_Right_" << i << " = " << RightHalo << ";\n";
   }
@@ -272,6 +401,8 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
       }
     }
 
+    std::string Guard = getComputeGuard(Out);
+    if (!Guard.empty()) OS << "  if (" << Guard << ") {\n";
 
     const std::list<BoundedFunction> &BFuncs = F->getBoundedFunctions();
     for (std::list<BoundedFunction>::const_iterator I = BFuncs.begin(), E = BFuncs.end(), B = I; I != E; ++I) {
@@ -303,6 +434,9 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
 
       const ElementType *ETy = F->getOutput()->getElementType();
       
+      codegenTemps(BF.Expr, OS);
+
+      
       OS << "  " << getTypeName(ETy) << " Res = ";
       codegenExpr(BF.Expr, OS);
       OS << ";\n";
@@ -366,6 +500,7 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
     OS << " = 0;\n";
     
     OS << "  }\n";
+    if (!Guard.empty()) OS << "  }\n";
     for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
       OS << "  }\n";
     }
@@ -376,41 +511,17 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
 
     // Non-boundary case
 
-    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-      OS << "  for (unsigned elem_" << i << " = 0; elem_" << i << " < ts_" << i << "; ++elem_" << i << ") {\n";
-      if (i != 0) {
-        OS   << "  int thisid_" << i << " = tid_" << i << " + elem_" << i << ";\n";
-        OS << "  int thislocal_" << i << " = threadIdx." << getDimensionIndex(i) << "*ts_" << i << " + elem_" << i << ";\n";
-      } else {
-        OS << "  int thisid_" << i << " = tid_" << i << " + elem_" << i << "*blockDim." << getDimensionIndex(i) << ";\n";
-        OS << "  int thislocal_" << i << " = local_" << i << " + elem_" << i << "*blockDim." << getDimensionIndex(i) << ";\n";
-      }
-    }
-
-    BoundedFunction BF = *(BFuncs.begin());
-
-    Idents.clear();
-    codegenLoads(BF.Expr, OS, Idents);
-
-    ETy = F->getOutput()->getElementType();
-    
-    OS << "  " << getTypeName(ETy) << " Res = ";
-    codegenExpr(BF.Expr, OS);
-    OS << ";\n";
-    
-    OS << "  Buffer_" << Out->getName();
-    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-      OS << "[elem_" << (G->getNumDimensions()-i-1) << "]";
-    }
-    OS << " = Res;\n";
-    
-    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-      OS << "  }\n";
-    }
+    codegenInteriorPoints(F, OS);
 
     // End Non-Boundary Case
 
     OS << "  }\n";
+
+    // Outputs that are not read again in the kernel stay in registers.
+    if (SharedFields.count(Out) == 0) {
+      WrittenFields.insert(Out->getName());
+      continue;
+    }
     
     OS << "  __syncthreads();\n";
 
@@ -448,15 +559,17 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
     */
 
 
+    if (!Guard.empty()) OS << "  if (" << Guard << ") {\n";
     OS << "Shared_" << Out->getName();
     for (int i = G->getNumDimensions()-1, e = 0; i >= e; --i) {
-      OS << "[thislocal_" << i << "+" << SharedMaxLeft[i] << "]";
+      OS << "[thislocal_" << i << "+" << -SharedExtents[Out][i].first << "]";
     }
     OS << " = Buffer_" << Out->getName();
     for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
       OS << "[elem_" << (G->getNumDimensions()-i-1) << "]";
     }
     OS << ";\n";
+    if (!Guard.empty()) OS << "  }\n";
 
 
     
@@ -469,9 +582,80 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
     WrittenFields.insert(Out->getName());
   }
 
+  if (getTimeTileSize() > 1) {
+    codegenRemainingTimeSteps(Functions, OS);
+  }
+
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E                                                    = Functions.end(); I != E; ++I) {
+    Function *F                                               = *I;
+    Field    *Out                                             = F->getOutput();
+
+    // Temporaries are recomputed in every time step, so the next kernel
+    // launch never reads them.
+    if (isTemporary(Out)) continue;
 
+    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
+      OS << "  for (unsigned elem_" << i << " = 0; elem_" << i << " < ts_" << i << "; ++elem_" << i << ") {\n";
+      if (i != 0) {
+        OS << "  int thisid_" << i << " = tid_" << i << " + elem_" << i << ";\n";
+        OS << "  int thislocal_" << i << " = threadIdx." << getDimensionIndex(i) << "*ts_" << i << " + elem_" << i << ";\n";
+      } else {
+        OS << "  int thisid_" << i << " = tid_" << i << " + elem_" << i << "*blockDim." << getDimensionIndex(i) << ";\n";
+        OS << "  int thislocal_" << i << " = local_" << i << " + elem_" << i << "*blockDim." << getDimensionIndex(i) << ";\n";
+      }
+    }
+    // Output guard
+    OS << "      if (";
+    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
+      if (i != 0) OS << " && ";
+      OS << "(thislocal_" << i << " >= Halo_Left_" << i
+         << " && thislocal_" << i << " < blockDim." << getDimensionIndex(i)
+         << "*ts_" << i << " - Halo_Right_" << i << " && thisid_" << i
+         << " >= " << /*Bounds[i].first*/0 << " && thisid_" << i
+         << " < Dim_" << i << " - " << /*Bounds[i].second*/0 << ")";
+
+    }
+    OS << ") {\n";
+
+    //OS << "        OUT_FIELD_REF(" << Out->getName() << ") = temp_"
+    //   << Out->getName() << ";\n";
+    OS << "AddrOffset = ";
+    unsigned DimTerms = 0;
+    unsigned Dim      = 0;
+    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
+      if (i != 0) OS << " + ";
+      OS << "thisid_" << i;
+      for (unsigned i = 0; i < DimTerms; ++i) {
+        OS << "*Dim_" << i;
+      }
+      ++DimTerms;
+      ++Dim;
+    }
+    OS << ";\n";
+    OS << "*(Out_" << Out->getName() << " + AddrOffset) = Buffer_" << Out->getName();
+    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
+      OS << "[elem_" << (G->getNumDimensions()-i-1) << "]";
+    }
+    OS << ";\n";
     
+    OS << "      }\n";
+
+    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
+      OS << "  }\n";
+    }
+  }
   
+  // End of kernel
+  OS << "} // End of kernel\n";
+}
+
+void CudaBackEnd::codegenRemainingTimeSteps(FunctionList &Functions,
+                                            llvm::raw_ostream &OS) {
+  std::set<std::string> Idents;
+
+  Grid *G = getGrid();
+
   OS << "  // Remaining time steps\n";
   InTS0 = false;
 
@@ -502,7 +686,11 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
       }
     }
 
-    OS << "{\n";
+    std::string Guard = getComputeGuard(Out);
+    if (!Guard.empty())
+      OS << "if (" << Guard << ") {\n";
+    else
+      OS << "{\n";
 
     const std::list<BoundedFunction> &BFuncs = F->getBoundedFunctions();
     for (std::list<BoundedFunction>::const_iterator I = BFuncs.begin(), E = BFuncs.end(), B = I; I != E; ++I) {
@@ -534,6 +722,9 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
 
       const ElementType *ETy = F->getOutput()->getElementType();
       
+      codegenTemps(BF.Expr, OS);
+
+      
       OS << "  " << getTypeName(ETy) << " Res = ";
       codegenExpr(BF.Expr, OS);
       OS << ";\n";
@@ -558,6 +749,8 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
 
     OS << "}\n";
 
+    if (SharedFields.count(Out) == 0) continue;
+
     OS << " __syncthreads();\n";
     
     for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
@@ -573,6 +766,7 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
 
 
     OS << "    if (";
+    if (!Guard.empty()) OS << Guard << " && ";
 
     // for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
     //   if (i != 0) OS << " && ";
@@ -621,7 +815,7 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
 
     OS << "Shared_" << Out->getName();
     for (int i = G->getNumDimensions()-1, e = 0; i >= e; --i) {
-      OS << "[thislocal_" << i << "+" << SharedMaxLeft[i] << "]";
+      OS << "[thislocal_" << i << "+" << -SharedExtents[Out][i].first << "]";
     }
     OS << " = Buffer_" << Out->getName();
     for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
@@ -653,48 +847,12 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
     Function *F                                               = *I;
     Field    *Out                                             = F->getOutput();
 
-    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-      OS << "  for (unsigned elem_" << i << " = 0; elem_" << i << " < ts_" << i << "; ++elem_" << i << ") {\n";
-      if (i != 0) {
-        OS << "  int thisid_" << i << " = tid_" << i << " + elem_" << i << ";\n";
-        OS << "  int thislocal_" << i << " = threadIdx." << getDimensionIndex(i) << "*ts_" << i << " + elem_" << i << ";\n";
-      } else {
-        OS << "  int thisid_" << i << " = tid_" << i << " + elem_" << i << "*blockDim." << getDimensionIndex(i) << ";\n";
-        OS << "  int thislocal_" << i << " = local_" << i << " + elem_" << i << "*blockDim." << getDimensionIndex(i) << ";\n";
-      }
-    }
-
-    OS << "{\n";
-
     const std::list<BoundedFunction> &BFuncs = F->getBoundedFunctions();
-  
-    BoundedFunction BF = *(BFuncs.begin());
+    std::string                       Guard  = getComputeGuard(Out);
 
-    OS << "{\n";
+    codegenInteriorPoints(F, OS);
 
-    Idents.clear();
-    codegenLoads(BF.Expr, OS, Idents);
-
-    const ElementType *ETy = F->getOutput()->getElementType();
-    
-    OS << "  " << getTypeName(ETy) << " Res = ";
-    codegenExpr(BF.Expr, OS);
-    OS << ";\n";
-    
-    OS << "  Buffer_" << Out->getName();
-    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-      OS << "[elem_" << (G->getNumDimensions()-i-1) << "]";
-    }
-    OS << " = Res;\n";
-    
-    OS << "  }\n";
-
-
-    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-      OS << "  }\n";
-    }
-
-    OS << "}\n";
+    if (SharedFields.count(Out) == 0) continue;
 
     OS << " __syncthreads();\n";
     
@@ -711,6 +869,7 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
 
 
     OS << "    if (";
+    if (!Guard.empty()) OS << Guard << " && ";
 
     // for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
     //   if (i != 0) OS << " && ";
@@ -759,7 +918,7 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
 
     OS << "Shared_" << Out->getName();
     for (int i = G->getNumDimensions()-1, e = 0; i >= e; --i) {
-      OS << "[thislocal_" << i << "+" << SharedMaxLeft[i] << "]";
+      OS << "[thislocal_" << i << "+" << -SharedExtents[Out][i].first << "]";
     }
     OS << " = Buffer_" << Out->getName();
     for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
@@ -782,161 +941,74 @@ void CudaBackEnd::codegenDevice(llvm::raw_ostream &OS) {
     
 
   OS << "}\n";
-
-  for (std::list<Function*>::iterator I = Functions.begin(),
-         E                                                    = Functions.end(); I != E; ++I) {
-    Function *F                                               = *I;
-    Field    *Out                                             = F->getOutput();
-
-    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-      OS << "  for (unsigned elem_" << i << " = 0; elem_" << i << " < ts_" << i << "; ++elem_" << i << ") {\n";
-      if (i != 0) {
-        OS << "  int thisid_" << i << " = tid_" << i << " + elem_" << i << ";\n";
-        OS << "  int thislocal_" << i << " = threadIdx." << getDimensionIndex(i) << "*ts_" << i << " + elem_" << i << ";\n";
-      } else {
-        OS << "  int thisid_" << i << " = tid_" << i << " + elem_" << i << "*blockDim." << getDimensionIndex(i) << ";\n";
-        OS << "  int thislocal_" << i << " = local_" << i << " + elem_" << i << "*blockDim." << getDimensionIndex(i) << ";\n";
-      }
-    }
-    // Output guard
-    OS << "      if (";
-    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-      if (i != 0) OS << " && ";
-      OS << "(thislocal_" << i << " >= Halo_Left_" << i
-         << " && thislocal_" << i << " < blockDim." << getDimensionIndex(i)
-         << "*ts_" << i << " - Halo_Right_" << i << " && thisid_" << i
-         << " >= " << /*Bounds[i].first*/0 << " && thisid_" << i
-         << " < Dim_" << i << " - " << /*Bounds[i].second*/0 << ")";
-
-    }
-    OS << ") {\n";
-
-    //OS << "        OUT_FIELD_REF(" << Out->getName() << ") = temp_"
-    //   << Out->getName() << ";\n";
-    OS << "AddrOffset = ";
-    unsigned DimTerms = 0;
-    unsigned Dim      = 0;
-    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-      if (i != 0) OS << " + ";
-      OS << "thisid_" << i;
-      for (unsigned i = 0; i < DimTerms; ++i) {
-        OS << "*Dim_" << i;
-      }
-      ++DimTerms;
-      ++Dim;
-    }
-    OS << ";\n";
-    OS << "*(Out_" << Out->getName() << " + AddrOffset) = Buffer_" << Out->getName();
-    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-      OS << "[elem_" << (G->getNumDimensions()-i-1) << "]";
-    }
-    OS << ";\n";
-    
-    OS << "      }\n";
-
-    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-      OS << "  }\n";
-    }
-  }
-  
-  // End of kernel
-  OS << "} // End of kernel\n";
 }
 
-std::string CudaBackEnd::getCanonicalPrototype() {
-
-  std::string              Ret;
-  llvm::raw_string_ostream OS(Ret);
-  
-  Grid                 *G         = getGrid();
-  std::list<Function*>  Functions = G->getFunctionList();
-
-  if (getConvergeField()) {
-    OS << "bool ";
-  } else {
-    OS << "void ";
-  }
-
-  OS << "ot_program_" << G->getName() << "(int timesteps";
-    
-  // Generate in/out parameters for each field
-  std::list<Field*> Fields = G->getFieldList();
-
-  for (std::list<Field*>::iterator I = Fields.begin(), E  = Fields.end();
-       I                                                 != E; ++I) {
-    Field *F                                              = *I;
-    OS << ", ";
-    OS << getTypeName(F->getElementType()) << " *Host_" << F->getName();
-  }
-  for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-    OS << ", int Dim_" << i;
-  }
-
-  typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
-  const ParamList Params = G->getParameters();
-
-  for (ParamList::const_iterator I = Params.begin(), E = Params.end(); I != E;
-       ++I) {
-    OS << ", " << getTypeName(I->second) << " " << I->first;
+void CudaBackEnd::codegenInteriorPoints(Function *F, llvm::raw_ostream &OS) {
+  Grid     *G       = getGrid();
+  unsigned  NumDims = G->getNumDimensions();
+  Field    *Out     = F->getOutput();
+
+  // The elements of a thread are adjacent in every dimension but 0, where
+  // they are a block apart.  The innermost element loop is unrolled, and
+  // its elements share the loads of the neighbors they have in common.
+  unsigned Jam      = NumDims > 1 ? NumDims-1 : NumDims;
+  unsigned NumElems = NumDims > 1 ? getElements(Jam) : 1;
+
+  for (unsigned i = 0; i < Jam; ++i) {
+    OS << "  for (unsigned elem_" << i << " = 0; elem_" << i << " < ts_" << i << "; ++elem_" << i << ") {\n";
+    if (i != 0) {
+      OS << "  int thisid_" << i << " = tid_" << i << " + elem_" << i << ";\n";
+      OS << "  int thislocal_" << i << " = threadIdx." << getDimensionIndex(i) << "*ts_" << i << " + elem_" << i << ";\n";
+    } else {
+      OS << "  int thisid_" << i << " = tid_" << i << " + elem_" << i << "*blockDim." << getDimensionIndex(i) << ";\n";
+      OS << "  int thislocal_" << i << " = local_" << i << " + elem_" << i << "*blockDim." << getDimensionIndex(i) << ";\n";
+    }
   }
 
-  if (getConvergeField()) {
-    OS << ", " << getTypeName(getConvergeField()->getElementType()) << " Tolerance";
+  OS << "{\n";
+  if (Jam < NumDims) {
+    OS << "  int thisid_" << Jam << " = tid_" << Jam << ";\n";
+    OS << "  int thislocal_" << Jam << " = threadIdx." << getDimensionIndex(Jam) << "*ts_" << Jam << ";\n";
   }
 
-  OS << ");\n";
-
-  OS.flush();
-  return Ret;
-}
-
-std::string CudaBackEnd::getCanonicalInvocation(StringRef TimeStepExpr,
-                                                StringRef ConvTolExpr) {
+  // thislocal_<Jam> is the first element of the thread, which is in the
+  // compute extent exactly if all elements are.
+  std::string Guard = getComputeGuard(Out);
+  if (!Guard.empty()) OS << "if (" << Guard << ") {\n";
 
-  std::string              Ret;
-  llvm::raw_string_ostream OS(Ret);
-  
-  Grid                 *G         = getGrid();
-  std::list<Function*>  Functions = G->getFunctionList();
+  const BoundedFunction &BF  = *(F->getBoundedFunctions().begin());
+  const ElementType     *ETy = Out->getElementType();
+  std::set<std::string>  Idents;
 
-  if (getConvergeField()) {
-    OS << "bool Converged = ";
-  }
-
-  OS << "ot_program_" << G->getName() << "(" << TimeStepExpr;
-    
-  // Generate in/out parameters for each field
-  std::list<Field*> Fields = G->getFieldList();
+  for (JamElement = 0; JamElement < NumElems; ++JamElement) {
+    codegenLoads(BF.Expr, OS, Idents);
 
-  for (std::list<Field*>::iterator I = Fields.begin(), E  = Fields.end();
-       I                                                 != E; ++I) {
-    Field *F                                              = *I;
-    OS << ", ";
-    OS << F->getName();
-  }
-  for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-    OS << ", Dim_" << i;
-  }
+    OS << "{\n";
+    codegenTemps(BF.Expr, OS);
 
-  typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
-  const ParamList Params = G->getParameters();
+    OS << "  " << getTypeName(ETy) << " Res = ";
+    codegenExpr(BF.Expr, OS);
+    OS << ";\n";
 
-  for (ParamList::const_iterator I = Params.begin(), E = Params.end(); I != E;
-       ++I) {
-    OS << ", " << I->first;
+    OS << "  Buffer_" << Out->getName();
+    for (int i = NumDims-1; i >= 0; --i) {
+      if ((unsigned)i == Jam)
+        OS << "[" << JamElement << "]";
+      else
+        OS << "[elem_" << i << "]";
+    }
+    OS << " = Res;\n";
+    OS << "}\n";
   }
+  JamElement = 0;
 
-  if (getConvergeField()) {
-    OS << ", " << ConvTolExpr;
+  if (!Guard.empty()) OS << "}\n";
+  OS << "}\n";
+  for (unsigned i = 0; i < Jam; ++i) {
+    OS << "  }\n";
   }
-
-  OS << ");\n";
-
-  OS.flush();
-  return Ret;
 }
 
-
 void CudaBackEnd::codegenHost(llvm::raw_ostream &OS) {
   Grid                 *G         = getGrid();
   std::list<Function*>  Functions = G->getFunctionList();
@@ -1005,65 +1077,68 @@ void CudaBackEnd::codegenHost(llvm::raw_ostream &OS) {
        I                                                 != E; ++I) {
     Field *F                                              = *I;
     OS << "  " << getTypeName(F->getElementType()) << " *device" << F->getName() << "_In;\n";
-    OS << "  " << getTypeName(F->getElementType()) << " *device" << F->getName() << "_Out;\n";
 
     OS << "  Result = cudaMalloc(&device" << F->getName() << "_In, sizeof(" << getTypeName(F->getElementType()) << ")*ArraySize);\n";
     OS << "  assert(Result == cudaSuccess);\n";
-    OS << "  Result = cudaMalloc(&device" << F->getName() << "_Out, sizeof(" << getTypeName(F->getElementType()) << ")*ArraySize);\n";
+    OS << "  Result = cudaMemcpy(device" << F->getName() << "_In, Host_" << F->getName() << ", sizeof(" << getTypeName(F->getElementType()) << ")*ArraySize, cudaMemcpyHostToDevice);\n";
     OS << "  assert(Result == cudaSuccess);\n";
 
-    
     OS << "  " << getTypeName(F->getElementType()) << " *device" << F->getName() << "_InPtr = device" << F->getName() << "_In;\n";
-    OS << "  " << getTypeName(F->getElementType()) << " *device" << F->getName() << "_OutPtr = device" << F->getName() << "_Out;\n";
 
-    OS << "  Result = cudaMemcpy(device" << F->getName() << "_In, Host_" << F->getName() << ", sizeof(" << getTypeName(F->getElementType()) << ")*ArraySize, cudaMemcpyHostToDevice);\n";
+    // The kernel never writes temporaries to global memory, so their one
+    // buffer serves as both input and output.
+    if (isTemporary(F)) {
+      OS << "  " << getTypeName(F->getElementType()) << " *device" << F->getName() << "_OutPtr = device" << F->getName() << "_In;\n";
+      continue;
+    }
+
+    OS << "  " << getTypeName(F->getElementType()) << " *device" << F->getName() << "_Out;\n";
+    OS << "  Result = cudaMalloc(&device" << F->getName() << "_Out, sizeof(" << getTypeName(F->getElementType()) << ")*ArraySize);\n";
     OS << "  assert(Result == cudaSuccess);\n";
+    OS << "  " << getTypeName(F->getElementType()) << " *device" << F->getName() << "_OutPtr = device" << F->getName() << "_Out;\n";
+
     OS << "  Result = cudaMemcpy(device" << F->getName() << "_Out, device" << F->getName() << "_In, sizeof(" << getTypeName(F->getElementType()) << ")*ArraySize, cudaMemcpyDeviceToDevice);\n";
     OS << "  assert(Result == cudaSuccess);\n";
   }  
 
-  Region          BlockRegion(G->getNumDimensions());
-  // Determine region for an entire block
-  for (std::map<const Field*, Region>::const_iterator
-         I          = getRegionMap().begin(),
-         E          = getRegionMap().end(); I != E; ++I) {
-    const Region &R = I->second;
-    BlockRegion     = Region::makeUnion(BlockRegion, R);
-  }
-
-  
-  for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-    std::pair<int, unsigned> Bound     = BlockRegion.getBound(i);
-    int                      LeftHalo  = Bound.first < 0 ? -Bound.first : Bound.first;
-    int                      RightHalo = Bound.second - LeftHalo - 1;
-    OS << "  const int Halo_Left_" << i << " = " << LeftHalo << ";\n";
-    OS << "  const int Halo_Right_" << i << " = " << RightHalo << ";\n";
-    OS << "  const int real_per_block_" << i << " = " << getElements(i)*getBlockSize(i) << " - Halo_Left_" << i << " - Halo_Right_" << i << ";\n";
-  }
-
   OS << "  dim3 block_size(" << getBlockSize(0);
   for (unsigned i = 1, e = G->getNumDimensions(); i < e; ++i) {
     OS << ", " << getBlockSize(i);
   }
   OS << ");\n";
 
-  for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-    OS << "  int num_blocks_" << i << " = Dim_" << i << " / real_per_block_" << i
-       << ";\n";
-    OS << "  int extra_" << i << " = Dim_" << i << " % real_per_block_" << i << ";\n";
-    OS << "  num_blocks_" << i << " = num_blocks_" << i << " + (extra_"
-       << i << " > 0 ? 1 : 0);\n";
-  }
+  // Each kernel has its own halo, and hence its own grid.
+  for (unsigned k = 0, ke = getKernels().size(); k != ke; ++k) {
+    std::string Suffix = getKernelSuffix(k);
 
-  if (useManualGrid() && G->getNumDimensions() == 3) {
-    OS << "  int num_blocks = num_blocks_0*num_blocks_1*num_blocks_2;\n";
-    OS << "  dim3 grid_size(num_blocks);\n";
-  } else {
-    OS << "  dim3 grid_size(num_blocks_0";
-    for (unsigned i = 1, e = G->getNumDimensions(); i < e; ++i) {
-      OS << ", num_blocks_" << i;
+    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
+      int LeftHalo, RightHalo;
+      if (!getHalo(k, i, LeftHalo, RightHalo)) {
+        report_fatal_error("Negative halo in dimension " + utostr(i));
+      }
+      OS << "  const int Halo_Left_" << i << Suffix << " = " << LeftHalo << ";\n";
+      OS << "  const int Halo_Right_" << i << Suffix << " = " << RightHalo << ";\n";
+      OS << "  const int real_per_block_" << i << Suffix << " = " << getElements(i)*getBlockSize(i) << " - Halo_Left_" << i << Suffix << " - Halo_Right_" << i << Suffix << ";\n";
+    }
+
+    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
+      OS << "  int num_blocks_" << i << Suffix << " = Dim_" << i << " / real_per_block_" << i << Suffix
+         << ";\n";
+      OS << "  int extra_" << i << Suffix << " = Dim_" << i << " % real_per_block_" << i << Suffix << ";\n";
+      OS << "  num_blocks_" << i << Suffix << " = num_blocks_" << i << Suffix << " + (extra_"
+         << i << Suffix << " > 0 ? 1 : 0);\n";
+    }
+
+    if (useManualGrid() && G->getNumDimensions() == 3) {
+      OS << "  int num_blocks" << Suffix << " = num_blocks_0" << Suffix << "*num_blocks_1" << Suffix << "*num_blocks_2" << Suffix << ";\n";
+      OS << "  dim3 grid_size" << Suffix << "(num_blocks" << Suffix << ");\n";
+    } else {
+      OS << "  dim3 grid_size" << Suffix << "(num_blocks_0" << Suffix;
+      for (unsigned i = 1, e = G->getNumDimensions(); i < e; ++i) {
+        OS << ", num_blocks_" << i << Suffix;
+      }
+      OS << ");\n";
     }
-    OS << ");\n";
   }
 
   OS << "  cudaThreadSynchronize();\n";
@@ -1075,41 +1150,48 @@ void CudaBackEnd::codegenHost(llvm::raw_ostream &OS) {
   OS << "  for (int t = 0; t < timesteps; t += " << getTimeTileSize()
      << ") {\n";
   
-  OS << "    ot_kernel_" << G->getName() << "<<<grid_size, block_size>>>(";
-  for (std::list<Field*>::iterator I = Fields.begin(), E  = Fields.end();
-       I                                                 != E; ++I) {
-    Field *F                                              = *I;
-    OS << "device" << F->getName() << "_InPtr, ";
-    OS << "device" << F->getName() << "_OutPtr, ";
-  }
-  for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
-    if (i > 0) OS << ", ";
-    OS << "Dim_" << i;
-  }
-  for (ParamList::const_iterator I = Params.begin(), E = Params.end(); I != E;
-       ++I) {
-    OS << ", " << I->first;
-  }
+  for (unsigned k = 0, ke = getKernels().size(); k != ke; ++k) {
+    std::string Suffix = getKernelSuffix(k);
 
-  if (useManualGrid() && G->getNumDimensions() == 3) {
-    OS << ", num_blocks_0, num_blocks_1, num_blocks_2";
-  }
-  
-  OS << ");\n";
+    OS << "    ot_kernel_" << G->getName() << Suffix << "<<<grid_size" << Suffix << ", block_size>>>(";
+    for (std::list<Field*>::iterator I = Fields.begin(), E  = Fields.end();
+         I                                                 != E; ++I) {
+      Field *F                                              = *I;
+      OS << "device" << F->getName() << "_InPtr, ";
+      OS << "device" << F->getName() << "_OutPtr, ";
+    }
+    for (unsigned i = 0, e = G->getNumDimensions(); i < e; ++i) {
+      if (i > 0) OS << ", ";
+      OS << "Dim_" << i;
+    }
+    for (ParamList::const_iterator I = Params.begin(), E = Params.end(); I != E;
+         ++I) {
+      OS << ", " << I->first;
+    }
 
-  OS << "    cudaError_t Err = cudaGetLastError();\n";
-  OS << "    if(Err != cudaSuccess) {\n";
-  OS << "      std::cerr << \"Kernel launch failure (error: \" << Err << \")\\n\";\n";
-  OS << "      abort();\n";
-  OS << "    }\n";
+    if (useManualGrid() && G->getNumDimensions() == 3) {
+      OS << ", num_blocks_0" << Suffix << ", num_blocks_1" << Suffix << ", num_blocks_2" << Suffix;
+    }
   
-  for (std::list<Field*>::iterator I = Fields.begin(), E  = Fields.end();
-       I                                                 != E; ++I) {
-    Field *F                                              = *I;
-    OS << "    std::swap(device" << F->getName() << "_InPtr, device"
-       << F->getName() << "_OutPtr);\n";
+    OS << ");\n";
+
+    OS << "    cudaError_t Err" << Suffix << " = cudaGetLastError();\n";
+    OS << "    if(Err" << Suffix << " != cudaSuccess) {\n";
+    OS << "      std::cerr << \"Kernel launch failure (error: \" << Err" << Suffix << " << \")\\n\";\n";
+    OS << "      abort();\n";
+    OS << "    }\n";
+
+    // The next kernel reads the fields written by this one.
+    const FunctionList &Kernel = getKernels()[k];
+    std::set<Field*>    Swapped;
+    for (FunctionList::const_iterator I = Kernel.begin(), E = Kernel.end();
+         I != E; ++I) {
+      Field *F = (*I)->getOutput();
+      if (isTemporary(F) || !Swapped.insert(F).second) continue;
+      OS << "    std::swap(device" << F->getName() << "_InPtr, device"
+         << F->getName() << "_OutPtr);\n";
+    }
   }
-  
   OS << "  }\n";
 
   OS << "  assert(cudaEventRecord(StopEvent, 0) == cudaSuccess);\n";
@@ -1119,6 +1201,7 @@ void CudaBackEnd::codegenHost(llvm::raw_ostream &OS) {
   for (std::list<Field*>::iterator I = Fields.begin(), E  = Fields.end();
        I                                                 != E; ++I) {
     Field *F                                              = *I;
+    if (!isCopiedOut(F)) continue;
     OS << "  Result = cudaMemcpy(Host_" << F->getName() << ", device" << F->getName() << "_InPtr, sizeof(" << getTypeName(F->getElementType()) << ")*ArraySize, cudaMemcpyDeviceToHost);\n";
     OS << "  assert(Result == cudaSuccess);\n";
   }  
@@ -1126,26 +1209,22 @@ void CudaBackEnd::codegenHost(llvm::raw_ostream &OS) {
   OS << "  cudaEventRecord(TotalStopEvent, 0);\n";
   OS << "  assert(cudaEventSynchronize(TotalStopEvent) == cudaSuccess);\n";
 
-  OS << "  double Flops = 0.0;\n";
-  OS << "  double Points;\n";
-  for (std::list<Function*>::iterator FI = Functions.begin(),
-         FE                                                   = Functions.end(); FI != FE; ++FI) {
-    Function *F                                               = *FI;
-    double    Flops                                           = F->countFlops();
+  // Cost of a time step at one point, see CostModel.
+  PointCost Cost = CostModel::getGridCost(G);
 
-    OS << "  Points = (Dim_0)";
-    for (unsigned i = 1, e = G->getNumDimensions(); i < e; ++i) {
-      OS << " * (Dim_" << i << ")";
-    }
-    OS << ";\n";
-    OS << "  Flops = Flops + Points * " << Flops << ";\n";
+  OS << "  double Points = (Dim_0)";
+  for (unsigned i = 1, e = G->getNumDimensions(); i < e; ++i) {
+    OS << " * (Dim_" << i << ")";
   }
-  OS << "  Flops = Flops * timesteps;\n";
+  OS << ";\n";
+  OS << "  double Flops = Points * " << Cost.Flops << " * timesteps;\n";
+  OS << "  double Bytes = Points * " << Cost.getBytes() << " * timesteps;\n";
   OS << "  float ElapsedMS;\n";
   OS << "  cudaEventElapsedTime(&ElapsedMS, StartEvent, StopEvent);\n";
   OS << "  double Elapsed = ElapsedMS / 1000.0;\n";
   OS << "  double GFlops = Flops / Elapsed / 1e9;\n";
   OS << "  std::cerr << \"GFlops: \" << GFlops << \"\\n\";\n";
+  OS << "  std::cerr << \"GB/s: \" << Bytes / Elapsed / 1e9 << \"\\n\";\n";
   OS << "  std::cerr << \"Elapsed: \" << Elapsed << \"\\n\";\n";
 
   OS << "  float TotalElapsedMS;\n";
@@ -1181,6 +1260,7 @@ void CudaBackEnd::codegenHost(llvm::raw_ostream &OS) {
        I                                                 != E; ++I) {
     Field *F                                              = *I;
     OS << "  cudaFree(device" << F->getName() << "_In);\n";
+    if (isTemporary(F)) continue;
     OS << "  cudaFree(device" << F->getName() << "_Out);\n";
   }
 
@@ -1194,17 +1274,64 @@ void CudaBackEnd::codegenHost(llvm::raw_ostream &OS) {
 }
 
 
-std::string CudaBackEnd::getTypeName(const ElementType *Ty) {
-  if (const FP32Type *FPTy = dyn_cast<const FP32Type>(Ty)) {
-    return "float";
-  } else if (const FP64Type *FPTy = dyn_cast<const FP64Type>(Ty)) {
-    return "double";
-  } else {
-    report_fatal_error("Unknown type");
+void CudaBackEnd::codegenTemps(Expression *Expr, llvm::raw_ostream &OS) {
+  std::vector<Expression*> Temps;
+  findCommonSubexprs(Expr, Temps);
+
+  TempIndices.clear();
+  for (unsigned i = 0, e = Temps.size(); i != e; ++i) {
+    OS << "  " << getTypeName(getExprType(Temps[i], getGrid(), true))
+       << " " << getTempName(Temps[i], i) << " = ";
+    codegenExpr(Temps[i], OS);
+    OS << ";\n";
+    TempIndices[Temps[i]] = i;
+  }
+}
+
+void CudaBackEnd::codegenInvariants(llvm::raw_ostream &OS) {
+  std::list<Function*> Functions = getGrid()->getFunctionList();
+
+  TempIndices.clear();
+  InvariantIndices.clear();
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    const std::list<BoundedFunction> &BFuncs = (*I)->getBoundedFunctions();
+
+    for (std::list<BoundedFunction>::const_iterator BI = BFuncs.begin(),
+           BE = BFuncs.end(); BI != BE; ++BI) {
+      std::vector<Expression*> Invariants;
+      findInvariantSubexprs(BI->Expr, Invariants);
+
+      for (unsigned i = 0, e = Invariants.size(); i != e; ++i) {
+        if (InvariantIndices.count(Invariants[i])) continue;
+
+        unsigned Index = InvariantIndices.size();
+        OS << "  const "
+           << getTypeName(getExprType(Invariants[i], getGrid(), true))
+           << " ot_inv_" << Index << " = ";
+        codegenExpr(Invariants[i], OS);
+        OS << ";\n";
+        InvariantIndices[Invariants[i]] = Index;
+      }
+    }
   }
 }
 
 void CudaBackEnd::codegenExpr(Expression *Expr, llvm::raw_ostream &OS) {
+  std::map<const Expression*, unsigned>::iterator Temp =
+    TempIndices.find(Expr);
+  if (Temp != TempIndices.end()) {
+    OS << getTempName(Expr, Temp->second);
+    return;
+  }
+
+  std::map<const Expression*, unsigned>::iterator Inv =
+    InvariantIndices.find(Expr);
+  if (Inv != InvariantIndices.end()) {
+    OS << "ot_inv_" << Inv->second;
+    return;
+  }
+
   if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
     return codegenBinaryOp(Op, OS);
   } else if (FieldRef *Ref = dyn_cast<FieldRef>(Expr)) {
@@ -1220,7 +1347,54 @@ void CudaBackEnd::codegenExpr(Expression *Expr, llvm::raw_ostream &OS) {
   }
 }
 
+bool CudaBackEnd::codegenMultiplyAdd(BinaryOp *Op, llvm::raw_ostream &OS) {
+  if (!getContraction() || !dependsOnData(Op) ||
+      (Op->getOperator() != BinaryOp::ADD &&
+       Op->getOperator() != BinaryOp::SUB)) {
+    return false;
+  }
+
+  // Products held in a variable are not recomputed.
+  BinaryOp *Mul    = NULL;
+  bool      OnLeft = false;
+  for (unsigned i = 0; i != 2 && !Mul; ++i) {
+    BinaryOp *M = dyn_cast<BinaryOp>(i == 0 ? Op->getLHS() : Op->getRHS());
+    if (M && M->getOperator() == BinaryOp::MUL && !TempIndices.count(M) &&
+        !InvariantIndices.count(M)) {
+      Mul    = M;
+      OnLeft = i == 0;
+    }
+  }
+  if (!Mul) {
+    return false;
+  }
+
+  // a*b-c = fma(a, b, -c) and c-a*b = fma(-a, b, c).
+  bool        Sub    = Op->getOperator() == BinaryOp::SUB;
+  Expression *Addend = OnLeft ? Op->getRHS() : Op->getLHS();
+
+  if (isa<FP64Type>(getExprType(Op, getGrid(), true))) {
+    OS << "__fma_rn(";
+  } else {
+    OS << "__fmaf_rn(";
+  }
+  if (Sub && !OnLeft) OS << "-(";
+  codegenExpr(Mul->getLHS(), OS);
+  if (Sub && !OnLeft) OS << ")";
+  OS << ", ";
+  codegenExpr(Mul->getRHS(), OS);
+  OS << ", ";
+  if (Sub && OnLeft) OS << "-(";
+  codegenExpr(Addend, OS);
+  if (Sub && OnLeft) OS << ")";
+  OS << ")";
+  return true;
+}
+
 void CudaBackEnd::codegenBinaryOp(BinaryOp *Op, llvm::raw_ostream &OS) {
+  if (codegenMultiplyAdd(Op, OS)) {
+    return;
+  }
 
   OS << "(";
   codegenExpr(Op->getLHS(), OS);
@@ -1235,6 +1409,13 @@ void CudaBackEnd::codegenBinaryOp(BinaryOp *Op, llvm::raw_ostream &OS) {
   OS << ")";
 }
 
+int CudaBackEnd::getJammedOffset(const std::vector<IntConstant*> &Offsets,
+                                 unsigned Dim) const {
+  int Offset = Offsets[Dim]->getValue();
+  if (Dim != 0 && Dim == Offsets.size()-1) Offset += JamElement;
+  return Offset;
+}
+
 void CudaBackEnd::codegenFieldRef(FieldRef *Ref, llvm::raw_ostream &OS) {
 
   Field                           *F       = Ref->getField();
@@ -1250,7 +1431,7 @@ void CudaBackEnd::codegenFieldRef(FieldRef *Ref, llvm::raw_ostream &OS) {
   
   for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
     
-    long Off = Offsets[i]->getValue();
+    long Off = getJammedOffset(Offsets, i);
 
     if (Off == 0)
       VarNameStr << "_0";
@@ -1330,7 +1511,7 @@ void CudaBackEnd::codegenFieldRefLoad(FieldRef *Ref, llvm::raw_ostream &OS,
   
   for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
     
-    long Off = Offsets[i]->getValue();
+    long Off = getJammedOffset(Offsets, i);
 
     if (Off == 0)
       VarNameStr << "_0";
@@ -1360,12 +1541,12 @@ void CudaBackEnd::codegenFieldRefLoad(FieldRef *Ref, llvm::raw_ostream &OS,
     unsigned Dim    = 0;
     for (std::vector<IntConstant*>::const_iterator I      = Offsets.begin(),
          E          = Offsets.end(), B = I; I != E; ++I) {
-      int    Offset = (*I)->getValue();
+      int    Offset = getJammedOffset(Offsets, Dim);
       if (B != I) OS << " + ";
       if (!UseShared)
-        OS << "(thisid_" << Dim << "+" << (*I)->getValue() << ")";
+        OS << "(thisid_" << Dim << "+" << Offset << ")";
       else
-        OS << "((thislocal_" << Dim << "+" << (*I)->getValue() << ")+max_left_offset_" << Dim << ")";
+        OS << "((thislocal_" << Dim << "+" << Offset << ")+max_left_offset_" << Dim << ")";
       for (unsigned                          i          = 0; i < DimTerms; ++i) {
         if (!UseShared)
           OS << "*Dim_" << i;
@@ -1391,9 +1572,9 @@ void CudaBackEnd::codegenFieldRefLoad(FieldRef *Ref, llvm::raw_ostream &OS,
     
     for (int i = Offsets.size()-1, e = 0; i >= e; --i) {
            
-      int Offset = Offsets[i]->getValue();
+      int Offset = getJammedOffset(Offsets, i);
 
-      OS << "[thislocal_" << i << "+" << SharedMaxLeft[i] << "+" << Offset << "]";
+      OS << "[thislocal_" << i << "+" << -SharedExtents[F][i].first << "+" << Offset << "]";
     }
     OS << ";\n";
   }
@@ -1401,25 +1582,4 @@ void CudaBackEnd::codegenFieldRefLoad(FieldRef *Ref, llvm::raw_ostream &OS,
   Idents.insert(VarName);
 }
 
-std::string CudaBackEnd::getBoundExpr(BoundExpr &Expr, unsigned Dim) {
-  std::string Ret;
-  raw_string_ostream Str(Ret);
-
-  Str << "(";
-  if (Expr.Base == (unsigned)(-1)) {
-    Str << "Dim_" << Dim;
-    Str << "-";
-    Str << Expr.Constant;
-    Str << "-1";
-  } else {
-    Str << Expr.Base;
-    Str << "+";
-    Str << Expr.Constant;
-  }
-  Str << ")";
-
-  Str.flush();
-  return Ret;
-}
-
 }
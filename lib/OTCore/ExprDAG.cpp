@@ -0,0 +1,302 @@
+/*
+ * ExprDAG.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: ExprDAG.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Core/ExprDAG.h"
+#include "overtile/Core/Expressions.h"
+#include "overtile/Core/Field.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Grid.h"
+#include "overtile/Core/Types.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cassert>
+#include <set>
+
+using namespace llvm;
+
+namespace overtile {
+
+ExprDAG::ExprDAG() {
+}
+
+Expression *ExprDAG::canonicalize(Expression *Expr) {
+  std::map<Expression*, Expression*>::iterator Memo = Canonical.find(Expr);
+  if (Memo != Canonical.end()) {
+    return Memo->second;
+  }
+
+  // The key of a node refers to its operands by the ids of their canonical
+  // nodes, so it has constant size.
+  std::string              Key;
+  llvm::raw_string_ostream KeyStr(Key);
+
+  if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    Expression *LHS = canonicalize(Op->getLHS());
+    Expression *RHS = canonicalize(Op->getRHS());
+    Op->setLHS(LHS);
+    Op->setRHS(RHS);
+
+    unsigned L = Ids[LHS];
+    unsigned R = Ids[RHS];
+    if ((Op->getOperator() == BinaryOp::ADD ||
+         Op->getOperator() == BinaryOp::MUL) && R < L) {
+      std::swap(L, R);
+    }
+    KeyStr << "op" << (unsigned)Op->getOperator() << "(" << L << "," << R
+           << ")";
+  } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    const std::vector<Expression*> &Params = FC->getParameters();
+
+    KeyStr << "call " << FC->getName() << "(";
+    for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+      Expression *P = canonicalize(Params[i]);
+      FC->setParameter(i, P);
+      if (i != 0) KeyStr << ",";
+      KeyStr << Ids[P];
+    }
+    KeyStr << ")";
+  } else if (FieldRef *Ref = dyn_cast<FieldRef>(Expr)) {
+    const std::vector<IntConstant*> &Offsets = Ref->getOffsets();
+
+    KeyStr << "ref " << Ref->getField()->getName();
+    for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
+      KeyStr << "[" << Offsets[i]->getValue() << "]";
+    }
+  } else if (ConstantExpr *C = dyn_cast<ConstantExpr>(Expr)) {
+    KeyStr << "const" << C->getClassType() << " " << C->getStringValue();
+  } else if (PlaceHolderExpr *PH = dyn_cast<PlaceHolderExpr>(Expr)) {
+    KeyStr << "param " << PH->getName();
+  } else {
+    report_fatal_error("Unhandled expression in ExprDAG::canonicalize");
+  }
+
+  KeyStr.flush();
+
+  Expression *&Node = Nodes[Key];
+  if (!Node) {
+    Node = Expr;
+    unsigned Id = Ids.size();
+    Ids[Expr] = Id;
+  }
+
+  // A let binding names the value, whichever node represents it.
+  if (Node->getBindingName().empty()) {
+    Node->setBindingName(Expr->getBindingName());
+  }
+
+  Canonical[Expr] = Node;
+  return Node;
+}
+
+void ExprDAG::canonicalizeGrid(Grid *G) {
+  const std::list<Function*> &Functions = G->getFunctionList();
+
+  // One table for all functions, so that equal invariant subexpressions of
+  // different functions are computed only once per kernel call.
+  ExprDAG DAG;
+
+  for (std::list<Function*>::const_iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    std::list<BoundedFunction> &BFuncs = (*I)->getBoundedFunctions();
+
+    for (std::list<BoundedFunction>::iterator BI = BFuncs.begin(),
+           BE = BFuncs.end(); BI != BE; ++BI) {
+      BI->Expr = DAG.canonicalize(BI->Expr);
+    }
+  }
+}
+
+namespace {
+
+/// countUses - Counts the operand edges pointing to every node of the DAG
+/// rooted at \p Expr, and appends the nodes to \p Order in post-order.
+void countUses(Expression *Expr, std::map<Expression*, unsigned> &Uses,
+               std::vector<Expression*> &Order) {
+  if (Uses[Expr]++ > 0) {
+    return;
+  }
+
+  if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    countUses(Op->getLHS(), Uses, Order);
+    countUses(Op->getRHS(), Uses, Order);
+  } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    const std::vector<Expression*> &Params = FC->getParameters();
+    for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+      countUses(Params[i], Uses, Order);
+    }
+  }
+
+  Order.push_back(Expr);
+}
+
+/// getDoubleType - Returns the double type.
+const ElementType *getDoubleType() {
+  static FP64Type Double;
+  return &Double;
+}
+
+/// findType - Records in \p FP32 and \p FP64 a float and a double type
+/// contributing to the value of \p Expr.
+void findType(const Expression *Expr, const Grid *G, bool FloatCalls,
+              const ElementType *&FP32, const ElementType *&FP64) {
+  const ElementType *Ty = 0;
+
+  if (const BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    findType(Op->getLHS(), G, FloatCalls, FP32, FP64);
+    findType(Op->getRHS(), G, FloatCalls, FP32, FP64);
+  } else if (const FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    const std::vector<Expression*> &Params = FC->getParameters();
+    const ElementType              *ArgFP32 = 0;
+    const ElementType              *ArgFP64 = 0;
+    for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+      findType(Params[i], G, FloatCalls, ArgFP32, ArgFP64);
+    }
+    if (ArgFP64 || (ArgFP32 && !FloatCalls)) {
+      // The double overload, e.g. sqrt(double) for a float argument in C.
+      FP64 = ArgFP64 ? ArgFP64 : getDoubleType();
+    } else if (ArgFP32) {
+      FP32 = ArgFP32;
+    }
+  } else if (const FieldRef *Ref = dyn_cast<FieldRef>(Expr)) {
+    Ty = Ref->getField()->getElementType();
+  } else if (const PlaceHolderExpr *PH = dyn_cast<PlaceHolderExpr>(Expr)) {
+    typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+    const ParamList &Params = G->getParameters();
+    std::string      Name   = PH->getName().str();
+
+    for (ParamList::const_iterator I = Params.begin(), E = Params.end();
+         I != E; ++I) {
+      if (I->first == Name) Ty = I->second;
+    }
+  }
+
+  if (Ty && isa<FP64Type>(Ty)) {
+    FP64 = Ty;
+  } else if (Ty) {
+    FP32 = Ty;
+  }
+}
+
+/// collectInvariants - Appends the largest invariant subexpressions of
+/// \p Expr that are not in \p Visited to \p Invariants.
+void collectInvariants(Expression *Expr, std::set<Expression*> &Visited,
+                       std::vector<Expression*> &Invariants) {
+  if (!Visited.insert(Expr).second) {
+    return;
+  }
+
+  if (!isa<BinaryOp>(Expr) && !isa<FunctionCall>(Expr)) {
+    return;
+  }
+  if (!readsFields(Expr)) {
+    if (dependsOnData(Expr)) Invariants.push_back(Expr);
+    return;
+  }
+
+  if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    collectInvariants(Op->getLHS(), Visited, Invariants);
+    collectInvariants(Op->getRHS(), Visited, Invariants);
+  } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    const std::vector<Expression*> &Params = FC->getParameters();
+    for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+      collectInvariants(Params[i], Visited, Invariants);
+    }
+  }
+}
+
+}
+
+void findCommonSubexprs(Expression *Expr, std::vector<Expression*> &Temps) {
+  std::map<Expression*, unsigned> Uses;
+  std::vector<Expression*>        Order;
+
+  Temps.clear();
+  countUses(Expr, Uses, Order);
+
+  // Loads, constants, and parameters are already held in variables.
+  for (unsigned i = 0, e = Order.size(); i != e; ++i) {
+    Expression *E = Order[i];
+    if (E == Expr) continue;
+    if (Uses[E] < 2 && E->getBindingName().empty()) continue;
+    if (!isa<BinaryOp>(E) && !isa<FunctionCall>(E)) continue;
+    // Invariant subexpressions are hoisted out of the point loops.
+    if (!readsFields(E)) continue;
+    Temps.push_back(E);
+  }
+}
+
+std::string getTempName(const Expression *Expr, unsigned Index) {
+  std::string        Name;
+  raw_string_ostream NameStr(Name);
+
+  if (Expr->getBindingName().empty()) {
+    NameStr << "ot_cse_" << Index;
+  } else {
+    NameStr << "ot_let_" << Expr->getBindingName() << "_" << Index;
+  }
+  return NameStr.str();
+}
+
+void findInvariantSubexprs(Expression *Expr,
+                           std::vector<Expression*> &Invariants) {
+  std::set<Expression*> Visited;
+  collectInvariants(Expr, Visited, Invariants);
+}
+
+bool dependsOnData(const Expression *Expr) {
+  if (const BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    return dependsOnData(Op->getLHS()) || dependsOnData(Op->getRHS());
+  } else if (const FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    const std::vector<Expression*> &Params = FC->getParameters();
+    for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+      if (dependsOnData(Params[i])) return true;
+    }
+    return false;
+  } else {
+    return isa<FieldRef>(Expr) || isa<PlaceHolderExpr>(Expr);
+  }
+}
+
+bool readsFields(const Expression *Expr) {
+  if (const BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    return readsFields(Op->getLHS()) || readsFields(Op->getRHS());
+  } else if (const FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    const std::vector<Expression*> &Params = FC->getParameters();
+    for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+      if (readsFields(Params[i])) return true;
+    }
+    return false;
+  } else {
+    return isa<FieldRef>(Expr);
+  }
+}
+
+const ElementType *getExprType(const Expression *Expr, const Grid *G,
+                               bool FloatCalls) {
+  const ElementType *FP32 = 0;
+  const ElementType *FP64 = 0;
+
+  findType(Expr, G, FloatCalls, FP32, FP64);
+  assert((FP32 || FP64) && "Expression does not depend on any data");
+  return FP64 ? FP64 : FP32;
+}
+
+}
@@ -25,7 +25,7 @@
 namespace overtile {
 
 Field::Field(Grid *G, ElementType *Ty, const std::string &N)
-  : TheGrid(G), ElemTy(Ty), Name(N) {
+  : TheGrid(G), ElemTy(Ty), Name(N), Copy(CopyInOut) {
   assert(G != NULL && "G cannot be NULL");
   assert(Ty != NULL && "Ty cannot be NULL");
   G->attachField(this);
@@ -29,6 +29,7 @@
 #include <iostream>
 #include <cassert>
 #include <cstdlib>
+#include <set>
 
 using namespace llvm;
 
@@ -163,10 +164,13 @@ public:
         FBound.second += Diff;
       }
 
-      if (InBound.first + InBound.second + Off > FBound.first + FBound.second) {
+      // The sums are unsigned, so compare them as int: a negative offset
+      // would otherwise wrap around and always grow the upper bound.
+      if (int(InBound.first + InBound.second) + Off >
+          int(FBound.first + FBound.second)) {
         // We need more elements on the upper bound
-        int Diff       = InBound.first + InBound.second + Off -
-          (FBound.first + FBound.second);
+        int Diff       = int(InBound.first + InBound.second) + Off -
+          int(FBound.first + FBound.second);
         FBound.second += Diff;
       }
 
@@ -282,71 +286,4 @@ void Function::getMaxOffsets(const Field *F, unsigned Dim, unsigned &LeftMax,
   }  
 }
 
-
-
-/// FieldRefVisitor - Helper class for adjustRegion.
-class FlopsVisitor {
-public:
-  FlopsVisitor()
-    : Flops(0.0) {}
-
-  void visitExpr(Expression *Expr) {
-    if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
-      visitBinaryOp(Op);
-    } else if (FieldRef *Ref = dyn_cast<FieldRef>(Expr)) {
-      visitFieldRef(Ref);
-    } else if (ConstantExpr *C = dyn_cast<ConstantExpr>(Expr)) {
-      // Do nothing
-    } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
-      visitFunctionCall(FC);  
-    } else if (PlaceHolderExpr *PH = dyn_cast<PlaceHolderExpr>(Expr)) {
-      // Do nothing
-    } else {
-      report_fatal_error("Unhandled expression type");
-    }
-  }
-
-  void visitFunctionCall(FunctionCall *FC) {
-
-    // For function calls, we count one op plus the parameters
-    const std::vector<Expression*> &Exprs = FC->getParameters();
-
-    Flops = Flops + 1.0;
-        
-    for (unsigned i = 0, e = Exprs.size(); i != e; ++i) {
-      visitExpr(Exprs[i]);
-    }
-  }
-  
-  void visitBinaryOp(BinaryOp *Op) {
-    visitExpr(Op->getLHS());
-    visitExpr(Op->getRHS());
-    Flops = Flops + 1.0;
-  }
-
-  void visitFieldRef(FieldRef *Ref) {
-  }
-
-  double getFlops() const { return Flops; }
-  
-private:
-  double Flops;
-};
-
-
-double Function::countFlops() const {
-  double Flops = 0.0;
-
-  for (std::list<BoundedFunction>::const_iterator I = Functions.begin(), E = Functions.end(); I != E; ++I) {
-    FlopsVisitor V;
-    V.visitExpr(I->Expr);
-    Flops = std::max(Flops, V.getFlops());
-  }
-
-  return Flops;
-}
-
-
-
-
 }
@@ -19,8 +19,10 @@
 
 #include "overtile/Core/Grid.h"
 #include "overtile/Core/Field.h"
+#include "overtile/Core/Function.h"
 #include <algorithm>
 #include <cassert>
+#include <set>
 
 namespace overtile {
 
@@ -47,6 +49,22 @@ void Grid::appendFunction(Function *F) {
   Functions.push_back(F);
 }
 
+bool Grid::isDefinedBeforeUse(const Field *F) const {
+  for (FunctionList::const_iterator I = Functions.begin(), E = Functions.end();
+       I != E; ++I) {
+    Function         *Func   = *I;
+    std::set<Field*>  Inputs = Func->getInputFields();
+
+    for (std::set<Field*>::iterator II = Inputs.begin(), IE = Inputs.end();
+         II != IE; ++II) {
+      if (*II == F) return false;
+    }
+    if (Func->getOutput() == F) return true;
+  }
+
+  return false;
+}
+
 Field *Grid::getFieldByName(llvm::StringRef Name) {
   for (FieldList::iterator I = Fields.begin(), E = Fields.end(); I != E; ++I) {
     Field *F = *I;
@@ -0,0 +1,925 @@
+/*
+ * Interpreter.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: Interpreter.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Core/Interpreter.h"
+#include "overtile/Core/ExprDAG.h"
+#include "overtile/Core/Expressions.h"
+#include "overtile/Core/Field.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Grid.h"
+#include "overtile/Core/MathBuiltins.h"
+#include "overtile/Core/Reciprocals.h"
+#include "overtile/Core/Simplify.h"
+#include "overtile/Core/Types.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+using namespace llvm;
+
+namespace overtile {
+
+namespace {
+
+//===-- Math functions --====================================================//
+
+#define OT_MATH1(Name)                                      \
+  float Name##_f(float X) { return std::Name(X); }          \
+  double Name##_d(double X) { return std::Name(X); }
+
+#define OT_MATH2(Name)                                      \
+  float Name##_f(float X, float Y) { return std::Name(X, Y); } \
+  double Name##_d(double X, double Y) { return std::Name(X, Y); }
+
+OT_MATH1(sqrt)
+OT_MATH1(fabs)
+OT_MATH1(exp)
+OT_MATH1(log)
+OT_MATH1(sin)
+OT_MATH1(cos)
+OT_MATH1(tan)
+OT_MATH1(atan)
+OT_MATH1(tanh)
+OT_MATH1(floor)
+OT_MATH1(ceil)
+OT_MATH2(pow)
+OT_MATH2(atan2)
+
+// C99 functions, which C++98 does not have in namespace std.
+#define OT_MATHC1(Name)                                     \
+  float Name##_f(float X) { return ::Name##f(X); }          \
+  double Name##_d(double X) { return ::Name(X); }
+
+OT_MATHC1(cbrt)
+OT_MATHC1(exp2)
+OT_MATHC1(log2)
+
+#undef OT_MATH1
+#undef OT_MATH2
+#undef OT_MATHC1
+
+float rsqrt_f(float X) { return 1.0f / std::sqrt(X); }
+double rsqrt_d(double X) { return 1.0 / std::sqrt(X); }
+float fmin_f(float X, float Y) { return X < Y ? X : Y; }
+double fmin_d(double X, double Y) { return X < Y ? X : Y; }
+float fmax_f(float X, float Y) { return X > Y ? X : Y; }
+double fmax_d(double X, double Y) { return X > Y ? X : Y; }
+
+/// MathFunction - The implementation of a math built-in for the bytecode.
+struct MathFunction {
+  const char *Name;
+  unsigned    Arity;
+  float     (*F1)(float);
+  double    (*D1)(double);
+  float     (*F2)(float, float);
+  double    (*D2)(double, double);
+};
+
+const MathFunction MathFunctions[] = {
+  { "sqrt",  1, sqrt_f,  sqrt_d,  NULL,    NULL    },
+  { "rsqrt", 1, rsqrt_f, rsqrt_d, NULL,    NULL    },
+  { "cbrt",  1, cbrt_f,  cbrt_d,  NULL,    NULL    },
+  { "fabs",  1, fabs_f,  fabs_d,  NULL,    NULL    },
+  { "exp",   1, exp_f,   exp_d,   NULL,    NULL    },
+  { "exp2",  1, exp2_f,  exp2_d,  NULL,    NULL    },
+  { "log",   1, log_f,   log_d,   NULL,    NULL    },
+  { "log2",  1, log2_f,  log2_d,  NULL,    NULL    },
+  { "sin",   1, sin_f,   sin_d,   NULL,    NULL    },
+  { "cos",   1, cos_f,   cos_d,   NULL,    NULL    },
+  { "tan",   1, tan_f,   tan_d,   NULL,    NULL    },
+  { "atan",  1, atan_f,  atan_d,  NULL,    NULL    },
+  { "tanh",  1, tanh_f,  tanh_d,  NULL,    NULL    },
+  { "floor", 1, floor_f, floor_d, NULL,    NULL    },
+  { "ceil",  1, ceil_f,  ceil_d,  NULL,    NULL    },
+  { "pow",   2, NULL,    NULL,    pow_f,   pow_d   },
+  { "atan2", 2, NULL,    NULL,    atan2_f, atan2_d },
+  { "fmin",  2, NULL,    NULL,    fmin_f,  fmin_d  },
+  { "fmax",  2, NULL,    NULL,    fmax_f,  fmax_d  },
+  { "min",   2, NULL,    NULL,    fmin_f,  fmin_d  },
+  { "max",   2, NULL,    NULL,    fmax_f,  fmax_d  }
+};
+
+const unsigned NumMathFunctions =
+  sizeof(MathFunctions) / sizeof(MathFunctions[0]);
+
+inline float apply(const MathFunction &F, float X) { return F.F1(X); }
+inline double apply(const MathFunction &F, double X) { return F.D1(X); }
+inline float apply(const MathFunction &F, float X, float Y) {
+  return F.F2(X, Y);
+}
+inline double apply(const MathFunction &F, double X, double Y) {
+  return F.D2(X, Y);
+}
+
+
+//===-- Tape construction --=================================================//
+
+/// TapeBuilder - Builds the instruction list for an expression, with one
+/// virtual register per value, then assigns physical registers.
+class TapeBuilder {
+public:
+  TapeBuilder(Interpreter::Tape &T,
+              const std::map<const Field*, unsigned> &FieldIdx,
+              const std::map<std::string, unsigned> &ParamIdx)
+    : TheTape(T), FieldIndices(FieldIdx), ParamIndices(ParamIdx) {}
+
+  void build(Expression *Expr);
+
+private:
+
+  unsigned visit(Expression *Expr);
+  unsigned emit(Interpreter::Opcode Op, unsigned A, unsigned B, unsigned C);
+  void allocateRegisters(unsigned Result);
+
+  static bool isPinned(Interpreter::Opcode Op) {
+    return Op == Interpreter::LoadConst || Op == Interpreter::LoadParam;
+  }
+
+  Interpreter::Tape                      &TheTape;
+  const std::map<const Field*, unsigned> &FieldIndices;
+  const std::map<std::string, unsigned>  &ParamIndices;
+  std::vector<Interpreter::Instruction>   Virtual;
+  std::map<Expression*, unsigned>         ExprValues;
+  std::map<std::string, unsigned>         LoadValues;
+  std::map<double, unsigned>              ConstValues;
+};
+
+void TapeBuilder::build(Expression *Expr) {
+  unsigned Result = visit(Expr);
+  allocateRegisters(Result);
+}
+
+unsigned TapeBuilder::emit(Interpreter::Opcode Op, unsigned A, unsigned B,
+                           unsigned C) {
+  Interpreter::Instruction I;
+  I.Op  = Op;
+  I.Dst = Virtual.size();
+  I.A   = A;
+  I.B   = B;
+  I.C   = C;
+  Virtual.push_back(I);
+  return I.Dst;
+}
+
+unsigned TapeBuilder::visit(Expression *Expr) {
+  // Expressions may be shared, e.g. through let bindings.
+  std::map<Expression*, unsigned>::iterator Memo = ExprValues.find(Expr);
+  if (Memo != ExprValues.end()) {
+    return Memo->second;
+  }
+
+  unsigned Value;
+
+  if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    unsigned LHS = visit(Op->getLHS());
+    unsigned RHS = visit(Op->getRHS());
+    Interpreter::Opcode Opc;
+    switch (Op->getOperator()) {
+    default: llvm_unreachable("Unhandled binary operator");
+    case BinaryOp::ADD: Opc = Interpreter::Add; break;
+    case BinaryOp::SUB: Opc = Interpreter::Sub; break;
+    case BinaryOp::MUL: Opc = Interpreter::Mul; break;
+    case BinaryOp::DIV: Opc = Interpreter::Div; break;
+    }
+    Value = emit(Opc, LHS, RHS, 0);
+  } else if (FieldRef *Ref = dyn_cast<FieldRef>(Expr)) {
+    const std::vector<IntConstant*> &Offsets = Ref->getOffsets();
+
+    std::string              Key;
+    llvm::raw_string_ostream KeyStr(Key);
+    std::vector<int>         Off;
+
+    KeyStr << Ref->getField()->getName();
+    for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
+      Off.push_back(Offsets[i]->getValue());
+      KeyStr << "," << Off.back();
+    }
+    KeyStr.flush();
+
+    std::map<std::string, unsigned>::iterator I = LoadValues.find(Key);
+    if (I != LoadValues.end()) {
+      Value = I->second;
+    } else {
+      TheTape.Offsets.push_back(Off);
+      Value = emit(Interpreter::LoadField,
+                   FieldIndices.find(Ref->getField())->second,
+                   TheTape.Offsets.size()-1, 0);
+      LoadValues[Key] = Value;
+    }
+  } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    const std::vector<Expression*> &Params = FC->getParameters();
+
+    // Look the function up by its canonical name, e.g. sqrt for sqrtf.
+    const MathBuiltin *MB = lookupMathBuiltin(FC->getName());
+    unsigned           Fn = 0;
+    while (MB && Fn < NumMathFunctions &&
+           StringRef(MB->Name) != MathFunctions[Fn].Name) {
+      ++Fn;
+    }
+    if (!MB || Fn == NumMathFunctions) {
+      report_fatal_error("Interpreter: unsupported function '" +
+                         FC->getName() + "'");
+    }
+    if (Params.size() != MathFunctions[Fn].Arity) {
+      report_fatal_error("Interpreter: wrong number of arguments to '" +
+                         FC->getName() + "'");
+    }
+
+    if (Params.size() == 1) {
+      unsigned X = visit(Params[0]);
+      Value = emit(Interpreter::Call1, X, 0, Fn);
+    } else {
+      unsigned X = visit(Params[0]);
+      unsigned Y = visit(Params[1]);
+      Value = emit(Interpreter::Call2, X, Y, Fn);
+    }
+  } else if (ConstantExpr *C = dyn_cast<ConstantExpr>(Expr)) {
+    double V = std::atof(C->getStringValue().c_str());
+
+    std::map<double, unsigned>::iterator I = ConstValues.find(V);
+    if (I != ConstValues.end()) {
+      Value = I->second;
+    } else {
+      TheTape.Constants.push_back(V);
+      Value = emit(Interpreter::LoadConst, TheTape.Constants.size()-1, 0, 0);
+      ConstValues[V] = Value;
+    }
+  } else if (PlaceHolderExpr *PH = dyn_cast<PlaceHolderExpr>(Expr)) {
+    std::map<std::string, unsigned>::const_iterator I =
+      ParamIndices.find(PH->getName().str());
+    if (I == ParamIndices.end()) {
+      report_fatal_error("Interpreter: unknown parameter '" +
+                         PH->getName() + "'");
+    }
+    Value = emit(Interpreter::LoadParam, I->second, 0, 0);
+  } else {
+    report_fatal_error("Unhandled expression in Interpreter");
+  }
+
+  ExprValues[Expr] = Value;
+  return Value;
+}
+
+void TapeBuilder::allocateRegisters(unsigned Result) {
+  unsigned NumValues = Virtual.size();
+
+  // Find the last use of every value
+  std::vector<int> LastUse(NumValues, -1);
+  for (unsigned i = 0; i != NumValues; ++i) {
+    const Interpreter::Instruction &I = Virtual[i];
+    switch (I.Op) {
+    default: break;
+    case Interpreter::Add:
+    case Interpreter::Sub:
+    case Interpreter::Mul:
+    case Interpreter::Div:
+    case Interpreter::Call2:
+      LastUse[I.B] = i;
+      // Fall-through
+    case Interpreter::Call1:
+      LastUse[I.A] = i;
+      break;
+    }
+  }
+  LastUse[Result] = NumValues;
+
+  // Constants and parameters are loaded once per execution and get their
+  // own registers, placed first.
+  std::vector<unsigned> Phys(NumValues, 0);
+  unsigned              NumRegs = 0;
+
+  for (unsigned i = 0; i != NumValues; ++i) {
+    if (isPinned(Virtual[i].Op)) {
+      Phys[i] = NumRegs++;
+      TheTape.Code.push_back(Virtual[i]);
+      TheTape.Code.back().Dst = Phys[i];
+    }
+  }
+  TheTape.NumPinned = NumRegs;
+
+  // Linear scan over the remaining values.  Operands are released before
+  // the result is allocated, so the result may reuse an operand register.
+  std::vector<unsigned> Free;
+
+  for (unsigned i = 0; i != NumValues; ++i) {
+    Interpreter::Instruction I = Virtual[i];
+    if (isPinned(I.Op)) continue;
+
+    bool HasRegOperands = I.Op != Interpreter::LoadField;
+    bool HasTwo         = I.Op != Interpreter::LoadField &&
+                          I.Op != Interpreter::Call1;
+
+    if (HasRegOperands) {
+      unsigned A = I.A;
+      I.A = Phys[A];
+      if (LastUse[A] == (int)i && !isPinned(Virtual[A].Op)) {
+        Free.push_back(Phys[A]);
+      }
+    }
+    if (HasTwo) {
+      unsigned B = I.B;
+      I.B = Phys[B];
+      if (LastUse[B] == (int)i && !isPinned(Virtual[B].Op) &&
+          (!HasRegOperands || B != Virtual[i].A)) {
+        Free.push_back(Phys[B]);
+      }
+    }
+
+    if (!Free.empty()) {
+      Phys[i] = Free.back();
+      Free.pop_back();
+    } else {
+      Phys[i] = NumRegs++;
+    }
+
+    I.Dst = Phys[i];
+    TheTape.Code.push_back(I);
+
+    // Values that are never used release their register right away.
+    if (LastUse[i] < 0) {
+      Free.push_back(Phys[i]);
+    }
+  }
+
+  TheTape.NumRegs = NumRegs;
+  TheTape.Result  = Phys[Result];
+}
+
+
+//===-- Evaluation --========================================================//
+
+/// FieldBuffer - Storage for a field during execution.
+struct FieldBuffer {
+  bool  IsDouble;
+  void *Host;
+  void *Cur;
+  void *Next;
+};
+
+/// TapeEvaluator - Evaluates a tape over chunks of points with element
+/// type T.
+template <typename T>
+class TapeEvaluator {
+public:
+  TapeEvaluator(const Interpreter::Tape &Tp, const std::vector<long> &Lin,
+                const double *Params);
+
+  /// run - Evaluates the tape for \p N consecutive points starting at linear
+  /// index \p Index, returning a pointer to the results.
+  const T *run(const std::vector<FieldBuffer> &Bufs, long Index, unsigned N);
+
+private:
+
+  T *reg(unsigned R) { return &Storage[R*Interpreter::ChunkSize]; }
+
+  const Interpreter::Tape &TheTape;
+  std::vector<long>        LinOffsets;
+  std::vector<T>           Storage;
+  std::vector<const T*>    Regs;
+};
+
+template <typename T>
+TapeEvaluator<T>::TapeEvaluator(const Interpreter::Tape &Tp,
+                                const std::vector<long> &Lin,
+                                const double *Params)
+  : TheTape(Tp), LinOffsets(Lin),
+    Storage(Tp.NumRegs*Interpreter::ChunkSize), Regs(Tp.NumRegs, NULL) {
+
+  // Fill the pinned registers
+  for (unsigned i = 0, e = Tp.Code.size(); i != e; ++i) {
+    const Interpreter::Instruction &I = Tp.Code[i];
+    T                               V;
+
+    if (I.Op == Interpreter::LoadConst) {
+      V = (T)Tp.Constants[I.A];
+    } else if (I.Op == Interpreter::LoadParam) {
+      V = (T)Params[I.A];
+    } else {
+      continue;
+    }
+
+    std::fill(reg(I.Dst), reg(I.Dst) + Interpreter::ChunkSize, V);
+    Regs[I.Dst] = reg(I.Dst);
+  }
+}
+
+template <typename T>
+const T *TapeEvaluator<T>::run(const std::vector<FieldBuffer> &Bufs,
+                               long Index, unsigned N) {
+  const bool IsDouble = sizeof(T) == sizeof(double);
+
+  for (unsigned i = 0, e = TheTape.Code.size(); i != e; ++i) {
+    const Interpreter::Instruction &I = TheTape.Code[i];
+
+    switch (I.Op) {
+    case Interpreter::LoadConst:
+    case Interpreter::LoadParam:
+      break;
+    case Interpreter::LoadField: {
+      const FieldBuffer &FB  = Bufs[I.A];
+      long               Idx = Index + LinOffsets[I.B];
+
+      if (FB.IsDouble == IsDouble) {
+        Regs[I.Dst] = static_cast<const T*>(FB.Cur) + Idx;
+      } else {
+        T *D = reg(I.Dst);
+        if (FB.IsDouble) {
+          const double *S = static_cast<const double*>(FB.Cur) + Idx;
+          for (unsigned p = 0; p < N; ++p) D[p] = (T)S[p];
+        } else {
+          const float *S = static_cast<const float*>(FB.Cur) + Idx;
+          for (unsigned p = 0; p < N; ++p) D[p] = (T)S[p];
+        }
+        Regs[I.Dst] = D;
+      }
+      break;
+    }
+    case Interpreter::Add: {
+      const T *L = Regs[I.A], *R = Regs[I.B];
+      T       *D = reg(I.Dst);
+      for (unsigned p = 0; p < N; ++p) D[p] = L[p] + R[p];
+      Regs[I.Dst] = D;
+      break;
+    }
+    case Interpreter::Sub: {
+      const T *L = Regs[I.A], *R = Regs[I.B];
+      T       *D = reg(I.Dst);
+      for (unsigned p = 0; p < N; ++p) D[p] = L[p] - R[p];
+      Regs[I.Dst] = D;
+      break;
+    }
+    case Interpreter::Mul: {
+      const T *L = Regs[I.A], *R = Regs[I.B];
+      T       *D = reg(I.Dst);
+      for (unsigned p = 0; p < N; ++p) D[p] = L[p] * R[p];
+      Regs[I.Dst] = D;
+      break;
+    }
+    case Interpreter::Div: {
+      const T *L = Regs[I.A], *R = Regs[I.B];
+      T       *D = reg(I.Dst);
+      for (unsigned p = 0; p < N; ++p) D[p] = L[p] / R[p];
+      Regs[I.Dst] = D;
+      break;
+    }
+    case Interpreter::Call1: {
+      const MathFunction &F = MathFunctions[I.C];
+      const T            *X = Regs[I.A];
+      T                  *D = reg(I.Dst);
+      for (unsigned p = 0; p < N; ++p) D[p] = apply(F, X[p]);
+      Regs[I.Dst] = D;
+      break;
+    }
+    case Interpreter::Call2: {
+      const MathFunction &F = MathFunctions[I.C];
+      const T            *X = Regs[I.A], *Y = Regs[I.B];
+      T                  *D = reg(I.Dst);
+      for (unsigned p = 0; p < N; ++p) D[p] = apply(F, X[p], Y[p]);
+      Regs[I.Dst] = D;
+      break;
+    }
+    }
+  }
+
+  return Regs[TheTape.Result];
+}
+
+int evalBound(const BoundExpr &B, int DimSize) {
+  if (B.Base == (unsigned)(-1)) {
+    return DimSize - (int)B.Constant - 1;
+  } else {
+    return (int)(B.Base + B.Constant);
+  }
+}
+
+/// createEvaluators - Appends to \p Evals an evaluator for each of the tapes
+/// \p Tapes of a function, whose field loads are at \p LinOffsets.
+template <typename T>
+void createEvaluators(const std::vector<Interpreter::Tape> &Tapes,
+                      const std::vector<std::vector<long> > &LinOffsets,
+                      const double *Params,
+                      std::vector<TapeEvaluator<T>*> &Evals) {
+  for (unsigned i = 0, e = Tapes.size(); i != e; ++i) {
+    Evals.push_back(new TapeEvaluator<T>(Tapes[i], LinOffsets[i], Params));
+  }
+}
+
+/// runFunction - Evaluates function \p F over the whole grid with the
+/// evaluators \p Evals of its bounded functions, writing the Next buffer of
+/// its output field.
+template <typename T>
+void runFunction(const overtile::Function *F,
+                 const std::vector<TapeEvaluator<T>*> &Evals,
+                 const std::vector<FieldBuffer> &Bufs,
+                 unsigned Out, const std::vector<int> &Dims,
+                 const std::vector<long> &Strides) {
+  const std::list<BoundedFunction> &BFuncs  = F->getBoundedFunctions();
+  unsigned                          NumDims = Dims.size();
+  unsigned                          NumBF   = BFuncs.size();
+
+  const T *Cur  = static_cast<const T*>(Bufs[Out].Cur);
+  T       *Next = static_cast<T*>(Bufs[Out].Next);
+
+  long NumRows = 1;
+  for (unsigned d = 1; d < NumDims; ++d) {
+    NumRows *= Dims[d];
+  }
+
+  std::vector<int>  Point(NumDims, 0);
+  std::vector<bool> RowIn(NumBF);
+  std::vector<int>  Lo(NumBF), Hi(NumBF);
+  std::vector<int>  Cuts;
+
+  for (long Row = 0; Row < NumRows; ++Row) {
+    long Rem = Row;
+    for (unsigned d = 1; d < NumDims; ++d) {
+      Point[d] = Rem % Dims[d];
+      Rem     /= Dims[d];
+    }
+
+    long RowBase = 0;
+    for (unsigned d = 1; d < NumDims; ++d) {
+      RowBase += Point[d] * Strides[d];
+    }
+
+    // Along dimension 0 every bounded function covers an interval, so the
+    // row splits into segments that each map to a single tape.
+    Cuts.clear();
+    Cuts.push_back(0);
+    Cuts.push_back(Dims[0]);
+
+    unsigned k = 0;
+    for (std::list<BoundedFunction>::const_iterator I = BFuncs.begin(),
+           E = BFuncs.end(); I != E; ++I, ++k) {
+      RowIn[k] = true;
+      for (unsigned d = 1; d < NumDims; ++d) {
+        RowIn[k] = RowIn[k] &&
+                   Point[d] >= evalBound(I->Bounds[d].LowerBound, Dims[d]) &&
+                   Point[d] <= evalBound(I->Bounds[d].UpperBound, Dims[d]);
+      }
+      Lo[k] = evalBound(I->Bounds[0].LowerBound, Dims[0]);
+      Hi[k] = evalBound(I->Bounds[0].UpperBound, Dims[0]);
+      if (RowIn[k]) {
+        Cuts.push_back(std::min(std::max(Lo[k], 0), Dims[0]));
+        Cuts.push_back(std::min(std::max(Hi[k]+1, 0), Dims[0]));
+      }
+    }
+
+    std::sort(Cuts.begin(), Cuts.end());
+    Cuts.erase(std::unique(Cuts.begin(), Cuts.end()), Cuts.end());
+
+    for (unsigned c = 0; c+1 < Cuts.size(); ++c) {
+      int Start = Cuts[c];
+      int End   = Cuts[c+1];
+
+      unsigned BF = 0;
+      while (BF < NumBF && !(RowIn[BF] && Lo[BF] <= Start && Start <= Hi[BF])) {
+        ++BF;
+      }
+
+      if (BF == NumBF) {
+        // Points outside of all bounds keep their current value.
+        std::memcpy(Next + RowBase + Start, Cur + RowBase + Start,
+                    sizeof(T)*(End-Start));
+        continue;
+      }
+
+      for (int p = Start; p < End; p += Interpreter::ChunkSize) {
+        unsigned N   = std::min<int>(Interpreter::ChunkSize, End - p);
+        const T *Res = Evals[BF]->run(Bufs, RowBase + p, N);
+        std::memcpy(Next + RowBase + p, Res, sizeof(T)*N);
+      }
+    }
+  }
+}
+
+template <typename T>
+bool checkConvergence(const void *Old, const void *New, long N,
+                      double Tolerance) {
+  const T *O = static_cast<const T*>(Old);
+  const T *C = static_cast<const T*>(New);
+  for (long i = 0; i < N; ++i) {
+    if (std::fabs((double)O[i] - (double)C[i]) > Tolerance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+
+Interpreter::Interpreter(Grid *G)
+  : BackEnd(G), Compiled(false) {
+}
+
+Interpreter::~Interpreter() {
+}
+
+void Interpreter::compile() {
+  if (Compiled) return;
+
+  ExprSimplifier::simplifyGrid(getGrid(), getFastMath());
+  DivisionReducer::reduceGrid(getGrid(), getFastMath());
+
+  // Shared subexpressions are compiled once, see TapeBuilder::visit().
+  ExprDAG::canonicalizeGrid(getGrid());
+
+  Grid                 *G         = getGrid();
+  std::list<Function*>  Functions = G->getFunctionList();
+  std::list<Field*>     Fields    = G->getFieldList();
+
+  typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+  const ParamList Params = G->getParameters();
+
+  std::map<const Field*, unsigned> FieldIdx;
+  std::map<std::string, unsigned>  ParamIdx;
+
+  unsigned Idx = 0;
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    FieldIdx[*I] = Idx++;
+  }
+  Idx = 0;
+  for (ParamList::const_iterator I = Params.begin(), E = Params.end(); I != E;
+       ++I) {
+    ParamIdx[I->first] = Idx++;
+  }
+
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    const std::list<BoundedFunction> &BFuncs = (*I)->getBoundedFunctions();
+
+    Tapes.push_back(std::vector<Tape>());
+
+    for (std::list<BoundedFunction>::const_iterator BI = BFuncs.begin(),
+           BE = BFuncs.end(); BI != BE; ++BI) {
+      Tapes.back().push_back(Tape());
+      TapeBuilder Builder(Tapes.back().back(), FieldIdx, ParamIdx);
+      Builder.build(BI->Expr);
+    }
+  }
+
+  Compiled = true;
+}
+
+bool Interpreter::execute(int TimeSteps, void *const *Fields, const int *Dims,
+                          const double *Params, double Tolerance) {
+  compile();
+
+  Grid                 *G         = getGrid();
+  unsigned              NumDims   = G->getNumDimensions();
+  std::list<Function*>  Functions = G->getFunctionList();
+  std::list<Field*>     FieldList = G->getFieldList();
+  const Field          *CF        = getConvergeField();
+
+  std::vector<int>  DimSizes(Dims, Dims + NumDims);
+  std::vector<long> Strides(NumDims, 1);
+  long              NumPoints = DimSizes[0];
+
+  for (unsigned d = 1; d < NumDims; ++d) {
+    Strides[d] = Strides[d-1] * DimSizes[d-1];
+    NumPoints *= DimSizes[d];
+  }
+
+  if (NumPoints <= 0) {
+    return true;
+  }
+
+  // Fields written by some function get a second buffer, all other fields
+  // are read in place.
+  std::map<const Field*, unsigned> FieldIdx;
+  std::vector<FieldBuffer>         Bufs;
+  std::vector<bool>                Updated(FieldList.size(), false);
+
+  for (std::list<Field*>::iterator I = FieldList.begin(), E = FieldList.end();
+       I != E; ++I) {
+    FieldBuffer FB;
+    FB.IsDouble = isa<FP64Type>((*I)->getElementType());
+    FB.Host     = Fields[Bufs.size()];
+    FB.Cur      = FB.Host;
+    FB.Next     = NULL;
+    FieldIdx[*I] = Bufs.size();
+    Bufs.push_back(FB);
+  }
+
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    unsigned Idx = FieldIdx[(*I)->getOutput()];
+    if (Updated[Idx]) continue;
+
+    FieldBuffer &FB    = Bufs[Idx];
+    size_t       Bytes = NumPoints * (FB.IsDouble ? sizeof(double)
+                                                  : sizeof(float));
+    FB.Cur  = std::malloc(Bytes);
+    FB.Next = std::malloc(Bytes);
+    std::memcpy(FB.Cur, FB.Host, Bytes);
+    Updated[Idx] = true;
+  }
+
+  // Keep the state before the last time step for the convergence check.
+  void   *Check      = NULL;
+  size_t  CheckBytes = 0;
+  if (CF && Updated[FieldIdx[CF]]) {
+    const FieldBuffer &FB = Bufs[FieldIdx[CF]];
+    CheckBytes = NumPoints * (FB.IsDouble ? sizeof(double) : sizeof(float));
+    Check      = std::malloc(CheckBytes);
+    std::memcpy(Check, FB.Host, CheckBytes);
+  }
+
+  // Linear offsets of the field loads for this grid size
+  std::vector<std::vector<std::vector<long> > > LinOffsets(Tapes.size());
+  for (unsigned f = 0, fe = Tapes.size(); f != fe; ++f) {
+    for (unsigned t = 0, te = Tapes[f].size(); t != te; ++t) {
+      const std::vector<std::vector<int> > &Offsets = Tapes[f][t].Offsets;
+      LinOffsets[f].push_back(std::vector<long>());
+      for (unsigned o = 0, oe = Offsets.size(); o != oe; ++o) {
+        long Lin = 0;
+        for (unsigned d = 0, de = Offsets[o].size(); d != de; ++d) {
+          Lin += Offsets[o][d] * Strides[d];
+        }
+        LinOffsets[f].back().push_back(Lin);
+      }
+    }
+  }
+
+  // Evaluators fill their constant registers when they are created, so they
+  // are created once per run and not for every time step.  Each function is
+  // evaluated in the type of its output field.
+  std::vector<std::vector<TapeEvaluator<float>*> >  FloatEvals(Tapes.size());
+  std::vector<std::vector<TapeEvaluator<double>*> > DoubleEvals(Tapes.size());
+
+  unsigned Fn = 0;
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I, ++Fn) {
+    if (Bufs[FieldIdx[(*I)->getOutput()]].IsDouble) {
+      createEvaluators(Tapes[Fn], LinOffsets[Fn], Params, DoubleEvals[Fn]);
+    } else {
+      createEvaluators(Tapes[Fn], LinOffsets[Fn], Params, FloatEvals[Fn]);
+    }
+  }
+
+  for (int t = 0; t < TimeSteps; ++t) {
+    if (Check && t == TimeSteps-1) {
+      std::memcpy(Check, Bufs[FieldIdx[CF]].Cur, CheckBytes);
+    }
+
+    unsigned f = 0;
+    for (std::list<Function*>::iterator I = Functions.begin(),
+           E = Functions.end(); I != E; ++I, ++f) {
+      unsigned     Out = FieldIdx[(*I)->getOutput()];
+      FieldBuffer &FB  = Bufs[Out];
+
+      if (FB.IsDouble) {
+        runFunction(*I, DoubleEvals[f], Bufs, Out, DimSizes, Strides);
+      } else {
+        runFunction(*I, FloatEvals[f], Bufs, Out, DimSizes, Strides);
+      }
+
+      std::swap(FB.Cur, FB.Next);
+    }
+  }
+
+  for (unsigned f = 0, fe = Tapes.size(); f != fe; ++f) {
+    for (unsigned i = 0, e = FloatEvals[f].size(); i != e; ++i) {
+      delete FloatEvals[f][i];
+    }
+    for (unsigned i = 0, e = DoubleEvals[f].size(); i != e; ++i) {
+      delete DoubleEvals[f][i];
+    }
+  }
+
+  for (unsigned i = 0, e = Bufs.size(); i != e; ++i) {
+    if (!Updated[i]) continue;
+
+    FieldBuffer &FB    = Bufs[i];
+    size_t       Bytes = NumPoints * (FB.IsDouble ? sizeof(double)
+                                                  : sizeof(float));
+    std::memcpy(FB.Host, FB.Cur, Bytes);
+    std::free(FB.Cur);
+    std::free(FB.Next);
+  }
+
+  bool Converged = true;
+  if (Check) {
+    if (Bufs[FieldIdx[CF]].IsDouble) {
+      Converged = checkConvergence<double>(Check, Bufs[FieldIdx[CF]].Host,
+                                           NumPoints, Tolerance);
+    } else {
+      Converged = checkConvergence<float>(Check, Bufs[FieldIdx[CF]].Host,
+                                          NumPoints, Tolerance);
+    }
+    std::free(Check);
+  }
+
+  return Converged;
+}
+
+void Interpreter::codegen(llvm::raw_ostream &OS) {
+  compile();
+
+  Grid                 *G         = getGrid();
+  unsigned              NumDims   = G->getNumDimensions();
+  std::list<Function*>  Functions = G->getFunctionList();
+  std::list<Field*>     Fields    = G->getFieldList();
+
+  typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+  const ParamList Params = G->getParameters();
+
+  std::vector<std::string> FieldNames;
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    FieldNames.push_back((*I)->getName());
+  }
+  std::vector<std::string> ParamNames;
+  for (ParamList::const_iterator I = Params.begin(), E = Params.end(); I != E;
+       ++I) {
+    ParamNames.push_back(I->first);
+  }
+
+  OS << "; OverTile bytecode for program " << G->getName() << "\n";
+
+  unsigned f = 0;
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I, ++f) {
+    const std::list<BoundedFunction> &BFuncs = (*I)->getBoundedFunctions();
+
+    unsigned t = 0;
+    for (std::list<BoundedFunction>::const_iterator BI = BFuncs.begin(),
+           BE = BFuncs.end(); BI != BE; ++BI, ++t) {
+      const Tape &Tp = Tapes[f][t];
+
+      // Bounds and offsets are listed in source order, i.e. the outermost
+      // dimension first.
+      OS << "\n" << (*I)->getOutput()->getName() << " @";
+      for (unsigned d = NumDims; d-- > 0; ) {
+        const FunctionBound &FB = BI->Bounds[d];
+        OS << "[";
+        if (FB.LowerBound.Base == (unsigned)(-1))
+          OS << "$-" << FB.LowerBound.Constant;
+        else
+          OS << FB.LowerBound.Base + FB.LowerBound.Constant;
+        OS << ":";
+        if (FB.UpperBound.Base == (unsigned)(-1))
+          OS << "$-" << FB.UpperBound.Constant;
+        else
+          OS << FB.UpperBound.Base + FB.UpperBound.Constant;
+        OS << "]";
+      }
+      OS << "  ; " << Tp.NumRegs << " registers\n";
+
+      for (unsigned i = 0, e = Tp.Code.size(); i != e; ++i) {
+        const Instruction &In = Tp.Code[i];
+
+        OS << "  r" << In.Dst << " = ";
+        switch (In.Op) {
+        case LoadField:
+          OS << "load " << FieldNames[In.A];
+          for (unsigned d = Tp.Offsets[In.B].size(); d-- > 0; ) {
+            OS << "[" << Tp.Offsets[In.B][d] << "]";
+          }
+          break;
+        case LoadConst: OS << "const " << Tp.Constants[In.A]; break;
+        case LoadParam: OS << "param " << ParamNames[In.A]; break;
+        case Add: OS << "add r" << In.A << ", r" << In.B; break;
+        case Sub: OS << "sub r" << In.A << ", r" << In.B; break;
+        case Mul: OS << "mul r" << In.A << ", r" << In.B; break;
+        case Div: OS << "div r" << In.A << ", r" << In.B; break;
+        case Call1:
+          OS << "call " << MathFunctions[In.C].Name << "(r" << In.A << ")";
+          break;
+        case Call2:
+          OS << "call " << MathFunctions[In.C].Name << "(r" << In.A << ", r"
+             << In.B << ")";
+          break;
+        }
+        OS << "\n";
+      }
+      OS << "  ret r" << Tp.Result << "\n";
+    }
+  }
+}
+
+}
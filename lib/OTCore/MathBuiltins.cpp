@@ -0,0 +1,76 @@
+/*
+ * MathBuiltins.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: MathBuiltins.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Core/MathBuiltins.h"
+
+using namespace llvm;
+
+namespace overtile {
+
+namespace {
+
+/// Weights approximate the throughput of the functions relative to an
+/// addition.
+const MathBuiltin MathBuiltins[] = {
+  // Name     Arity  Weight  LibName  Reciprocal
+  { "fabs",   1,      1.0,   "fabs",  false },
+  { "floor",  1,      1.0,   "floor", false },
+  { "ceil",   1,      1.0,   "ceil",  false },
+  { "fmin",   2,      1.0,   "fmin",  false },
+  { "fmax",   2,      1.0,   "fmax",  false },
+  { "min",    2,      1.0,   "fmin",  false },
+  { "max",    2,      1.0,   "fmax",  false },
+  { "rsqrt",  1,      2.0,   "sqrt",  true  },
+  { "sqrt",   1,      4.0,   "sqrt",  false },
+  { "cbrt",   1,      8.0,   "cbrt",  false },
+  { "exp",    1,      8.0,   "exp",   false },
+  { "exp2",   1,      8.0,   "exp2",  false },
+  { "log",    1,      8.0,   "log",   false },
+  { "log2",   1,      8.0,   "log2",  false },
+  { "sin",    1,      8.0,   "sin",   false },
+  { "cos",    1,      8.0,   "cos",   false },
+  { "tan",    1,     16.0,   "tan",   false },
+  { "atan",   1,     16.0,   "atan",  false },
+  { "tanh",   1,     16.0,   "tanh",  false },
+  { "atan2",  2,     16.0,   "atan2", false },
+  { "pow",    2,     16.0,   "pow",   false }
+};
+
+const unsigned NumMathBuiltins =
+  sizeof(MathBuiltins) / sizeof(MathBuiltins[0]);
+
+}
+
+const MathBuiltin *lookupMathBuiltin(StringRef Name) {
+  if (Name.startswith("__")) {
+    Name = Name.substr(2);
+  }
+
+  for (unsigned i = 0; i != NumMathBuiltins; ++i) {
+    StringRef Known = MathBuiltins[i].Name;
+    if (Name == Known ||
+        (Name.size() == Known.size()+1 && Name.startswith(Known) &&
+         Name[Name.size()-1] == 'f')) {
+      return &MathBuiltins[i];
+    }
+  }
+  return NULL;
+}
+
+}
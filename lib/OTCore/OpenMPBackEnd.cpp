@@ -0,0 +1,2424 @@
+/*
+ * OpenMPBackEnd.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: OpenMPBackEnd.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Core/OpenMPBackEnd.h"
+#include "overtile/Core/CostModel.h"
+#include "overtile/Core/ExprDAG.h"
+#include "overtile/Core/Expressions.h"
+#include "overtile/Core/Field.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Grid.h"
+#include "overtile/Core/MathBuiltins.h"
+#include "overtile/Core/Types.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cassert>
+#include <map>
+
+using namespace llvm;
+
+
+namespace overtile {
+
+OpenMPBackEnd::OpenMPBackEnd(Grid *G)
+  : BackEnd(G), VectorBits(getDefaultVectorBits()), UseRuntime(false),
+    FirstStep(false),
+    Guarded(false), Split(false), Stream(false), VectorLanes(0), JamRows(1),
+    JamRow(0) {
+}
+
+OpenMPBackEnd::~OpenMPBackEnd() {
+}
+
+unsigned OpenMPBackEnd::getDefaultVectorBits() {
+#if defined(__AVX512F__)
+  return 512;
+#elif defined(__AVX__)
+  return 256;
+#else
+  return 128;
+#endif
+}
+
+void OpenMPBackEnd::codegen(llvm::raw_ostream &OS) {
+  codegenKernel(OS);
+  codegenHost(OS);
+}
+
+bool OpenMPBackEnd::isTemporary(const Field *F) const {
+  return getTilingStrategy() == OverlappedTiling && BackEnd::isTemporary(F);
+}
+
+void OpenMPBackEnd::codegenKernel(llvm::raw_ostream &OS) {
+  Grid                 *G         = getGrid();
+  unsigned              NumDims   = G->getNumDimensions();
+  std::list<Function*>  Functions = G->getFunctionList();
+  std::list<Field*>     Fields    = G->getFieldList();
+
+  OS << "//\n"
+     << "// Generated by OverTile\n"
+     << "//\n"
+     << "// Description:\n"
+     << "// OpenMP kernel code\n"
+     << "//\n";
+
+  OS << "#include <algorithm>\n";
+  OS << "#include <cassert>\n";
+  OS << "#include <cmath>\n";
+  OS << "#include <cstdlib>\n";
+  OS << "#include <cstring>\n";
+  OS << "#include <iostream>\n";
+  if (UseRuntime) {
+    OS << "#include \"overtile/Runtime/Runtime.h\"\n";
+  } else {
+    OS << "#include <omp.h>\n";
+  }
+
+  OS << "static inline int ot_clamp(int V, int N) {\n";
+  OS << "  return V < 0 ? 0 : (V >= N ? N-1 : V);\n";
+  OS << "}\n";
+
+  // Pipeline stages wait for each other.  Like the runtime, poll with a
+  // pause and yield the core once the wait gets long, so that a waiting
+  // stage does not take the time slices of the one it waits for when there
+  // are more threads than cores.
+  if (getTilingStrategy() == WavefrontTiling) {
+    OS << "#include <sched.h>\n";
+    OS << "static inline void ot_backoff(int &Spins) {\n";
+    OS << "  if (++Spins < 1024) {\n";
+    OS << "#if defined(__i386__) || defined(__x86_64__)\n";
+    OS << "    __asm__ __volatile__(\"pause\" ::: \"memory\");\n";
+    OS << "#endif\n";
+    OS << "  } else {\n";
+    OS << "    sched_yield();\n";
+    OS << "  }\n";
+    OS << "}\n";
+  }
+
+  // Multiply-adds are only fused where the target has an FMA instruction;
+  // elsewhere fmaf() is a slow library routine.
+  if (getContraction()) {
+    const char *Types[][2] = { { "float", "ot_fmaf" }, { "double", "ot_fma" } };
+    for (unsigned i = 0; i < 2; ++i) {
+      const char *S = Types[i][0];
+      OS << "static inline " << S << " " << Types[i][1] << "(" << S << " A, "
+         << S << " B, " << S << " C) {\n";
+      OS << "#ifdef FP_FAST_FMA" << (i == 0 ? "F" : "") << "\n";
+      OS << "  return " << (i == 0 ? "fmaf" : "fma") << "(A, B, C);\n";
+      OS << "#else\n";
+      OS << "  return A*B+C;\n";
+      OS << "#endif\n";
+      OS << "}\n";
+    }
+  }
+
+  // Scratch buffers are aligned so that vector loads of the center point
+  // can be aligned.
+  OS << "template <typename T> static T *ot_alloc(int N) {\n";
+  OS << "  void *P = 0;\n";
+  OS << "  if (posix_memalign(&P, 64, sizeof(T)*N) != 0) return 0;\n";
+  OS << "  memset(P, 0, sizeof(T)*N);\n";
+  OS << "  return (T*)P;\n";
+  OS << "}\n";
+
+  if (VectorBits > 0) {
+    codegenVectorSupport(OS);
+  }
+
+  // Fields written by some function live in the scratch buffers, all other
+  // fields are only ever read from global memory.
+  UpdatedFields.clear();
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    UpdatedFields.insert((*I)->getOutput()->getName());
+  }
+
+  // Kernel arguments, as (type, name) pairs
+  std::vector<std::pair<std::string, std::string> > Args;
+  Args.push_back(std::make_pair("int", "Steps"));
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field       *F      = *I;
+    std::string  TyName = getTypeName(F->getElementType());
+    Args.push_back(std::make_pair(TyName + " *", "In_" + F->getName()));
+    Args.push_back(std::make_pair(TyName + " *", "Out_" + F->getName()));
+  }
+  for (unsigned i = 0; i < NumDims; ++i) {
+    Args.push_back(std::make_pair(std::string("int"),
+                                  "Dim_" + llvm::utostr(i)));
+  }
+
+  typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+  const ParamList Params = G->getParameters();
+
+  for (ParamList::const_iterator I = Params.begin(), E = Params.end(); I != E;
+       ++I) {
+    Args.push_back(std::make_pair(getTypeName(I->second), I->first));
+  }
+
+  if (UseRuntime) {
+    // The kernel body runs on every worker of the runtime.  The arguments
+    // are passed through a struct and unpacked into locals of the same
+    // names.
+    OS << "struct ot_args_" << G->getName() << " {\n";
+    for (unsigned i = 0, e = Args.size(); i != e; ++i) {
+      OS << "  " << Args[i].first << " " << Args[i].second << ";\n";
+    }
+    OS << "};\n";
+
+    OS << "static void ot_worker_" << G->getName()
+       << "(void *Arg, int Worker) {\n";
+    OS << "  const ot_args_" << G->getName() << " &A = *(const ot_args_"
+       << G->getName() << "*)Arg;\n";
+    for (unsigned i = 0, e = Args.size(); i != e; ++i) {
+      OS << "  " << Args[i].first << " " << Args[i].second << " = A."
+         << Args[i].second << ";\n";
+    }
+  } else {
+    OS << "static void ot_kernel_" << G->getName() << "(";
+    for (unsigned i = 0, e = Args.size(); i != e; ++i) {
+      if (i != 0) OS << ", ";
+      OS << Args[i].first << " " << Args[i].second;
+    }
+    OS << ") {\n";
+  }
+
+  codegenInvariants(OS);
+
+  if (getTilingStrategy() == SplitTiling) {
+    codegenSplitTiles(OS);
+  } else if (getTilingStrategy() == WavefrontTiling) {
+    codegenWavefront(OS);
+  } else if (getTilingStrategy() == StreamingTiling) {
+    codegenStreaming(OS);
+  } else {
+    codegenOverlappedTiles(OS);
+  }
+
+  OS << "} // End of kernel\n";
+
+  if (UseRuntime) {
+    OS << "static void ot_kernel_" << G->getName() << "(";
+    for (unsigned i = 0, e = Args.size(); i != e; ++i) {
+      if (i != 0) OS << ", ";
+      OS << Args[i].first << " " << Args[i].second;
+    }
+    OS << ") {\n";
+    OS << "  ot_args_" << G->getName() << " A;\n";
+    for (unsigned i = 0, e = Args.size(); i != e; ++i) {
+      OS << "  A." << Args[i].second << " = " << Args[i].second << ";\n";
+    }
+    OS << "  ot_rt_run(ot_worker_" << G->getName() << ", &A);\n";
+    OS << "}\n";
+  }
+}
+
+void OpenMPBackEnd::codegenOverlappedTiles(llvm::raw_ostream &OS) {
+  Grid                 *G         = getGrid();
+  unsigned              NumDims   = G->getNumDimensions();
+  std::list<Function*>  Functions = G->getFunctionList();
+  std::list<Field*>     Fields    = G->getFieldList();
+
+  computeTileSizes();
+  codegenTileGeometry(NumDims, OS);
+
+  OS << "  const int ScratchSize = Pitch_0";
+  for (unsigned i = 1; i < NumDims; ++i) {
+    OS << "*Pitch_" << i;
+  }
+  OS << ";\n";
+
+  codegenParallelBegin(OS);
+
+  // Per-thread scratch, two planes per updated field.  The padding around
+  // the tile is never written and stays zero.
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (UpdatedFields.count(F->getName()) == 0) continue;
+    std::string TyName = getTypeName(F->getElementType());
+    OS << "    " << TyName << " *Shared_" << F->getName() << " = ot_alloc<"
+       << TyName << ">(ScratchSize);\n";
+    OS << "    " << TyName << " *Next_" << F->getName() << " = ot_alloc<"
+       << TyName << ">(ScratchSize);\n";
+  }
+
+  codegenGroupLoops(NumDims, OS);
+
+  for (unsigned i = 0; i < NumDims; ++i) {
+    OS << "    const int base_" << i << " = group_" << i << "*real_per_tile_"
+       << i << " - Halo_Left_" << i << ";\n";
+  }
+
+  // A tile is interior if every function can be evaluated with its first
+  // bounded function at every point of the tile, including the halo.
+  OS << "    const bool Interior = true";
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    const BoundedFunction &BF = *(*I)->getBoundedFunctions().begin();
+    for (unsigned i = 0; i < NumDims; ++i) {
+      OS << " && base_" << i << " >= "
+         << getBoundExpr(BF.Bounds[i].LowerBound, i)
+         << " && base_" << i << "+Tile_" << i << "-1 <= "
+         << getBoundExpr(BF.Bounds[i].UpperBound, i);
+    }
+  }
+  OS << ";\n";
+
+  for (unsigned Pass = 0; Pass < 2; ++Pass) {
+    Guarded = (Pass == 1);
+
+    if (!Guarded) {
+      OS << "    if (Interior) {\n";
+    } else {
+      OS << "    } else {\n";
+    }
+
+    OS << "    // First time step\n";
+    FirstStep = true;
+    codegenTimeStep(OS);
+
+    OS << "    // Remaining time steps\n";
+    FirstStep = false;
+    OS << "    for (int t = 1; t < Steps; ++t) {\n";
+    codegenTimeStep(OS);
+    OS << "    }\n";
+  }
+  OS << "    }\n";
+
+  codegenWriteBack(OS);
+  codegenGroupLoopsEnd(NumDims, OS);
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (UpdatedFields.count(F->getName()) == 0) continue;
+    OS << "    free(Shared_" << F->getName() << ");\n";
+    OS << "    free(Next_" << F->getName() << ");\n";
+  }
+
+  codegenParallelEnd(OS);
+}
+
+void OpenMPBackEnd::codegenTileGeometry(unsigned NumTiled,
+                                        llvm::raw_ostream &OS) {
+  if (getVerbose() && getScratchBudget() != 0) {
+    llvm::errs() << "Scratch tile:";
+    for (unsigned i = 0, e = TileSize.size(); i != e; ++i) {
+      llvm::errs() << " " << TileSize[i];
+    }
+    llvm::errs() << "\n";
+  }
+
+  for (unsigned i = 0; i < NumTiled; ++i) {
+    int LeftHalo, RightHalo;
+    if (!getHalo(0, i, LeftHalo, RightHalo)) {
+      report_fatal_error("Negative halo in dimension " + llvm::utostr(i));
+    }
+
+    OS << "  const int Halo_Left_" << i << " = " << LeftHalo << ";\n";
+    OS << "  const int Halo_Right_" << i << " = " << RightHalo << ";\n";
+    OS << "  const int Tile_" << i << " = " << TileSize[i] << ";\n";
+    OS << "  const int real_per_tile_" << i << " = Tile_" << i
+       << " - Halo_Left_" << i << " - Halo_Right_" << i << ";\n";
+    OS << "  const int num_tiles_" << i << " = (Dim_" << i
+       << " + real_per_tile_" << i << " - 1) / real_per_tile_" << i << ";\n";
+    OS << "  const int Pad_Left_" << i << " = " << PadLeft[i] << ";\n";
+    OS << "  const int Pitch_" << i << " = " << getPitch(i, TileSize[i])
+       << ";\n";
+  }
+}
+
+void OpenMPBackEnd::codegenTimeStep(llvm::raw_ostream &OS) {
+  std::list<Function*> Functions = getGrid()->getFunctionList();
+
+  WrittenFields.clear();
+
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    codegenFunction(*I, OS);
+  }
+}
+
+void OpenMPBackEnd::codegenFunction(Function *F, llvm::raw_ostream &OS) {
+  Grid                  *G       = getGrid();
+  unsigned               NumDims = G->getNumDimensions();
+  Field                 *Out     = F->getOutput();
+
+  OS << "    // Function " << Out->getName() << "\n";
+
+  for (int i = NumDims-1; i >= 2; --i) {
+    OS << "    for (int local_" << i << " = 0; local_" << i << " < Tile_" << i
+       << "; ++local_" << i << ") {\n";
+    codegenPointIndex(i, OS);
+  }
+
+  // Away from the grid boundary, the loop over dimension 1 is unrolled by
+  // the number of elements per thread and jammed into the loop over
+  // dimension 0, so that neighboring rows share their loads.
+  unsigned Jam = 1;
+  if (NumDims > 1 && !Guarded) {
+    Jam = std::min(getElements(1), TileSize[1]);
+  }
+
+  if (NumDims > 1 && Jam > 1) {
+    OS << "    {\n";
+    OS << "    int local_1 = 0;\n";
+    OS << "    for (; local_1 + " << Jam << " <= Tile_1; local_1 += " << Jam
+       << ") {\n";
+    codegenPointIndex(1, OS);
+    JamRows = Jam;
+    codegenRow(F, OS);
+    JamRows = 1;
+    OS << "    }\n";
+    if (TileSize[1] % Jam != 0) {
+      OS << "    for (; local_1 < Tile_1; ++local_1) {\n";
+      codegenPointIndex(1, OS);
+      codegenRow(F, OS);
+      OS << "    }\n";
+    }
+    OS << "    }\n";
+  } else if (NumDims > 1) {
+    OS << "    for (int local_1 = 0; local_1 < Tile_1; ++local_1) {\n";
+    codegenPointIndex(1, OS);
+    codegenRow(F, OS);
+    OS << "    }\n";
+  } else {
+    codegenRow(F, OS);
+  }
+
+  for (unsigned i = 2; i < NumDims; ++i) {
+    OS << "    }\n";
+  }
+
+  OS << "    std::swap(Shared_" << Out->getName() << ", Next_"
+     << Out->getName() << ");\n";
+
+  WrittenFields.insert(Out->getName());
+}
+
+void OpenMPBackEnd::codegenRow(Function *F, llvm::raw_ostream &OS) {
+  unsigned Lanes = Guarded ? 0 : getVectorLanes(F);
+
+  OS << "    {\n";
+  if (Lanes > 1) {
+    // Vector loop over dimension 0, followed by a scalar remainder loop
+    OS << "    int local_0 = 0;\n";
+    OS << "    for (; local_0 + " << Lanes << " <= Tile_0; local_0 += " << Lanes
+       << ") {\n";
+    codegenPointIndex(0, OS);
+    VectorLanes = Lanes;
+    codegenPoint(F, OS);
+    VectorLanes = 0;
+    OS << "    }\n";
+    OS << "    for (; local_0 < Tile_0; ++local_0) {\n";
+  } else {
+    OS << "    for (int local_0 = 0; local_0 < Tile_0; ++local_0) {\n";
+  }
+  codegenPointIndex(0, OS);
+  codegenPoint(F, OS);
+  OS << "    }\n";
+  OS << "    }\n";
+}
+
+void OpenMPBackEnd::codegenPointIndex(unsigned Dim, llvm::raw_ostream &OS) {
+  unsigned NumDims = getGrid()->getNumDimensions();
+
+  OS << "      const int thisid_" << Dim << " = base_" << Dim << " + local_"
+     << Dim << ";\n";
+  OS << "      const int Idx_" << Dim << " = ";
+  if (Dim != NumDims-1) OS << "Idx_" << (Dim+1) << "*Pitch_" << Dim << " + ";
+  OS << "local_" << Dim << " + Pad_Left_" << Dim << ";\n";
+  OS << "      const int GIdx_" << Dim << " = ";
+  if (Dim != NumDims-1) OS << "GIdx_" << (Dim+1) << "*Dim_" << Dim << " + ";
+  OS << "thisid_" << Dim << ";\n";
+}
+
+void OpenMPBackEnd::codegenPoint(Function *F, llvm::raw_ostream &OS) {
+  unsigned               NumDims = getGrid()->getNumDimensions();
+  Field                 *Out     = F->getOutput();
+  std::string            TyName  = getTypeName(Out->getElementType());
+  std::set<std::string>  Idents;
+
+  if (VectorLanes > 0) {
+    TyName = getVectorTypeName(Out->getElementType());
+  }
+
+  OS << "      " << TyName << " Res;\n";
+
+  const std::list<BoundedFunction> &BFuncs = F->getBoundedFunctions();
+
+  if (Guarded) {
+    for (std::list<BoundedFunction>::const_iterator I = BFuncs.begin(),
+           E = BFuncs.end(), B = I; I != E; ++I) {
+      const BoundedFunction &BF = *I;
+
+      if (I == B)
+        OS << "      if (";
+      else
+        OS << "      } else if (";
+
+      for (unsigned i = 0; i < NumDims; ++i) {
+        const FunctionBound &Bound = BF.Bounds[i];
+
+        if (i != 0) OS << " && ";
+
+        OS << "(thisid_" << i << " >= " << getBoundExpr(Bound.LowerBound, i)
+           << " && thisid_" << i << " <= "
+           << getBoundExpr(Bound.UpperBound, i) << ")";
+      }
+      OS << ") {\n";
+
+      Idents.clear();
+      codegenLoads(BF.Expr, OS, Idents);
+
+      codegenTemps(BF.Expr, OS);
+
+
+      OS << "      Res = ";
+      codegenExpr(BF.Expr, OS);
+      OS << ";\n";
+    }
+
+    OS << "      } else {\n";
+    if (FirstStep) {
+      // Points outside of the function bounds keep their current value.
+      OS << "      Res = (";
+      for (unsigned i = 0; i < NumDims; ++i) {
+        if (i != 0) OS << " && ";
+        OS << "thisid_" << i << " >= 0 && thisid_" << i << " < Dim_" << i;
+      }
+      OS << ") ? In_" << Out->getName() << "[GIdx_0] : 0;\n";
+    } else {
+      OS << "      Res = Shared_" << Out->getName() << "[Idx_0];\n";
+    }
+    OS << "      }\n";
+    codegenStore(Out, OS);
+  } else {
+    const BoundedFunction &BF = *(BFuncs.begin());
+
+    // The rows of an unroll-and-jam group are evaluated one after the other,
+    // and each row only loads the neighbors not loaded by the rows before.
+    for (JamRow = 0; JamRow < JamRows; ++JamRow) {
+      codegenLoads(BF.Expr, OS, Idents);
+
+      if (JamRows > 1) OS << "      {\n";
+      codegenTemps(BF.Expr, OS);
+
+
+      OS << "      Res = ";
+      codegenExpr(BF.Expr, OS);
+      OS << ";\n";
+      codegenStore(Out, OS);
+      if (JamRows > 1) OS << "      }\n";
+    }
+    JamRow = 0;
+  }
+}
+
+void OpenMPBackEnd::codegenStore(Field *Out, llvm::raw_ostream &OS) {
+  std::vector<int> Off(getGrid()->getNumDimensions(), 0);
+  if (JamRow > 0) Off[1] = JamRow;
+
+  if (VectorLanes > 0) {
+    OS << "      ot_store(&Next_" << Out->getName() << "["
+       << getScratchIndex(Off) << "], Res);\n";
+  } else {
+    OS << "      Next_" << Out->getName() << "[" << getScratchIndex(Off)
+       << "] = Res;\n";
+  }
+}
+
+void OpenMPBackEnd::codegenWriteBack(llvm::raw_ostream &OS) {
+  Grid                 *G       = getGrid();
+  unsigned              NumDims = G->getNumDimensions();
+  std::list<Field*>     Fields  = G->getFieldList();
+
+  OS << "    // Write back valid interior\n";
+
+  for (int i = NumDims-1; i >= 0; --i) {
+    OS << "    for (int local_" << i << " = Halo_Left_" << i << "; local_" << i
+       << " < Tile_" << i << " - Halo_Right_" << i << "; ++local_" << i
+       << ") {\n";
+    OS << "      const int thisid_" << i << " = base_" << i << " + local_" << i
+       << ";\n";
+    OS << "      if (thisid_" << i << " >= Dim_" << i << ") break;\n";
+    OS << "      const int Idx_" << i << " = ";
+    if (i != (int)NumDims-1) OS << "Idx_" << (i+1) << "*Pitch_" << i << " + ";
+    OS << "local_" << i << " + Pad_Left_" << i << ";\n";
+    OS << "      const int GIdx_" << i << " = ";
+    if (i != (int)NumDims-1) OS << "GIdx_" << (i+1) << "*Dim_" << i << " + ";
+    OS << "thisid_" << i << ";\n";
+  }
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (UpdatedFields.count(F->getName()) == 0 || isTemporary(F)) continue;
+    OS << "      Out_" << F->getName() << "[GIdx_0] = Shared_" << F->getName()
+       << "[Idx_0];\n";
+  }
+
+  for (unsigned i = 0; i < NumDims; ++i) {
+    OS << "    }\n";
+  }
+}
+
+void OpenMPBackEnd::codegenHost(llvm::raw_ostream &OS) {
+  Grid                 *G         = getGrid();
+  unsigned              NumDims   = G->getNumDimensions();
+  std::list<Function*>  Functions = G->getFunctionList();
+  std::list<Field*>     Fields    = G->getFieldList();
+
+  OS << "\n\n\n\n//\n"
+     << "// Generated by OverTile\n"
+     << "//\n"
+     << "// Description:\n"
+     << "// OpenMP host code\n"
+     << "//\n";
+
+  // Strip the trailing ";\n" from the canonical prototype
+  std::string Proto = getCanonicalPrototype();
+  OS << Proto.substr(0, Proto.size()-2) << " {\n";
+
+  OS << "  int ArraySize = Dim_0";
+  for (unsigned i = 1; i < NumDims; ++i) {
+    OS << "*Dim_" << i;
+  }
+  OS << ";\n";
+
+  OS << "  double TotalStart = " << getWallClock() << ";\n";
+
+  // The buffers are first touched in parallel, in the same order in which
+  // the threads work on the tiles, so that on NUMA machines the pages of a
+  // tile end up on the socket of the thread computing it.
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field       *F      = *I;
+    std::string  TyName = getTypeName(F->getElementType());
+    std::string  Name   = F->getName();
+
+    // The kernel never writes temporaries to the global buffers, so their
+    // one buffer serves as both input and output.
+    bool Temp = isTemporary(F);
+
+    if (UseRuntime) {
+      OS << "  " << TyName << " *" << Name << "_In = (" << TyName
+         << "*)ot_rt_alloc(sizeof(" << TyName << ")*ArraySize);\n";
+      OS << "  ot_rt_copy(" << Name << "_In, Host_" << Name << ", sizeof("
+         << TyName << ")*ArraySize);\n";
+      if (!Temp) {
+        OS << "  " << TyName << " *" << Name << "_Out = (" << TyName
+           << "*)ot_rt_alloc(sizeof(" << TyName << ")*ArraySize);\n";
+        OS << "  ot_rt_copy(" << Name << "_Out, Host_" << Name << ", sizeof("
+           << TyName << ")*ArraySize);\n";
+      }
+    } else {
+      OS << "  " << TyName << " *" << Name << "_In = new " << TyName
+         << "[ArraySize];\n";
+      if (!Temp) {
+        OS << "  " << TyName << " *" << Name << "_Out = new " << TyName
+           << "[ArraySize];\n";
+      }
+    }
+    OS << "  " << TyName << " *" << Name << "_InPtr = " << Name << "_In;\n";
+    OS << "  " << TyName << " *" << Name << "_OutPtr = " << Name
+       << (Temp ? "_In" : "_Out") << ";\n";
+  }
+
+  if (!UseRuntime) {
+    OS << "#pragma omp parallel for schedule(static)\n";
+    OS << "  for (int i = 0; i < ArraySize; ++i) {\n";
+    for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+         I != E; ++I) {
+      std::string Name = (*I)->getName();
+      OS << "    " << Name << "_In[i] = Host_" << Name << "[i];\n";
+      if (isTemporary(*I)) continue;
+      OS << "    " << Name << "_Out[i] = Host_" << Name << "[i];\n";
+    }
+    OS << "  }\n";
+  }
+
+  OS << "  double Start = " << getWallClock() << ";\n";
+
+  OS << "  for (int t = 0; t < timesteps; t += " << getTimeTileSize()
+     << ") {\n";
+  OS << "    int Steps = std::min(" << getTimeTileSize()
+     << ", timesteps - t);\n";
+
+  OS << "    ot_kernel_" << G->getName() << "(Steps";
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    OS << ", " << F->getName() << "_InPtr";
+    OS << ", " << F->getName() << "_OutPtr";
+  }
+  for (unsigned i = 0; i < NumDims; ++i) {
+    OS << ", Dim_" << i;
+  }
+
+  typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+  const ParamList Params = G->getParameters();
+
+  for (ParamList::const_iterator I = Params.begin(), E = Params.end(); I != E;
+       ++I) {
+    OS << ", " << I->first;
+  }
+  OS << ");\n";
+
+  bool InPlace = getTilingStrategy() == SplitTiling ||
+                 getTilingStrategy() == WavefrontTiling;
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (isTemporary(F)) continue;
+
+    if (InPlace) {
+      // Split and wavefront tiles alternate between the two buffers with
+      // every write, so the result is in the output buffer only after an
+      // odd number of writes.
+      unsigned Writes = 0;
+      for (std::list<Function*>::const_iterator FI =
+             G->getFunctionList().begin(), FE = G->getFunctionList().end();
+           FI != FE; ++FI) {
+        if ((*FI)->getOutput() == F) ++Writes;
+      }
+      if (Writes % 2 == 0) continue;
+      OS << "    if (Steps % 2 != 0)\n  ";
+    }
+    OS << "    std::swap(" << F->getName() << "_InPtr, " << F->getName()
+       << "_OutPtr);\n";
+  }
+
+  OS << "  }\n";
+
+  OS << "  double Elapsed = " << getWallClock() << " - Start;\n";
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (!isCopiedOut(F)) continue;
+    OS << "  " << (UseRuntime ? "ot_rt_copy" : "memcpy") << "(Host_"
+       << F->getName() << ", " << F->getName() << "_InPtr, sizeof("
+       << getTypeName(F->getElementType()) << ")*ArraySize);\n";
+  }
+
+  OS << "  double TotalElapsed = " << getWallClock()
+     << " - TotalStart;\n";
+
+  // Cost of a time step at one point, see CostModel.
+  PointCost Cost = CostModel::getGridCost(getGrid());
+
+  OS << "  double Points = (Dim_0)";
+  for (unsigned i = 1; i < NumDims; ++i) {
+    OS << " * (Dim_" << i << ")";
+  }
+  OS << ";\n";
+  OS << "  double Flops = Points * " << Cost.Flops << " * timesteps;\n";
+  OS << "  double Bytes = Points * " << Cost.getBytes() << " * timesteps;\n";
+  OS << "  double GFlops = Flops / Elapsed / 1e9;\n";
+  OS << "  std::cerr << \"GFlops: \" << GFlops << \"\\n\";\n";
+  OS << "  std::cerr << \"GB/s: \" << Bytes / Elapsed / 1e9 << \"\\n\";\n";
+  OS << "  std::cerr << \"Elapsed: \" << Elapsed << \"\\n\";\n";
+  OS << "  double TotalGFlops = Flops / TotalElapsed / 1e9;\n";
+  OS << "  std::cerr << \"Total GFlops: \" << TotalGFlops << \"\\n\";\n";
+  OS << "  std::cerr << \"Total Elapsed: \" << TotalElapsed << \"\\n\";\n";
+
+  // Convergence check
+  if (const Field *CF = getConvergeField()) {
+    OS << "  bool Converged = true;\n";
+    OS << "  for (int i = 0; i < ArraySize; ++i) {\n";
+    OS << "    if (std::abs(" << CF->getName() << "_OutPtr[i]-Host_"
+       << CF->getName() << "[i]) > Tolerance) {\n";
+    OS << "      std::cout << \"Check failed for \" << i << \": \" << std::abs("
+       << CF->getName() << "_OutPtr[i]-Host_" << CF->getName()
+       << "[i]) << \"\\n\";\n";
+    OS << "      Converged = false;\n";
+    OS << "      break;\n";
+    OS << "    }\n";
+    OS << "  }\n";
+  }
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (UseRuntime) {
+      OS << "  ot_rt_free(" << F->getName() << "_In);\n";
+      if (!isTemporary(F)) {
+        OS << "  ot_rt_free(" << F->getName() << "_Out);\n";
+      }
+    } else {
+      OS << "  delete [] " << F->getName() << "_In;\n";
+      if (!isTemporary(F)) {
+        OS << "  delete [] " << F->getName() << "_Out;\n";
+      }
+    }
+  }
+
+  if (getConvergeField()) {
+    OS << "  return Converged;\n";
+  } else {
+    OS << "  return;\n";
+  }
+
+  OS << "}\n";
+}
+
+void OpenMPBackEnd::codegenTemps(Expression *Expr, llvm::raw_ostream &OS) {
+  std::vector<Expression*> Temps;
+  findCommonSubexprs(Expr, Temps);
+
+  TempIndices.clear();
+  for (unsigned i = 0, e = Temps.size(); i != e; ++i) {
+    std::string TyName;
+    if (VectorLanes > 0) {
+      TyName = getVectorTypeName(VectorElementType);
+    } else {
+      TyName = getTypeName(getExprType(Temps[i], getGrid(), false));
+    }
+    OS << "      " << TyName << " " << getTempName(Temps[i], i) << " = ";
+    codegenExpr(Temps[i], OS);
+    OS << ";\n";
+    TempIndices[Temps[i]] = i;
+  }
+}
+
+void OpenMPBackEnd::codegenInvariants(llvm::raw_ostream &OS) {
+  std::list<Function*> Functions = getGrid()->getFunctionList();
+
+  TempIndices.clear();
+  InvariantIndices.clear();
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    const std::list<BoundedFunction> &BFuncs = (*I)->getBoundedFunctions();
+
+    for (std::list<BoundedFunction>::const_iterator BI = BFuncs.begin(),
+           BE = BFuncs.end(); BI != BE; ++BI) {
+      std::vector<Expression*> Invariants;
+      findInvariantSubexprs(BI->Expr, Invariants);
+
+      for (unsigned i = 0, e = Invariants.size(); i != e; ++i) {
+        if (InvariantIndices.count(Invariants[i])) continue;
+
+        unsigned Index = InvariantIndices.size();
+        OS << "  const "
+           << getTypeName(getExprType(Invariants[i], getGrid(), false))
+           << " ot_inv_" << Index << " = ";
+        codegenExpr(Invariants[i], OS);
+        OS << ";\n";
+        InvariantIndices[Invariants[i]] = Index;
+      }
+    }
+  }
+}
+
+void OpenMPBackEnd::codegenExpr(Expression *Expr, llvm::raw_ostream &OS) {
+  std::map<const Expression*, unsigned>::iterator Temp =
+    TempIndices.find(Expr);
+  if (Temp != TempIndices.end()) {
+    OS << getTempName(Expr, Temp->second);
+    return;
+  }
+
+  std::map<const Expression*, unsigned>::iterator Inv =
+    InvariantIndices.find(Expr);
+  if (Inv != InvariantIndices.end()) {
+    if (VectorLanes > 0) {
+      OS << "ot_splat((" << getTypeName(VectorElementType) << ")ot_inv_"
+         << Inv->second << ")";
+    } else {
+      OS << "ot_inv_" << Inv->second;
+    }
+    return;
+  }
+
+  if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    return codegenBinaryOp(Op, OS);
+  } else if (FieldRef *Ref = dyn_cast<FieldRef>(Expr)) {
+    return codegenFieldRef(Ref, OS);
+  } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    return codegenFunctionCall(FC, OS);
+  } else if (ConstantExpr *C = dyn_cast<ConstantExpr>(Expr)) {
+    return codegenConstant(C, OS);
+  } else if (PlaceHolderExpr *PH = dyn_cast<PlaceHolderExpr>(Expr)) {
+    if (VectorLanes > 0) {
+      OS << "ot_splat((" << getTypeName(VectorElementType) << ")"
+         << PH->getName() << ")";
+    } else {
+      OS << PH->getName();
+    }
+  } else {
+    report_fatal_error("Unhandled expression in OpenMPBackEnd::codegenExpr");
+  }
+}
+
+bool OpenMPBackEnd::codegenMultiplyAdd(BinaryOp *Op, llvm::raw_ostream &OS) {
+  if (!getContraction() || !dependsOnData(Op) ||
+      (Op->getOperator() != BinaryOp::ADD &&
+       Op->getOperator() != BinaryOp::SUB)) {
+    return false;
+  }
+
+  // Products held in a variable are not recomputed.
+  BinaryOp *Mul    = NULL;
+  bool      OnLeft = false;
+  for (unsigned i = 0; i != 2 && !Mul; ++i) {
+    BinaryOp *M = dyn_cast<BinaryOp>(i == 0 ? Op->getLHS() : Op->getRHS());
+    if (M && M->getOperator() == BinaryOp::MUL && !TempIndices.count(M) &&
+        !InvariantIndices.count(M)) {
+      Mul    = M;
+      OnLeft = i == 0;
+    }
+  }
+  if (!Mul) {
+    return false;
+  }
+
+  // a*b-c = fma(a, b, -c) and c-a*b = fma(-a, b, c).
+  bool        Sub    = Op->getOperator() == BinaryOp::SUB;
+  Expression *Addend = OnLeft ? Op->getRHS() : Op->getLHS();
+
+  if (VectorLanes > 0) {
+    OS << "ot_v_fma(";
+  } else if (isa<FP64Type>(getExprType(Op, getGrid(), false))) {
+    OS << "ot_fma(";
+  } else {
+    OS << "ot_fmaf(";
+  }
+  if (Sub && !OnLeft) OS << "-(";
+  codegenExpr(Mul->getLHS(), OS);
+  if (Sub && !OnLeft) OS << ")";
+  OS << ", ";
+  codegenExpr(Mul->getRHS(), OS);
+  OS << ", ";
+  if (Sub && OnLeft) OS << "-(";
+  codegenExpr(Addend, OS);
+  if (Sub && OnLeft) OS << ")";
+  OS << ")";
+  return true;
+}
+
+void OpenMPBackEnd::codegenBinaryOp(BinaryOp *Op, llvm::raw_ostream &OS) {
+  if (codegenMultiplyAdd(Op, OS)) {
+    return;
+  }
+
+  OS << "(";
+  codegenExpr(Op->getLHS(), OS);
+  switch (Op->getOperator()) {
+    default: assert(0 && "Unhandled binary operator"); break;
+    case BinaryOp::ADD: OS << "+"; break;
+    case BinaryOp::SUB: OS << "-"; break;
+    case BinaryOp::MUL: OS << "*"; break;
+    case BinaryOp::DIV: OS << "/"; break;
+  }
+  codegenExpr(Op->getRHS(), OS);
+  OS << ")";
+}
+
+namespace {
+/// getOffsetName - Returns the variable name suffix for offset \p Off, e.g.
+/// m1 for -1.
+std::string getOffsetName(int Off) {
+  std::string              Name;
+  llvm::raw_string_ostream NameStr(Name);
+
+  if (Off == 0)
+    NameStr << "0";
+  else if (Off > 0)
+    NameStr << "p" << Off;
+  else
+    NameStr << "m" << (-Off);
+
+  NameStr.flush();
+  return Name;
+}
+
+/// getRefName - Returns the canonical variable name for a field reference,
+/// e.g. A_p1_0 for A[1][0].  \p Row is added to the offset in dimension 1.
+std::string getRefName(FieldRef *Ref, int Row) {
+  const std::vector<IntConstant*> &Offsets = Ref->getOffsets();
+
+  std::string              VarName;
+  llvm::raw_string_ostream VarNameStr(VarName);
+
+  VarNameStr << Ref->getField()->getName();
+
+  for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
+    int Off = Offsets[i]->getValue();
+    if (i == 1) Off += Row;
+
+    VarNameStr << "_" << getOffsetName(Off);
+  }
+
+  VarNameStr.flush();
+  return VarName;
+}
+}
+
+void OpenMPBackEnd::codegenFieldRef(FieldRef *Ref, llvm::raw_ostream &OS) {
+  OS << getRefName(Ref, JamRow);
+}
+
+void OpenMPBackEnd::codegenFunctionCall(FunctionCall *FC,
+                                        llvm::raw_ostream &OS) {
+
+  const std::vector<Expression*> Exprs = FC->getParameters();
+  const MathBuiltin             *MB    = lookupMathBuiltin(FC->getName());
+
+  if (!MB) {
+    report_fatal_error("Unknown function '" + FC->getName() + "'");
+  }
+
+  // Scalar calls go to the C++ library, whose overloads follow the type of
+  // the arguments; vector calls to the implementations emitted by
+  // codegenVectorSupport().
+  if (VectorLanes > 0) {
+    OS << "ot_v_" << MB->Name << "(";
+  } else if (MB->Reciprocal) {
+    OS << "(1/std::" << MB->LibName << "(";
+  } else {
+    OS << "std::" << MB->LibName << "(";
+  }
+  for (unsigned i = 0, e = Exprs.size(); i != e; ++i) {
+    if (i > 0) OS << ", ";
+    codegenExpr(Exprs[i], OS);
+  }
+  OS << ")";
+  if (VectorLanes == 0 && MB->Reciprocal) {
+    OS << ")";
+  }
+}
+
+void OpenMPBackEnd::
+codegenConstant(ConstantExpr *Expr, llvm::raw_ostream &OS) {
+  if (VectorLanes > 0) {
+    OS << "ot_splat((" << getTypeName(VectorElementType) << ")"
+       << Expr->getStringValue() << ")";
+  } else {
+    OS << Expr->getStringValue();
+  }
+}
+
+void OpenMPBackEnd::codegenSplitTiles(llvm::raw_ostream &OS) {
+  Grid                 *G         = getGrid();
+  unsigned              NumDims   = G->getNumDimensions();
+  unsigned              D         = NumDims-1;
+  std::list<Function*>  Functions = G->getFunctionList();
+  std::list<Field*>     Fields    = G->getFieldList();
+  unsigned              Left, Right;
+
+  // Tiles are only formed along the outermost dimension.  Every function
+  // shrinks an upright tile by the largest offset in that dimension on both
+  // sides, and grows the inverted tile between two upright tiles by the same
+  // amount.  With two buffers per field, an upright tile only overwrites
+  // values that the inverted tiles no longer need as long as the slope is
+  // the same for all functions.
+  getMaxOffsets(D, Left, Right);
+
+  Split = true;
+  Guarded = false;
+
+  std::map<std::string, unsigned> Writes;
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    Writes[(*I)->getOutput()->getName()]++;
+  }
+
+  UpdatedFields.clear();
+  for (std::map<std::string, unsigned>::iterator I = Writes.begin(),
+         E = Writes.end(); I != E; ++I) {
+    UpdatedFields.insert(I->first);
+  }
+
+  OS << "  const int Radius = " << std::max(Left, Right) << ";\n";
+  OS << "  const int NumSub = Steps*" << Functions.size() << ";\n";
+  OS << "  const int Width = std::max(" << getElements(D)*getBlockSize(D)
+     << ", (2*NumSub+1)*Radius);\n";
+  OS << "  const int num_tiles = std::max(1, Dim_" << D << " / Width);\n";
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (UpdatedFields.count(F->getName()) == 0) continue;
+    std::string TyName = getTypeName(F->getElementType());
+    OS << "  " << TyName << " *Buf_" << F->getName() << "[2] = { In_"
+       << F->getName() << ", Out_" << F->getName() << " };\n";
+  }
+
+  codegenParallelBegin(OS);
+
+  if (D > 0) {
+    OS << "    const int SubLo = 0;\n";
+    OS << "    const int SubHi = Dim_" << (D-1) << ";\n";
+  }
+
+  for (unsigned Phase = 0; Phase < 2; ++Phase) {
+    if (Phase == 0) {
+      OS << "    // Upright tiles\n";
+      codegenTileLoop(0, OS);
+      OS << "      const int Begin = (int)((long long)tile*Dim_" << D
+         << "/num_tiles);\n";
+      OS << "      const int End = (int)((long long)(tile+1)*Dim_" << D
+         << "/num_tiles);\n";
+    } else {
+      OS << "    // Inverted tiles\n";
+      codegenTileLoop(1, OS);
+      OS << "      const int Begin = (int)((long long)tile*Dim_" << D
+         << "/num_tiles);\n";
+    }
+
+    for (std::map<std::string, unsigned>::iterator I = Writes.begin(),
+           E = Writes.end(); I != E; ++I) {
+      OS << "      int Cur_" << I->first << " = 0;\n";
+    }
+    OS << "      int Sub = 0;\n";
+    OS << "      for (int t = 0; t < Steps; ++t) {\n";
+
+    for (std::list<Function*>::iterator I = Functions.begin(),
+           E = Functions.end(); I != E; ++I) {
+      Function *F = *I;
+
+      OS << "      // Function " << F->getOutput()->getName() << "\n";
+      OS << "      {\n";
+      OS << "      ++Sub;\n";
+      if (Phase == 0) {
+        OS << "      const int Lo = tile == 0 ? 0 : Begin + Sub*Radius;\n";
+        OS << "      const int Hi = tile == num_tiles-1 ? Dim_" << D
+           << " : End - Sub*Radius;\n";
+      } else {
+        OS << "      const int Lo = Begin - Sub*Radius;\n";
+        OS << "      const int Hi = Begin + Sub*Radius;\n";
+      }
+      codegenSplitFunction(F, OS);
+      OS << "      }\n";
+    }
+
+    OS << "      }\n";
+    OS << "    }\n";
+  }
+
+  codegenParallelEnd(OS);
+
+  Split = false;
+}
+
+void OpenMPBackEnd::codegenWavefront(llvm::raw_ostream &OS) {
+  Grid                 *G         = getGrid();
+  unsigned              NumDims   = G->getNumDimensions();
+  unsigned              D         = NumDims-1;
+  std::list<Function*>  Functions = G->getFunctionList();
+  std::list<Field*>     Fields    = G->getFieldList();
+  unsigned              Left, Right;
+
+  // Every function of every time step is a stage of a pipeline over the
+  // planes of the outermost dimension.  A stage may compute a plane once
+  // the previous stage has finished all planes within the stencil radius,
+  // so the planes in flight between two stages stay in the shared cache.
+  // Since a stage never runs ahead of its predecessor, two buffers per
+  // field are enough.
+  getMaxOffsets(D, Left, Right);
+
+  Split = true;
+  Guarded = false;
+
+  std::map<std::string, unsigned> Writes;
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    Writes[(*I)->getOutput()->getName()]++;
+  }
+
+  UpdatedFields.clear();
+  for (std::map<std::string, unsigned>::iterator I = Writes.begin(),
+         E = Writes.end(); I != E; ++I) {
+    UpdatedFields.insert(I->first);
+  }
+
+  OS << "  const int Radius = " << std::max(Left, Right) << ";\n";
+  OS << "  const int NumSub = Steps*" << Functions.size() << ";\n";
+  // Progress counters, one cache line per counter
+  if (UseRuntime) {
+    OS << "  const int MaxThreads = ot_rt_num_workers();\n";
+    OS << "  int *Done = (int*)ot_rt_shared(Worker, "
+       << "sizeof(int)*NumSub*MaxThreads*16);\n";
+  } else {
+    OS << "  const int MaxThreads = omp_get_max_threads();\n";
+    OS << "  int *Done = new int[NumSub*MaxThreads*16]();\n";
+  }
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (UpdatedFields.count(F->getName()) == 0) continue;
+    std::string TyName = getTypeName(F->getElementType());
+    OS << "  " << TyName << " *Buf_" << F->getName() << "[2] = { In_"
+       << F->getName() << ", Out_" << F->getName() << " };\n";
+  }
+
+  codegenParallelBegin(OS);
+  if (UseRuntime) {
+    OS << "    const int NThreads = MaxThreads;\n";
+    OS << "    const int Tid = Worker;\n";
+  } else {
+    OS << "    const int NThreads = omp_get_num_threads();\n";
+    OS << "    const int Tid = omp_get_thread_num();\n";
+  }
+
+  // If there are more threads than stages, each stage is shared by a group
+  // of threads that split the planes along the next dimension.
+  if (D > 0) {
+    OS << "    const int Group = NumSub >= NThreads ? 1 : NThreads / NumSub;\n";
+  } else {
+    OS << "    const int Group = 1;\n";
+  }
+  OS << "    const int Member = Tid % Group;\n";
+  OS << "    const int Stride = NThreads / Group;\n";
+  if (D > 0) {
+    OS << "    const int SubLo = (int)((long long)Member*Dim_" << (D-1)
+       << "/Group);\n";
+    OS << "    const int SubHi = (int)((long long)(Member+1)*Dim_" << (D-1)
+       << "/Group);\n";
+  }
+  OS << "    for (int s = Tid / Group; Tid < Stride*Group && s < NumSub; "
+     << "s += Stride) {\n";
+  OS << "      const int t = s / " << Functions.size() << ";\n";
+  OS << "      for (int Plane = 0; Plane < Dim_" << D << "; ++Plane) {\n";
+  OS << "      if (s > 0) {\n";
+  OS << "        const int Need = std::min(Plane+Radius+1, Dim_" << D
+     << ");\n";
+  OS << "        for (int m = 0; m < Group; ++m) {\n";
+  OS << "          int Spins = 0;\n";
+  OS << "          while (__atomic_load_n(&Done[((s-1)*MaxThreads+m)*16], "
+     << "__ATOMIC_ACQUIRE) < Need) {\n";
+  OS << "            ot_backoff(Spins);\n";
+  OS << "          }\n";
+  OS << "        }\n";
+  OS << "      }\n";
+  OS << "      const int Lo = Plane;\n";
+  OS << "      const int Hi = Plane+1;\n";
+  OS << "      switch (s % " << Functions.size() << ") {\n";
+
+  std::map<std::string, unsigned> Before;
+  unsigned                        Index = 0;
+
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I, ++Index) {
+    Function *F = *I;
+
+    OS << "      case " << Index << ": {\n";
+
+    // Buffer holding the current version of every updated field
+    for (std::map<std::string, unsigned>::iterator WI = Writes.begin(),
+           WE = Writes.end(); WI != WE; ++WI) {
+      OS << "      int Cur_" << WI->first << " = (t*" << WI->second << "+"
+         << Before[WI->first] << ") & 1;\n";
+    }
+
+    OS << "      // Function " << F->getOutput()->getName() << "\n";
+    codegenSplitFunction(F, OS);
+    OS << "      break;\n";
+    OS << "      }\n";
+
+    Before[F->getOutput()->getName()]++;
+  }
+
+  OS << "      }\n";
+  OS << "      __atomic_store_n(&Done[(s*MaxThreads+Member)*16], Plane+1, "
+     << "__ATOMIC_RELEASE);\n";
+  OS << "      }\n";
+  OS << "    }\n";
+  codegenParallelEnd(OS);
+  if (!UseRuntime) {
+    OS << "  delete [] Done;\n";
+  }
+
+  Split = false;
+}
+
+void OpenMPBackEnd::codegenStreaming(llvm::raw_ostream &OS) {
+  Grid                  *G         = getGrid();
+  unsigned               NumDims   = G->getNumDimensions();
+  unsigned               D         = NumDims-1;
+  std::list<Function*>   FuncList  = G->getFunctionList();
+  std::vector<Function*> Functions(FuncList.begin(), FuncList.end());
+  std::list<Field*>      Fields    = G->getFieldList();
+  unsigned               NumFuncs  = Functions.size();
+  unsigned               Radius    = getStreamRadius();
+  unsigned               MaxLevels = getTimeTileSize()*NumFuncs + 1;
+
+  if (NumDims < 2) {
+    report_fatal_error("Streaming needs at least two dimensions");
+  }
+
+  // The tile is only formed in the inner dimensions.  The outermost
+  // dimension is streamed through: every function of every time step is a
+  // level that computes one plane of the tile per iteration, Radius planes
+  // behind the level before it.  Each level keeps a window of the last
+  // planes it computed, just deep enough for the levels reading from it.
+  Stream  = true;
+  Guarded = false;
+
+  UpdatedFields.clear();
+  for (unsigned f = 0; f < NumFuncs; ++f) {
+    UpdatedFields.insert(Functions[f]->getOutput()->getName());
+  }
+
+  computeTileSizes();
+  codegenTileGeometry(D, OS);
+
+  OS << "  const int PlaneSize = Pitch_0";
+  for (unsigned i = 1; i < D; ++i) {
+    OS << "*Pitch_" << i;
+  }
+  OS << ";\n";
+  OS << "  const int Radius = " << Radius << ";\n";
+  OS << "  const int NumSub = Steps*" << NumFuncs << ";\n";
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (UpdatedFields.count(F->getName()) == 0) continue;
+    OS << "  const int Depth_" << F->getName() << " = "
+       << getStreamDepth(F->getName()) << ";\n";
+  }
+
+  codegenParallelBegin(OS);
+
+  // Per-thread windows.  Level 0 holds the input planes of every updated
+  // field, level s the output of function (s-1) % NumFuncs.
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (UpdatedFields.count(F->getName()) == 0) continue;
+    std::string TyName = getTypeName(F->getElementType());
+    std::string Name   = F->getName();
+
+    OS << "    " << TyName << " *Win_" << Name << "[" << MaxLevels << "];\n";
+    OS << "    for (int s = 0; s <= NumSub; ++s) {\n";
+    OS << "      const bool Written = s == 0";
+    for (unsigned f = 0; f < NumFuncs; ++f) {
+      if (Functions[f]->getOutput()->getName() == Name) {
+        OS << " || (s-1) % " << NumFuncs << " == " << f;
+      }
+    }
+    OS << ";\n";
+    OS << "      Win_" << Name << "[s] = Written ? ot_alloc<" << TyName
+       << ">(Depth_" << Name << "*PlaneSize) : 0;\n";
+    OS << "    }\n";
+  }
+
+  codegenGroupLoops(D, OS);
+
+  for (unsigned i = 0; i < D; ++i) {
+    OS << "    const int base_" << i << " = group_" << i << "*real_per_tile_"
+       << i << " - Halo_Left_" << i << ";\n";
+  }
+
+  // A tile is interior if every function can be evaluated with its first
+  // bounded function at every point of the tile, including the halo.
+  OS << "    const bool Interior = true";
+  for (unsigned f = 0; f < NumFuncs; ++f) {
+    const BoundedFunction &BF = *Functions[f]->getBoundedFunctions().begin();
+    for (unsigned i = 0; i < D; ++i) {
+      OS << " && base_" << i << " >= "
+         << getBoundExpr(BF.Bounds[i].LowerBound, i)
+         << " && base_" << i << "+Tile_" << i << "-1 <= "
+         << getBoundExpr(BF.Bounds[i].UpperBound, i);
+    }
+  }
+  OS << ";\n";
+
+  OS << "    for (int zin = 0; zin < Dim_" << D << " + NumSub*Radius; ++zin) "
+     << "{\n";
+
+  // Load the next input plane, including the padding, since the first
+  // level reads neighbors outside of the tile.
+  OS << "    if (zin < Dim_" << D << ") {\n";
+  OS << "      const int thisid_" << D << " = zin;\n";
+  OS << "      const int GIdx_" << D << " = zin;\n";
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (UpdatedFields.count(F->getName()) == 0) continue;
+    OS << "      " << getTypeName(F->getElementType()) << " *Load_"
+       << F->getName() << " = Win_" << F->getName() << "[0] + (zin % Depth_"
+       << F->getName() << ")*PlaneSize;\n";
+  }
+  codegenPlaneLoops(-1, D, OS);
+  OS << "      const bool Inside = true";
+  for (unsigned i = 0; i < D; ++i) {
+    OS << " && thisid_" << i << " >= 0 && thisid_" << i << " < Dim_" << i;
+  }
+  OS << ";\n";
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (UpdatedFields.count(F->getName()) == 0) continue;
+    OS << "      Load_" << F->getName() << "[Idx_0] = Inside ? In_"
+       << F->getName() << "[GIdx_0] : 0;\n";
+  }
+  for (unsigned i = 0; i < D; ++i) {
+    OS << "      }\n";
+  }
+  OS << "    }\n";
+
+  // Advance every level by one plane
+  OS << "    for (int s = 1; s <= NumSub; ++s) {\n";
+  OS << "      const int thisid_" << D << " = zin - s*Radius;\n";
+  OS << "      if (thisid_" << D << " < 0 || thisid_" << D << " >= Dim_" << D
+     << ") continue;\n";
+  OS << "      const int GIdx_" << D << " = thisid_" << D << ";\n";
+  OS << "      const int t = (s-1) / " << NumFuncs << ";\n";
+  OS << "      switch ((s-1) % " << NumFuncs << ") {\n";
+
+  for (unsigned f = 0; f < NumFuncs; ++f) {
+    Function    *F    = Functions[f];
+    Field       *Out  = F->getOutput();
+    std::string  Name = Out->getName();
+
+    OS << "      case " << f << ": {\n";
+    OS << "      // Function " << Name << "\n";
+
+    // Planes of the current version of every updated field
+    for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+         I != E; ++I) {
+      Field *Fld = *I;
+      if (UpdatedFields.count(Fld->getName()) == 0) continue;
+      std::string FName = Fld->getName();
+
+      OS << "      const int Lvl_" << FName << " = std::max(0, s - "
+         << getVersionDistance(FName, f) << ");\n";
+      for (int o = -(int)Radius; o <= (int)Radius; ++o) {
+        OS << "      const " << getTypeName(Fld->getElementType()) << " *Src_"
+           << FName << "_" << getOffsetName(o) << " = Win_" << FName
+           << "[Lvl_" << FName << "] + ((thisid_" << D << "+(" << o
+           << ")+Depth_" << FName << ") % Depth_" << FName
+           << ")*PlaneSize;\n";
+      }
+    }
+    OS << "      " << getTypeName(Out->getElementType()) << " *Dst_" << Name
+       << " = Win_" << Name << "[s] + (thisid_" << D << " % Depth_" << Name
+       << ")*PlaneSize;\n";
+
+    const BoundedFunction &BF = *F->getBoundedFunctions().begin();
+
+    OS << "      if (Interior && thisid_" << D << " >= "
+       << getBoundExpr(BF.Bounds[D].LowerBound, D) << " && thisid_" << D
+       << " <= " << getBoundExpr(BF.Bounds[D].UpperBound, D) << ") {\n";
+    Guarded = false;
+    codegenPlaneLoops(0, D, OS);
+    codegenSplitPoint(F, OS);
+    for (unsigned i = 0; i < D; ++i) {
+      OS << "      }\n";
+    }
+    OS << "      } else {\n";
+    Guarded = true;
+    codegenPlaneLoops(0, D, OS);
+    codegenSplitPoint(F, OS);
+    for (unsigned i = 0; i < D; ++i) {
+      OS << "      }\n";
+    }
+    OS << "      }\n";
+    Guarded = false;
+
+    // The last write of a field in the time tile goes back to global memory
+    bool Last = true;
+    for (unsigned g = f+1; g < NumFuncs; ++g) {
+      if (Functions[g]->getOutput()->getName() == Name) Last = false;
+    }
+
+    if (Last) {
+      OS << "      if (t == Steps-1) {\n";
+      codegenPlaneLoops(1, D, OS);
+      OS << "      if (";
+      for (unsigned i = 0; i < D; ++i) {
+        if (i != 0) OS << " && ";
+        OS << "thisid_" << i << " < Dim_" << i;
+      }
+      OS << ") Out_" << Name << "[GIdx_0] = Dst_" << Name << "[Idx_0];\n";
+      for (unsigned i = 0; i < D; ++i) {
+        OS << "      }\n";
+      }
+      OS << "      }\n";
+    }
+
+    OS << "      break;\n";
+    OS << "      }\n";
+  }
+
+  OS << "      }\n";
+  OS << "    }\n";
+  OS << "    }\n";
+
+  codegenGroupLoopsEnd(D, OS);
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+    if (UpdatedFields.count(F->getName()) == 0) continue;
+    OS << "    for (int s = 0; s <= NumSub; ++s) {\n";
+    OS << "      free(Win_" << F->getName() << "[s]);\n";
+    OS << "    }\n";
+  }
+
+  codegenParallelEnd(OS);
+
+  Stream = false;
+}
+
+void OpenMPBackEnd::codegenPlaneLoops(int Range, unsigned NumTiled,
+                                      llvm::raw_ostream &OS) {
+  for (int i = NumTiled-1; i >= 0; --i) {
+    if (Range < 0) {
+      OS << "      for (int local_" << i << " = -Pad_Left_" << i << "; local_"
+         << i << " < Pitch_" << i << " - Pad_Left_" << i << "; ++local_" << i
+         << ") {\n";
+    } else if (Range > 0) {
+      OS << "      for (int local_" << i << " = Halo_Left_" << i << "; local_"
+         << i << " < Tile_" << i << " - Halo_Right_" << i << "; ++local_" << i
+         << ") {\n";
+    } else {
+      OS << "      for (int local_" << i << " = 0; local_" << i << " < Tile_"
+         << i << "; ++local_" << i << ") {\n";
+    }
+    OS << "      const int thisid_" << i << " = base_" << i << " + local_"
+       << i << ";\n";
+    OS << "      const int Idx_" << i << " = ";
+    if (i != (int)NumTiled-1) OS << "Idx_" << (i+1) << "*Pitch_" << i << " + ";
+    OS << "local_" << i << " + Pad_Left_" << i << ";\n";
+    OS << "      const int GIdx_" << i << " = GIdx_" << (i+1) << "*Dim_" << i
+       << " + thisid_" << i << ";\n";
+  }
+}
+
+unsigned OpenMPBackEnd::getStreamRadius() const {
+  unsigned Left, Right;
+  getMaxOffsets(getGrid()->getNumDimensions()-1, Left, Right);
+  return std::max(Left, Right);
+}
+
+unsigned OpenMPBackEnd::getVersionDistance(const std::string &Name,
+                                           unsigned Func) const {
+  std::list<Function*> Functions = getGrid()->getFunctionList();
+  unsigned             NumFuncs  = Functions.size();
+  unsigned             Index     = 0;
+  int                  Before    = -1;
+  int                  LastWrite = -1;
+
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I, ++Index) {
+    if ((*I)->getOutput()->getName() != Name) continue;
+    if (Index < Func) Before = Index;
+    LastWrite = Index;
+  }
+
+  // Written earlier in the same time step, or in the previous one
+  if (Before >= 0) {
+    return Func - Before;
+  } else {
+    return Func + NumFuncs - LastWrite;
+  }
+}
+
+unsigned OpenMPBackEnd::getStreamDepth(const std::string &Name) const {
+  unsigned NumFuncs = getGrid()->getFunctionList().size();
+  unsigned MaxDist  = 0;
+
+  for (unsigned f = 0; f < NumFuncs; ++f) {
+    MaxDist = std::max(MaxDist, getVersionDistance(Name, f));
+  }
+
+  // A level reading version s-MaxDist at offsets up to Radius needs the
+  // planes from MaxDist*Radius ahead to Radius behind the current one.
+  return (MaxDist+1)*getStreamRadius() + 1;
+}
+
+void OpenMPBackEnd::codegenParallelBegin(llvm::raw_ostream &OS) {
+  if (!UseRuntime) {
+    OS << "#pragma omp parallel\n";
+  }
+  OS << "  {\n";
+}
+
+void OpenMPBackEnd::codegenParallelEnd(llvm::raw_ostream &OS) {
+  OS << "  }\n";
+  if (UseRuntime) {
+    OS << "  ot_rt_barrier(Worker);\n";
+  }
+}
+
+void OpenMPBackEnd::codegenGroupLoops(unsigned NumTiled,
+                                      llvm::raw_ostream &OS) {
+  if (!UseRuntime) {
+    OS << "#pragma omp for ";
+    if (NumTiled > 1) {
+      OS << "collapse(" << NumTiled << ") ";
+    }
+    OS << "schedule(dynamic)\n";
+
+    for (int i = NumTiled-1; i >= 0; --i) {
+      OS << "    for (int group_" << i << " = 0; group_" << i
+         << " < num_tiles_" << i << "; ++group_" << i << ") {\n";
+    }
+    return;
+  }
+
+  // A single loop over all tiles, in the same order as the collapsed loops
+  OS << "    ot_rt_tiles_reset(Worker, (long)num_tiles_0";
+  for (unsigned i = 1; i < NumTiled; ++i) {
+    OS << "*num_tiles_" << i;
+  }
+  OS << ");\n";
+  OS << "    for (long Next; (Next = ot_rt_next_tile(Worker)) >= 0; ) {\n";
+  for (unsigned i = 0; i < NumTiled; ++i) {
+    OS << "    const int group_" << i << " = (int)(Next % num_tiles_" << i
+       << ");\n";
+    if (i+1 < NumTiled) {
+      OS << "    Next /= num_tiles_" << i << ";\n";
+    }
+  }
+}
+
+void OpenMPBackEnd::codegenGroupLoopsEnd(unsigned NumTiled,
+                                         llvm::raw_ostream &OS) {
+  unsigned NumLoops = UseRuntime ? 1 : NumTiled;
+  for (unsigned i = 0; i < NumLoops; ++i) {
+    OS << "    }\n";
+  }
+}
+
+void OpenMPBackEnd::codegenTileLoop(unsigned First, llvm::raw_ostream &OS) {
+  if (!UseRuntime) {
+    OS << "#pragma omp for schedule(dynamic)\n";
+    OS << "    for (int tile = " << First << "; tile < num_tiles; ++tile) {\n";
+    return;
+  }
+
+  OS << "    ot_rt_tiles_reset(Worker, num_tiles - " << First << ");\n";
+  OS << "    for (long Next; (Next = ot_rt_next_tile(Worker)) >= 0; ) {\n";
+  OS << "      const int tile = " << First << " + (int)Next;\n";
+}
+
+const char *OpenMPBackEnd::getWallClock() const {
+  return UseRuntime ? "ot_rt_wtime()" : "omp_get_wtime()";
+}
+
+void OpenMPBackEnd::codegenSplitFunction(Function *F, llvm::raw_ostream &OS) {
+  Grid                 *G       = getGrid();
+  unsigned              NumDims = G->getNumDimensions();
+  unsigned              D       = NumDims-1;
+  std::list<Field*>     Fields  = G->getFieldList();
+  Field                *Out     = F->getOutput();
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *Fld = *I;
+    if (UpdatedFields.count(Fld->getName()) == 0) continue;
+    OS << "      const " << getTypeName(Fld->getElementType()) << " *Src_"
+       << Fld->getName() << " = Buf_" << Fld->getName() << "[Cur_"
+       << Fld->getName() << "];\n";
+  }
+  OS << "      " << getTypeName(Out->getElementType()) << " *Dst_"
+     << Out->getName() << " = Buf_" << Out->getName() << "[Cur_"
+     << Out->getName() << "^1];\n";
+
+  // Loop over the rows of the tile
+  for (int i = D; i >= 1; --i) {
+    if ((unsigned)i == D) {
+      OS << "      for (int thisid_" << i << " = Lo; thisid_" << i
+         << " < Hi; ++thisid_" << i << ") {\n";
+    } else if ((unsigned)i == D-1) {
+      OS << "      for (int thisid_" << i << " = SubLo; thisid_" << i
+         << " < SubHi; ++thisid_" << i << ") {\n";
+    } else {
+      OS << "      for (int thisid_" << i << " = 0; thisid_" << i
+         << " < Dim_" << i << "; ++thisid_" << i << ") {\n";
+    }
+    OS << "      const int GIdx_" << i << " = ";
+    if ((unsigned)i != D) OS << "GIdx_" << (i+1) << "*Dim_" << i << " + ";
+    OS << "thisid_" << i << ";\n";
+  }
+
+  if (D == 0) {
+    OS << "      const int Begin0 = Lo;\n";
+    OS << "      const int End0 = Hi;\n";
+  } else if (D == 1) {
+    OS << "      const int Begin0 = SubLo;\n";
+    OS << "      const int End0 = SubHi;\n";
+  } else {
+    OS << "      const int Begin0 = 0;\n";
+    OS << "      const int End0 = Dim_0;\n";
+  }
+
+  // Split the row into the part where the first bounded function applies
+  // everywhere and the guarded parts around it.
+  const BoundedFunction &BF = *F->getBoundedFunctions().begin();
+
+  OS << "      const bool RowInterior = true";
+  for (unsigned i = 1; i < NumDims; ++i) {
+    OS << " && thisid_" << i << " >= "
+       << getBoundExpr(BF.Bounds[i].LowerBound, i) << " && thisid_" << i
+       << " <= " << getBoundExpr(BF.Bounds[i].UpperBound, i);
+  }
+  OS << ";\n";
+  OS << "      int I0 = Begin0, I1 = Begin0;\n";
+  OS << "      if (RowInterior) {\n";
+  OS << "        I0 = std::min(std::max(Begin0, "
+     << getBoundExpr(BF.Bounds[0].LowerBound, 0) << "), End0);\n";
+  OS << "        I1 = std::max(I0, std::min(End0, "
+     << getBoundExpr(BF.Bounds[0].UpperBound, 0) << "+1));\n";
+  OS << "      }\n";
+
+  const char *Ranges[][2] = { { "Begin0", "I0" }, { "I0", "I1" },
+                              { "I1", "End0" } };
+
+  for (unsigned r = 0; r < 3; ++r) {
+    Guarded = (r != 1);
+    OS << "      for (int thisid_0 = " << Ranges[r][0] << "; thisid_0 < "
+       << Ranges[r][1] << "; ++thisid_0) {\n";
+    OS << "      const int GIdx_0 = ";
+    if (D != 0) OS << "GIdx_1*Dim_0 + ";
+    OS << "thisid_0;\n";
+    codegenSplitPoint(F, OS);
+    OS << "      }\n";
+  }
+  Guarded = false;
+
+  for (unsigned i = 1; i < NumDims; ++i) {
+    OS << "      }\n";
+  }
+
+  OS << "      Cur_" << Out->getName() << " ^= 1;\n";
+}
+
+void OpenMPBackEnd::codegenSplitPoint(Function *F, llvm::raw_ostream &OS) {
+  unsigned               NumDims = getGrid()->getNumDimensions();
+  Field                 *Out     = F->getOutput();
+  std::set<std::string>  Idents;
+
+  OS << "      " << getTypeName(Out->getElementType()) << " Res;\n";
+
+  const std::list<BoundedFunction> &BFuncs = F->getBoundedFunctions();
+
+  if (Guarded) {
+    for (std::list<BoundedFunction>::const_iterator I = BFuncs.begin(),
+           E = BFuncs.end(), B = I; I != E; ++I) {
+      const BoundedFunction &BF = *I;
+
+      if (I == B)
+        OS << "      if (";
+      else
+        OS << "      } else if (";
+
+      for (unsigned i = 0; i < NumDims; ++i) {
+        const FunctionBound &Bound = BF.Bounds[i];
+
+        if (i != 0) OS << " && ";
+
+        OS << "(thisid_" << i << " >= " << getBoundExpr(Bound.LowerBound, i)
+           << " && thisid_" << i << " <= "
+           << getBoundExpr(Bound.UpperBound, i) << ")";
+      }
+      OS << ") {\n";
+
+      Idents.clear();
+      codegenLoads(BF.Expr, OS, Idents);
+
+      codegenTemps(BF.Expr, OS);
+
+
+      OS << "      Res = ";
+      codegenExpr(BF.Expr, OS);
+      OS << ";\n";
+    }
+
+    // Points outside of the function bounds keep their current value.
+    OS << "      } else {\n";
+    if (Stream) {
+      OS << "      Res = Src_" << Out->getName() << "_0[Idx_0];\n";
+    } else {
+      OS << "      Res = Src_" << Out->getName() << "[GIdx_0];\n";
+    }
+    OS << "      }\n";
+  } else {
+    const BoundedFunction &BF = *(BFuncs.begin());
+
+    codegenLoads(BF.Expr, OS, Idents);
+
+    codegenTemps(BF.Expr, OS);
+
+
+    OS << "      Res = ";
+    codegenExpr(BF.Expr, OS);
+    OS << ";\n";
+  }
+
+  if (Stream) {
+    OS << "      Dst_" << Out->getName() << "[Idx_0] = Res;\n";
+  } else {
+    OS << "      Dst_" << Out->getName() << "[GIdx_0] = Res;\n";
+  }
+}
+
+void OpenMPBackEnd::codegenLoads(Expression *Expr, llvm::raw_ostream &OS,
+                                 std::set<std::string> &Idents) {
+  if (FieldRef *Ref = dyn_cast<FieldRef>(Expr)) {
+    codegenFieldRefLoad(Ref, OS, Idents);
+  } else if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    codegenLoads(Op->getLHS(), OS, Idents);
+    codegenLoads(Op->getRHS(), OS, Idents);
+  } else if (isa<ConstantExpr>(Expr)) {
+    /* Do nothing */
+  } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+
+    const std::vector<Expression*> &Exprs = FC->getParameters();
+
+    for (unsigned i = 0, e = Exprs.size(); i != e; ++i) {
+      codegenLoads(Exprs[i], OS, Idents);
+    }
+  } else if (isa<PlaceHolderExpr>(Expr)) {
+    /* Do nothing */
+  } else {
+    report_fatal_error("Unhandled expr type");
+  }
+}
+
+void OpenMPBackEnd::codegenFieldRefLoad(FieldRef *Ref, llvm::raw_ostream &OS,
+                                        std::set<std::string> &Idents) {
+  Field                           *F       = Ref->getField();
+  const std::vector<IntConstant*> &Offsets = Ref->getOffsets();
+  std::string                      Name    = F->getName();
+  std::string                      VarName = getRefName(Ref, JamRow);
+
+  // If we have already code-gen'd this load, then skip it
+  if (Idents.count(VarName) > 0)
+    return;
+
+  std::vector<int> Off;
+  for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
+    Off.push_back(Offsets[i]->getValue());
+  }
+  if (JamRow > 0) Off[1] += JamRow;
+
+  if (Stream && UpdatedFields.count(Name) > 0) {
+    // Streamed fields are read from the window plane at the offset in the
+    // outermost dimension.
+    int              PlaneOff = Off.back();
+    std::vector<int> InPlane(Off.begin(), Off.end()-1);
+
+    OS << "      const " << getTypeName(F->getElementType()) << " " << VarName
+       << " = Src_" << Name << "_" << getOffsetName(PlaneOff) << "["
+       << getScratchIndex(InPlane) << "];\n";
+    Idents.insert(VarName);
+    return;
+  }
+
+  if (Split || Stream) {
+    // Split tiles work directly on the global buffers.
+    OS << "      const " << getTypeName(F->getElementType()) << " " << VarName
+       << " = ";
+    if (UpdatedFields.count(Name) > 0) {
+      OS << "Src_" << Name;
+    } else {
+      OS << "In_" << Name;
+    }
+    OS << "[" << getGlobalIndex(Off) << "];\n";
+    Idents.insert(VarName);
+    return;
+  }
+
+  // Fields that have not been updated yet in this time step are read from
+  // the global input array.
+  bool UseShared = UpdatedFields.count(Name) > 0 &&
+                   (!FirstStep || WrittenFields.count(Name) > 0);
+
+  if (VectorLanes > 0) {
+    // Only the scratch rows are aligned, so only loads without an offset in
+    // dimension 0 can use aligned loads.
+    OS << "      const " << getVectorTypeName(F->getElementType()) << " "
+       << VarName << " = ";
+    if (UseShared) {
+      OS << (Off[0] == 0 ? "ot_load" : "ot_loadu") << "(&Shared_" << Name
+         << "[" << getScratchIndex(Off) << "])";
+    } else {
+      OS << "ot_loadu(&In_" << Name << "[" << getGlobalIndex(Off) << "])";
+    }
+    OS << ";\n";
+  } else {
+    OS << "      const " << getTypeName(F->getElementType()) << " " << VarName
+       << " = ";
+    if (UseShared) {
+      OS << "Shared_" << Name << "[" << getScratchIndex(Off) << "]";
+    } else {
+      OS << "In_" << Name << "[" << getGlobalIndex(Off) << "]";
+    }
+    OS << ";\n";
+  }
+
+  Idents.insert(VarName);
+}
+
+std::string OpenMPBackEnd::
+getScratchIndex(const std::vector<int> &Offsets) const {
+  std::string        Ret;
+  raw_string_ostream Str(Ret);
+
+  Str << "Idx_0";
+  for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
+    if (Offsets[i] == 0) continue;
+    Str << "+(" << Offsets[i] << ")";
+    for (unsigned j = 0; j < i; ++j) {
+      Str << "*Pitch_" << j;
+    }
+  }
+
+  Str.flush();
+  return Ret;
+}
+
+std::string OpenMPBackEnd::
+getGlobalIndex(const std::vector<int> &Offsets) const {
+  std::string        Ret;
+  raw_string_ostream Str(Ret);
+
+  if (!Guarded) {
+    // Neighbors of points inside of the function bounds are always inside of
+    // the grid.
+    Str << "GIdx_0";
+    for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
+      if (Offsets[i] == 0) continue;
+      Str << "+(" << Offsets[i] << ")";
+      for (unsigned j = 0; j < i; ++j) {
+        Str << "*Dim_" << j;
+      }
+    }
+  } else {
+    for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
+      if (i != 0) Str << " + ";
+      Str << "ot_clamp(thisid_" << i;
+      if (Offsets[i] != 0) Str << "+(" << Offsets[i] << ")";
+      Str << ", Dim_" << i << ")";
+      for (unsigned j = 0; j < i; ++j) {
+        Str << "*Dim_" << j;
+      }
+    }
+  }
+
+  Str.flush();
+  return Ret;
+}
+
+unsigned OpenMPBackEnd::getPitch(unsigned Dim, unsigned Tile) const {
+  unsigned Pitch = Tile + PadLeft[Dim] + PadRight[Dim];
+
+  // Keep the rows of the scratch buffers aligned to the vector width.
+  if (Dim == 0 && VectorBits > 0) {
+    unsigned Align = VectorBits / 32;
+    Pitch = (Pitch + Align - 1) / Align * Align;
+  }
+
+  return Pitch;
+}
+
+unsigned OpenMPBackEnd::getTileSize(unsigned Dim) {
+  unsigned NumDims = getGrid()->getNumDimensions();
+
+  if (Dim >= NumDims || getTilingStrategy() == SplitTiling ||
+      getTilingStrategy() == WavefrontTiling ||
+      (getTilingStrategy() == StreamingTiling && Dim == NumDims-1)) {
+    return 0;
+  }
+
+  computeTileSizes();
+  return TileSize[Dim];
+}
+
+void OpenMPBackEnd::computeTileSizes() {
+  Grid                       *G         = getGrid();
+  unsigned                    NumDims   = G->getNumDimensions();
+  const std::list<Function*> &Functions = G->getFunctionList();
+  Region                      BlockRegion = getBlockRegion();
+  std::vector<unsigned>       Halo(NumDims);
+
+  PadLeft.assign(NumDims, 0);
+  PadRight.assign(NumDims, 0);
+  TileSize.resize(NumDims);
+
+  for (unsigned i = 0; i < NumDims; ++i) {
+    getMaxOffsets(i, PadLeft[i], PadRight[i]);
+
+    if (i == 0 && VectorBits > 0) {
+      unsigned Align = VectorBits / 32;
+      PadLeft[i] = (PadLeft[i] + Align - 1) / Align * Align;
+    }
+
+    Halo[i]     = BlockRegion.getBound(i).second - 1;
+    TileSize[i] = getElements(i)*getBlockSize(i);
+  }
+
+  if (getScratchBudget() == 0) {
+    return;
+  }
+
+  // Each thread keeps two copies of every updated field, or with streaming,
+  // one window per level and for the input.
+  bool     Streaming     = getTilingStrategy() == StreamingTiling;
+  unsigned NumTiled      = Streaming ? NumDims-1 : NumDims;
+  unsigned BytesPerPoint = 0;
+  for (std::list<Function*>::const_iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    const Field       *Out  = (*I)->getOutput();
+    const ElementType *Ty   = Out->getElementType();
+    unsigned           Size = isa<FP32Type>(Ty) ? 4 : 8;
+
+    if (Streaming) {
+      BytesPerPoint += getTimeTileSize() * Size * getStreamDepth(Out->getName());
+    } else {
+      BytesPerPoint += 2 * Size;
+    }
+  }
+  if (Streaming) {
+    std::set<std::string> Inputs;
+    for (std::list<Function*>::const_iterator I = Functions.begin(),
+           E = Functions.end(); I != E; ++I) {
+      const Field *Out = (*I)->getOutput();
+      if (!Inputs.insert(Out->getName()).second) continue;
+      BytesPerPoint += (isa<FP32Type>(Out->getElementType()) ? 4 : 8) *
+                       getStreamDepth(Out->getName());
+    }
+  }
+
+  // Grow the tile one step at a time, always in the dimension that
+  // increases the fraction of useful points the most, until the scratch
+  // buffers would no longer fit into the budget.  The block size given by
+  // the user is the smallest tile considered.
+  unsigned Step0 = VectorBits > 0 ? VectorBits / 32 : 1;
+
+  for (;;) {
+    int    Best    = -1;
+    double BestEff = -1.0;
+
+    for (unsigned d = 0; d < NumTiled; ++d) {
+      if (TileSize[d] >= MaxTileSize) continue;
+
+      std::vector<unsigned> Tile = TileSize;
+      Tile[d] += (d == 0 ? Step0 : 1);
+
+      uint64_t Bytes = BytesPerPoint;
+      double   Eff   = 1.0;
+      for (unsigned i = 0; i < NumTiled; ++i) {
+        Bytes *= getPitch(i, Tile[i]);
+        Eff   *= Tile[i] > Halo[i] ?
+                 (double)(Tile[i] - Halo[i]) / Tile[i] : 0.0;
+      }
+
+      if (Bytes > getScratchBudget()) continue;
+
+      // Tiles that do not cover their own halo are fixed first.
+      if (TileSize[d] <= Halo[d]) Eff = 2.0;
+
+      if (Eff > BestEff) {
+        Best    = d;
+        BestEff = Eff;
+      }
+    }
+
+    if (Best < 0) break;
+
+    TileSize[Best] += (Best == 0 ? Step0 : 1);
+  }
+}
+
+std::string OpenMPBackEnd::getVectorTypeName(const ElementType *Ty) {
+  if (isa<FP32Type>(Ty)) {
+    return "ot_vf32";
+  } else if (isa<FP64Type>(Ty)) {
+    return "ot_vf64";
+  } else {
+    report_fatal_error("Unknown type");
+  }
+}
+
+namespace {
+/// collectCalls - Collects the built-ins called in \p Expr.  Returns false
+/// if the expression mixes element types with \p Ty, which cannot be
+/// expressed with vector extensions.
+bool collectCalls(Expression *Expr, const ElementType *Ty, const Grid *G,
+                  std::set<const MathBuiltin*> &Calls) {
+  // Vector lanes splat parameters and invariants in the element type, while
+  // scalar code evaluates them in their C type, e.g. a double parameter of
+  // a float function.  A point's result must not depend on whether it is
+  // computed in a vector lane.
+  if (isa<FP32Type>(Ty) && !readsFields(Expr) && dependsOnData(Expr) &&
+      isa<FP64Type>(getExprType(Expr, G, false))) {
+    return false;
+  }
+
+  if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    return collectCalls(Op->getLHS(), Ty, G, Calls) &&
+           collectCalls(Op->getRHS(), Ty, G, Calls);
+  } else if (FieldRef *Ref = dyn_cast<FieldRef>(Expr)) {
+    return Ref->getField()->getElementType()->getClassType() ==
+           Ty->getClassType();
+  } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    const std::vector<Expression*> &Params = FC->getParameters();
+    const MathBuiltin              *MB     = lookupMathBuiltin(FC->getName());
+    if (!MB) {
+      report_fatal_error("Unknown function '" + FC->getName() + "'");
+    }
+    Calls.insert(MB);
+    for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+      if (!collectCalls(Params[i], Ty, G, Calls)) return false;
+    }
+    return true;
+  }
+  return true;
+}
+}
+
+unsigned OpenMPBackEnd::getVectorLanes(Function *F) {
+  const ElementType            *Ty = F->getOutput()->getElementType();
+  std::set<const MathBuiltin*>  Calls;
+
+  if (VectorBits == 0) {
+    return 0;
+  }
+
+  if (!collectCalls(F->getBoundedFunctions().begin()->Expr, Ty, getGrid(),
+                    Calls)) {
+    return 0;
+  }
+
+  VectorElementType = Ty;
+
+  if (isa<FP32Type>(Ty)) {
+    return VectorBits / 32;
+  } else {
+    return VectorBits / 64;
+  }
+}
+
+void OpenMPBackEnd::codegenVectorSupport(llvm::raw_ostream &OS) {
+  std::list<Function*>         Functions = getGrid()->getFunctionList();
+  std::set<const MathBuiltin*> Calls;
+
+  OS << "typedef float ot_vf32 __attribute__((vector_size(" << VectorBits/8
+     << ")));\n";
+  OS << "typedef double ot_vf64 __attribute__((vector_size(" << VectorBits/8
+     << ")));\n";
+
+  const char *Types[][2] = { { "float", "ot_vf32" }, { "double", "ot_vf64" } };
+
+  for (unsigned i = 0; i < 2; ++i) {
+    const char *S = Types[i][0];
+    const char *V = Types[i][1];
+
+    OS << "static inline " << V << " ot_load(const " << S << " *P) {\n";
+    OS << "  return *(const " << V << "*)P;\n";
+    OS << "}\n";
+    OS << "static inline " << V << " ot_loadu(const " << S << " *P) {\n";
+    OS << "  " << V << " R;\n";
+    OS << "  memcpy(&R, P, sizeof(R));\n";
+    OS << "  return R;\n";
+    OS << "}\n";
+    OS << "static inline void ot_store(" << S << " *P, " << V << " X) {\n";
+    OS << "  *(" << V << "*)P = X;\n";
+    OS << "}\n";
+    OS << "static inline " << V << " ot_splat(" << S << " X) {\n";
+    OS << "  " << V << " R = {};\n";
+    OS << "  return R + X;\n";
+    OS << "}\n";
+  }
+
+  if (getContraction()) {
+    // x86 FMA intrinsics of the vector width, which accept the vector
+    // types above.
+    const char *Prefix = VectorBits == 512 ? "_mm512" :
+                         VectorBits == 256 ? "_mm256" : "_mm";
+    const char *Macro  = VectorBits == 512 ? "__AVX512F__" : "__FMA__";
+
+    OS << "#if defined(" << Macro << ")\n";
+    OS << "#include <immintrin.h>\n";
+    OS << "#endif\n";
+    for (unsigned i = 0; i < 2; ++i) {
+      const char *V = Types[i][1];
+      OS << "static inline " << V << " ot_v_fma(" << V << " A, " << V
+         << " B, " << V << " C) {\n";
+      OS << "#if defined(" << Macro << ")\n";
+      OS << "  return " << Prefix << "_fmadd_" << (i == 0 ? "ps" : "pd")
+         << "(A, B, C);\n";
+      OS << "#else\n";
+      OS << "  return A*B+C;\n";
+      OS << "#endif\n";
+      OS << "}\n";
+    }
+  }
+
+  for (std::list<Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    Function *F = *I;
+    collectCalls(F->getBoundedFunctions().begin()->Expr,
+                 F->getOutput()->getElementType(), getGrid(), Calls);
+  }
+
+  if (Calls.empty()) {
+    return;
+  }
+
+  // Integer vectors of the same layout, for bit manipulation and masks.
+  OS << "typedef int ot_vi32 __attribute__((vector_size(" << VectorBits/8
+     << ")));\n";
+  OS << "typedef long long ot_vi64 __attribute__((vector_size("
+     << VectorBits/8 << ")));\n";
+  for (unsigned i = 0; i < 2; ++i) {
+    const char *V = Types[i][1];
+    const char *M = i == 0 ? "ot_vi32" : "ot_vi64";
+    OS << "static inline " << V << " ot_select(" << M << " K, " << V
+       << " A, " << V << " B) {\n";
+    OS << "  return (" << V << ")((K & (" << M << ")A) | (~K & (" << M
+       << ")B));\n";
+    OS << "}\n";
+  }
+  OS << "#if defined(__SSE2__)\n";
+  OS << "#include <immintrin.h>\n";
+  OS << "#endif\n";
+
+  for (std::set<const MathBuiltin*>::iterator I = Calls.begin(),
+         E = Calls.end(); I != E; ++I) {
+    codegenVectorMath(*I, OS);
+  }
+}
+
+namespace {
+/// codegenLaneLoop - Emits the body of a vector function that applies the
+/// C++ library function of \p MB lane by lane.
+void codegenLaneLoop(const MathBuiltin *MB, const char *V,
+                     llvm::raw_ostream &OS) {
+  OS << "  " << V << " R;\n";
+  OS << "  for (unsigned l = 0; l < sizeof(R)/sizeof(R[0]); ++l)\n";
+  OS << "    R[l] = " << (MB->Reciprocal ? "1/" : "") << "std::"
+     << MB->LibName << "(";
+  for (unsigned a = 0; a < MB->Arity; ++a) {
+    if (a != 0) OS << ", ";
+    OS << "X" << a << "[l]";
+  }
+  OS << ");\n";
+  OS << "  return R;\n";
+}
+
+/// codegenCoefficient - Emits the literal \p C in single or double
+/// precision.
+void codegenCoefficient(double C, bool Double, llvm::raw_ostream &OS) {
+  std::string        Str;
+  raw_string_ostream StrOS(Str);
+
+  StrOS << format(Double ? "%.17g" : "%.9g", C);
+  StrOS.flush();
+  if (Str.find_first_of(".e") == std::string::npos) {
+    Str += ".0";
+  }
+  OS << Str << (Double ? "" : "f");
+}
+
+/// codegenFastExp - Emits the body of ot_v_exp for single or double
+/// precision.  The argument is split into N*ln2 + D with |D| <= ln2/2, and
+/// exp(D) is evaluated with its Taylor series, which is within 3 ulp.
+/// Results below the smallest normal number flush to zero.
+void codegenFastExp(bool Double, llvm::raw_ostream &OS) {
+  const char *V = Double ? "ot_vf64" : "ot_vf32";
+  const char *M = Double ? "ot_vi64" : "ot_vi32";
+  const char *F = Double ? "" : "f";
+
+  if (Double) {
+    OS << "  const ot_vf64 Hi = ot_splat(709.782712893384), "
+       << "Lo = ot_splat(-707.0);\n";
+  } else {
+    OS << "  const ot_vf32 Hi = ot_splat(88.7228393f), "
+       << "Lo = ot_splat(-86.0f);\n";
+  }
+  OS << "  " << V << " C = ot_select((" << M << ")(X0 > Hi), Hi, X0);\n";
+  OS << "  C = ot_select((" << M << ")(C < Lo), Lo, C);\n";
+
+  // Adding 1.5*2^52 (1.5*2^23) rounds to the integer N, which ends up in
+  // the low bits of T.
+  const char *Magic = Double ? "6755399441055744.0" : "12582912.0f";
+  OS << "  " << V << " T = C*1.44269504088896341" << F << " + " << Magic
+     << ";\n";
+  OS << "  " << V << " N = T - " << Magic << ";\n";
+  if (Double) {
+    OS << "  ot_vf64 D = C - N*6.93147180369123816490e-01 "
+       << "- N*1.90821492927058770002e-10;\n";
+  } else {
+    OS << "  ot_vf32 D = C - N*0.693359375f + N*2.12194440e-4f;\n";
+  }
+
+  unsigned Degree = Double ? 12 : 7;
+  double   Coeff  = 1.0;
+  OS << "  " << V << " P = 1.0" << F;
+  for (unsigned k = 1; k <= Degree; ++k) {
+    Coeff /= k;
+    OS << " + D*";
+    if (k < Degree) OS << "(";
+    codegenCoefficient(Coeff, Double, OS);
+  }
+  OS << std::string(Degree-1, ')') << ";\n";
+
+  // 2^N is built in two halves so that N = 1024 (128) does not overflow.
+  if (Double) {
+    OS << "  ot_vf64 R = P*(ot_vf64)(((ot_vi64)T - 0x4338000000000000LL "
+       << "+ 1022) << 52)*2.0;\n";
+  } else {
+    OS << "  ot_vf32 R = P*(ot_vf32)(((ot_vi32)T - 0x4b400000 + 126) << 23)"
+       << "*2.0f;\n";
+  }
+  OS << "  R = ot_select((" << M << ")(X0 > Hi), ot_splat(__builtin_inf"
+     << F << "()), R);\n";
+  OS << "  return ot_select((" << M << ")(X0 < Lo), ot_splat(0.0" << F
+     << "), R);\n";
+}
+
+/// codegenFastLog - Emits the body of ot_v_log for single or double
+/// precision.  The argument is split into 2^E*M with sqrt(2)/2 <= M <
+/// sqrt(2), and log(M) is evaluated as 2*atanh((M-1)/(M+1)), which is
+/// within 2 ulp.  Denormal arguments are not supported.
+void codegenFastLog(bool Double, llvm::raw_ostream &OS) {
+  const char *V = Double ? "ot_vf64" : "ot_vf32";
+  const char *M = Double ? "ot_vi64" : "ot_vi32";
+  const char *F = Double ? "" : "f";
+
+  OS << "  " << M << " B = (" << M << ")X0;\n";
+  if (Double) {
+    OS << "  ot_vf64 A = (ot_vf64)((B & 0xfffffffffffffLL) | "
+       << "0x3ff0000000000000LL);\n";
+  } else {
+    OS << "  ot_vf32 A = (ot_vf32)((B & 0x7fffff) | 0x3f800000);\n";
+  }
+  OS << "  " << M << " Big = (" << M << ")(A > 1.41421356237309505" << F
+     << ");\n";
+  if (Double) {
+    OS << "  ot_vi64 E = ((B >> 52) & 0x7ff) - 1023 - Big;\n";
+  } else {
+    OS << "  ot_vi32 E = ((B >> 23) & 0xff) - 127 - Big;\n";
+  }
+  OS << "  A = ot_select(Big, A*0.5" << F << ", A);\n";
+  OS << "  " << V << " S = (A - 1.0" << F << ")/(A + 1.0" << F << ");\n";
+  OS << "  " << V << " Z = S*S;\n";
+
+  unsigned Terms = Double ? 9 : 4;
+  OS << "  " << V << " L = 2.0" << F << "*S + 2.0" << F << "*S*Z*(";
+  for (unsigned k = 1; k <= Terms; ++k) {
+    if (k > 1) OS << " + Z*";
+    if (k < Terms && k > 1) OS << "(";
+    codegenCoefficient(1.0 / (2*k+1), Double, OS);
+  }
+  OS << std::string(Terms-2, ')') << ");\n";
+
+  // E is converted exactly through the low bits of 1.5*2^52 (1.5*2^23).
+  if (Double) {
+    OS << "  ot_vf64 N = (ot_vf64)(E + 0x4338000000000000LL) "
+       << "- 6755399441055744.0;\n";
+    OS << "  ot_vf64 R = N*6.93147180369123816490e-01 + "
+       << "(L + N*1.90821492927058770002e-10);\n";
+  } else {
+    OS << "  ot_vf32 N = (ot_vf32)(E + 0x4b400000) - 12582912.0f;\n";
+    OS << "  ot_vf32 R = N*0.693359375f + (L - N*2.12194440e-4f);\n";
+  }
+  OS << "  R = ot_select((" << M << ")(X0 == __builtin_inf" << F
+     << "()), X0, R);\n";
+  OS << "  R = ot_select((" << M << ")(X0 == 0.0" << F
+     << "), ot_splat(-__builtin_inf" << F << "()), R);\n";
+  OS << "  return ot_select((" << M << ")(X0 < 0.0" << F << ") | (" << M
+     << ")(X0 != X0), ot_splat(__builtin_nan" << F << "(\"\")), R);\n";
+}
+}
+
+void OpenMPBackEnd::codegenVectorMath(const MathBuiltin *MB,
+                                      llvm::raw_ostream &OS) {
+  StringRef   Name   = MB->Name;
+  bool        Fast   = getFastMath();
+  const char *Prefix = VectorBits == 512 ? "_mm512" :
+                       VectorBits == 256 ? "_mm256" : "_mm";
+  const char *Macro  = VectorBits == 512 ? "__AVX512F__" :
+                       VectorBits == 256 ? "__AVX__" : "__SSE2__";
+
+  for (unsigned i = 0; i < 2; ++i) {
+    bool        Double = i == 1;
+    const char *V      = Double ? "ot_vf64" : "ot_vf32";
+    const char *M      = Double ? "ot_vi64" : "ot_vi32";
+    const char *F      = Double ? "" : "f";
+    const char *PS     = Double ? "pd" : "ps";
+
+    OS << "static inline " << V << " ot_v_" << Name << "(";
+    for (unsigned a = 0; a < MB->Arity; ++a) {
+      if (a != 0) OS << ", ";
+      OS << V << " X" << a;
+    }
+    OS << ") {\n";
+
+    if (Name == "fabs") {
+      OS << "  return (" << V << ")((" << M << ")X0 & "
+         << (Double ? "0x7fffffffffffffffLL" : "0x7fffffff") << ");\n";
+    } else if (MB->LibName == StringRef("fmin") ||
+               MB->LibName == StringRef("fmax")) {
+      // fmin and fmax return the other argument if one is NaN.
+      const char *Cmp = MB->LibName == StringRef("fmin") ? "<" : ">";
+      OS << "  return ot_select((" << M << ")(X0 " << Cmp << " X1)";
+      if (!Fast) {
+        OS << " | (" << M << ")(X1 != X1)";
+      }
+      OS << ", X0, X1);\n";
+    } else if (Name == "sqrt" || Name == "rsqrt") {
+      // The hardware square root is correctly rounded.  With fast math,
+      // the reciprocal square root estimate is refined by a Newton step.
+      bool Estimate = Fast && Name == "rsqrt" &&
+                      (!Double || VectorBits == 512);
+      OS << "#if defined(" << Macro << ")\n";
+      if (Estimate) {
+        OS << "  " << V << " Y = " << Prefix << "_rsqrt"
+           << (VectorBits == 512 ? "14" : "") << "_" << PS << "(X0);\n";
+        for (unsigned Step = 0; Step < (Double ? 2u : 1u); ++Step) {
+          OS << "  Y = Y*(1.5" << F << " - 0.5" << F << "*X0*Y*Y);\n";
+        }
+        OS << "  return Y;\n";
+      } else {
+        OS << "  return ";
+        if (Name == "rsqrt") OS << "1.0" << F << "/";
+        OS << Prefix << "_sqrt_" << PS << "(X0);\n";
+      }
+      OS << "#else\n";
+      codegenLaneLoop(MB, V, OS);
+      OS << "#endif\n";
+    } else if (Fast && Name == "exp") {
+      codegenFastExp(Double, OS);
+    } else if (Fast && Name == "log") {
+      codegenFastLog(Double, OS);
+    } else {
+      codegenLaneLoop(MB, V, OS);
+    }
+    OS << "}\n";
+  }
+}
+
+}
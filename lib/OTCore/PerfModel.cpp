@@ -0,0 +1,471 @@
+/*
+ * PerfModel.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: PerfModel.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Core/PerfModel.h"
+#include "overtile/Core/BackEnd.h"
+#include "overtile/Core/CostModel.h"
+#include "overtile/Core/Field.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Grid.h"
+#include "overtile/Core/ResourceCheck.h"
+#include "overtile/Core/Types.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/Format.h"
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+
+using namespace llvm;
+
+namespace overtile {
+
+namespace {
+
+struct UnsignedKey {
+  const char               *Key;
+  unsigned MachineModel::*  Member;
+};
+
+struct DoubleKey {
+  const char             *Key;
+  double MachineModel::*  Member;
+};
+
+const UnsignedKey UnsignedKeys[] = {
+  { "multiprocessors",                 &MachineModel::Multiprocessors },
+  { "warp-size",                       &MachineModel::WarpSize },
+  { "max-threads-per-block",           &MachineModel::MaxThreadsPerBlock },
+  { "max-threads-per-multiprocessor",
+    &MachineModel::MaxThreadsPerMultiprocessor },
+  { "max-blocks-per-multiprocessor",
+    &MachineModel::MaxBlocksPerMultiprocessor },
+  { "shared-bytes-per-multiprocessor",
+    &MachineModel::SharedBytesPerMultiprocessor },
+  { "shared-bytes-per-block",          &MachineModel::SharedBytesPerBlock },
+  { "registers-per-multiprocessor",
+    &MachineModel::RegistersPerMultiprocessor },
+  { "max-registers-per-thread",        &MachineModel::MaxRegistersPerThread }
+};
+
+const DoubleKey DoubleKeys[] = {
+  { "peak-gflops-fp32",     &MachineModel::PeakGFlopsFP32 },
+  { "peak-gflops-fp64",     &MachineModel::PeakGFlopsFP64 },
+  { "bandwidth-gbs",        &MachineModel::BandwidthGBs },
+  { "saturation-occupancy", &MachineModel::SaturationOccupancy }
+};
+
+const unsigned NumUnsignedKeys = sizeof(UnsignedKeys) / sizeof(UnsignedKeys[0]);
+const unsigned NumDoubleKeys   = sizeof(DoubleKeys) / sizeof(DoubleKeys[0]);
+
+/// getSize - Returns the size in bytes of a value of field \p F.
+unsigned getSize(const Field *F) {
+  return isa<FP64Type>(F->getElementType()) ? 8 : 4;
+}
+
+/// getPoints - Returns the number of points of field \p F that a block
+/// writing back \p Useful points in each dimension needs, given the
+/// regions \p Map.
+double getPoints(const BackEnd::RegionMap &Map, const Field *F,
+                 const std::vector<int> &Useful) {
+  const Region &R      = Map.find(F)->second;
+  double        Points = 1.0;
+
+  for (unsigned i = 0, e = Useful.size(); i != e; ++i) {
+    Points *= Useful[i] + R.getBound(i).second - 1;
+  }
+  return Points;
+}
+
+/// printList - Writes \p Values as a JSON array.
+template <typename T>
+void printList(const std::vector<T> &Values, raw_ostream &OS) {
+  OS << "[";
+  for (unsigned i = 0, e = Values.size(); i != e; ++i) {
+    if (i != 0) OS << ", ";
+    OS << Values[i];
+  }
+  OS << "]";
+}
+
+}
+
+MachineModel::MachineModel() {
+  setPreset("fermi");
+}
+
+bool MachineModel::setPreset(StringRef N) {
+  if (N == "gt200") {
+    Multiprocessors              = 30;
+    WarpSize                     = 32;
+    MaxThreadsPerBlock           = 512;
+    MaxThreadsPerMultiprocessor  = 1024;
+    MaxBlocksPerMultiprocessor   = 8;
+    SharedBytesPerMultiprocessor = 16*1024;
+    SharedBytesPerBlock          = 16*1024;
+    RegistersPerMultiprocessor   = 16*1024;
+    MaxRegistersPerThread        = 124;
+    PeakGFlopsFP32               = 933.0;
+    PeakGFlopsFP64               = 78.0;
+    BandwidthGBs                 = 141.7;
+  } else if (N == "fermi") {
+    Multiprocessors              = 14;
+    WarpSize                     = 32;
+    MaxThreadsPerBlock           = 1024;
+    MaxThreadsPerMultiprocessor  = 1536;
+    MaxBlocksPerMultiprocessor   = 8;
+    SharedBytesPerMultiprocessor = 48*1024;
+    SharedBytesPerBlock          = 48*1024;
+    RegistersPerMultiprocessor   = 32*1024;
+    MaxRegistersPerThread        = 63;
+    PeakGFlopsFP32               = 1030.0;
+    PeakGFlopsFP64               = 515.0;
+    BandwidthGBs                 = 144.0;
+  } else if (N == "kepler") {
+    Multiprocessors              = 13;
+    WarpSize                     = 32;
+    MaxThreadsPerBlock           = 1024;
+    MaxThreadsPerMultiprocessor  = 2048;
+    MaxBlocksPerMultiprocessor   = 16;
+    SharedBytesPerMultiprocessor = 48*1024;
+    SharedBytesPerBlock          = 48*1024;
+    RegistersPerMultiprocessor   = 64*1024;
+    MaxRegistersPerThread        = 255;
+    PeakGFlopsFP32               = 3520.0;
+    PeakGFlopsFP64               = 1170.0;
+    BandwidthGBs                 = 208.0;
+  } else {
+    return false;
+  }
+
+  Name                = N;
+  SaturationOccupancy = 0.5;
+  return true;
+}
+
+bool MachineModel::parse(StringRef Text, std::string &Err) {
+  SmallVector<StringRef, 16> Lines;
+  Text.split(Lines, "\n");
+
+  for (unsigned l = 0, le = Lines.size(); l != le; ++l) {
+    StringRef Line = Lines[l].trim();
+    if (Line.empty() || Line[0] == '#') continue;
+
+    std::pair<StringRef, StringRef> KV = Line.split(':');
+    StringRef Key   = KV.first.trim();
+    StringRef Value = KV.second.trim();
+    std::string Where = "line " + utostr(l+1) + ": ";
+
+    if (Value.empty()) {
+      Err = Where + "expected 'key: value'";
+      return false;
+    }
+
+    if (Key == "name") {
+      Name = Value;
+      continue;
+    }
+
+    bool Known = false;
+    for (unsigned i = 0; i != NumUnsignedKeys && !Known; ++i) {
+      if (Key != UnsignedKeys[i].Key) continue;
+      unsigned V;
+      if (Value.getAsInteger(10, V) || V == 0) {
+        Err = Where + "'" + Key.str() + "' must be a positive integer";
+        return false;
+      }
+      this->*UnsignedKeys[i].Member = V;
+      Known = true;
+    }
+    for (unsigned i = 0; i != NumDoubleKeys && !Known; ++i) {
+      if (Key != DoubleKeys[i].Key) continue;
+      std::string S = Value.str();
+      char       *End;
+      double      V = strtod(S.c_str(), &End);
+      if (*End != '\0' || V <= 0.0) {
+        Err = Where + "'" + Key.str() + "' must be a positive number";
+        return false;
+      }
+      this->*DoubleKeys[i].Member = V;
+      Known = true;
+    }
+
+    if (!Known) {
+      Err = Where + "unknown key '" + Key.str() + "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+void MachineModel::print(raw_ostream &OS) const {
+  OS << "name: " << Name << "\n";
+  for (unsigned i = 0; i != NumUnsignedKeys; ++i) {
+    OS << UnsignedKeys[i].Key << ": " << this->*UnsignedKeys[i].Member << "\n";
+  }
+  for (unsigned i = 0; i != NumDoubleKeys; ++i) {
+    OS << DoubleKeys[i].Key << ": "
+       << format("%g", this->*DoubleKeys[i].Member) << "\n";
+  }
+}
+
+KernelPrediction::KernelPrediction()
+  : NumFunctions(0), ThreadsPerBlock(1), UsefulPoints(0.0),
+    ComputedPoints(0.0), ScratchBytes(0), Registers(0),
+    BlocksPerMultiprocessor(0),
+    Occupancy(0.0), Flops(0.0), OnChipLoads(0.0), GlobalLoads(0.0),
+    GlobalStores(0.0), GlobalBytes(0.0), Seconds(0.0), MemoryBound(false) {
+}
+
+double KernelPrediction::getRedundancy() const {
+  if (ComputedPoints == 0.0) return 0.0;
+  return 1.0 - UsefulPoints * NumFunctions / ComputedPoints;
+}
+
+PerfModel::PerfModel(const BackEnd &B, const MachineModel &M)
+  : BE(B), Machine(M) {
+  Kernels.resize(BE.getKernels().size());
+  for (unsigned i = 0, e = Kernels.size(); i != e; ++i) {
+    predictKernel(i, Kernels[i]);
+  }
+}
+
+void PerfModel::predictKernel(unsigned Kernel, KernelPrediction &KP) const {
+  const BackEnd::FunctionList &Functions = BE.getKernels()[Kernel];
+  const BackEnd::RegionMap    &Map       = BE.getRegionMap(Kernel);
+  unsigned                     NumDims   = BE.getGrid()->getNumDimensions();
+  unsigned                     TimeTile  = BE.getTimeTileSize();
+
+  // A block writes back the points of its tile that are not in its halo.
+  std::vector<int> Useful(NumDims);
+
+  KP.UsefulPoints = 1.0;
+  for (unsigned i = 0; i < NumDims; ++i) {
+    int Left, Right;
+    if (!BE.getHalo(Kernel, i, Left, Right) && KP.Invalid.empty()) {
+      KP.Invalid = "negative halo of " + itostr(Left) + "+" + itostr(Right) +
+                   " points in dimension " + utostr(i);
+    }
+
+    KP.HaloLeft.push_back(Left);
+    KP.HaloRight.push_back(Right);
+    Useful[i] = BE.getElements(i)*BE.getBlockSize(i) - Left - Right;
+    if (Useful[i] <= 0 && KP.Invalid.empty()) {
+      KP.Invalid = "block does not cover its halo in dimension " + utostr(i);
+    }
+
+    KP.ThreadsPerBlock *= BE.getBlockSize(i);
+    KP.UsefulPoints    *= std::max(Useful[i], 0);
+  }
+  if (!KP.Invalid.empty()) return;
+
+  KP.NumFunctions = Functions.size();
+
+  // Every function is evaluated on the region of its output in each time
+  // step.  Fields are read from global memory once per time tile, unless
+  // an earlier function of the kernel computes them, and outputs that are
+  // not temporaries are written back once.
+  std::set<const Field*> Written;
+  std::set<const Field*> Read;
+  unsigned               BufferRegs = 0;
+  bool                   FP64       = false;
+
+  for (BackEnd::FunctionList::const_iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    const Field *Out    = (*I)->getOutput();
+    PointCost    Cost   = CostModel::getFunctionCost(*I);
+    double       Points = getPoints(Map, Out, Useful);
+
+    KP.ComputedPoints += Points;
+    KP.Flops          += Cost.WeightedFlops * Points;
+    KP.OnChipLoads    += Cost.Loads * Points;
+
+    std::set<Field*> Inputs = (*I)->getInputFields();
+    for (std::set<Field*>::iterator FI = Inputs.begin(), FE = Inputs.end();
+         FI != FE; ++FI) {
+      FP64 |= getSize(*FI) == 8;
+      if (Written.count(*FI) || !Read.insert(*FI).second) continue;
+
+      double Loads = getPoints(Map, *FI, Useful);
+      KP.GlobalLoads += Loads;
+      KP.GlobalBytes += Loads * getSize(*FI);
+    }
+    Written.insert(Out);
+
+    if (!BE.isTemporary(Out)) {
+      KP.GlobalStores += KP.UsefulPoints;
+      KP.GlobalBytes  += KP.UsefulPoints * getSize(Out);
+    }
+
+    FP64 |= getSize(Out) == 8;
+  }
+
+  KP.Flops        /= KP.UsefulPoints;
+  KP.OnChipLoads  /= KP.UsefulPoints;
+  KP.GlobalLoads  /= KP.UsefulPoints * TimeTile;
+  KP.GlobalStores /= KP.UsefulPoints * TimeTile;
+  KP.GlobalBytes  /= KP.UsefulPoints * TimeTile;
+
+  KP.ScratchBytes = BE.getKernelScratchBytes(Kernel);
+  KP.Registers    = ResourceCheck::getRegisters(BE, Kernel, BufferRegs);
+
+  // Occupancy is limited by threads, registers, and shared memory, which
+  // are allocated to whole warps.
+  unsigned Warps = (KP.ThreadsPerBlock + Machine.WarpSize-1) /
+                   Machine.WarpSize;
+  unsigned Slots = Warps * Machine.WarpSize;
+  unsigned Regs  = std::min(KP.Registers, Machine.MaxRegistersPerThread);
+
+  unsigned Blocks = Machine.MaxBlocksPerMultiprocessor;
+  Blocks = std::min(Blocks, Machine.MaxThreadsPerMultiprocessor / Slots);
+  Blocks = std::min(Blocks, Machine.RegistersPerMultiprocessor /
+                            (Regs * Slots));
+  if (KP.ScratchBytes > 0) {
+    Blocks = std::min<uint64_t>(Blocks,
+                                Machine.SharedBytesPerMultiprocessor /
+                                KP.ScratchBytes);
+  }
+
+  if (KP.ThreadsPerBlock > Machine.MaxThreadsPerBlock) {
+    KP.Invalid = "block has more than " + utostr(Machine.MaxThreadsPerBlock) +
+                 " threads";
+  } else if (KP.ScratchBytes > Machine.SharedBytesPerBlock) {
+    KP.Invalid = "scratch does not fit into the shared memory of a block";
+  } else if (Blocks == 0) {
+    KP.Invalid = "no block fits on a multiprocessor";
+  }
+  if (!KP.Invalid.empty()) return;
+
+  KP.BlocksPerMultiprocessor = Blocks;
+  KP.Occupancy = double(Blocks * Slots) / Machine.MaxThreadsPerMultiprocessor;
+
+  double Efficiency = std::min(1.0, KP.Occupancy / Machine.SaturationOccupancy)
+                      * KP.ThreadsPerBlock / Slots;
+  double Peak       = FP64 ? Machine.PeakGFlopsFP64 : Machine.PeakGFlopsFP32;
+  double Compute    = KP.Flops / (Peak * 1e9);
+  double Memory     = KP.GlobalBytes / (Machine.BandwidthGBs * 1e9);
+
+  KP.MemoryBound = Memory > Compute;
+  KP.Seconds     = std::max(Compute, Memory) / Efficiency;
+}
+
+bool PerfModel::isValid() const {
+  for (unsigned i = 0, e = Kernels.size(); i != e; ++i) {
+    if (!Kernels[i].Invalid.empty()) return false;
+  }
+  return true;
+}
+
+double PerfModel::getGStencils() const {
+  if (!isValid()) return 0.0;
+
+  // The kernels of a time step run one after the other.
+  double Seconds = 0.0;
+  for (unsigned i = 0, e = Kernels.size(); i != e; ++i) {
+    Seconds += Kernels[i].Seconds;
+  }
+  return Seconds > 0.0 ? 1e-9 / Seconds : 0.0;
+}
+
+void PerfModel::print(raw_ostream &OS) const {
+  const Grid *G       = BE.getGrid();
+  unsigned    NumDims = G->getNumDimensions();
+
+  std::vector<unsigned> BlockSize;
+  std::vector<unsigned> Elements;
+  for (unsigned i = 0; i < NumDims; ++i) {
+    BlockSize.push_back(BE.getBlockSize(i));
+    Elements.push_back(BE.getElements(i));
+  }
+
+  OS << "{\n";
+  OS << "  \"program\": \"" << G->getName() << "\",\n";
+  OS << "  \"machine\": \"" << Machine.Name << "\",\n";
+  OS << "  \"block\": ";
+  printList(BlockSize, OS);
+  OS << ",\n";
+  OS << "  \"elements\": ";
+  printList(Elements, OS);
+  OS << ",\n";
+  OS << "  \"time-tile\": " << BE.getTimeTileSize() << ",\n";
+  OS << "  \"valid\": " << (isValid() ? "true" : "false") << ",\n";
+  OS << "  \"gstencils\": " << format("%g", getGStencils()) << ",\n";
+  OS << "  \"kernels\": [";
+
+  for (unsigned k = 0, ke = Kernels.size(); k != ke; ++k) {
+    const KernelPrediction      &KP        = Kernels[k];
+    const BackEnd::FunctionList &Functions = BE.getKernels()[k];
+
+    OS << (k != 0 ? ",\n" : "\n") << "    {\n";
+    OS << "      \"functions\": [";
+    for (BackEnd::FunctionList::const_iterator I = Functions.begin(),
+           B = I, E = Functions.end(); I != E; ++I) {
+      if (I != B) OS << ", ";
+      OS << "\"" << (*I)->getOutput()->getName() << "\"";
+    }
+    OS << "],\n";
+
+    if (!KP.Invalid.empty()) {
+      OS << "      \"valid\": false,\n";
+      OS << "      \"reason\": \"" << KP.Invalid << "\"\n";
+      OS << "    }";
+      continue;
+    }
+
+    OS << "      \"valid\": true,\n";
+    OS << "      \"halo-left\": ";
+    printList(KP.HaloLeft, OS);
+    OS << ",\n";
+    OS << "      \"halo-right\": ";
+    printList(KP.HaloRight, OS);
+    OS << ",\n";
+    OS << "      \"threads-per-block\": " << KP.ThreadsPerBlock << ",\n";
+    OS << "      \"useful-points-per-block\": "
+       << format("%g", KP.UsefulPoints) << ",\n";
+    OS << "      \"computed-points-per-block\": "
+       << format("%g", KP.ComputedPoints) << ",\n";
+    OS << "      \"redundant-compute-ratio\": "
+       << format("%g", KP.getRedundancy()) << ",\n";
+    OS << "      \"scratch-bytes\": " << KP.ScratchBytes << ",\n";
+    OS << "      \"registers\": " << KP.Registers << ",\n";
+    OS << "      \"spills\": "
+       << (KP.Registers > Machine.MaxRegistersPerThread ? "true" : "false")
+       << ",\n";
+    OS << "      \"blocks-per-multiprocessor\": " << KP.BlocksPerMultiprocessor
+       << ",\n";
+    OS << "      \"occupancy\": " << format("%g", KP.Occupancy) << ",\n";
+    OS << "      \"flops-per-point\": " << format("%g", KP.Flops) << ",\n";
+    OS << "      \"on-chip-loads-per-point\": "
+       << format("%g", KP.OnChipLoads) << ",\n";
+    OS << "      \"global-loads-per-point\": "
+       << format("%g", KP.GlobalLoads) << ",\n";
+    OS << "      \"global-stores-per-point\": "
+       << format("%g", KP.GlobalStores) << ",\n";
+    OS << "      \"global-bytes-per-point\": "
+       << format("%g", KP.GlobalBytes) << ",\n";
+    OS << "      \"bound\": \"" << (KP.MemoryBound ? "memory" : "compute")
+       << "\"\n";
+    OS << "    }";
+  }
+  OS << "\n  ]\n";
+  OS << "}\n";
+}
+
+}
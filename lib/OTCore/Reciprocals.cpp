@@ -0,0 +1,187 @@
+/*
+ * Reciprocals.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: Reciprocals.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Core/Reciprocals.h"
+#include "overtile/Core/ExprDAG.h"
+#include "overtile/Core/Expressions.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Grid.h"
+#include "overtile/Core/Types.h"
+#include "llvm/Support/Casting.h"
+#include <cfloat>
+#include <cmath>
+#include <set>
+
+using namespace llvm;
+
+namespace overtile {
+
+namespace {
+
+/// isOne - Returns true if \p Expr is the constant 1.
+bool isOne(const Expression *Expr) {
+  if (const IntConstant *I = dyn_cast<IntConstant>(Expr)) {
+    return I->getValue() == 1;
+  } else if (const FP32Constant *F = dyn_cast<FP32Constant>(Expr)) {
+    return F->getValue() == 1.0f;
+  }
+  return false;
+}
+
+/// isDouble - Returns true if \p Expr is evaluated in double precision.
+bool isDouble(const Expression *Expr, const Grid *G) {
+  return dependsOnData(Expr) && isa<FP64Type>(getExprType(Expr, G, false));
+}
+
+/// getReciprocal - Returns the reciprocal of the constant \p C, or NULL if
+/// it is not a normal float, or if it is not exact and \p Inexact is not
+/// set.
+FP32Constant *getReciprocal(const ConstantExpr *C, bool Inexact) {
+  double V;
+  if (const IntConstant *I = dyn_cast<IntConstant>(C)) {
+    V = I->getValue();
+  } else {
+    V = cast<FP32Constant>(C)->getValue();
+  }
+
+  if (V == 0.0) {
+    return NULL;
+  }
+
+  // The reciprocal of a power of two is exact.
+  int  Exp;
+  bool Exact = std::fabs(std::frexp(V, &Exp)) == 0.5;
+  if (!Exact && !Inexact) {
+    return NULL;
+  }
+
+  float R = (float)(1.0 / V);
+  if (std::fabs(R) < FLT_MIN || std::fabs(R) > FLT_MAX) {
+    return NULL;
+  }
+  return new FP32Constant(R);
+}
+
+}
+
+DivisionReducer::DivisionReducer(const Grid *G, bool FM)
+  : TheGrid(G), FastMath(FM) {
+}
+
+Expression *DivisionReducer::reduce(Expression *Expr) {
+  Divisors.clear();
+  Reciprocals.clear();
+  Reduced.clear();
+
+  std::set<Expression*> Visited;
+  countDivisors(Expr, Visited);
+  return reduceNode(Expr);
+}
+
+void DivisionReducer::reduceGrid(Grid *G, bool FastMath) {
+  const std::list<Function*> &Functions = G->getFunctionList();
+
+  for (std::list<Function*>::const_iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    ExprDAG                     DAG;
+    DivisionReducer             Reducer(G, FastMath);
+    std::list<BoundedFunction> &BFuncs = (*I)->getBoundedFunctions();
+
+    for (std::list<BoundedFunction>::iterator BI = BFuncs.begin(),
+           BE = BFuncs.end(); BI != BE; ++BI) {
+      BI->Expr = Reducer.reduce(DAG.canonicalize(BI->Expr));
+    }
+  }
+}
+
+void DivisionReducer::countDivisors(Expression *Expr,
+                                    std::set<Expression*> &Visited) {
+  if (!Visited.insert(Expr).second) {
+    return;
+  }
+
+  if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    if (Op->getOperator() == BinaryOp::DIV) {
+      Divisors[Op->getRHS()]++;
+    }
+    countDivisors(Op->getLHS(), Visited);
+    countDivisors(Op->getRHS(), Visited);
+  } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    const std::vector<Expression*> &Params = FC->getParameters();
+    for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+      countDivisors(Params[i], Visited);
+    }
+  }
+}
+
+Expression *DivisionReducer::reduceNode(Expression *Expr) {
+  std::map<Expression*, Expression*>::iterator Memo = Reduced.find(Expr);
+  if (Memo != Reduced.end()) {
+    return Memo->second;
+  }
+
+  Expression *Result = Expr;
+
+  if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    Expression *Divisor = Op->getRHS();
+    Expression *L       = reduceNode(Op->getLHS());
+    Expression *R       = reduceNode(Divisor);
+    Op->setLHS(L);
+    Op->setRHS(R);
+
+    if (Op->getOperator() == BinaryOp::DIV) {
+      // A float reciprocal loses precision if the division is carried out
+      // in double precision, unless it is exact.
+      bool          Narrowing = isDouble(L, TheGrid) && !isDouble(R, TheGrid);
+      ConstantExpr *C         = dyn_cast<ConstantExpr>(R);
+
+      if (C && !isa<ConstantExpr>(L)) {
+        if (FP32Constant *Rcp = getReciprocal(C, FastMath && !Narrowing)) {
+          Result = new BinaryOp(BinaryOp::MUL, L, Rcp);
+        }
+      } else if (!C && FastMath && !Narrowing &&
+                 (!readsFields(R) || Divisors[Divisor] > 1)) {
+        // 1/x is its own reciprocal, which the other divisions can share.
+        Expression *&Rcp = Reciprocals[Divisor];
+        if (!Rcp) {
+          Rcp = isOne(L) ? Op
+                         : new BinaryOp(BinaryOp::DIV, new FP32Constant(1.0f),
+                                        R);
+        }
+        if (Rcp != Op) {
+          Result = isOne(L) ? Rcp : new BinaryOp(BinaryOp::MUL, L, Rcp);
+        }
+      }
+    }
+  } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    const std::vector<Expression*> &Params = FC->getParameters();
+    for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+      FC->setParameter(i, reduceNode(Params[i]));
+    }
+  }
+
+  if (Result != Expr && Result->getBindingName().empty()) {
+    Result->setBindingName(Expr->getBindingName());
+  }
+
+  Reduced[Expr] = Result;
+  return Result;
+}
+
+}
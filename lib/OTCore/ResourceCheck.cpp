@@ -0,0 +1,375 @@
+/*
+ * ResourceCheck.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: ResourceCheck.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Core/ResourceCheck.h"
+#include "overtile/Core/BackEnd.h"
+#include "overtile/Core/CostModel.h"
+#include "overtile/Core/Field.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Grid.h"
+#include "overtile/Core/PerfModel.h"
+#include "overtile/Core/Types.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Casting.h"
+#include <algorithm>
+#include <deque>
+#include <set>
+
+using namespace llvm;
+
+namespace overtile {
+
+namespace {
+
+/// Largest block size and number of elements per thread that clamp()
+/// considers in any dimension.
+const unsigned MaxBlockSize = 1024;
+const unsigned MaxElements  = 16;
+
+/// Configuration - The block sizes, the elements per thread, and the time
+/// tile size, in this order.
+typedef std::vector<unsigned> Configuration;
+
+/// getState - Returns in \p C the configuration of \p BE.
+void getState(const BackEnd &BE, Configuration &C) {
+  unsigned NumDims = BE.getGrid()->getNumDimensions();
+
+  C.clear();
+  for (unsigned i = 0; i < NumDims; ++i) {
+    C.push_back(BE.getBlockSize(i));
+  }
+  for (unsigned i = 0; i < NumDims; ++i) {
+    C.push_back(BE.getElements(i));
+  }
+  C.push_back(BE.getRequestedTimeTileSize());
+}
+
+/// setState - Changes the configuration of \p BE to \p C.
+void setState(BackEnd &BE, const Configuration &C) {
+  unsigned NumDims = BE.getGrid()->getNumDimensions();
+
+  for (unsigned i = 0; i < NumDims; ++i) {
+    BE.setBlockSize(i, C[i]);
+    BE.setElements(i, C[NumDims+i]);
+  }
+  BE.setTimeTileSize(C.back());
+}
+
+/// printList - Writes \p Values as a YAML flow sequence.
+template <typename T>
+void printList(const std::vector<T> &Values, raw_ostream &OS) {
+  OS << "[";
+  for (unsigned i = 0, e = Values.size(); i != e; ++i) {
+    OS << (i == 0 ? "" : ", ") << Values[i];
+  }
+  OS << "]";
+}
+
+void printMessages(const char *Key, const std::vector<std::string> &Messages,
+                   raw_ostream &OS) {
+  OS << Key << ":";
+  if (Messages.empty()) {
+    OS << " []\n";
+    return;
+  }
+  OS << "\n";
+  for (unsigned i = 0, e = Messages.size(); i != e; ++i) {
+    OS << "  - \"" << Messages[i] << "\"\n";
+  }
+}
+
+}
+
+KernelResources::KernelResources()
+  : Threads(0), ScratchBytes(0), BufferRegisters(0), Registers(0) {
+}
+
+ResourceCheck::ResourceCheck(BackEnd &B, const MachineModel *M)
+  : BE(B), Machine(M) {
+  check();
+}
+
+void ResourceCheck::check() {
+  Kernels.assign(BE.getKernels().size(), KernelResources());
+  Errors.clear();
+  Warnings.clear();
+
+  // The back end changes the configuration itself if the fused kernel does
+  // not fit into the scratch budget.
+  unsigned Time = BE.getTimeTileSize();
+  if (Kernels.size() > 1) {
+    Warnings.push_back("functions split into " + utostr(Kernels.size()) +
+                       " kernels with time tile 1 instead of " +
+                       utostr(BE.getRequestedTimeTileSize()) +
+                       " to fit the scratch budget of " +
+                       utostr(BE.getScratchBudget()) + " bytes");
+  } else if (Time != BE.getRequestedTimeTileSize()) {
+    Warnings.push_back("time tile reduced from " +
+                       utostr(BE.getRequestedTimeTileSize()) + " to " +
+                       utostr(Time) + " to fit the scratch budget of " +
+                       utostr(BE.getScratchBudget()) + " bytes");
+  }
+
+  for (unsigned i = 0, e = Kernels.size(); i != e; ++i) {
+    checkKernel(i, Kernels[i]);
+  }
+}
+
+void ResourceCheck::checkKernel(unsigned Kernel, KernelResources &KR) {
+  unsigned    NumDims = BE.getGrid()->getNumDimensions();
+  std::string Prefix;
+
+  if (Kernels.size() > 1) {
+    Prefix = "kernel " + utostr(Kernel) + ": ";
+  }
+
+  for (unsigned i = 0; i < NumDims; ++i) {
+    int Left, Right;
+    bool HaloOK = BE.getHalo(Kernel, i, Left, Right);
+
+    KR.TileSize.push_back(BE.getTileSize(i));
+    KR.HaloLeft.push_back(Left);
+    KR.HaloRight.push_back(Right);
+
+    if (!HaloOK) {
+      Errors.push_back(Prefix + "block region does not contain offset 0 " +
+                       "in dimension " + utostr(i) + ", its halo is " +
+                       itostr(Left) + "+" + itostr(Right) + " points");
+    } else if (KR.TileSize[i] != 0 && KR.getUsefulPoints(i) <= 0) {
+      Errors.push_back(Prefix + "tile of " + utostr(KR.TileSize[i]) +
+                       " points in dimension " + utostr(i) +
+                       " does not cover its halo of " + utostr(Left) + "+" +
+                       utostr(Right) + " points");
+    }
+  }
+
+  if (!Machine) return;
+
+  KR.Threads = 1;
+  for (unsigned i = 0; i < NumDims; ++i) {
+    KR.Threads *= BE.getBlockSize(i);
+  }
+  KR.ScratchBytes = BE.getKernelScratchBytes(Kernel);
+  KR.Registers    = getRegisters(BE, Kernel, KR.BufferRegisters);
+
+  // All kernels are launched with the same block.
+  if (Kernel == 0 && KR.Threads > Machine->MaxThreadsPerBlock) {
+    Errors.push_back("block of " + utostr(KR.Threads) +
+                     " threads, the device allows " +
+                     utostr(Machine->MaxThreadsPerBlock));
+  }
+
+  if (KR.ScratchBytes > Machine->SharedBytesPerBlock) {
+    Errors.push_back(Prefix + utostr(KR.ScratchBytes) +
+                     " bytes of shared memory, the device allows " +
+                     utostr(Machine->SharedBytesPerBlock) + " per block");
+  } else if (BE.getScratchBudget() != 0 &&
+             KR.ScratchBytes > BE.getScratchBudget()) {
+    Warnings.push_back(Prefix + utostr(KR.ScratchBytes) +
+                       " bytes of shared memory exceed the scratch budget of " +
+                       utostr(BE.getScratchBudget()));
+  }
+
+  // Registers are allocated to whole warps, and a thread never gets more
+  // than the per-thread limit; the rest spills.
+  uint64_t Slots = (KR.Threads + Machine->WarpSize-1) / Machine->WarpSize *
+                   Machine->WarpSize;
+  uint64_t Regs  = std::min(KR.Registers, Machine->MaxRegistersPerThread);
+  if (Regs * Slots > Machine->RegistersPerMultiprocessor) {
+    Errors.push_back(Prefix + "block needs " + utostr(Regs * Slots) +
+                     " registers, a multiprocessor has " +
+                     utostr(Machine->RegistersPerMultiprocessor));
+  }
+  if (KR.Registers > Machine->MaxRegistersPerThread) {
+    Warnings.push_back(Prefix + "about " + utostr(KR.Registers) +
+                       " registers per thread, " +
+                       utostr(KR.BufferRegisters) +
+                       " of them for Buffer_ arrays, exceed the limit of " +
+                       utostr(Machine->MaxRegistersPerThread) +
+                       " and spill to local memory");
+  }
+}
+
+bool ResourceCheck::clamp() {
+  if (isFeasible()) return true;
+
+  unsigned NumDims = BE.getGrid()->getNumDimensions();
+  bool     Verbose = BE.getVerbose();
+  bool     Found   = false;
+
+  Configuration Start;
+  getState(BE, Start);
+
+  // Breadth-first search over the steps, so that the first feasible
+  // configuration is one of the nearest.  Block sizes are changed first,
+  // then elements, and the time tile last.
+  std::set<Configuration>   Seen;
+  std::deque<Configuration> Queue;
+  Seen.insert(Start);
+  Queue.push_back(Start);
+
+  BE.setVerbose(false);
+  for (unsigned States = 0; !Queue.empty() && States < MaxClampStates;
+       ++States) {
+    Configuration C = Queue.front();
+    Queue.pop_front();
+
+    if (States != 0) {
+      setState(BE, C);
+      BE.retile();
+      check();
+      if (isFeasible()) {
+        Found = true;
+        break;
+      }
+    }
+
+    std::vector<Configuration> Next;
+    for (unsigned i = 0; i < NumDims; ++i) {
+      if (C[i] < MaxBlockSize) {
+        Next.push_back(C);
+        Next.back()[i] = std::min(C[i]*2, MaxBlockSize);
+      }
+      if (C[i] > 1) {
+        Next.push_back(C);
+        Next.back()[i] = C[i]/2;
+      }
+    }
+    for (unsigned i = NumDims; i < 2*NumDims; ++i) {
+      if (C[i] < MaxElements) {
+        Next.push_back(C);
+        Next.back()[i] = C[i]+1;
+      }
+      if (C[i] > 1) {
+        Next.push_back(C);
+        Next.back()[i] = C[i]-1;
+      }
+    }
+    if (C.back() > 1) {
+      Next.push_back(C);
+      Next.back().back() = C.back()-1;
+    }
+
+    for (unsigned n = 0, ne = Next.size(); n != ne; ++n) {
+      if (Seen.insert(Next[n]).second) {
+        Queue.push_back(Next[n]);
+      }
+    }
+  }
+  BE.setVerbose(Verbose);
+
+  if (!Found) {
+    setState(BE, Start);
+  }
+  BE.retile();
+  check();
+  return Found;
+}
+
+void ResourceCheck::print(raw_ostream &OS) const {
+  OS << "program: " << BE.getGrid()->getName() << "\n";
+  OS << "configuration: " << getConfiguration(BE) << "\n";
+  OS << "feasible: " << (isFeasible() ? "true" : "false") << "\n";
+  OS << "kernels:\n";
+
+  for (unsigned k = 0, ke = Kernels.size(); k != ke; ++k) {
+    const KernelResources       &KR        = Kernels[k];
+    const BackEnd::FunctionList &Functions = BE.getKernels()[k];
+
+    std::vector<std::string> Names;
+    for (BackEnd::FunctionList::const_iterator I = Functions.begin(),
+           E = Functions.end(); I != E; ++I) {
+      Names.push_back((*I)->getOutput()->getName());
+    }
+
+    std::vector<int> Useful;
+    for (unsigned i = 0, e = KR.TileSize.size(); i != e; ++i) {
+      Useful.push_back(KR.TileSize[i] != 0 ? KR.getUsefulPoints(i) : 0);
+    }
+
+    OS << "  - functions: ";
+    printList(Names, OS);
+    OS << "\n    tile: ";
+    printList(KR.TileSize, OS);
+    OS << "\n    halo-left: ";
+    printList(KR.HaloLeft, OS);
+    OS << "\n    halo-right: ";
+    printList(KR.HaloRight, OS);
+    OS << "\n    useful-points: ";
+    printList(Useful, OS);
+    OS << "\n";
+
+    if (Machine) {
+      OS << "    threads: " << KR.Threads << "\n";
+      OS << "    shared-bytes: " << KR.ScratchBytes << "\n";
+      OS << "    registers: " << KR.Registers << "\n";
+      OS << "    buffer-registers: " << KR.BufferRegisters << "\n";
+    }
+  }
+
+  printMessages("errors", Errors, OS);
+  printMessages("warnings", Warnings, OS);
+}
+
+std::string ResourceCheck::getConfiguration(const BackEnd &BE) {
+  unsigned    NumDims = BE.getGrid()->getNumDimensions();
+  std::string Ret;
+
+  Ret = "block:";
+  for (unsigned i = 0; i < NumDims; ++i) {
+    Ret += (i == 0 ? "" : ",") + utostr(BE.getBlockSize(i));
+  }
+  Ret += " tile:";
+  for (unsigned i = 0; i < NumDims; ++i) {
+    Ret += (i == 0 ? "" : ",") + utostr(BE.getElements(i));
+  }
+  Ret += " time:" + utostr(BE.getRequestedTimeTileSize());
+  return Ret;
+}
+
+unsigned ResourceCheck::getRegisters(const BackEnd &BE, unsigned Kernel,
+                                     unsigned &BufferRegs) {
+  const BackEnd::FunctionList &Functions = BE.getKernels()[Kernel];
+  unsigned                     Elements  = 1;
+  unsigned                     LoadRegs  = 0;
+  std::set<const Field*>       Outputs;
+
+  for (unsigned i = 0, e = BE.getGrid()->getNumDimensions(); i < e; ++i) {
+    Elements *= BE.getElements(i);
+  }
+
+  // A thread keeps the elements of every output in its Buffer_ array, and
+  // the values that one point reads in registers.
+  BufferRegs = 0;
+  for (BackEnd::FunctionList::const_iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    const Field *Out  = (*I)->getOutput();
+    unsigned     Size = isa<FP32Type>(Out->getElementType()) ? 4 : 8;
+    PointCost    Cost = CostModel::getFunctionCost(*I);
+
+    if (Outputs.insert(Out).second) {
+      BufferRegs += Elements * Size / 4;
+    }
+    LoadRegs = std::max(LoadRegs, Cost.Loads * Size / 4);
+  }
+
+  return BaseRegisters + BufferRegs + LoadRegs;
+}
+
+}
@@ -0,0 +1,374 @@
+/*
+ * Simplify.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: Simplify.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Core/Simplify.h"
+#include "overtile/Core/Field.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Grid.h"
+#include "llvm/Support/Casting.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+
+using namespace llvm;
+
+namespace overtile {
+
+namespace {
+
+/// getValue - Returns the value of the constant \p C.
+double getValue(const ConstantExpr *C) {
+  if (const IntConstant *I = dyn_cast<IntConstant>(C)) {
+    return I->getValue();
+  } else {
+    return cast<FP32Constant>(C)->getValue();
+  }
+}
+
+/// isNegativeZero - Returns true if \p C is -0.0.
+bool isNegativeZero(const ConstantExpr *C) {
+  return isa<FP32Constant>(C) && getValue(C) == 0.0 &&
+         C->getStringValue()[0] == '-';
+}
+
+/// isExactInFloat - Returns true if the integer \p V is exactly
+/// representable as a float.
+bool isExactInFloat(long long V) {
+  return V >= -(1LL << 24) && V <= (1LL << 24);
+}
+
+/// negate - Returns a new constant with the negated value of \p C, or NULL
+/// if it cannot be represented.
+ConstantExpr *negate(const ConstantExpr *C) {
+  if (const IntConstant *I = dyn_cast<IntConstant>(C)) {
+    if (I->getValue() == INT_MIN) return NULL;
+    return new IntConstant(-I->getValue());
+  } else {
+    return new FP32Constant(-cast<FP32Constant>(C)->getValue());
+  }
+}
+
+/// getNegated - Returns x if \p Expr is the negation 0-x, and NULL
+/// otherwise.
+Expression *getNegated(Expression *Expr) {
+  BinaryOp *Op = dyn_cast<BinaryOp>(Expr);
+  if (!Op || Op->getOperator() != BinaryOp::SUB) return NULL;
+
+  const ConstantExpr *C = dyn_cast<ConstantExpr>(Op->getLHS());
+  if (!C || getValue(C) != 0.0) return NULL;
+  return Op->getRHS();
+}
+
+/// isEqual - Returns true if \p A and \p B are structurally equal.
+bool isEqual(const Expression *A, const Expression *B) {
+  if (A == B) return true;
+  if (A->getClassType() != B->getClassType()) return false;
+
+  if (const BinaryOp *OpA = dyn_cast<BinaryOp>(A)) {
+    const BinaryOp *OpB = cast<BinaryOp>(B);
+    return OpA->getOperator() == OpB->getOperator() &&
+           isEqual(OpA->getLHS(), OpB->getLHS()) &&
+           isEqual(OpA->getRHS(), OpB->getRHS());
+  } else if (const FunctionCall *FA = dyn_cast<FunctionCall>(A)) {
+    const FunctionCall             *FB      = cast<FunctionCall>(B);
+    const std::vector<Expression*> &ParamsA = FA->getParameters();
+    const std::vector<Expression*> &ParamsB = FB->getParameters();
+    if (FA->getName() != FB->getName() || ParamsA.size() != ParamsB.size()) {
+      return false;
+    }
+    for (unsigned i = 0, e = ParamsA.size(); i != e; ++i) {
+      if (!isEqual(ParamsA[i], ParamsB[i])) return false;
+    }
+    return true;
+  } else if (const FieldRef *RefA = dyn_cast<FieldRef>(A)) {
+    const FieldRef                  *RefB = cast<FieldRef>(B);
+    const std::vector<IntConstant*> &OffA = RefA->getOffsets();
+    const std::vector<IntConstant*> &OffB = RefB->getOffsets();
+    if (RefA->getField() != RefB->getField()) return false;
+    for (unsigned i = 0, e = OffA.size(); i != e; ++i) {
+      if (OffA[i]->getValue() != OffB[i]->getValue()) return false;
+    }
+    return true;
+  } else if (const ConstantExpr *CA = dyn_cast<ConstantExpr>(A)) {
+    return CA->getStringValue() == cast<ConstantExpr>(B)->getStringValue();
+  } else if (const PlaceHolderExpr *PA = dyn_cast<PlaceHolderExpr>(A)) {
+    return PA->getName() == cast<PlaceHolderExpr>(B)->getName();
+  }
+  return false;
+}
+
+}
+
+ExprSimplifier::ExprSimplifier(bool FM)
+  : FastMath(FM) {
+}
+
+Expression *ExprSimplifier::simplify(Expression *Expr) {
+  std::map<Expression*, Expression*>::iterator Memo = Simplified.find(Expr);
+  if (Memo != Simplified.end()) {
+    return Memo->second;
+  }
+
+  Expression *Result = Expr;
+
+  if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    Op->setLHS(simplify(Op->getLHS()));
+    Op->setRHS(simplify(Op->getRHS()));
+    Result = simplifyBinaryOp(Op);
+  } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    const std::vector<Expression*> &Params = FC->getParameters();
+    for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+      FC->setParameter(i, simplify(Params[i]));
+    }
+  }
+
+  // The simplified value keeps the name of a let binding.
+  if (Result != Expr && Result->getBindingName().empty()) {
+    Result->setBindingName(Expr->getBindingName());
+  }
+
+  Simplified[Expr] = Result;
+  return Result;
+}
+
+void ExprSimplifier::simplifyGrid(Grid *G, bool FastMath) {
+  const std::list<Function*> &Functions = G->getFunctionList();
+  ExprSimplifier              Simplifier(FastMath);
+
+  for (std::list<Function*>::const_iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    std::list<BoundedFunction> &BFuncs = (*I)->getBoundedFunctions();
+
+    for (std::list<BoundedFunction>::iterator BI = BFuncs.begin(),
+           BE = BFuncs.end(); BI != BE; ++BI) {
+      BI->Expr = Simplifier.simplify(BI->Expr);
+    }
+  }
+}
+
+Expression *ExprSimplifier::simplifyBinaryOp(BinaryOp *Op) {
+  BinaryOp::Operator  Opc = Op->getOperator();
+  Expression         *L   = Op->getLHS();
+  Expression         *R   = Op->getRHS();
+  ConstantExpr       *LC  = dyn_cast<ConstantExpr>(L);
+  ConstantExpr       *RC  = dyn_cast<ConstantExpr>(R);
+
+  if (LC && RC) {
+    if (ConstantExpr *C = fold(Opc, LC, RC)) {
+      return C;
+    }
+    return Op;
+  }
+
+  // Constants go to the right of commutative operators.
+  if (LC && (Opc == BinaryOp::ADD || Opc == BinaryOp::MUL)) {
+    Op->setLHS(R);
+    Op->setRHS(L);
+    std::swap(L, R);
+    std::swap(LC, RC);
+  }
+
+  if (RC) {
+    double V = getValue(RC);
+
+    switch (Opc) {
+    case BinaryOp::MUL:
+      if (V == 1.0) return L;
+      if (FastMath && V == 0.0) return RC;
+      break;
+    case BinaryOp::DIV:
+      if (V == 1.0) return L;
+      break;
+    case BinaryOp::ADD:
+      // Only x + -0.0 is exact for x = -0.0.
+      if (V == 0.0 && (FastMath || isNegativeZero(RC))) return L;
+      if (V < 0.0) {
+        if (ConstantExpr *NegC = negate(RC)) {
+          return simplifyBinaryOp(new BinaryOp(BinaryOp::SUB, L, NegC));
+        }
+      }
+      break;
+    case BinaryOp::SUB:
+      if (V == 0.0 && (FastMath || !isNegativeZero(RC))) return L;
+      if (V < 0.0) {
+        if (ConstantExpr *NegC = negate(RC)) {
+          return simplifyBinaryOp(new BinaryOp(BinaryOp::ADD, L, NegC));
+        }
+      }
+      break;
+    }
+  }
+
+  if (!FastMath) {
+    return Op;
+  }
+
+  if (LC && Opc == BinaryOp::DIV && getValue(LC) == 0.0) {
+    return LC;
+  }
+  if (Opc == BinaryOp::SUB && isEqual(L, R)) {
+    return new FP32Constant(0.0f);
+  }
+  if (Opc == BinaryOp::DIV && isEqual(L, R)) {
+    return new FP32Constant(1.0f);
+  }
+
+  // Propagate negations written as 0-x.
+  Expression *NegL = getNegated(L);
+  Expression *NegR = getNegated(R);
+
+  switch (Opc) {
+  case BinaryOp::ADD:
+    if (NegR) {
+      return simplifyBinaryOp(new BinaryOp(BinaryOp::SUB, L, NegR));
+    } else if (NegL) {
+      return simplifyBinaryOp(new BinaryOp(BinaryOp::SUB, R, NegL));
+    }
+    break;
+  case BinaryOp::SUB:
+    if (NegR) {
+      return simplifyBinaryOp(new BinaryOp(BinaryOp::ADD, L, NegR));
+    }
+    break;
+  case BinaryOp::MUL:
+  case BinaryOp::DIV:
+    if (NegL && NegR) {
+      return simplifyBinaryOp(new BinaryOp(Opc, NegL, NegR));
+    } else if (NegL || NegR) {
+      // Hoist the negation, so that an enclosing + or - can absorb it.
+      Expression *Prod = simplifyBinaryOp(new BinaryOp(Opc, NegL ? NegL : L,
+                                                       NegR ? NegR : R));
+      return new BinaryOp(BinaryOp::SUB, new FP32Constant(0.0f), Prod);
+    }
+    break;
+  }
+
+  return reassociate(Op);
+}
+
+Expression *ExprSimplifier::reassociate(BinaryOp *Op) {
+  BinaryOp     *Inner = dyn_cast<BinaryOp>(Op->getLHS());
+  ConstantExpr *C2    = dyn_cast<ConstantExpr>(Op->getRHS());
+  if (!Inner || !C2) return Op;
+
+  ConstantExpr *C1 = dyn_cast<ConstantExpr>(Inner->getRHS());
+  if (!C1) return Op;
+
+  BinaryOp::Operator Outer     = Op->getOperator();
+  BinaryOp::Operator In        = Inner->getOperator();
+  bool               OuterAdd  = Outer == BinaryOp::ADD ||
+                                 Outer == BinaryOp::SUB;
+  bool               InnerAdd  = In == BinaryOp::ADD || In == BinaryOp::SUB;
+  BinaryOp::Operator NewOpc    = In;
+  ConstantExpr      *C         = NULL;
+
+  if (OuterAdd != InnerAdd) {
+    return Op;
+  }
+
+  if (OuterAdd) {
+    // (x+c1)+c2 = x+(c1+c2), (x+c1)-c2 = x+(c1-c2), and likewise for x-c1.
+    C = fold(In == Outer ? BinaryOp::ADD : BinaryOp::SUB, C1, C2);
+  } else if (In == Outer) {
+    // (x*c1)*c2 = x*(c1*c2), (x/c1)/c2 = x/(c1*c2).
+    C = fold(BinaryOp::MUL, C1, C2);
+  } else {
+    // (x*c1)/c2 = x*(c1/c2), (x/c1)*c2 = x*(c2/c1).
+    NewOpc = BinaryOp::MUL;
+    C      = In == BinaryOp::MUL ? fold(BinaryOp::DIV, C1, C2)
+                                 : fold(BinaryOp::DIV, C2, C1);
+  }
+
+  if (!C) return Op;
+  return simplifyBinaryOp(new BinaryOp(NewOpc, Inner->getLHS(), C));
+}
+
+ConstantExpr *ExprSimplifier::fold(BinaryOp::Operator Op,
+                                   const ConstantExpr *L,
+                                   const ConstantExpr *R) const {
+  const IntConstant *LI = dyn_cast<IntConstant>(L);
+  const IntConstant *RI = dyn_cast<IntConstant>(R);
+  double             A  = getValue(L);
+  double             B  = getValue(R);
+
+  if (Op == BinaryOp::DIV && B == 0.0) {
+    return NULL;
+  }
+
+  if (LI && RI) {
+    // C evaluates these in integer arithmetic, while the interpreter and the
+    // JIT use floating-point arithmetic.  Fold when both agree.
+    long long X      = LI->getValue();
+    long long Y      = RI->getValue();
+    long long Res    = 0;
+    bool      Folded = true;
+
+    switch (Op) {
+    case BinaryOp::ADD: Res = X + Y; break;
+    case BinaryOp::SUB: Res = X - Y; break;
+    case BinaryOp::MUL: Res = X * Y; break;
+    case BinaryOp::DIV:
+      Folded = X % Y == 0;
+      Res    = Folded ? X / Y : 0;
+      break;
+    }
+
+    if (Folded && isExactInFloat(Res)) {
+      return new IntConstant((int)Res);
+    }
+    if (!FastMath) {
+      return NULL;
+    }
+  } else if (!FastMath && ((LI && !isExactInFloat(LI->getValue())) ||
+                           (RI && !isExactInFloat(RI->getValue())))) {
+    return NULL;
+  }
+
+  float Res = 0.0f;
+
+  if (FastMath) {
+    double D = 0.0;
+    switch (Op) {
+    case BinaryOp::ADD: D = A + B; break;
+    case BinaryOp::SUB: D = A - B; break;
+    case BinaryOp::MUL: D = A * B; break;
+    case BinaryOp::DIV: D = A / B; break;
+    }
+    Res = (float)D;
+  } else {
+    // Single-precision arithmetic, exactly as in the generated code.
+    float X = (float)A;
+    float Y = (float)B;
+    switch (Op) {
+    case BinaryOp::ADD: Res = X + Y; break;
+    case BinaryOp::SUB: Res = X - Y; break;
+    case BinaryOp::MUL: Res = X * Y; break;
+    case BinaryOp::DIV: Res = X / Y; break;
+    }
+  }
+
+  // Infinities and NaNs have no literal in the generated code.
+  if (Res != Res || Res > FLT_MAX || Res < -FLT_MAX) {
+    return NULL;
+  }
+
+  return new FP32Constant(Res);
+}
+
+}
@@ -0,0 +1,326 @@
+/*
+ * TuningDB.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: TuningDB.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Core/TuningDB.h"
+#include "overtile/Core/Expressions.h"
+#include "overtile/Core/Field.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Grid.h"
+#include "overtile/Core/Types.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
+#include <cstdlib>
+#include <map>
+
+using namespace llvm;
+
+namespace overtile {
+
+namespace {
+
+/// Normalizer - Writes a program with fields and parameters numbered in
+/// declaration order instead of named.
+class Normalizer {
+public:
+  Normalizer(const Grid *G, raw_ostream &O)
+    : OS(O) {
+    const std::list<Field*> &Fields = G->getFieldList();
+    for (std::list<Field*>::const_iterator I = Fields.begin(),
+           E = Fields.end(); I != E; ++I) {
+      FieldIndices.insert(std::make_pair(*I, FieldIndices.size()));
+    }
+
+    typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+    const ParamList &Params = G->getParameters();
+    for (ParamList::const_iterator I = Params.begin(), E = Params.end();
+         I != E; ++I) {
+      ParamIndices.insert(std::make_pair(I->first, ParamIndices.size()));
+    }
+  }
+
+  void printGrid(const Grid *G) {
+    OS << "grid " << G->getNumDimensions() << ";";
+
+    const std::list<Field*> &Fields = G->getFieldList();
+    for (std::list<Field*>::const_iterator I = Fields.begin(),
+           E = Fields.end(); I != E; ++I) {
+      OS << "field " << (*I)->getElementType()->getTypeName() << " "
+         << (*I)->getCopySemantic() << ";";
+    }
+
+    typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+    const ParamList &Params = G->getParameters();
+    for (ParamList::const_iterator I = Params.begin(), E = Params.end();
+         I != E; ++I) {
+      OS << "param " << I->second->getTypeName() << ";";
+    }
+
+    const std::list<Function*> &Functions = G->getFunctionList();
+    for (std::list<Function*>::const_iterator I = Functions.begin(),
+           E = Functions.end(); I != E; ++I) {
+      OS << "f" << FieldIndices[(*I)->getOutput()] << "=";
+
+      const std::list<BoundedFunction> &BFuncs = (*I)->getBoundedFunctions();
+      for (std::list<BoundedFunction>::const_iterator BI = BFuncs.begin(),
+             BE = BFuncs.end(); BI != BE; ++BI) {
+        OS << "@";
+        for (unsigned i = 0, e = BI->Bounds.size(); i != e; ++i) {
+          const FunctionBound &B = BI->Bounds[i];
+          OS << "[" << B.LowerBound.Base << "-" << B.LowerBound.Constant << ":"
+             << B.UpperBound.Base << "-" << B.UpperBound.Constant << "]";
+        }
+        OS << ":";
+        printExpr(BI->Expr);
+      }
+      OS << ";";
+    }
+  }
+
+  void printExpr(const Expression *Expr) {
+    if (const BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+      static const char Ops[] = { '+', '-', '*', '/' };
+      OS << "(";
+      printExpr(Op->getLHS());
+      OS << Ops[Op->getOperator()];
+      printExpr(Op->getRHS());
+      OS << ")";
+    } else if (const FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+      const std::vector<Expression*> &Params = FC->getParameters();
+      OS << FC->getName() << "(";
+      for (unsigned i = 0, e = Params.size(); i != e; ++i) {
+        if (i != 0) OS << ",";
+        printExpr(Params[i]);
+      }
+      OS << ")";
+    } else if (const FieldRef *Ref = dyn_cast<FieldRef>(Expr)) {
+      const std::vector<IntConstant*> &Offsets = Ref->getOffsets();
+      OS << "f" << FieldIndices[Ref->getField()];
+      for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
+        OS << "[" << Offsets[i]->getValue() << "]";
+      }
+    } else if (const IntConstant *IC = dyn_cast<IntConstant>(Expr)) {
+      OS << IC->getValue();
+    } else if (const FP32Constant *FC = dyn_cast<FP32Constant>(Expr)) {
+      OS << format("%.9g", FC->getValue());
+    } else if (const PlaceHolderExpr *PH = dyn_cast<PlaceHolderExpr>(Expr)) {
+      std::map<std::string, unsigned>::iterator I =
+        ParamIndices.find(PH->getName().str());
+      if (I != ParamIndices.end()) {
+        OS << "p" << I->second;
+      } else {
+        OS << "$" << PH->getName();
+      }
+    } else {
+      report_fatal_error("Unhandled expression type");
+    }
+  }
+
+private:
+  raw_ostream                      &OS;
+  std::map<const Field*, unsigned>  FieldIndices;
+  std::map<std::string, unsigned>   ParamIndices;
+};
+
+/// parseList - Parses the comma-separated positive integers in \p Text
+/// into \p Values.  Returns false if there are none or one is invalid.
+bool parseList(StringRef Text, std::vector<unsigned> &Values) {
+  SmallVector<StringRef, 4> Comps;
+  Text.split(Comps, ",");
+
+  Values.clear();
+  for (unsigned i = 0, e = Comps.size(); i != e; ++i) {
+    unsigned V;
+    if (Comps[i].getAsInteger(10, V) || V == 0) {
+      return false;
+    }
+    Values.push_back(V);
+  }
+  return !Values.empty();
+}
+
+void printList(const std::vector<unsigned> &Values, raw_ostream &OS) {
+  for (unsigned i = 0, e = Values.size(); i != e; ++i) {
+    OS << (i == 0 ? "" : ",") << Values[i];
+  }
+}
+
+}
+
+TuningEntry::TuningEntry()
+  : SizeBucket(0), Time(1) {
+}
+
+std::string TuningEntry::getAttributes() const {
+  std::string        Ret;
+  raw_string_ostream OS(Ret);
+
+  OS << "block:";
+  printList(Block, OS);
+  OS << " tile:";
+  printList(Elements, OS);
+  OS << " time:" << Time;
+  return OS.str();
+}
+
+std::string TuningDB::getGridHash(const Grid *G) {
+  std::string        Text;
+  raw_string_ostream OS(Text);
+  Normalizer(G, OS).printGrid(G);
+  OS.flush();
+
+  // 64-bit FNV-1a
+  uint64_t Hash = 14695981039346656037ULL;
+  for (unsigned i = 0, e = Text.size(); i != e; ++i) {
+    Hash ^= (unsigned char)Text[i];
+    Hash *= 1099511628211ULL;
+  }
+
+  std::string        Ret;
+  raw_string_ostream RetOS(Ret);
+  RetOS << format("%016llx", (unsigned long long)Hash);
+  return RetOS.str();
+}
+
+int TuningDB::getSizeBucket(uint64_t Points) {
+  int Bucket = 0;
+  while (Points > 1) {
+    Points >>= 1;
+    ++Bucket;
+  }
+  return Bucket;
+}
+
+bool TuningDB::parse(StringRef Text, std::string &Err) {
+  SmallVector<StringRef, 16> Lines;
+  Text.split(Lines, "\n");
+
+  for (unsigned l = 0, le = Lines.size(); l != le; ++l) {
+    StringRef Line    = Lines[l];
+    StringRef Comment;
+    size_t    Hash    = Line.find('#');
+    if (Hash != StringRef::npos) {
+      Comment = Line.substr(Hash+1).trim();
+      Line    = Line.substr(0, Hash);
+    }
+
+    SmallVector<StringRef, 8> Cols;
+    SplitString(Line, Cols, " \t\r");
+    if (Cols.empty()) continue;
+
+    std::string Where = "line " + utostr(l+1) + ": ";
+    if (Cols.size() != 7) {
+      Err = Where + "expected 'hash target machine size block: tile: time:'";
+      return false;
+    }
+
+    TuningEntry E;
+    E.Hash    = Cols[0];
+    E.Target  = Cols[1];
+    E.Machine = Cols[2] == "-" ? "" : Cols[2].str();
+    E.Program = Comment;
+    if (Cols[3].getAsInteger(10, E.SizeBucket) || E.SizeBucket < 0) {
+      Err = Where + "size bucket must be a non-negative integer";
+      return false;
+    }
+
+    bool HasBlock = false, HasTile = false, HasTime = false;
+    for (unsigned c = 4; c != 7; ++c) {
+      std::vector<unsigned> Values;
+      std::pair<StringRef, StringRef> KV = Cols[c].split(':');
+      if (!parseList(KV.second, Values)) {
+        Err = Where + "'" + Cols[c].str() + "' needs positive integers";
+        return false;
+      }
+      if (KV.first == "block") {
+        E.Block  = Values;
+        HasBlock = true;
+      } else if (KV.first == "tile") {
+        E.Elements = Values;
+        HasTile    = true;
+      } else if (KV.first == "time" && Values.size() == 1) {
+        E.Time  = Values[0];
+        HasTime = true;
+      } else {
+        Err = Where + "unknown attribute '" + Cols[c].str() + "'";
+        return false;
+      }
+    }
+    if (!HasBlock || !HasTile || !HasTime) {
+      Err = Where + "expected block:, tile:, and time: attributes";
+      return false;
+    }
+    insert(E);
+  }
+  return true;
+}
+
+void TuningDB::print(raw_ostream &OS) const {
+  for (unsigned i = 0, e = Entries.size(); i != e; ++i) {
+    const TuningEntry &E = Entries[i];
+    OS << E.Hash << " " << E.Target << " "
+       << (E.Machine.empty() ? "-" : E.Machine) << " " << E.SizeBucket << " "
+       << E.getAttributes();
+    if (!E.Program.empty()) {
+      OS << "  # " << E.Program;
+    }
+    OS << "\n";
+  }
+}
+
+const TuningEntry *TuningDB::lookup(StringRef Hash, StringRef Target,
+                                    StringRef Machine, int SizeBucket) const {
+  const TuningEntry *Best = NULL;
+
+  for (unsigned i = 0, e = Entries.size(); i != e; ++i) {
+    const TuningEntry &E = Entries[i];
+    if (E.Hash != Hash || E.Target != Target || E.Machine != Machine) {
+      continue;
+    }
+    if (!Best) {
+      Best = &E;
+    } else if (SizeBucket < 0) {
+      if (E.SizeBucket > Best->SizeBucket) Best = &E;
+    } else {
+      int Dist     = std::abs(E.SizeBucket - SizeBucket);
+      int BestDist = std::abs(Best->SizeBucket - SizeBucket);
+      if (Dist < BestDist ||
+          (Dist == BestDist && E.SizeBucket > Best->SizeBucket)) {
+        Best = &E;
+      }
+    }
+  }
+  return Best;
+}
+
+void TuningDB::insert(const TuningEntry &E) {
+  for (unsigned i = 0, e = Entries.size(); i != e; ++i) {
+    TuningEntry &Old = Entries[i];
+    if (Old.Hash == E.Hash && Old.Target == E.Target &&
+        Old.Machine == E.Machine && Old.SizeBucket == E.SizeBucket) {
+      Old = E;
+      return;
+    }
+  }
+  Entries.push_back(E);
+}
+
+}
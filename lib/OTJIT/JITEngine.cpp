@@ -0,0 +1,828 @@
+/*
+ * JITEngine.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: JITEngine.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/JIT/JITEngine.h"
+#include "overtile/Core/ExprDAG.h"
+#include "overtile/Core/Expressions.h"
+#include "overtile/Core/Field.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Grid.h"
+#include "overtile/Core/MathBuiltins.h"
+#include "overtile/Core/Reciprocals.h"
+#include "overtile/Core/Simplify.h"
+#include "overtile/Core/Types.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Intrinsics.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/PassManager.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/JIT.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include <map>
+#include <set>
+
+using namespace llvm;
+
+namespace overtile {
+
+namespace {
+
+/// LoopState - Bookkeeping for a counted loop built with beginLoop/endLoop.
+struct LoopState {
+  PHINode    *IV;
+  BasicBlock *Header;
+  BasicBlock *Exit;
+};
+
+/**
+ * Lowers the functions of a grid to a single LLVM function with the
+ * canonical host signature.
+ *
+ * Every field that is written by some function gets two buffers.  A
+ * function reads the current buffers of all fields and writes the next
+ * buffer of its output field, after which the two are swapped.  This gives
+ * the same ordering as the tiled back-ends: fields already updated in the
+ * current time step are seen with their new values.
+ */
+class ProgramLowering {
+public:
+  ProgramLowering(JITEngine &E, Module *Mod);
+
+  /// lower - Returns the program, or NULL if it calls a function that the
+  /// JIT cannot lower, which getError() then describes.
+  llvm::Function *lower();
+
+  const std::string &getError() const { return Error; }
+
+private:
+
+  Type *getLLVMType(const ElementType *Ty);
+
+  LoopState beginLoop(Value *Lo, Value *Hi, const std::string &Name);
+  void endLoop(LoopState &L);
+
+  AllocaInst *createEntryAlloca(Type *Ty, const std::string &Name);
+  Value *emitMalloc(Value *Bytes, Type *PtrTy, const std::string &Name);
+  void emitFree(Value *Ptr);
+  Value *emitMin(Value *A, Value *B);
+  Value *emitMax(Value *A, Value *B);
+
+  Value *getBound(const BoundExpr &B, unsigned Dim);
+  Value *emitInBounds(const BoundedFunction &BF, unsigned FirstDim);
+
+  void emitFunction(overtile::Function *F);
+  void emitLoopNest(overtile::Function *F, unsigned Dim);
+  void emitRow(overtile::Function *F);
+  void emitPoints(overtile::Function *F, Value *Lo, Value *Hi, bool Interior);
+  void emitConvergenceCheck(const Field *CF, Value *Check, Value *NumPoints);
+
+  Value *emitExpr(Expression *Expr);
+  Value *emitExprNode(Expression *Expr);
+  Value *emitFieldRef(FieldRef *Ref);
+  Value *emitFunctionCall(FunctionCall *FC);
+  std::string getLibCallName(const MathBuiltin *MB);
+  Value *convert(Value *V, Type *Ty);
+
+  typedef std::map<const Field*, Value*> FieldValueMap;
+
+  JITEngine              &Engine;
+  Grid                   *G;
+  Module                 *M;
+  LLVMContext            &Ctx;
+  IRBuilder<>             Builder;
+  llvm::Function         *Program;
+  unsigned                NumDims;
+  Type                   *Int32Ty;
+  Type                   *Int64Ty;
+  Type                   *ComputeTy;
+  Value                  *TimeSteps;
+  Value                  *Tolerance;
+  Value                  *PointIndex;
+  Value                  *NextBase;
+  std::vector<Value*>     Dims;
+  std::vector<Value*>     Strides;
+  std::vector<Value*>     Point;
+  std::set<const Field*>  UpdatedFields;
+  FieldValueMap           HostPtrs;
+  FieldValueMap           CurSlots;
+  FieldValueMap           NextSlots;
+  FieldValueMap           Bases;
+  std::map<std::string, Value*> Params;
+  std::map<Expression*, Value*> ExprValues;
+  std::string             Error;
+};
+
+ProgramLowering::ProgramLowering(JITEngine &E, Module *Mod)
+  : Engine(E), G(E.getGrid()), M(Mod), Ctx(Mod->getContext()), Builder(Ctx),
+    Program(NULL), NumDims(G->getNumDimensions()), ComputeTy(NULL),
+    TimeSteps(NULL), Tolerance(NULL), PointIndex(NULL), NextBase(NULL) {
+  Int32Ty = Type::getInt32Ty(Ctx);
+  Int64Ty = Type::getInt64Ty(Ctx);
+  Point.resize(NumDims, NULL);
+}
+
+Type *ProgramLowering::getLLVMType(const ElementType *Ty) {
+  if (isa<FP32Type>(Ty)) {
+    return Type::getFloatTy(Ctx);
+  } else if (isa<FP64Type>(Ty)) {
+    return Type::getDoubleTy(Ctx);
+  } else {
+    report_fatal_error("Unknown type");
+  }
+}
+
+llvm::Function *ProgramLowering::lower() {
+  ExprSimplifier::simplifyGrid(G, Engine.getFastMath());
+  DivisionReducer::reduceGrid(G, Engine.getFastMath());
+  ExprDAG::canonicalizeGrid(G);
+
+  std::list<Field*>               Fields    = G->getFieldList();
+  std::list<overtile::Function*>  Functions = G->getFunctionList();
+  const Field                    *CF        = Engine.getConvergeField();
+
+  typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+  const ParamList GridParams = G->getParameters();
+
+  // Build the canonical prototype
+  std::vector<Type*> ArgTys;
+  ArgTys.push_back(Int32Ty);
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    ArgTys.push_back(PointerType::getUnqual(getLLVMType((*I)->getElementType())));
+  }
+  for (unsigned i = 0; i < NumDims; ++i) {
+    ArgTys.push_back(Int32Ty);
+  }
+  for (ParamList::const_iterator I = GridParams.begin(), E = GridParams.end();
+       I != E; ++I) {
+    ArgTys.push_back(getLLVMType(I->second));
+  }
+  if (CF) {
+    ArgTys.push_back(getLLVMType(CF->getElementType()));
+  }
+
+  Type *RetTy = CF ? Type::getInt1Ty(Ctx) : Type::getVoidTy(Ctx);
+
+  Program = llvm::Function::Create(FunctionType::get(RetTy, ArgTys, false),
+                                   GlobalValue::ExternalLinkage,
+                                   "ot_program_" + G->getName(), M);
+
+  llvm::Function::arg_iterator AI = Program->arg_begin();
+
+  TimeSteps = &*AI;
+  AI->setName("timesteps");
+  ++AI;
+
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I, ++AI) {
+    AI->setName("Host_" + (*I)->getName());
+    HostPtrs[*I] = &*AI;
+  }
+
+  std::vector<Value*> DimArgs;
+  for (unsigned i = 0; i < NumDims; ++i, ++AI) {
+    AI->setName("Dim_" + utostr(i));
+    DimArgs.push_back(&*AI);
+  }
+
+  for (ParamList::const_iterator I = GridParams.begin(), E = GridParams.end();
+       I != E; ++I, ++AI) {
+    AI->setName(I->first);
+    Params[I->first] = &*AI;
+  }
+
+  if (CF) {
+    AI->setName("Tolerance");
+    Tolerance = &*AI;
+  }
+
+  BasicBlock *Entry = BasicBlock::Create(Ctx, "entry", Program);
+  Builder.SetInsertPoint(Entry);
+
+  // Specialized dimensions are folded to constants, but we still make sure
+  // the caller agrees with them.
+  for (unsigned i = 0; i < NumDims; ++i) {
+    unsigned Size = Engine.getSpecializedDimension(i);
+    if (Size == 0) {
+      Dims.push_back(DimArgs[i]);
+      continue;
+    }
+
+    Value      *Expected = ConstantInt::get(Int32Ty, Size);
+    BasicBlock *Bad      = BasicBlock::Create(Ctx, "bad.dim", Program);
+    BasicBlock *Ok       = BasicBlock::Create(Ctx, "dim.ok", Program);
+
+    Builder.CreateCondBr(Builder.CreateICmpEQ(DimArgs[i], Expected), Ok, Bad);
+    Builder.SetInsertPoint(Bad);
+    Builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::trap));
+    Builder.CreateUnreachable();
+    Builder.SetInsertPoint(Ok);
+
+    Dims.push_back(Expected);
+  }
+
+  // Linear layout, dimension 0 is contiguous
+  Strides.push_back(ConstantInt::get(Int64Ty, 1));
+  for (unsigned i = 1; i < NumDims; ++i) {
+    Strides.push_back(Builder.CreateMul(Strides[i-1],
+                                        Builder.CreateSExt(Dims[i-1], Int64Ty),
+                                        "Stride_" + utostr(i)));
+  }
+  Value *NumPoints = Builder.CreateMul(Strides[NumDims-1],
+                                       Builder.CreateSExt(Dims[NumDims-1],
+                                                          Int64Ty),
+                                       "ArraySize");
+
+  for (std::list<overtile::Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    UpdatedFields.insert((*I)->getOutput());
+  }
+
+  // Allocate double buffers for the updated fields.  Fields that are only
+  // read are used in place.
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+
+    if (UpdatedFields.count(F) == 0) {
+      Bases[F] = HostPtrs[F];
+      continue;
+    }
+
+    Type  *PtrTy = PointerType::getUnqual(getLLVMType(F->getElementType()));
+    Value *Bytes = Builder.CreateMul(NumPoints,
+                     llvm::ConstantExpr::getSizeOf(getLLVMType(F->getElementType())));
+    Value *Cur   = emitMalloc(Bytes, PtrTy, F->getName() + "_In");
+    Value *Next  = emitMalloc(Bytes, PtrTy, F->getName() + "_Out");
+
+    Builder.CreateMemCpy(Cur, HostPtrs[F], Bytes, 1);
+
+    CurSlots[F]  = createEntryAlloca(PtrTy, F->getName() + "_InPtr");
+    NextSlots[F] = createEntryAlloca(PtrTy, F->getName() + "_OutPtr");
+    Builder.CreateStore(Cur, CurSlots[F]);
+    Builder.CreateStore(Next, NextSlots[F]);
+  }
+
+  // The convergence check compares the last two time steps, so keep a copy
+  // of the state before the last step.
+  Value *Check = NULL;
+  if (CF && UpdatedFields.count(CF) > 0) {
+    Type  *PtrTy = PointerType::getUnqual(getLLVMType(CF->getElementType()));
+    Value *Bytes = Builder.CreateMul(NumPoints,
+                     llvm::ConstantExpr::getSizeOf(getLLVMType(CF->getElementType())));
+    Check = emitMalloc(Bytes, PtrTy, "Check");
+    Builder.CreateMemCpy(Check, HostPtrs[CF], Bytes, 1);
+  }
+
+  LoopState TimeLoop = beginLoop(ConstantInt::get(Int32Ty, 0), TimeSteps, "t");
+
+  if (Check) {
+    Value *Bytes = Builder.CreateMul(NumPoints,
+                     llvm::ConstantExpr::getSizeOf(getLLVMType(CF->getElementType())));
+    Value *IsLast = Builder.CreateICmpEQ(TimeLoop.IV,
+                      Builder.CreateSub(TimeSteps, ConstantInt::get(Int32Ty, 1)));
+
+    BasicBlock *Save = BasicBlock::Create(Ctx, "save.check", Program);
+    BasicBlock *Cont = BasicBlock::Create(Ctx, "step", Program);
+
+    Builder.CreateCondBr(IsLast, Save, Cont);
+    Builder.SetInsertPoint(Save);
+    Builder.CreateMemCpy(Check, Builder.CreateLoad(CurSlots[CF]), Bytes, 1);
+    Builder.CreateBr(Cont);
+    Builder.SetInsertPoint(Cont);
+  }
+
+  for (std::list<overtile::Function*>::iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    emitFunction(*I);
+  }
+
+  endLoop(TimeLoop);
+
+  // Copy the results back and release the buffers
+  for (std::list<Field*>::iterator I = Fields.begin(), E = Fields.end();
+       I != E; ++I) {
+    Field *F = *I;
+
+    if (UpdatedFields.count(F) == 0) continue;
+
+    Value *Bytes = Builder.CreateMul(NumPoints,
+                     llvm::ConstantExpr::getSizeOf(getLLVMType(F->getElementType())));
+    Value *Cur   = Builder.CreateLoad(CurSlots[F]);
+    Value *Next  = Builder.CreateLoad(NextSlots[F]);
+
+    Builder.CreateMemCpy(HostPtrs[F], Cur, Bytes, 1);
+    emitFree(Cur);
+    emitFree(Next);
+  }
+
+  if (!CF) {
+    Builder.CreateRetVoid();
+  } else if (!Check) {
+    // The field never changes, so it has trivially converged.
+    Builder.CreateRet(ConstantInt::getTrue(Ctx));
+  } else {
+    emitConvergenceCheck(CF, Check, NumPoints);
+  }
+
+  return Error.empty() ? Program : NULL;
+}
+
+LoopState ProgramLowering::beginLoop(Value *Lo, Value *Hi,
+                                     const std::string &Name) {
+  LoopState   L;
+  BasicBlock *Pre  = Builder.GetInsertBlock();
+  BasicBlock *Body = BasicBlock::Create(Ctx, Name + ".body", Program);
+
+  L.Header = BasicBlock::Create(Ctx, Name + ".header", Program);
+  L.Exit   = BasicBlock::Create(Ctx, Name + ".exit", Program);
+
+  Builder.CreateBr(L.Header);
+  Builder.SetInsertPoint(L.Header);
+
+  L.IV = Builder.CreatePHI(Lo->getType(), 2, Name);
+  L.IV->addIncoming(Lo, Pre);
+
+  Builder.CreateCondBr(Builder.CreateICmpSLT(L.IV, Hi), Body, L.Exit);
+  Builder.SetInsertPoint(Body);
+
+  return L;
+}
+
+void ProgramLowering::endLoop(LoopState &L) {
+  Value *Next = Builder.CreateNSWAdd(L.IV, ConstantInt::get(L.IV->getType(), 1),
+                                     L.IV->getName() + ".next");
+  L.IV->addIncoming(Next, Builder.GetInsertBlock());
+  Builder.CreateBr(L.Header);
+  Builder.SetInsertPoint(L.Exit);
+}
+
+AllocaInst *ProgramLowering::createEntryAlloca(Type *Ty,
+                                               const std::string &Name) {
+  // Allocas must live in the entry block to be promoted to registers.
+  BasicBlock  &Entry = Program->getEntryBlock();
+  IRBuilder<>  EntryBuilder(&Entry, Entry.begin());
+  return EntryBuilder.CreateAlloca(Ty, 0, Name);
+}
+
+Value *ProgramLowering::emitMalloc(Value *Bytes, Type *PtrTy,
+                                   const std::string &Name) {
+  Type     *Int8PtrTy = Type::getInt8PtrTy(Ctx);
+  Constant *Malloc    = M->getOrInsertFunction("malloc",
+                          FunctionType::get(Int8PtrTy, Int64Ty, false));
+  Value    *Mem       = Builder.CreateCall(Malloc, Bytes);
+  return Builder.CreateBitCast(Mem, PtrTy, Name);
+}
+
+void ProgramLowering::emitFree(Value *Ptr) {
+  Type     *Int8PtrTy = Type::getInt8PtrTy(Ctx);
+  Constant *Free      = M->getOrInsertFunction("free",
+                          FunctionType::get(Type::getVoidTy(Ctx), Int8PtrTy,
+                                            false));
+  Builder.CreateCall(Free, Builder.CreateBitCast(Ptr, Int8PtrTy));
+}
+
+Value *ProgramLowering::emitMin(Value *A, Value *B) {
+  return Builder.CreateSelect(Builder.CreateICmpSLT(A, B), A, B);
+}
+
+Value *ProgramLowering::emitMax(Value *A, Value *B) {
+  return Builder.CreateSelect(Builder.CreateICmpSGT(A, B), A, B);
+}
+
+Value *ProgramLowering::getBound(const BoundExpr &B, unsigned Dim) {
+  if (B.Base == (unsigned)(-1)) {
+    return Builder.CreateSub(Dims[Dim],
+                             ConstantInt::get(Int32Ty, B.Constant + 1));
+  } else {
+    return ConstantInt::get(Int32Ty, B.Base + B.Constant);
+  }
+}
+
+Value *ProgramLowering::emitInBounds(const BoundedFunction &BF,
+                                     unsigned FirstDim) {
+  Value *Cond = ConstantInt::getTrue(Ctx);
+
+  for (unsigned i = FirstDim; i < NumDims; ++i) {
+    Value *Lo = getBound(BF.Bounds[i].LowerBound, i);
+    Value *Hi = getBound(BF.Bounds[i].UpperBound, i);
+    Cond = Builder.CreateAnd(Cond, Builder.CreateICmpSGE(Point[i], Lo));
+    Cond = Builder.CreateAnd(Cond, Builder.CreateICmpSLE(Point[i], Hi));
+  }
+
+  return Cond;
+}
+
+void ProgramLowering::emitFunction(overtile::Function *F) {
+  Field *Out = F->getOutput();
+
+  ComputeTy = getLLVMType(Out->getElementType());
+
+  for (FieldValueMap::iterator I = CurSlots.begin(), E = CurSlots.end();
+       I != E; ++I) {
+    Bases[I->first] = Builder.CreateLoad(I->second,
+                                         I->first->getName() + "_InPtr");
+  }
+  NextBase = Builder.CreateLoad(NextSlots[Out], Out->getName() + "_OutPtr");
+
+  emitLoopNest(F, NumDims-1);
+
+  // The freshly written buffer becomes the current one
+  Builder.CreateStore(NextBase, CurSlots[Out]);
+  Builder.CreateStore(Bases[Out], NextSlots[Out]);
+}
+
+void ProgramLowering::emitLoopNest(overtile::Function *F, unsigned Dim) {
+  if (Dim == 0) {
+    emitRow(F);
+    return;
+  }
+
+  LoopState L = beginLoop(ConstantInt::get(Int32Ty, 0), Dims[Dim],
+                          "i" + utostr(Dim));
+  Point[Dim] = L.IV;
+  emitLoopNest(F, Dim-1);
+  endLoop(L);
+}
+
+void ProgramLowering::emitRow(overtile::Function *F) {
+  const BoundedFunction &BF   = F->getBoundedFunctions().front();
+  Value                 *Zero = ConstantInt::get(Int32Ty, 0);
+
+  // Split the row into the range covered by the first bounded function,
+  // which is evaluated without any checks, and the remaining points on
+  // either side of it.
+  Value *RowIn = emitInBounds(BF, 1);
+  Value *Lo    = getBound(BF.Bounds[0].LowerBound, 0);
+  Value *Hi    = Builder.CreateAdd(getBound(BF.Bounds[0].UpperBound, 0),
+                                   ConstantInt::get(Int32Ty, 1));
+
+  Lo = emitMin(emitMax(Lo, Zero), Dims[0]);
+  Hi = emitMax(emitMin(Hi, Dims[0]), Lo);
+  Lo = Builder.CreateSelect(RowIn, Lo, Dims[0]);
+  Hi = Builder.CreateSelect(RowIn, Hi, Dims[0]);
+
+  emitPoints(F, Zero, Lo, false);
+  emitPoints(F, Lo, Hi, true);
+  emitPoints(F, Hi, Dims[0], false);
+}
+
+void ProgramLowering::emitPoints(overtile::Function *F, Value *Lo, Value *Hi,
+                                 bool Interior) {
+  const std::list<BoundedFunction> &BFuncs = F->getBoundedFunctions();
+  Field                            *Out    = F->getOutput();
+
+  LoopState L = beginLoop(Lo, Hi, Interior ? "i0.interior" : "i0");
+  Point[0] = L.IV;
+
+  PointIndex = Builder.CreateSExt(Point[0], Int64Ty);
+  for (unsigned i = 1; i < NumDims; ++i) {
+    PointIndex = Builder.CreateAdd(PointIndex,
+                   Builder.CreateMul(Builder.CreateSExt(Point[i], Int64Ty),
+                                     Strides[i]));
+  }
+
+  Value *Res;
+
+  if (Interior) {
+    ExprValues.clear();
+    Res = emitExpr(BFuncs.front().Expr);
+  } else {
+    // The first bounded function containing the point wins.  Points outside
+    // of all bounds keep their current value.
+    BasicBlock *Done = BasicBlock::Create(Ctx, "point.done", Program);
+
+    std::vector<std::pair<Value*, BasicBlock*> > Incoming;
+
+    for (std::list<BoundedFunction>::const_iterator I = BFuncs.begin(),
+           E = BFuncs.end(); I != E; ++I) {
+      BasicBlock *Then = BasicBlock::Create(Ctx, "bf.then", Program);
+      BasicBlock *Else = BasicBlock::Create(Ctx, "bf.else", Program);
+
+      Builder.CreateCondBr(emitInBounds(*I, 0), Then, Else);
+
+      Builder.SetInsertPoint(Then);
+      ExprValues.clear();
+      Value *V = emitExpr(I->Expr);
+      Incoming.push_back(std::make_pair(V, Builder.GetInsertBlock()));
+      Builder.CreateBr(Done);
+
+      Builder.SetInsertPoint(Else);
+    }
+
+    Value *Old = Builder.CreateLoad(Builder.CreateGEP(Bases[Out], PointIndex));
+    Incoming.push_back(std::make_pair(convert(Old, ComputeTy),
+                                      Builder.GetInsertBlock()));
+    Builder.CreateBr(Done);
+
+    Builder.SetInsertPoint(Done);
+    PHINode *Phi = Builder.CreatePHI(ComputeTy, Incoming.size(), "res");
+    for (unsigned i = 0, e = Incoming.size(); i != e; ++i) {
+      Phi->addIncoming(Incoming[i].first, Incoming[i].second);
+    }
+    Res = Phi;
+  }
+
+  Builder.CreateStore(Res, Builder.CreateGEP(NextBase, PointIndex));
+
+  endLoop(L);
+}
+
+void ProgramLowering::emitConvergenceCheck(const Field *CF, Value *Check,
+                                           Value *NumPoints) {
+  Value      *Converged = createEntryAlloca(Type::getInt1Ty(Ctx), "Converged");
+  Value      *Tol       = convert(Tolerance, getLLVMType(CF->getElementType()));
+  BasicBlock *Done      = BasicBlock::Create(Ctx, "check.done", Program);
+
+  Builder.CreateStore(ConstantInt::getTrue(Ctx), Converged);
+
+  LoopState L = beginLoop(ConstantInt::get(Int64Ty, 0), NumPoints, "check");
+
+  Value *Old  = Builder.CreateLoad(Builder.CreateGEP(Check, L.IV));
+  Value *New  = Builder.CreateLoad(Builder.CreateGEP(HostPtrs[CF], L.IV));
+  Value *Diff = Builder.CreateFSub(Old, New);
+  Value *Abs  = Builder.CreateSelect(
+                  Builder.CreateFCmpOLT(Diff, Constant::getNullValue(Diff->getType())),
+                  Builder.CreateFNeg(Diff), Diff);
+
+  BasicBlock *Fail = BasicBlock::Create(Ctx, "check.fail", Program);
+  BasicBlock *Cont = BasicBlock::Create(Ctx, "check.next", Program);
+
+  Builder.CreateCondBr(Builder.CreateFCmpOGT(Abs, Tol), Fail, Cont);
+
+  Builder.SetInsertPoint(Fail);
+  Builder.CreateStore(ConstantInt::getFalse(Ctx), Converged);
+  Builder.CreateBr(Done);
+
+  Builder.SetInsertPoint(Cont);
+  endLoop(L);
+  Builder.CreateBr(Done);
+
+  Builder.SetInsertPoint(Done);
+  emitFree(Check);
+  Builder.CreateRet(Builder.CreateLoad(Converged));
+}
+
+Value *ProgramLowering::emitExpr(Expression *Expr) {
+  // Shared subexpressions of the DAG are evaluated once per point.
+  std::map<Expression*, Value*>::iterator Memo = ExprValues.find(Expr);
+  if (Memo != ExprValues.end()) {
+    return Memo->second;
+  }
+
+  Value *V = emitExprNode(Expr);
+  if (!Expr->getBindingName().empty() && isa<Instruction>(V)) {
+    V->setName(Expr->getBindingName());
+  }
+  ExprValues[Expr] = V;
+  return V;
+}
+
+Value *ProgramLowering::emitExprNode(Expression *Expr) {
+  if (BinaryOp *Op = dyn_cast<BinaryOp>(Expr)) {
+    Value *LHS = emitExpr(Op->getLHS());
+    Value *RHS = emitExpr(Op->getRHS());
+    switch (Op->getOperator()) {
+    default: llvm_unreachable("Unhandled binary operator");
+    case BinaryOp::ADD: return Builder.CreateFAdd(LHS, RHS);
+    case BinaryOp::SUB: return Builder.CreateFSub(LHS, RHS);
+    case BinaryOp::MUL: return Builder.CreateFMul(LHS, RHS);
+    case BinaryOp::DIV: return Builder.CreateFDiv(LHS, RHS);
+    }
+  } else if (FieldRef *Ref = dyn_cast<FieldRef>(Expr)) {
+    return emitFieldRef(Ref);
+  } else if (FunctionCall *FC = dyn_cast<FunctionCall>(Expr)) {
+    return emitFunctionCall(FC);
+  } else if (IntConstant *C = dyn_cast<IntConstant>(Expr)) {
+    return ConstantFP::get(ComputeTy, (double)C->getValue());
+  } else if (FP32Constant *C = dyn_cast<FP32Constant>(Expr)) {
+    return ConstantFP::get(ComputeTy, C->getStringValue());
+  } else if (PlaceHolderExpr *PH = dyn_cast<PlaceHolderExpr>(Expr)) {
+    std::map<std::string, Value*>::iterator I = Params.find(PH->getName().str());
+    if (I == Params.end()) {
+      report_fatal_error("Unknown parameter '" + PH->getName() + "'");
+    }
+    return convert(I->second, ComputeTy);
+  } else {
+    report_fatal_error("Unhandled expression in JITEngine");
+  }
+}
+
+Value *ProgramLowering::emitFieldRef(FieldRef *Ref) {
+  Field                           *F       = Ref->getField();
+  const std::vector<IntConstant*> &Offsets = Ref->getOffsets();
+
+  Value *Idx = PointIndex;
+  for (unsigned i = 0, e = Offsets.size(); i != e; ++i) {
+    int Off = Offsets[i]->getValue();
+    if (Off == 0) continue;
+    Idx = Builder.CreateAdd(Idx,
+                            Builder.CreateMul(ConstantInt::get(Int64Ty, Off,
+                                                               true),
+                                              Strides[i]));
+  }
+
+  Value *V = Builder.CreateLoad(Builder.CreateGEP(Bases[F], Idx),
+                                F->getName());
+  return convert(V, ComputeTy);
+}
+
+Value *ProgramLowering::emitFunctionCall(FunctionCall *FC) {
+  const std::vector<Expression*> &Exprs = FC->getParameters();
+
+  // Grids built without the parser may call anything, so the call is checked
+  // here.  The first bad call is reported and the rest of the program is
+  // still lowered, with an undefined value for the call.
+  const MathBuiltin *MB = lookupMathBuiltin(FC->getName());
+  if (!MB || MB->Arity != Exprs.size()) {
+    if (Error.empty()) {
+      raw_string_ostream ErrStr(Error);
+      if (!MB) {
+        ErrStr << "Function '" << FC->getName()
+               << "' is not a known math function";
+      } else {
+        ErrStr << "Function '" << FC->getName() << "' takes " << MB->Arity
+               << (MB->Arity == 1 ? " argument" : " arguments");
+      }
+    }
+    return UndefValue::get(ComputeTy);
+  }
+
+  std::string Name = getLibCallName(MB);
+
+  std::vector<Value*> Args;
+  for (unsigned i = 0, e = Exprs.size(); i != e; ++i) {
+    Args.push_back(emitExpr(Exprs[i]));
+  }
+
+  std::vector<Type*> ArgTys(Args.size(), ComputeTy);
+  Constant *Callee = M->getOrInsertFunction(Name,
+                       FunctionType::get(ComputeTy, ArgTys, false));
+
+  Value *Call = Builder.CreateCall(Callee, Args);
+  if (MB->Reciprocal) {
+    return Builder.CreateFDiv(ConstantFP::get(ComputeTy, 1.0), Call);
+  }
+  return Call;
+}
+
+/// getLibCallName - Returns the C library function that computes \p MB in
+/// the compute type, e.g. sqrtf for any of sqrt, sqrtf, and __sqrtf in
+/// single precision.  Reciprocals call the function they invert.
+std::string ProgramLowering::getLibCallName(const MathBuiltin *MB) {
+  std::string Name = MB->LibName;
+  if (ComputeTy->isFloatTy()) {
+    Name += "f";
+  }
+  return Name;
+}
+
+Value *ProgramLowering::convert(Value *V, Type *Ty) {
+  if (V->getType() == Ty) {
+    return V;
+  } else if (V->getType()->isFloatTy()) {
+    return Builder.CreateFPExt(V, Ty);
+  } else {
+    return Builder.CreateFPTrunc(V, Ty);
+  }
+}
+
+}
+
+
+JITEngine::JITEngine(Grid *G)
+  : BackEnd(G), DimSizes(G->getNumDimensions(), 0), OptLevel(3),
+    Context(NULL), Engine(NULL), EntryPoint(NULL) {
+}
+
+JITEngine::~JITEngine() {
+  // The engine owns the module, which must go before its context.
+  delete Engine;
+  delete Context;
+}
+
+void JITEngine::specializeDimension(unsigned Dim, unsigned Size) {
+  if (Dim < DimSizes.size()) {
+    DimSizes[Dim] = Size;
+  }
+}
+
+void JITEngine::codegen(llvm::raw_ostream &OS) {
+  LLVMContext       Ctx;
+  std::string       Err;
+  OwningPtr<Module> M(buildModule(Ctx, Err));
+
+  if (!M) {
+    report_fatal_error(Err);
+  }
+
+  optimizeModule(M.get());
+  M->print(OS, 0);
+}
+
+void *JITEngine::compile(std::string &ErrMsg) {
+  if (EntryPoint) {
+    return EntryPoint;
+  }
+
+  InitializeNativeTarget();
+
+  if (!Context) {
+    Context = new LLVMContext();
+  }
+
+  Module *M = buildModule(*Context, ErrMsg);
+  if (!M) {
+    return NULL;
+  }
+
+  Engine = EngineBuilder(M)
+             .setErrorStr(&ErrMsg)
+             .setEngineKind(EngineKind::JIT)
+             .setOptLevel(OptLevel > 2 ? CodeGenOpt::Aggressive
+                                       : CodeGenOpt::Default)
+             .create();
+  if (!Engine) {
+    delete M;
+    return NULL;
+  }
+
+  optimizeModule(M);
+
+  llvm::Function *Program = M->getFunction("ot_program_" + getGrid()->getName());
+  EntryPoint = Engine->getPointerToFunction(Program);
+  return EntryPoint;
+}
+
+Module *JITEngine::buildModule(LLVMContext &Ctx, std::string &ErrMsg) {
+  Module          *M = new Module("ot_" + getGrid()->getName(), Ctx);
+  ProgramLowering  Lowering(*this, M);
+
+  if (!Lowering.lower()) {
+    ErrMsg = Lowering.getError();
+    delete M;
+    return NULL;
+  }
+
+  std::string Err;
+  if (verifyModule(*M, ReturnStatusAction, &Err)) {
+    report_fatal_error("JITEngine produced invalid IR: " + Err);
+  }
+
+  return M;
+}
+
+void JITEngine::optimizeModule(Module *M) {
+  PassManagerBuilder  PMBuilder;
+  FunctionPassManager FPM(M);
+  PassManager         MPM;
+
+  PMBuilder.OptLevel = OptLevel;
+
+  if (Engine) {
+    FPM.add(new TargetData(*Engine->getTargetData()));
+    MPM.add(new TargetData(*Engine->getTargetData()));
+  }
+
+  PMBuilder.populateFunctionPassManager(FPM);
+  PMBuilder.populateModulePassManager(MPM);
+
+  FPM.doInitialization();
+  for (Module::iterator I = M->begin(), E = M->end(); I != E; ++I) {
+    FPM.run(*I);
+  }
+  FPM.doFinalization();
+
+  MPM.run(*M);
+}
+
+}
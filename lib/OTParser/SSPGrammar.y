@@ -30,8 +30,10 @@
 #include "overtile/Core/Field.h"
 #include "overtile/Core/Function.h"
 #include "overtile/Core/Grid.h"
+#include "overtile/Core/MathBuiltins.h"
 #include "overtile/Core/Types.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Casting.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 #include <iostream>
@@ -60,6 +62,7 @@ void SSPerror(SSPParser*, const char*);
   overtile::BoundExpr BExpr;
   overtile::FunctionBound FuncBound;
   overtile::BoundedFunction *FuncExpr;
+  overtile::Field::CopySemantic CopySem;
 }
 
 %token AT
@@ -102,6 +105,7 @@ void SSPerror(SSPParser*, const char*);
 %type<BExpr> bound_expr
 %type<FuncExprList> func_expr_list;
 %type<FuncExpr> func_expr;
+%type<CopySem> copy_semantic
 
 %%
 
@@ -157,6 +161,7 @@ field_def
     }
     
     Field *F = new Field(G, $3, $2->str());
+    F->setCopySemantic($4);
   }
 ;
 
@@ -252,8 +257,16 @@ expression
     $$ = $1;
   }
 | LET IDENT EQUALS expression IN expression {
-    $$ = $6;
-    $$->replacePlaceHolder(*$2, $4);    
+    // The value is shared by all uses of the binding, not copied.
+    $4->setBindingName(*$2);
+
+    PlaceHolderExpr *PH = dyn_cast<PlaceHolderExpr>($6);
+    if (PH && PH->getName() == *$2) {
+      $$ = $4;
+    } else {
+      $$ = $6;
+      $$->replacePlaceHolder(*$2, $4);
+    }
   }
 ;
 
@@ -295,6 +308,22 @@ unary_expr
     $$ = new FP32Constant($1);
   }
 | IDENT OPENPARENS expr_list CLOSEPARENS {
+    const MathBuiltin *MB = lookupMathBuiltin(*$1);
+
+    if (MB == NULL || MB->Arity != $3->size()) {
+      std::string        Msg;
+      raw_string_ostream MsgStr(Msg);
+      if (MB == NULL) {
+        MsgStr << "Function '" << (*$1) << "' is not a known math function";
+      } else {
+        MsgStr << "Function '" << (*$1) << "' takes " << MB->Arity
+               << (MB->Arity == 1 ? " argument" : " arguments");
+      }
+      MsgStr.flush();
+      yyerror(Parser, Msg.c_str());
+      YYERROR;
+    }
+
     std::reverse($3->begin(), $3->end());
     $$ = new FunctionCall(*$1, *$3);
     delete $3;
@@ -376,9 +405,15 @@ type
 ;
 
 copy_semantic
-: INOUT
-| IN
-| OUT
+: INOUT {
+    $$ = Field::CopyInOut;
+  }
+| IN {
+    $$ = Field::CopyIn;
+  }
+| OUT {
+    $$ = Field::CopyOut;
+  }
 ;
 
 %%
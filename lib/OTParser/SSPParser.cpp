@@ -19,6 +19,7 @@
 
 #include "overtile/Core/Error.h"
 #include "overtile/Core/Expressions.h"
+#include "overtile/Core/Field.h"
 #include "overtile/Core/Function.h"
 #include "overtile/Core/Types.h"
 #include "overtile/Parser/SSPParser.h"
@@ -0,0 +1,526 @@
+/*
+ * Runtime.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: Runtime.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Runtime/Runtime.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+const unsigned CacheLine = 64;
+
+/// Granularity of the parts of a buffer placed by the workers.
+const size_t PageSize = 4096;
+
+/// Number of polls of the task generation before an idle worker blocks.
+const int SpinCount = 1 << 16;
+
+/// TileRange - The tiles [Begin, End) still owned by one worker.  Padded to
+/// a cache line so that workers do not contend on each other's ranges.
+struct TileRange {
+  volatile long Begin;
+  volatile long End;
+  volatile int  Lock;
+  char          Pad[CacheLine - 2*sizeof(long) - sizeof(int)];
+};
+
+/// WorkerSense - The local sense of one worker for the barrier.
+struct WorkerSense {
+  volatile int Sense;
+  char         Pad[CacheLine - sizeof(int)];
+};
+
+struct Pool {
+  int               NumWorkers;
+  pthread_t        *Threads;
+
+  // Task dispatch.  Idle workers poll Generation for a while and then sleep
+  // on Wake.
+  pthread_mutex_t   Mutex;
+  pthread_cond_t    Wake;
+  volatile unsigned Generation;
+  volatile int      Sleeping;
+  volatile int      Quit;
+  ot_rt_task        Task;
+  void             *Arg;
+  volatile int      Running;
+
+  // Sense-reversing barrier.
+  volatile int      BarrierCount;
+  volatile int      BarrierSense;
+  WorkerSense      *Senses;
+
+  // Work-stealing tile queue.
+  TileRange        *Ranges;
+
+  // Buffer returned by ot_rt_shared().
+  void             *Shared;
+  size_t            SharedSize;
+};
+
+Pool           *ThePool = 0;
+pthread_mutex_t InitMutex = PTHREAD_MUTEX_INITIALIZER;
+
+inline void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__("pause" ::: "memory");
+#endif
+}
+
+/// backoff - Waits a little while polling.  Yields the core once the wait
+/// gets long, in case there are more workers than cores.
+inline void backoff(int &Spins) {
+  if (++Spins < 1024)
+    cpuRelax();
+  else
+    sched_yield();
+}
+
+inline void acquire(volatile int *Lock) {
+  int Spins = 0;
+  while (__sync_lock_test_and_set(Lock, 1)) {
+    while (*Lock)
+      backoff(Spins);
+  }
+}
+
+inline void release(volatile int *Lock) {
+  __sync_lock_release(Lock);
+}
+
+template <typename T>
+T *allocLines(int Count) {
+  void *Ptr = 0;
+  if (posix_memalign(&Ptr, CacheLine, sizeof(T)*Count) != 0)
+    abort();
+  memset(Ptr, 0, sizeof(T)*Count);
+  return static_cast<T*>(Ptr);
+}
+
+/// CPUInfo - The location of a logical CPU in the machine.
+struct CPUInfo {
+  int CPU;
+  int Package;
+  int Core;
+
+  bool operator<(const CPUInfo &RHS) const {
+    if (Package != RHS.Package) return Package < RHS.Package;
+    if (Core != RHS.Core) return Core < RHS.Core;
+    return CPU < RHS.CPU;
+  }
+};
+
+int readTopology(int CPU, const char *Name) {
+  char Path[128];
+  snprintf(Path, sizeof(Path), "/sys/devices/system/cpu/cpu%d/topology/%s",
+           CPU, Name);
+  int   Value = -1;
+  FILE *File  = fopen(Path, "r");
+  if (File) {
+    if (fscanf(File, "%d", &Value) != 1)
+      Value = -1;
+    fclose(File);
+  }
+  return Value;
+}
+
+/// computePlacement - Chooses the CPU of every worker, or -1 to leave a
+/// worker unpinned.  Consecutive workers initially own neighboring tiles and
+/// the memory under them (see ot_rt_alloc()), so they are kept on the same
+/// socket.  Workers are spread evenly over the physical cores before any
+/// hyper-threads are used.
+void computePlacement(int NumWorkers, int *CPUs) {
+  for (int w = 0; w < NumWorkers; ++w)
+    CPUs[w] = -1;
+
+  const char *Env = getenv("OT_PIN_THREADS");
+  if (Env && atoi(Env) == 0)
+    return;
+
+#ifdef __linux__
+  cpu_set_t Mask;
+  if (sched_getaffinity(0, sizeof(Mask), &Mask) != 0)
+    return;
+
+  std::vector<CPUInfo> All;
+  for (int c = 0; c < CPU_SETSIZE; ++c) {
+    if (!CPU_ISSET(c, &Mask))
+      continue;
+    CPUInfo Info;
+    Info.CPU     = c;
+    Info.Package = readTopology(c, "physical_package_id");
+    Info.Core    = readTopology(c, "core_id");
+    if (Info.Package < 0) Info.Package = 0;
+    if (Info.Core < 0) Info.Core = c;
+    All.push_back(Info);
+  }
+  if (All.empty())
+    return;
+  std::sort(All.begin(), All.end());
+
+  // The first hyper-thread of every physical core
+  std::vector<CPUInfo> Primary;
+  for (size_t i = 0; i < All.size(); ++i) {
+    if (i == 0 || All[i].Package != All[i-1].Package ||
+        All[i].Core != All[i-1].Core)
+      Primary.push_back(All[i]);
+  }
+
+  const std::vector<CPUInfo> &Candidates =
+    NumWorkers <= (int)Primary.size() ? Primary : All;
+  for (int w = 0; w < NumWorkers; ++w) {
+    size_t Index = (size_t)((long long)w*Candidates.size()/NumWorkers);
+    CPUs[w] = Candidates[Index].CPU;
+  }
+#endif
+}
+
+void pinThread(pthread_t Thread, int CPU) {
+  if (CPU < 0)
+    return;
+#ifdef __linux__
+  cpu_set_t Set;
+  CPU_ZERO(&Set);
+  CPU_SET(CPU, &Set);
+  pthread_setaffinity_np(Thread, sizeof(Set), &Set);
+#else
+  (void)Thread;
+#endif
+}
+
+int defaultNumWorkers() {
+  const char *Env = getenv("OT_NUM_THREADS");
+  if (Env) {
+    int N = atoi(Env);
+    if (N > 0)
+      return N;
+  }
+  long NumCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+  return NumCPUs > 0 ? (int)NumCPUs : 1;
+}
+
+void *workerMain(void *Arg) {
+  int      Worker = (int)(long)Arg;
+  Pool    *P      = ThePool;
+  unsigned Seen   = 0;
+
+  for (;;) {
+    // New tasks usually follow quickly, so spin for a while before going to
+    // sleep.
+    for (int i = 0; i < SpinCount; ++i) {
+      if (P->Generation != Seen || P->Quit)
+        break;
+      cpuRelax();
+    }
+    if (P->Generation == Seen && !P->Quit) {
+      pthread_mutex_lock(&P->Mutex);
+      ++P->Sleeping;
+      while (P->Generation == Seen && !P->Quit)
+        pthread_cond_wait(&P->Wake, &P->Mutex);
+      --P->Sleeping;
+      pthread_mutex_unlock(&P->Mutex);
+    }
+    if (P->Quit)
+      break;
+
+    Seen = P->Generation;
+    __sync_synchronize();
+    P->Task(P->Arg, Worker);
+    __sync_fetch_and_sub(&P->Running, 1);
+  }
+  return 0;
+}
+
+/// CopyTask - A copy, or a zeroing if Src is null, split over the workers.
+struct CopyTask {
+  char       *Dst;
+  const char *Src;
+  size_t      Bytes;
+};
+
+/// partBegin - Returns the offset of the part of a buffer of \p Bytes bytes
+/// that is first touched by \p Worker.  Worker w gets the w-th of
+/// NumWorkers equal parts, rounded to pages, which is where the tiles it
+/// initially owns in a loop over the outermost dimension live.
+size_t partBegin(size_t Bytes, int Worker, int NumWorkers) {
+  if (Worker >= NumWorkers)
+    return Bytes;
+  size_t Begin = (size_t)((unsigned long long)Bytes*Worker/NumWorkers);
+  return Begin & ~(PageSize-1);
+}
+
+void copyPart(void *Arg, int Worker) {
+  CopyTask *Task  = static_cast<CopyTask*>(Arg);
+  int       N     = ThePool->NumWorkers;
+  size_t    Begin = partBegin(Task->Bytes, Worker, N);
+  size_t    End   = partBegin(Task->Bytes, Worker+1, N);
+
+  if (End <= Begin)
+    return;
+  if (Task->Src)
+    memcpy(Task->Dst + Begin, Task->Src + Begin, End - Begin);
+  else
+    memset(Task->Dst + Begin, 0, End - Begin);
+}
+
+}
+
+extern "C" {
+
+void ot_rt_init(int NumWorkers) {
+  pthread_mutex_lock(&InitMutex);
+  if (ThePool) {
+    pthread_mutex_unlock(&InitMutex);
+    return;
+  }
+
+  if (NumWorkers <= 0)
+    NumWorkers = defaultNumWorkers();
+
+  Pool *P         = new Pool();
+  P->NumWorkers   = NumWorkers;
+  P->Threads      = new pthread_t[NumWorkers];
+  pthread_mutex_init(&P->Mutex, 0);
+  pthread_cond_init(&P->Wake, 0);
+  P->Generation   = 0;
+  P->Sleeping     = 0;
+  P->Quit         = 0;
+  P->Task         = 0;
+  P->Arg          = 0;
+  P->Running      = 0;
+  P->BarrierCount = 0;
+  P->BarrierSense = 0;
+  P->Senses       = allocLines<WorkerSense>(NumWorkers);
+  P->Ranges       = allocLines<TileRange>(NumWorkers);
+  P->Shared       = 0;
+  P->SharedSize   = 0;
+  ThePool         = P;
+
+  // Only the threads of the pool are pinned.  The calling thread is worker
+  // 0, but its affinity belongs to the application, so CPUs[0] is left for
+  // it without pinning it there.
+  int *CPUs = new int[NumWorkers];
+  computePlacement(NumWorkers, CPUs);
+  for (int w = 1; w < NumWorkers; ++w) {
+    pthread_create(&P->Threads[w], 0, workerMain, (void*)(long)w);
+    pinThread(P->Threads[w], CPUs[w]);
+  }
+  delete [] CPUs;
+
+  atexit(ot_rt_shutdown);
+  pthread_mutex_unlock(&InitMutex);
+}
+
+void ot_rt_shutdown(void) {
+  pthread_mutex_lock(&InitMutex);
+  Pool *P = ThePool;
+  if (!P) {
+    pthread_mutex_unlock(&InitMutex);
+    return;
+  }
+
+  pthread_mutex_lock(&P->Mutex);
+  P->Quit = 1;
+  pthread_cond_broadcast(&P->Wake);
+  pthread_mutex_unlock(&P->Mutex);
+
+  for (int w = 1; w < P->NumWorkers; ++w)
+    pthread_join(P->Threads[w], 0);
+
+  pthread_cond_destroy(&P->Wake);
+  pthread_mutex_destroy(&P->Mutex);
+  free(P->Senses);
+  free(P->Ranges);
+  free(P->Shared);
+  delete [] P->Threads;
+  delete P;
+  ThePool = 0;
+  pthread_mutex_unlock(&InitMutex);
+}
+
+int ot_rt_num_workers(void) {
+  ot_rt_init(0);
+  return ThePool->NumWorkers;
+}
+
+void ot_rt_run(ot_rt_task Task, void *Arg) {
+  ot_rt_init(0);
+  Pool *P = ThePool;
+
+  if (P->NumWorkers == 1) {
+    Task(Arg, 0);
+    return;
+  }
+
+  P->Task    = Task;
+  P->Arg     = Arg;
+  P->Running = P->NumWorkers - 1;
+  __sync_synchronize();
+
+  pthread_mutex_lock(&P->Mutex);
+  ++P->Generation;
+  if (P->Sleeping)
+    pthread_cond_broadcast(&P->Wake);
+  pthread_mutex_unlock(&P->Mutex);
+
+  Task(Arg, 0);
+
+  int Spins = 0;
+  while (P->Running > 0)
+    backoff(Spins);
+  __sync_synchronize();
+}
+
+void ot_rt_barrier(int Worker) {
+  Pool *P = ThePool;
+  if (P->NumWorkers == 1)
+    return;
+
+  int Sense = !P->Senses[Worker].Sense;
+  P->Senses[Worker].Sense = Sense;
+
+  if (__sync_add_and_fetch(&P->BarrierCount, 1) == P->NumWorkers) {
+    P->BarrierCount = 0;
+    __sync_synchronize();
+    P->BarrierSense = Sense;
+  } else {
+    int Spins = 0;
+    while (P->BarrierSense != Sense)
+      backoff(Spins);
+  }
+  __sync_synchronize();
+}
+
+void ot_rt_tiles_reset(int Worker, long NumTiles) {
+  Pool *P = ThePool;
+  int   N = P->NumWorkers;
+
+  // Nobody may still be stealing from the previous loop.
+  ot_rt_barrier(Worker);
+
+  TileRange &Own = P->Ranges[Worker];
+  acquire(&Own.Lock);
+  Own.Begin = NumTiles*Worker/N;
+  Own.End   = NumTiles*(Worker+1)/N;
+  release(&Own.Lock);
+
+  ot_rt_barrier(Worker);
+}
+
+long ot_rt_next_tile(int Worker) {
+  Pool      *P   = ThePool;
+  int        N   = P->NumWorkers;
+  TileRange &Own = P->Ranges[Worker];
+
+  acquire(&Own.Lock);
+  if (Own.Begin < Own.End) {
+    long Tile = Own.Begin++;
+    release(&Own.Lock);
+    return Tile;
+  }
+  release(&Own.Lock);
+
+  // Steal the upper half of the first non-empty range after our own.
+  for (int i = 1; i < N; ++i) {
+    TileRange &Victim = P->Ranges[(Worker+i) % N];
+    if (Victim.Begin >= Victim.End)
+      continue;
+
+    acquire(&Victim.Lock);
+    long Begin = Victim.Begin;
+    long End   = Victim.End;
+    if (Begin < End) {
+      long Mid   = End - (End-Begin+1)/2;
+      Victim.End = Mid;
+      release(&Victim.Lock);
+
+      acquire(&Own.Lock);
+      Own.Begin = Mid+1;
+      Own.End   = End;
+      release(&Own.Lock);
+      return Mid;
+    }
+    release(&Victim.Lock);
+  }
+
+  return -1;
+}
+
+void *ot_rt_shared(int Worker, size_t Bytes) {
+  Pool *P = ThePool;
+
+  ot_rt_barrier(Worker);
+  if (Worker == 0) {
+    if (Bytes > P->SharedSize) {
+      free(P->Shared);
+      P->Shared = 0;
+      if (posix_memalign(&P->Shared, CacheLine, Bytes) != 0)
+        abort();
+      P->SharedSize = Bytes;
+    }
+    memset(P->Shared, 0, Bytes);
+  }
+  ot_rt_barrier(Worker);
+
+  return P->Shared;
+}
+
+void *ot_rt_alloc(size_t Bytes) {
+  void *Ptr = 0;
+  if (posix_memalign(&Ptr, PageSize, Bytes ? Bytes : 1) != 0)
+    return 0;
+
+  CopyTask Task;
+  Task.Dst   = static_cast<char*>(Ptr);
+  Task.Src   = 0;
+  Task.Bytes = Bytes;
+  ot_rt_run(copyPart, &Task);
+  return Ptr;
+}
+
+void ot_rt_copy(void *Dst, const void *Src, size_t Bytes) {
+  CopyTask Task;
+  Task.Dst   = static_cast<char*>(Dst);
+  Task.Src   = static_cast<const char*>(Src);
+  Task.Bytes = Bytes;
+  ot_rt_run(copyPart, &Task);
+}
+
+size_t ot_rt_part(size_t Bytes, int Worker) {
+  return partBegin(Bytes, Worker, ot_rt_num_workers());
+}
+
+void ot_rt_free(void *Ptr) {
+  free(Ptr);
+}
+
+double ot_rt_wtime(void) {
+  struct timeval TV;
+  gettimeofday(&TV, 0);
+  return TV.tv_sec + TV.tv_usec*1e-6;
+}
+
+}
@@ -0,0 +1,89 @@
+// The cpu-omp code on the OverTile runtime, with an odd number of time steps
+// and one field written twice per step, so the buffer parity differs by field.
+// otsc-flags: -runtime
+// otsc-flags: -runtime -tiling=split
+// otsc-flags: -runtime -tiling=wavefront
+
+#include <cstdio>
+#include "utils.h"
+
+int main() {
+
+  const int Dim_0     = 500;
+  const int Dim_1     = 500;
+  const int TimeSteps = 101;
+  
+  // We want repeatable runs
+  srand(4242);
+
+  float *A    = new float[Dim_0*Dim_1];
+  float *RefA = new float[Dim_0*Dim_1];
+  float *B    = new float[Dim_0*Dim_1];
+  float *RefB = new float[Dim_0*Dim_1];
+
+  for (int i = 0; i < Dim_0*Dim_1; ++i) {
+    A[i] = RefA[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+    B[i] = RefB[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+  }
+
+
+  // Reference run, A is written twice and B once per time step
+  float *Temp = new float[Dim_0*Dim_1];
+  memcpy(Temp, RefA, sizeof(float)*Dim_0*Dim_1);
+
+  for (int t = 0; t < TimeSteps; ++t) {
+    for (int i = 1; i < Dim_0-1; ++i) {
+      for (int j = 1; j < Dim_1-1; ++j) {
+        REF_2D(Temp,i,j) = 0.2f * (REF_2D(RefA,i,j-1) + REF_2D(RefA,i,j) + REF_2D(RefA,i,j+1) + REF_2D(RefA,i-1,j) + REF_2D(RefA,i+1,j));
+      }
+    }
+    memcpy(RefA, Temp, sizeof(float)*Dim_0*Dim_1);
+    for (int i = 1; i < Dim_0-1; ++i) {
+      for (int j = 1; j < Dim_1-1; ++j) {
+        REF_2D(RefB,i,j) = 0.5f * (REF_2D(RefA,i,j) + REF_2D(RefB,i,j));
+      }
+    }
+    for (int i = 1; i < Dim_0-1; ++i) {
+      for (int j = 1; j < Dim_1-1; ++j) {
+        REF_2D(Temp,i,j) = 0.25f * (REF_2D(RefA,i,j-1) + REF_2D(RefA,i,j+1) + REF_2D(RefB,i-1,j) + REF_2D(RefB,i+1,j));
+      }
+    }
+    memcpy(RefA, Temp, sizeof(float)*Dim_0*Dim_1);
+  }
+
+  delete [] Temp;
+
+
+  // OT Run
+#pragma sdsl begin time_steps:TimeSteps block:32,4 tile:2,4 time:4
+  program j2druntime is
+  grid 2
+  field A float inout
+  field B float inout
+    A = 
+    @[1:$-1][1:$-1] : 0.2*(A[0][-1]+A[0][0]+A[0][1]+A[-1][0]+A[1][0])
+    B = 
+    @[1:$-1][1:$-1] : 0.5*(A[0][0]+B[0][0])
+    A = 
+    @[1:$-1][1:$-1] : 0.25*(A[0][-1]+A[0][1]+B[-1][0]+B[1][0])
+#pragma sdsl end
+
+
+  // Comparison
+  bool ResA = CompareResult(A, RefA, Dim_0*Dim_1);
+  bool ResB = CompareResult(B, RefB, Dim_0*Dim_1);
+
+  
+#ifdef PRINT
+  for (int i = 0; i < Dim_0; ++i) {
+    std::cout << "Res: " << A[i] << "  -  Ref: " << RefA[i] << "\n";
+  }
+#endif
+  
+  delete [] A;
+  delete [] RefA;
+  delete [] B;
+  delete [] RefB;
+  
+  return ((ResA && ResB) ? 0 : 1);
+}
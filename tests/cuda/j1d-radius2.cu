@@ -0,0 +1,59 @@
+
+#include <cstdio>
+#include "utils.h"
+
+int main() {
+
+  const int Dim_0     = 10000;
+  const int TimeSteps = 100;
+  
+  // We want repeatable runs
+  srand(4242);
+
+  float *A    = new float[Dim_0];
+  float *RefA = new float[Dim_0];
+
+  for (int i = 0; i < Dim_0; ++i) {
+    A[i] = RefA[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+  }
+
+
+  // Reference run
+  float *Temp = new float[Dim_0];
+  memcpy(Temp, RefA, sizeof(float)*Dim_0);
+  
+  for (int t = 0; t < TimeSteps; ++t) {
+    for (int i = 2; i < Dim_0-2; ++i) {
+      Temp[i] = 0.2f * (RefA[i-2] + RefA[i-1] + RefA[i] + RefA[i+1] + RefA[i+2]);
+    }
+    memcpy(RefA, Temp, sizeof(float)*Dim_0);
+  }
+
+  delete [] Temp;
+
+
+  // OT Run
+#pragma sdsl begin time_steps:TimeSteps block:64 tile:2 time:3
+  program j1dr2 is
+  grid 1
+  field A float inout
+    A = 
+    @[2:$-2] : 0.2*(A[-2]+A[-1]+A[0]+A[1]+A[2])
+#pragma sdsl end
+
+
+  // Comparison
+  bool Res = CompareResult(A, RefA, Dim_0);
+
+  
+#ifdef PRINT
+  for (int i = 0; i < Dim_0; ++i) {
+    std::cout << "Res: " << A[i] << "  -  Ref: " << RefA[i] << "\n";
+  }
+#endif
+  
+  delete [] A;
+  delete [] RefA;
+  
+  return (Res ? 0 : 1);
+}
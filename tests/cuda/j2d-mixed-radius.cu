@@ -0,0 +1,82 @@
+// Fields read at different radii: A at radius 2, B at radius 1 but only at
+// offset 0 by its own function, and the constant field F only at offset 0.
+
+#include <cstdio>
+#include "utils.h"
+
+int main() {
+
+  const int Dim_0     = 500;
+  const int Dim_1     = 500;
+  const int TimeSteps = 100;
+  
+  // We want repeatable runs
+  srand(4242);
+
+  float *A    = new float[Dim_0*Dim_1];
+  float *RefA = new float[Dim_0*Dim_1];
+  float *B    = new float[Dim_0*Dim_1];
+  float *RefB = new float[Dim_0*Dim_1];
+  float *F    = new float[Dim_0*Dim_1];
+
+  for (int i = 0; i < Dim_0*Dim_1; ++i) {
+    A[i] = RefA[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+    B[i] = RefB[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+    F[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+  }
+
+
+  // Reference run
+  float *Temp = new float[Dim_0*Dim_1];
+  memcpy(Temp, RefA, sizeof(float)*Dim_0*Dim_1);
+
+  for (int t = 0; t < TimeSteps; ++t) {
+    for (int i = 2; i < Dim_0-2; ++i) {
+      for (int j = 2; j < Dim_1-2; ++j) {
+        REF_2D(Temp,i,j) = 0.1f * (REF_2D(RefA,i,j-2) + REF_2D(RefA,i,j-1) + REF_2D(RefA,i,j) + REF_2D(RefA,i,j+1) + REF_2D(RefA,i,j+2) + REF_2D(RefA,i-2,j) + REF_2D(RefA,i-1,j) + REF_2D(RefA,i+1,j) + REF_2D(RefA,i+2,j) + REF_2D(F,i,j));
+      }
+    }
+    memcpy(RefA, Temp, sizeof(float)*Dim_0*Dim_1);
+    for (int i = 1; i < Dim_0-1; ++i) {
+      for (int j = 1; j < Dim_1-1; ++j) {
+        REF_2D(RefB,i,j) = 0.5f * REF_2D(RefB,i,j) + 0.125f * (REF_2D(RefA,i,j-1) + REF_2D(RefA,i,j+1) + REF_2D(RefA,i-1,j) + REF_2D(RefA,i+1,j));
+      }
+    }
+  }
+
+  delete [] Temp;
+
+
+  // OT Run
+#pragma sdsl begin time_steps:TimeSteps block:32,8 tile:1,2 time:2
+  program j2dmixed is
+  grid 2
+  field A float inout
+  field B float inout
+  field F float in
+    A = 
+    @[2:$-2][2:$-2] : 0.1*(A[0][-2]+A[0][-1]+A[0][0]+A[0][1]+A[0][2]+A[-2][0]+A[-1][0]+A[1][0]+A[2][0]+F[0][0])
+    B = 
+    @[1:$-1][1:$-1] : 0.5*B[0][0]+0.125*(A[0][-1]+A[0][1]+A[-1][0]+A[1][0])
+#pragma sdsl end
+
+
+  // Comparison
+  bool ResA = CompareResult(A, RefA, Dim_0*Dim_1);
+  bool ResB = CompareResult(B, RefB, Dim_0*Dim_1);
+
+  
+#ifdef PRINT
+  for (int i = 0; i < Dim_0; ++i) {
+    std::cout << "Res: " << A[i] << "  -  Ref: " << RefA[i] << "\n";
+  }
+#endif
+  
+  delete [] A;
+  delete [] RefA;
+  delete [] B;
+  delete [] RefB;
+  delete [] F;
+  
+  return ((ResA && ResB) ? 0 : 1);
+}
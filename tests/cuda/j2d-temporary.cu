@@ -0,0 +1,81 @@
+// A rician-style pipeline: G is an 'in' field that every time step computes
+// from U before reading it, so it is a temporary and is never written back.
+
+#include <cstdio>
+#include "utils.h"
+
+int main() {
+
+  const int Dim_0     = 500;
+  const int Dim_1     = 500;
+  const int TimeSteps = 100;
+  
+  // We want repeatable runs
+  srand(4242);
+
+  float *U     = new float[Dim_0*Dim_1];
+  float *RefU  = new float[Dim_0*Dim_1];
+  float *G     = new float[Dim_0*Dim_1];
+  float *RefG  = new float[Dim_0*Dim_1];
+  float *InitG = new float[Dim_0*Dim_1];
+
+  for (int i = 0; i < Dim_0*Dim_1; ++i) {
+    U[i] = RefU[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+    G[i] = RefG[i] = InitG[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+  }
+
+
+  // Reference run, the boundary of G keeps its initial values
+  float *Temp = new float[Dim_0*Dim_1];
+  memcpy(Temp, RefU, sizeof(float)*Dim_0*Dim_1);
+
+  for (int t = 0; t < TimeSteps; ++t) {
+    for (int i = 1; i < Dim_0-1; ++i) {
+      for (int j = 1; j < Dim_1-1; ++j) {
+        float C = REF_2D(RefU,i,j);
+        REF_2D(RefG,i,j) = 1.0f / (1.0f + (C - REF_2D(RefU,i,j+1))*(C - REF_2D(RefU,i,j+1)) + (C - REF_2D(RefU,i,j-1))*(C - REF_2D(RefU,i,j-1)) + (C - REF_2D(RefU,i+1,j))*(C - REF_2D(RefU,i+1,j)) + (C - REF_2D(RefU,i-1,j))*(C - REF_2D(RefU,i-1,j)));
+      }
+    }
+    for (int i = 1; i < Dim_0-1; ++i) {
+      for (int j = 1; j < Dim_1-1; ++j) {
+        REF_2D(Temp,i,j) = (REF_2D(RefU,i,j) + 0.2f * (REF_2D(RefU,i,j+1)*REF_2D(RefG,i,j+1) + REF_2D(RefU,i,j-1)*REF_2D(RefG,i,j-1) + REF_2D(RefU,i+1,j)*REF_2D(RefG,i+1,j) + REF_2D(RefU,i-1,j)*REF_2D(RefG,i-1,j))) / (1.0f + 0.2f * (REF_2D(RefG,i,j+1) + REF_2D(RefG,i,j-1) + REF_2D(RefG,i+1,j) + REF_2D(RefG,i-1,j)));
+      }
+    }
+    memcpy(RefU, Temp, sizeof(float)*Dim_0*Dim_1);
+  }
+
+  delete [] Temp;
+
+
+  // OT Run
+#pragma sdsl begin time_steps:TimeSteps block:32,4 tile:2,4 time:2
+  program j2dtemp is
+  grid 2
+  field U float inout
+  field G float in
+    G = 
+    @[1:$-1][1:$-1] : 1.0/(1.0+(U[0][0]-U[0][1])*(U[0][0]-U[0][1])+(U[0][0]-U[0][-1])*(U[0][0]-U[0][-1])+(U[0][0]-U[1][0])*(U[0][0]-U[1][0])+(U[0][0]-U[-1][0])*(U[0][0]-U[-1][0]))
+    U = 
+    @[1:$-1][1:$-1] : (U[0][0]+0.2*(U[0][1]*G[0][1]+U[0][-1]*G[0][-1]+U[1][0]*G[1][0]+U[-1][0]*G[-1][0]))/(1.0+0.2*(G[0][1]+G[0][-1]+G[1][0]+G[-1][0]))
+#pragma sdsl end
+
+
+  // Comparison, G is 'in' and so is not copied back
+  bool ResU = CompareResult(U, RefU, Dim_0*Dim_1);
+  bool ResG = CompareResult(G, InitG, Dim_0*Dim_1);
+
+  
+#ifdef PRINT
+  for (int i = 0; i < Dim_0; ++i) {
+    std::cout << "Res: " << U[i] << "  -  Ref: " << RefU[i] << "\n";
+  }
+#endif
+  
+  delete [] U;
+  delete [] RefU;
+  delete [] G;
+  delete [] RefG;
+  delete [] InitG;
+  
+  return ((ResU && ResG) ? 0 : 1);
+}
@@ -0,0 +1,80 @@
+
+#include "overtile/Core/CostModel.h"
+#include "overtile/Parser/SSPParser.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include <iostream>
+
+using namespace overtile;
+using namespace llvm;
+
+// The let binding is counted once, w*2.0 reads no fields and is not
+// counted, and the boundary function of A is ignored.
+static const char *Source =
+  "program costs is\n"
+  "grid 2\n"
+  "param w float\n"
+  "field A float inout\n"
+  "field B double inout\n"
+  "  A = \n"
+  "  @[1:$-1][1:$-1] : let d = A[0][1] - A[0][-1] in d*d + w*2.0*A[0][0]\n"
+  "  @[0:$][0:$] : exp(A[0][0])\n"
+  "  B = \n"
+  "  @[1:$-1][1:$-1] : sqrt(B[0][0]) / (A[1][0] + 1.0)\n";
+
+// What otsc -print-cost writes for the program above.
+static const char *ExpectedCost =
+  "program: costs\n"
+  "functions:\n"
+  "  - output: A\n"
+  "    flops: 4\n"
+  "    weighted-flops: 4\n"
+  "    loads: 3\n"
+  "    stores: 1\n"
+  "    bytes-fp32: 8\n"
+  "    bytes-fp64: 0\n"
+  "    bytes: 8\n"
+  "    intensity: 0.5\n"
+  "  - output: B\n"
+  "    flops: 3\n"
+  "    weighted-flops: 9\n"
+  "    loads: 2\n"
+  "    stores: 1\n"
+  "    bytes-fp32: 4\n"
+  "    bytes-fp64: 16\n"
+  "    bytes: 20\n"
+  "    intensity: 0.45\n"
+  "total:\n"
+  "  flops: 7\n"
+  "  weighted-flops: 13\n"
+  "  loads: 5\n"
+  "  stores: 2\n"
+  "  bytes-fp32: 12\n"
+  "  bytes-fp64: 16\n"
+  "  bytes: 28\n"
+  "  intensity: 0.464286\n";
+
+int main() {
+  SourceMgr SM;
+  SSPParser P(MemoryBuffer::getMemBuffer(Source, "cost-model"), SM);
+  if (P.parseBuffer()) {
+    return 1;
+  }
+
+  std::string       Str;
+  raw_string_ostream OS(Str);
+  CostModel::print(P.getGrid(), OS);
+  OS.flush();
+
+  std::cout << Str;
+
+  if (Str != ExpectedCost) {
+    std::cout << "Expected:\n" << ExpectedCost;
+    std::cout << "FAIL!\n";
+    return 1;
+  }
+
+  std::cout << "OK\n";
+  return 0;
+}
@@ -0,0 +1,71 @@
+
+#include "overtile/Core/CudaBackEnd.h"
+#include "overtile/Core/PerfModel.h"
+#include "overtile/Core/ResourceCheck.h"
+#include "overtile/Parser/SSPParser.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include <iostream>
+
+using namespace overtile;
+using namespace llvm;
+
+// Offsets of -2 used to wrap the upper bound of the regions around, which
+// gave a huge right halo once the time tile had two or more steps.
+static const char *Source =
+  "program r2 is\n"
+  "grid 2\n"
+  "field A float inout\n"
+  "  A = \n"
+  "  @[2:$-2][2:$-2] : 0.2*(A[0][-2]+A[0][2]+A[0][0]+A[-2][0]+A[2][0])\n";
+
+/// checkHalos - Returns true if block BX x BY with time tile T has a halo of
+/// 2*(T-1) points on each side in both dimensions, and is feasible as
+/// expected.
+static bool checkHalos(unsigned BX, unsigned BY, unsigned T, bool Feasible) {
+  SourceMgr SM;
+  SSPParser P(MemoryBuffer::getMemBuffer(Source, "halo-radius2"), SM);
+  if (P.parseBuffer()) {
+    return false;
+  }
+
+  CudaBackEnd BE(P.getGrid());
+  BE.setBlockSize(0, BX);
+  BE.setBlockSize(1, BY);
+  BE.setTimeTileSize(T);
+  BE.run();
+
+  ResourceCheck RC(BE, NULL);
+  MachineModel  M;
+  PerfModel     PM(BE, M);
+
+  const KernelResources  &KR = RC.getKernels()[0];
+  const KernelPrediction &KP = PM.getKernels()[0];
+  const int               H  = 2*(T-1);
+  bool                    OK = RC.isFeasible() == Feasible &&
+                               KP.Invalid.empty() == Feasible;
+
+  for (unsigned i = 0; i < 2; ++i) {
+    OK = OK && KR.HaloLeft[i] == H && KR.HaloRight[i] == H &&
+         KP.HaloLeft[i] == H && KP.HaloRight[i] == H;
+  }
+
+  std::cout << "block:" << BX << "," << BY << " time:" << T
+            << " halo-left: " << KR.HaloLeft[0] << "," << KR.HaloLeft[1]
+            << " halo-right: " << KR.HaloRight[0] << "," << KR.HaloRight[1]
+            << " feasible: " << (RC.isFeasible() ? "true" : "false")
+            << (OK ? "  OK" : "  FAIL!") << "\n";
+  return OK;
+}
+
+int main() {
+  bool Res = true;
+
+  Res = checkHalos(32, 8, 1, true) && Res;
+  Res = checkHalos(32, 8, 2, true) && Res;
+  Res = checkHalos(32, 4, 2, false) && Res;
+  Res = checkHalos(32, 8, 3, false) && Res;
+  Res = checkHalos(32, 16, 3, true) && Res;
+
+  return (Res ? 0 : 1);
+}
@@ -0,0 +1,137 @@
+
+#include "overtile/Core/Interpreter.h"
+#include "overtile/Parser/SSPParser.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include <algorithm>
+#include <cstdio>
+#include "utils.h"
+
+using namespace overtile;
+using namespace llvm;
+
+// Float spellings of the built-ins, including the reciprocal rsqrtf.
+static const char *Source1D =
+  "program interpmath is\n"
+  "grid 1\n"
+  "field A float inout\n"
+  "field B float in\n"
+  "  A = \n"
+  "  @[1:$-1] : 0.25*(A[-1]+A[1]) + 0.1*sqrtf(B[0]) + 0.1*rsqrtf(B[0]+1.0)"
+  " + 0.1*fminf(A[0], B[0]) + 0.1*expf(0.0-fabsf(A[0]))\n";
+
+// A parameter, and a second bounded function for the points that the first
+// does not cover, over many time steps.
+static const char *Source2D =
+  "program interpj2d is\n"
+  "grid 2\n"
+  "param w float\n"
+  "field A float inout\n"
+  "  A = \n"
+  "  @[1:$-1][1:$-1] : w*(A[0][-1]+A[0][0]+A[0][1]+A[-1][0]+A[1][0])\n"
+  "  @[0:$][0:$] : A[0][0]\n";
+
+static bool runInterpreter(const char *Source, int TimeSteps,
+                           void *const *Fields, const int *Dims,
+                           const double *Params) {
+  SourceMgr SM;
+  SSPParser P(MemoryBuffer::getMemBuffer(Source, "interp-math"), SM);
+  if (P.parseBuffer()) {
+    return false;
+  }
+
+  Interpreter I(P.getGrid());
+  I.run();
+  I.execute(TimeSteps, Fields, Dims, Params);
+  return true;
+}
+
+int main() {
+
+  // We want repeatable runs
+  srand(4242);
+
+
+  // 1D program with math functions
+  const int Dim_0     = 10000;
+  const int TimeSteps = 10;
+
+  float *A    = new float[Dim_0];
+  float *B    = new float[Dim_0];
+  float *RefA = new float[Dim_0];
+
+  for (int i = 0; i < Dim_0; ++i) {
+    A[i] = RefA[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+    B[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+  }
+
+  float *Temp = new float[Dim_0];
+  memcpy(Temp, RefA, sizeof(float)*Dim_0);
+
+  for (int t = 0; t < TimeSteps; ++t) {
+    for (int i = 1; i < Dim_0-1; ++i) {
+      Temp[i] = 0.25f*(RefA[i-1] + RefA[i+1]) + 0.1f*std::sqrt(B[i])
+        + 0.1f/std::sqrt(B[i]+1.0f) + 0.1f*std::min(RefA[i], B[i])
+        + 0.1f*std::exp(-std::fabs(RefA[i]));
+    }
+    memcpy(RefA, Temp, sizeof(float)*Dim_0);
+  }
+
+  delete [] Temp;
+
+  void *Fields1D[] = { A, B };
+  int   Dims1D[]   = { Dim_0 };
+  if (!runInterpreter(Source1D, TimeSteps, Fields1D, Dims1D, NULL)) {
+    return 1;
+  }
+
+  bool Res = CompareResult(A, RefA, Dim_0);
+
+  delete [] A;
+  delete [] B;
+  delete [] RefA;
+
+
+  // 2D program with a parameter
+  const int Dim2_0     = 200;
+  const int Dim2_1     = 100;
+  const int TimeSteps2 = 50;
+  const int N          = Dim2_0*Dim2_1;
+
+  float *C    = new float[N];
+  float *RefC = new float[N];
+
+  for (int i = 0; i < N; ++i) {
+    C[i] = RefC[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+  }
+
+  Temp = new float[N];
+  memcpy(Temp, RefC, sizeof(float)*N);
+
+  for (int t = 0; t < TimeSteps2; ++t) {
+    for (int j = 1; j < Dim2_1-1; ++j) {
+      for (int i = 1; i < Dim2_0-1; ++i) {
+        Temp[j*Dim2_0+i] = 0.2f*(RefC[j*Dim2_0+i-1] + RefC[j*Dim2_0+i] +
+                                 RefC[j*Dim2_0+i+1] + RefC[(j-1)*Dim2_0+i] +
+                                 RefC[(j+1)*Dim2_0+i]);
+      }
+    }
+    memcpy(RefC, Temp, sizeof(float)*N);
+  }
+
+  delete [] Temp;
+
+  void   *Fields2D[] = { C };
+  int     Dims2D[]   = { Dim2_0, Dim2_1 };
+  double  Params2D[] = { 0.2 };
+  if (!runInterpreter(Source2D, TimeSteps2, Fields2D, Dims2D, Params2D)) {
+    return 1;
+  }
+
+  Res = CompareResult(C, RefC, N) && Res;
+
+  delete [] C;
+  delete [] RefC;
+
+  return (Res ? 0 : 1);
+}
@@ -0,0 +1,118 @@
+
+#include "overtile/Core/Expressions.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Grid.h"
+#include "overtile/JIT/JITEngine.h"
+#include "overtile/Parser/SSPParser.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include <algorithm>
+#include <cstdio>
+#include "utils.h"
+
+using namespace overtile;
+using namespace llvm;
+
+// Every spelling of a built-in must reach the C library function of the
+// compute type, e.g. both sqrtf and rsqrt call sqrtf.
+static const char *Source =
+  "program jitmath is\n"
+  "grid 1\n"
+  "field A float inout\n"
+  "field B float in\n"
+  "  A = \n"
+  "  @[1:$-1] : 0.25*(A[-1]+A[1]) + 0.1*sqrtf(B[0]) + 0.1*rsqrt(B[0]+1.0)"
+  " + 0.1*fmin(A[0], B[0]) + 0.1*expf(0.0-fabs(A[0]))\n";
+
+typedef void (*ProgramTy)(int, float*, float*, int);
+
+int main() {
+
+  const int Dim_0     = 10000;
+  const int TimeSteps = 10;
+
+  // We want repeatable runs
+  srand(4242);
+
+  float *A    = new float[Dim_0];
+  float *B    = new float[Dim_0];
+  float *RefA = new float[Dim_0];
+
+  for (int i = 0; i < Dim_0; ++i) {
+    A[i] = RefA[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+    B[i] = (float)rand() / (float)(RAND_MAX + 1.0f);
+  }
+
+
+  // Reference run
+  float *Temp = new float[Dim_0];
+  memcpy(Temp, RefA, sizeof(float)*Dim_0);
+
+  for (int t = 0; t < TimeSteps; ++t) {
+    for (int i = 1; i < Dim_0-1; ++i) {
+      Temp[i] = 0.25f*(RefA[i-1] + RefA[i+1]) + 0.1f*std::sqrt(B[i])
+        + 0.1f/std::sqrt(B[i]+1.0f) + 0.1f*std::min(RefA[i], B[i])
+        + 0.1f*std::exp(-std::fabs(RefA[i]));
+    }
+    memcpy(RefA, Temp, sizeof(float)*Dim_0);
+  }
+
+  delete [] Temp;
+
+
+  // OT Run
+  SourceMgr SM;
+  SSPParser P(MemoryBuffer::getMemBuffer(Source, "jit-math"), SM);
+  if (P.parseBuffer()) {
+    return 1;
+  }
+
+  JITEngine JE(P.getGrid());
+  JE.run();
+
+  std::string Err;
+  ProgramTy   Prog = reinterpret_cast<ProgramTy>(JE.compile(Err));
+  if (!Prog) {
+    std::cout << "Compile error: " << Err << "\n";
+    std::cout << "FAIL!\n";
+    return 1;
+  }
+
+  Prog(TimeSteps, A, B, Dim_0);
+
+
+  // Comparison
+  bool Res = CompareResult(A, RefA, Dim_0);
+
+
+  // Grids built through the API are not checked by the parser, so the JIT
+  // must reject calls to unknown functions itself.
+  SourceMgr SM2;
+  SSPParser P2(MemoryBuffer::getMemBuffer(Source, "jit-math"), SM2);
+  if (P2.parseBuffer()) {
+    return 1;
+  }
+
+  Grid                       *G    = P2.getGrid();
+  std::list<BoundedFunction> &BFs  =
+    G->getFunctionList().front()->getBoundedFunctions();
+  std::vector<Expression*>    Args(1, BFs.front().Expr);
+  BFs.front().Expr = new FunctionCall("frobnicate", Args);
+
+  JITEngine BadJE(G);
+  BadJE.run();
+
+  Err.clear();
+  if (BadJE.compile(Err) != NULL ||
+      Err.find("frobnicate") == std::string::npos) {
+    std::cout << "Unknown function not diagnosed\n";
+    std::cout << "FAIL!\n";
+    Res = false;
+  }
+
+  delete [] A;
+  delete [] B;
+  delete [] RefA;
+
+  return (Res ? 0 : 1);
+}
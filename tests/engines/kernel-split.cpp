@@ -0,0 +1,100 @@
+
+#include "overtile/Core/CudaBackEnd.h"
+#include "overtile/Core/ResourceCheck.h"
+#include "overtile/Parser/SSPParser.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include <iostream>
+
+using namespace overtile;
+using namespace llvm;
+
+static const char *Source =
+  "program fdtd2d is\n"
+  "grid 2\n"
+  "field Ex float inout\n"
+  "field Ey float inout\n"
+  "field Hz float inout\n"
+  "  Ey = \n"
+  "  @[1:$][0:$] : Ey[0][0] - 0.5*(Hz[0][0] - Hz[-1][0])\n"
+  "  Ex = \n"
+  "  @[0:$][1:$] : Ex[0][0] - 0.5*(Hz[0][0] - Hz[0][-1])\n"
+  "  Hz = \n"
+  "  @[0:$-1][0:$-1] : Hz[0][0] - 0.7*(Ex[0][1] - Ex[0][0] + Ey[1][0]"
+  " - Ey[0][0])\n";
+
+/// checkPartition - Returns true if the kernels of \p BE under a scratch
+/// budget of \p Budget bytes are \p NumKernels kernels with time tile size
+/// \p Time, the requested time tile size of 4 is kept, and a warning is
+/// given exactly if the configuration changed.
+static bool checkPartition(CudaBackEnd &BE, unsigned Budget,
+                           unsigned NumKernels, unsigned Time) {
+  BE.setScratchBudget(Budget);
+  BE.retile();
+
+  ResourceCheck RC(BE, NULL);
+  bool          Changed = NumKernels != 1 || Time != 4;
+  bool          OK      = BE.getKernels().size() == NumKernels &&
+                          BE.getTimeTileSize() == Time &&
+                          BE.getRequestedTimeTileSize() == 4 &&
+                          RC.getWarnings().empty() == !Changed;
+
+  for (unsigned k = 0, e = BE.getKernels().size(); k != e; ++k) {
+    OK = OK && (Budget == 0 || BE.getKernelScratchBytes(k) <= Budget);
+  }
+
+  std::cout << "budget: " << Budget << " kernels: " << BE.getKernels().size()
+            << " time: " << BE.getTimeTileSize() << " scratch: "
+            << BE.getKernelScratchBytes(0);
+  if (!RC.getWarnings().empty()) {
+    std::cout << " (" << RC.getWarnings()[0] << ")";
+  }
+  std::cout << (OK ? "  OK" : "  FAIL!") << "\n";
+  return OK;
+}
+
+int main() {
+  SourceMgr SM;
+  SSPParser P(MemoryBuffer::getMemBuffer(Source, "kernel-split"), SM);
+  if (P.parseBuffer()) {
+    return 1;
+  }
+
+  CudaBackEnd BE(P.getGrid());
+  BE.setBlockSize(0, 32);
+  BE.setBlockSize(1, 4);
+  BE.setElements(1, 4);
+  BE.setTimeTileSize(4);
+  BE.setScratchBudget(0);
+  BE.run();
+
+  // Scratch of the fused kernel for each time tile size
+  uint64_t Fused[5];
+  for (unsigned T = 1; T <= 4; ++T) {
+    BE.setTimeTileSize(T);
+    BE.retile();
+    Fused[T] = BE.getKernelScratchBytes(0);
+  }
+  BE.setTimeTileSize(4);
+
+  bool Res = true;
+
+  Res = checkPartition(BE, 0, 1, 4) && Res;
+  Res = checkPartition(BE, Fused[4], 1, 4) && Res;
+
+  // The largest time tile that fits keeps the functions fused
+  for (unsigned T = 3; T >= 1; --T) {
+    if (Fused[T] < Fused[T+1]) {
+      Res = checkPartition(BE, Fused[T+1]-1, 1, T) && Res;
+      break;
+    }
+  }
+
+  // Only split if a time tile size of 1 does not fit either
+  Res = checkPartition(BE, Fused[1]-1, 2, 1) && Res;
+
+  // The requested time tile size is back once the budget allows it
+  Res = checkPartition(BE, 0, 1, 4) && Res;
+
+  return (Res ? 0 : 1);
+}
@@ -0,0 +1,88 @@
+
+#include "overtile/Core/CudaBackEnd.h"
+#include "overtile/Core/PerfModel.h"
+#include "overtile/Parser/SSPParser.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include <iostream>
+
+using namespace overtile;
+using namespace llvm;
+
+static const char *Source =
+  "program j2d is\n"
+  "grid 2\n"
+  "field A float inout\n"
+  "  A = \n"
+  "  @[1:$-1][1:$-1] : 0.2*(A[0][-1]+A[0][0]+A[0][1]+A[-1][0]+A[1][0])\n";
+
+// What otsc -predict writes for the program above with block:32,4 tile:1,4
+// time:2 on the default machine.
+static const char *ExpectedPrediction =
+  "{\n"
+  "  \"program\": \"j2d\",\n"
+  "  \"machine\": \"fermi\",\n"
+  "  \"block\": [32, 4],\n"
+  "  \"elements\": [1, 4],\n"
+  "  \"time-tile\": 2,\n"
+  "  \"valid\": true,\n"
+  "  \"gstencils\": 32.4464,\n"
+  "  \"kernels\": [\n"
+  "    {\n"
+  "      \"functions\": [\"A\"],\n"
+  "      \"valid\": true,\n"
+  "      \"halo-left\": [1, 1],\n"
+  "      \"halo-right\": [1, 1],\n"
+  "      \"threads-per-block\": 128,\n"
+  "      \"useful-points-per-block\": 420,\n"
+  "      \"computed-points-per-block\": 512,\n"
+  "      \"redundant-compute-ratio\": 0.179688,\n"
+  "      \"scratch-bytes\": 2448,\n"
+  "      \"registers\": 25,\n"
+  "      \"spills\": false,\n"
+  "      \"blocks-per-multiprocessor\": 8,\n"
+  "      \"occupancy\": 0.666667,\n"
+  "      \"flops-per-point\": 6.09524,\n"
+  "      \"on-chip-loads-per-point\": 6.09524,\n"
+  "      \"global-loads-per-point\": 0.609524,\n"
+  "      \"global-stores-per-point\": 0.5,\n"
+  "      \"global-bytes-per-point\": 4.4381,\n"
+  "      \"bound\": \"memory\"\n"
+  "    }\n"
+  "  ]\n"
+  "}\n";
+
+int main() {
+  SourceMgr SM;
+  SSPParser P(MemoryBuffer::getMemBuffer(Source, "perf-model"), SM);
+  if (P.parseBuffer()) {
+    return 1;
+  }
+
+  CudaBackEnd BE(P.getGrid());
+  BE.setBlockSize(0, 32);
+  BE.setBlockSize(1, 4);
+  BE.setElements(1, 4);
+  BE.setTimeTileSize(2);
+  BE.run();
+
+  MachineModel Machine;
+  PerfModel    Model(BE, Machine);
+
+  std::string       Str;
+  raw_string_ostream OS(Str);
+  Model.print(OS);
+  OS.flush();
+
+  std::cout << Str;
+
+  if (Str != ExpectedPrediction || !Model.isValid()) {
+    std::cout << "Expected:\n" << ExpectedPrediction;
+    std::cout << "FAIL!\n";
+    return 1;
+  }
+
+  std::cout << "OK\n";
+  return 0;
+}
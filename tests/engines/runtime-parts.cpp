@@ -0,0 +1,84 @@
+
+#include "overtile/Runtime/Runtime.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static const int    NumWorkers = 4;
+static const size_t PageSize   = 4096;
+
+static bool check(bool Cond, const char *What) {
+  std::cout << What << (Cond ? "  OK" : "  FAIL!") << "\n";
+  return Cond;
+}
+
+/// checkParts - Returns true if the parts of a buffer of \p Bytes bytes
+/// cover it in order, begin on page boundaries, and differ from an equal
+/// split by less than a page.
+static bool checkParts(size_t Bytes) {
+  bool OK = ot_rt_part(Bytes, 0) == 0 &&
+            ot_rt_part(Bytes, NumWorkers) == Bytes;
+
+  std::cout << "parts of " << Bytes << ":";
+  for (int w = 0; w < NumWorkers; ++w) {
+    size_t Begin = ot_rt_part(Bytes, w);
+    size_t End   = ot_rt_part(Bytes, w+1);
+    size_t Equal = Bytes / NumWorkers * w;
+
+    std::cout << " " << Begin;
+    OK = OK && Begin <= End && Begin % PageSize == 0 &&
+         Begin <= Equal + Bytes % NumWorkers && Equal < Begin + PageSize;
+  }
+  std::cout << (OK ? "  OK" : "  FAIL!") << "\n";
+  return OK;
+}
+
+/// checkCopy - Returns true if a buffer of \p Bytes bytes from
+/// ot_rt_alloc() is zeroed and round-trips through ot_rt_copy().
+static bool checkCopy(size_t Bytes) {
+  std::vector<unsigned char> Src(Bytes + 1), Back(Bytes + 1, 0);
+  for (size_t i = 0; i != Bytes; ++i) {
+    Src[i] = (unsigned char)(i * 7 + i / PageSize);
+  }
+
+  unsigned char *Buf = static_cast<unsigned char*>(ot_rt_alloc(Bytes));
+  bool           OK  = Buf != NULL;
+
+  for (size_t i = 0; OK && i != Bytes; ++i) {
+    OK = Buf[i] == 0;
+  }
+  if (OK) {
+    ot_rt_copy(Buf, &Src[0], Bytes);
+    ot_rt_copy(&Back[0], Buf, Bytes);
+    OK = std::memcmp(&Back[0], &Src[0], Bytes) == 0 && Back[Bytes] == 0;
+  }
+  ot_rt_free(Buf);
+
+  std::cout << "copy of " << Bytes << (OK ? "  OK" : "  FAIL!") << "\n";
+  return OK;
+}
+
+int main() {
+  setenv("OT_NUM_THREADS", "4", 1);
+
+  bool Res = true;
+
+  Res = check(ot_rt_num_workers() == NumWorkers, "workers from OT_NUM_THREADS")
+        && Res;
+
+  // Buffers smaller than a page are touched by worker 0 alone
+  Res = checkParts(0) && Res;
+  Res = checkParts(100) && Res;
+  Res = checkParts(PageSize) && Res;
+  Res = checkParts(4*PageSize) && Res;
+  Res = checkParts(5*PageSize + 123) && Res;
+  Res = checkParts((1 << 20) + 7) && Res;
+
+  Res = checkCopy(0) && Res;
+  Res = checkCopy(100) && Res;
+  Res = checkCopy(5*PageSize + 123) && Res;
+  Res = checkCopy((1 << 20) + 7) && Res;
+
+  return (Res ? 0 : 1);
+}
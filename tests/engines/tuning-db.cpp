@@ -0,0 +1,146 @@
+
+#include "overtile/Core/TuningDB.h"
+#include "overtile/Parser/SSPParser.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include <iostream>
+
+using namespace overtile;
+using namespace llvm;
+
+static const char *Source =
+  "program j2d is\n"
+  "grid 2\n"
+  "field A float inout\n"
+  "  A = \n"
+  "  @[1:$-1][1:$-1] : 0.2*(A[0][-1]+A[0][0]+A[0][1]+A[-1][0]+A[1][0])\n";
+
+// The same program with other names and formatting.
+static const char *Renamed =
+  "program other is grid 2 field X float inout\n"
+  "  X = @[1:$-1][1:$-1] :\n"
+  "    0.2 * (X[0][-1] + X[0][0] + X[0][1] + X[-1][0] + X[1][0])\n";
+
+// A different program.
+static const char *Changed =
+  "program j2d is\n"
+  "grid 2\n"
+  "field A float inout\n"
+  "  A = \n"
+  "  @[1:$-1][1:$-1] : 0.25*(A[0][-1]+A[0][1]+A[-1][0]+A[1][0])\n";
+
+static std::string getHash(const char *Text) {
+  SourceMgr SM;
+  SSPParser P(MemoryBuffer::getMemBuffer(Text, "tuning-db"), SM);
+  if (P.parseBuffer()) {
+    return "";
+  }
+  return TuningDB::getGridHash(P.getGrid());
+}
+
+static TuningEntry makeEntry(const std::string &Hash, const char *Target,
+                             int SizeBucket, unsigned BX, unsigned Time) {
+  TuningEntry E;
+  E.Hash       = Hash;
+  E.Target     = Target;
+  E.SizeBucket = SizeBucket;
+  E.Block.push_back(BX);
+  E.Block.push_back(8);
+  E.Elements.push_back(1);
+  E.Elements.push_back(2);
+  E.Time       = Time;
+  E.Program    = "j2d";
+  return E;
+}
+
+static bool check(bool Cond, const char *What) {
+  std::cout << What << (Cond ? "  OK" : "  FAIL!") << "\n";
+  return Cond;
+}
+
+/// checkLookup - Returns true if the lookup of \p SizeBucket finds the entry
+/// with block size \p BX, or no entry if \p BX is 0.
+static bool checkLookup(const TuningDB &DB, const std::string &Hash,
+                        const char *Target, int SizeBucket, unsigned BX) {
+  const TuningEntry *E = DB.lookup(Hash, Target, "", SizeBucket);
+  bool               OK;
+
+  if (BX == 0) {
+    OK = E == NULL;
+  } else {
+    OK = E != NULL && E->Block[0] == BX;
+  }
+
+  std::cout << "lookup " << Target << " bucket " << SizeBucket << ": "
+            << (E ? E->getAttributes() : "none")
+            << (OK ? "  OK" : "  FAIL!") << "\n";
+  return OK;
+}
+
+int main() {
+  bool Res = true;
+
+  // Program keys
+  std::string Hash = getHash(Source);
+  Res = check(Hash.size() == 16, "hash has 16 digits") && Res;
+  Res = check(getHash(Renamed) == Hash, "renamed program, same hash") && Res;
+  Res = check(getHash(Changed) != Hash, "changed program, new hash") && Res;
+
+  // Size buckets
+  Res = check(TuningDB::getSizeBucket(1) == 0, "bucket of 1") && Res;
+  Res = check(TuningDB::getSizeBucket(1023) == 9, "bucket of 1023") && Res;
+  Res = check(TuningDB::getSizeBucket(1024) == 10, "bucket of 1024") && Res;
+  Res = check(TuningDB::getSizeBucket(500*500) == 17, "bucket of 500^2") &&
+        Res;
+  Res = check(TuningDB::getSizeBucket(1ULL << 40) == 40, "bucket of 2^40") &&
+        Res;
+
+  // Lookup by size bucket
+  TuningDB DB;
+  DB.insert(makeEntry(Hash, "cuda", 10, 16, 2));
+  DB.insert(makeEntry(Hash, "cuda", 20, 64, 4));
+  DB.insert(makeEntry(Hash, "cpu-omp", 18, 128, 1));
+
+  Res = checkLookup(DB, Hash, "cuda", 10, 16) && Res;
+  Res = checkLookup(DB, Hash, "cuda", 14, 16) && Res;
+  Res = checkLookup(DB, Hash, "cuda", 15, 64) && Res;
+  Res = checkLookup(DB, Hash, "cuda", 30, 64) && Res;
+  Res = checkLookup(DB, Hash, "cuda", -1, 64) && Res;
+  Res = checkLookup(DB, Hash, "cpu-omp", 10, 128) && Res;
+  Res = checkLookup(DB, getHash(Changed), "cuda", 10, 0) && Res;
+
+  // An entry with the same key replaces the old one
+  DB.insert(makeEntry(Hash, "cuda", 10, 32, 3));
+  Res = checkLookup(DB, Hash, "cuda", 10, 32) && Res;
+
+  // Round trip through the file format
+  std::string       Text;
+  raw_string_ostream OS(Text);
+  DB.print(OS);
+  OS.flush();
+  std::cout << Text;
+
+  TuningDB    DB2;
+  std::string Err;
+  Res = check(DB2.parse(Text, Err), "parse printed database") && Res;
+
+  std::string       Text2;
+  raw_string_ostream OS2(Text2);
+  DB2.print(OS2);
+  OS2.flush();
+  Res = check(Text2 == Text, "reprinted database is identical") && Res;
+
+  const TuningEntry *E = DB2.lookup(Hash, "cuda", "", 10);
+  Res = check(E != NULL && E->getAttributes() == "block:32,8 tile:1,2 time:3"
+              && E->Program == "j2d", "parsed entry") && Res;
+
+  // Malformed lines are diagnosed with their line number
+  TuningDB DB3;
+  Err.clear();
+  Res = check(!DB3.parse("# comment\n" + Hash + " cuda - 10 block:32,8\n",
+                         Err) && Err.find("line 2") != std::string::npos,
+              "malformed line") && Res;
+
+  return (Res ? 0 : 1);
+}
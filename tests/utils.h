@@ -2,6 +2,9 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 template <typename T>
@@ -19,7 +19,14 @@
 
 #include "overtile/Parser/SSPParser.h"
 
+#include "overtile/Core/CostModel.h"
 #include "overtile/Core/CudaBackEnd.h"
+#include "overtile/Core/Interpreter.h"
+#include "overtile/Core/OpenMPBackEnd.h"
+#include "overtile/Core/PerfModel.h"
+#include "overtile/Core/ResourceCheck.h"
+#include "overtile/Core/TuningDB.h"
+#include "overtile/JIT/JITEngine.h"
 
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/Support/CommandLine.h"
@@ -51,6 +58,10 @@ static cl::opt<std::string>
 Machine("machine", cl::desc("Set target machine"),
         cl::value_desc("machine"), cl::init(""));
 
+static cl::opt<std::string>
+Target("target", cl::desc("Set code generation target (cuda, cpu-omp, llvm, bytecode)"),
+       cl::value_desc("target"), cl::init("cuda"));
+
 static cl::opt<unsigned>
 TimeTileSize("t", cl::desc("Specify time tile size"),
              cl::value_desc("N"), cl::init(1));
@@ -81,6 +92,93 @@ ElementsZ("ez", cl::desc("Specify elements per thread (Z)"),
           cl::value_desc("N"), cl::init(1));
 
 
+static cl::opt<std::string>
+Tiling("tiling",
+       cl::desc("Set tiling strategy (overlapped, split, wavefront, "
+                "stream)"),
+       cl::value_desc("strategy"), cl::init("overlapped"));
+
+static cl::opt<unsigned>
+VectorBits("vector-bits",
+           cl::desc("Vector width in bits for the cpu-omp target (0 = scalar; "
+                    "default: the widest vectors of the host, e.g. 256 "
+                    "with AVX)"),
+           cl::value_desc("N"), cl::init(0));
+
+static cl::opt<unsigned>
+ScratchKB("scratch-kb",
+          cl::desc("Limit scratch to N KB: shared memory per block for the "
+                   "cuda target (default 48), and per-thread tile buffers "
+                   "for the cpu-omp target, e.g. the L2 cache size "
+                   "(default 0 = use block sizes)"),
+          cl::value_desc("N"), cl::init(0));
+
+static cl::opt<bool>
+UseRuntime("runtime",
+           cl::desc("Run cpu-omp kernels on the persistent worker pool of "
+                    "the OverTile runtime instead of OpenMP"),
+           cl::init(false));
+
+static cl::opt<bool>
+FastMath("fast-math",
+         cl::desc("Allow simplifications that do not preserve IEEE "
+                  "semantics, such as x*0 = 0 and reassociating constants, "
+                  "and approximate exp, log, and rsqrt in cpu-omp vector "
+                  "code"),
+         cl::init(false));
+
+static cl::opt<bool>
+FPContract("fp-contract",
+           cl::desc("Compute a*b+c with fused multiply-add instructions"),
+           cl::init(false));
+
+
+static cl::opt<bool>
+PrintCost("print-cost",
+          cl::desc("Write the per-point cost of the program (operations, "
+                   "loads, bytes, intensity) in YAML instead of code"),
+          cl::init(false));
+
+static cl::opt<bool>
+Predict("predict",
+        cl::desc("Write the predicted performance of the tile configuration "
+                 "on the -machine device (gt200, fermi, or kepler; default "
+                 "fermi) in JSON instead of code, cuda target only"),
+        cl::init(false));
+
+static cl::opt<std::string>
+MachineDesc("machine-desc",
+            cl::desc("Override the device parameters for -predict with the "
+                     "'key: value' lines of <file>"),
+            cl::value_desc("file"), cl::init(""));
+
+static cl::opt<bool>
+CheckResources("check-resources",
+               cl::desc("Write the resources that the tile configuration "
+                        "needs (halos, and for the cuda target threads, "
+                        "shared memory, and registers) in YAML instead of "
+                        "code"),
+               cl::init(false));
+
+static cl::opt<bool>
+Clamp("clamp",
+      cl::desc("Change a tile configuration that cannot run on the target "
+               "to the nearest one that can"),
+      cl::init(false));
+
+static cl::opt<std::string>
+TuningDBFile("tuning-db",
+             cl::desc("Take the block, tile, and time tile sizes that are "
+                      "not given from the tuning database <file> (default: "
+                      "$OT_TUNING_DB)"),
+             cl::value_desc("file"), cl::init(""));
+
+static cl::list<unsigned>
+ProblemSize("size",
+            cl::desc("Problem size to look up in the tuning database, per "
+                     "dimension"),
+            cl::value_desc("N,..."), cl::CommaSeparated);
+
 static cl::opt<bool>
 Verbose("v", cl::desc("Print verbose output"),
         cl::init(false));
@@ -151,6 +249,235 @@ StringRef ltrim(StringRef S, StringRef Chars = " \t\n\v\f\r") {
 }
 
 
+/// SetTilingStrategy - Sets the tiling strategy named \p Name on \p BE.
+/// Returns false if the strategy is not known or not supported by the
+/// target.
+bool SetTilingStrategy(BackEnd *BE, StringRef Name) {
+  if (Name == "overlapped") {
+    BE->setTilingStrategy(BackEnd::OverlappedTiling);
+  } else if (Name == "split") {
+    if (Target != "cpu-omp") {
+      errs() << "Split tiling is only supported by the cpu-omp target\n";
+      return false;
+    }
+    BE->setTilingStrategy(BackEnd::SplitTiling);
+  } else if (Name == "wavefront") {
+    if (Target != "cpu-omp") {
+      errs() << "Wavefront tiling is only supported by the cpu-omp target\n";
+      return false;
+    }
+    BE->setTilingStrategy(BackEnd::WavefrontTiling);
+  } else if (Name == "stream") {
+    if (Target != "cpu-omp") {
+      errs() << "Streaming is only supported by the cpu-omp target\n";
+      return false;
+    }
+    if (BE->getGrid()->getNumDimensions() < 2) {
+      errs() << "Streaming needs a grid with at least two dimensions\n";
+      return false;
+    }
+    BE->setTilingStrategy(BackEnd::StreamingTiling);
+  } else {
+    errs() << "Unknown tiling strategy '" << Name << "'\n";
+    return false;
+  }
+  return true;
+}
+
+/// GetMachineModel - Sets \p M to the -machine device.  Returns false if it
+/// is not known or its description cannot be read.
+bool GetMachineModel(MachineModel &M) {
+  if (!Machine.empty() && !M.setPreset(Machine)) {
+    errs() << "Unknown machine '" << Machine << "' for -predict\n";
+    return false;
+  }
+
+  if (!MachineDesc.empty()) {
+    OwningPtr<MemoryBuffer> Desc;
+    if (error_code ec = MemoryBuffer::getFileOrSTDIN(MachineDesc, Desc)) {
+      errs() << "Unable to read " << MachineDesc << ": " << ec.message()
+             << "\n";
+      return false;
+    }
+
+    std::string Err;
+    if (!M.parse(Desc->getBuffer(), Err)) {
+      errs() << MachineDesc << ": " << Err << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+/// GetTuningDB - Reads the tuning database of -tuning-db or $OT_TUNING_DB
+/// into \p DB, if any.  Returns false if it cannot be parsed, or if the file
+/// given with -tuning-db cannot be read.
+bool GetTuningDB(TuningDB &DB) {
+  std::string Path = TuningDBFile;
+  if (Path.empty()) {
+    const char *Env = getenv("OT_TUNING_DB");
+    if (!Env || !*Env) {
+      return true;
+    }
+    Path = Env;
+  }
+
+  OwningPtr<MemoryBuffer> Text;
+  if (error_code ec = MemoryBuffer::getFileOrSTDIN(Path, Text)) {
+    errs() << "Unable to read " << Path << ": " << ec.message() << "\n";
+    return TuningDBFile.empty();
+  }
+
+  std::string Err;
+  if (!DB.parse(Text->getBuffer(), Err)) {
+    errs() << Path << ": " << Err << "\n";
+    return false;
+  }
+  return true;
+}
+
+/// LookupTuning - Returns the entry of \p DB for the program of \p BE, for
+/// the problem size \p Size if it is not empty, or NULL.  \p BE must not
+/// have been run yet.
+const TuningEntry *LookupTuning(const TuningDB &DB, BackEnd *BE,
+                                const std::vector<unsigned> &Size) {
+  if (DB.empty()) {
+    return NULL;
+  }
+
+  int Bucket = -1;
+  if (!Size.empty()) {
+    uint64_t Points = 1;
+    for (unsigned i = 0, e = Size.size(); i != e; ++i) {
+      Points *= Size[i];
+    }
+    Bucket = TuningDB::getSizeBucket(Points);
+  }
+  std::string        Hash  = TuningDB::getGridHash(BE->getGrid());
+  const TuningEntry *Tuned = DB.lookup(Hash, Target, BE->getMachine(),
+                                       Bucket);
+  if (!Tuned && Verbose) {
+    errs() << BE->getGrid()->getName() << ": no tuning database entry for "
+           << Hash << "\n";
+  }
+  return Tuned;
+}
+
+/// ApplyTuning - Sets the block, tile, or time tile sizes of \p BE to those
+/// of \p Tuned, unless they are given by a #pragma sdsl begin attribute
+/// (\p HasBlock, \p HasTile, \p HasTime) or on the command line.
+void ApplyTuning(BackEnd *BE, const TuningEntry *Tuned, bool HasBlock,
+                 bool HasTile, bool HasTime) {
+  if (!Tuned) {
+    return;
+  }
+
+  HasBlock = HasBlock || BlockSizeX.getNumOccurrences() > 0 ||
+             BlockSizeY.getNumOccurrences() > 0 ||
+             BlockSizeZ.getNumOccurrences() > 0;
+  HasTile  = HasTile || ElementsX.getNumOccurrences() > 0 ||
+             ElementsY.getNumOccurrences() > 0 ||
+             ElementsZ.getNumOccurrences() > 0;
+  HasTime  = HasTime || TimeTileSize.getNumOccurrences() > 0;
+
+  if (!HasBlock) {
+    for (unsigned i = 0, e = Tuned->Block.size(); i != e; ++i) {
+      BE->setBlockSize(i, Tuned->Block[i]);
+    }
+  }
+  if (!HasTile) {
+    for (unsigned i = 0, e = Tuned->Elements.size(); i != e; ++i) {
+      BE->setElements(i, Tuned->Elements[i]);
+    }
+  }
+  if (!HasTime) {
+    BE->setTimeTileSize(Tuned->Time);
+  }
+
+  if (Verbose && (!HasBlock || !HasTile || !HasTime)) {
+    errs() << BE->getGrid()->getName() << ": using '"
+           << Tuned->getAttributes() << "' from the tuning database\n";
+  }
+}
+
+/// ValidateConfiguration - Checks the resources that the tile configuration
+/// of \p BE needs, on the device \p M for the cuda target, and with -clamp
+/// changes it to the nearest configuration that can run.  Returns false if
+/// it cannot run and code is to be generated for it.
+bool ValidateConfiguration(BackEnd *BE, const MachineModel *M) {
+  if (Target != "cuda" && Target != "cpu-omp") {
+    return true;
+  }
+
+  ResourceCheck RC(*BE, M);
+  std::string   Name = BE->getGrid()->getName();
+
+  if (!RC.isFeasible() && Clamp) {
+    std::string Old = ResourceCheck::getConfiguration(*BE);
+    if (RC.clamp()) {
+      errs() << Name << ": clamped '" << Old << "' to '"
+             << ResourceCheck::getConfiguration(*BE) << "'\n";
+    }
+  }
+
+  const std::vector<std::string> &Warnings = RC.getWarnings();
+  for (unsigned i = 0, e = Warnings.size(); i != e; ++i) {
+    errs() << Name << ": warning: " << Warnings[i] << "\n";
+  }
+
+  if (RC.isFeasible() || CheckResources || PrintCost || Predict) {
+    return true;
+  }
+
+  const std::vector<std::string> &Errors = RC.getErrors();
+  errs() << Name << ": tile configuration '"
+         << ResourceCheck::getConfiguration(*BE) << "' cannot run:\n";
+  for (unsigned i = 0, e = Errors.size(); i != e; ++i) {
+    errs() << "  " << Errors[i] << "\n";
+  }
+  if (!Clamp) {
+    errs() << "Use -clamp to change it to the nearest one that can\n";
+  }
+  return false;
+}
+
+/// CreateBackEnd - Returns a new back-end for the requested target, or NULL
+/// if the target is not known.
+BackEnd *CreateBackEnd(Grid *G) {
+  BackEnd *BE = NULL;
+
+  if (Target == "cuda") {
+    BE = new CudaBackEnd(G);
+  } else if (Target == "cpu-omp") {
+    if (VectorBits != 0 && VectorBits != 128 && VectorBits != 256 &&
+        VectorBits != 512) {
+      errs() << "Vector width must be 0, 128, 256, or 512 bits\n";
+      return NULL;
+    }
+    OpenMPBackEnd *OMP = new OpenMPBackEnd(G);
+    if (VectorBits.getNumOccurrences() > 0) {
+      OMP->setVectorBits(VectorBits);
+    }
+    OMP->setUseRuntime(UseRuntime);
+    BE = OMP;
+  } else if (Target == "llvm") {
+    BE = new JITEngine(G);
+  } else if (Target == "bytecode") {
+    BE = new Interpreter(G);
+  } else {
+    errs() << "Unknown target '" << Target << "'\n";
+    return NULL;
+  }
+
+  if (Target == "cpu-omp" || ScratchKB.getNumOccurrences() > 0) {
+    BE->setScratchBudget(ScratchKB * 1024);
+  }
+  BE->setFastMath(FastMath);
+  BE->setContraction(FPContract);
+  return BE;
+}
+
+
 }
 
 
@@ -167,6 +494,28 @@ int main(int argc, char **argv) {
   cl::SetVersionPrinter(PrintVersion);
   cl::ParseCommandLineOptions(argc, argv, "otsc - OverTile Stencil Compiler");
 
+  if (Predict && Target != "cuda") {
+    errs() << "-predict is only supported by the cuda target\n";
+    return 1;
+  }
+
+  // The limits of the device are checked for all cuda programs, but only
+  // -predict needs a -machine that has a model.
+  MachineModel        TheMachine;
+  const MachineModel *Device = NULL;
+  if (Target == "cuda" &&
+      (Predict || Machine.empty() || MachineModel().setPreset(Machine))) {
+    if (!GetMachineModel(TheMachine)) {
+      return 1;
+    }
+    Device = &TheMachine;
+  }
+
+  TuningDB TheTuningDB;
+  if (!GetTuningDB(TheTuningDB)) {
+    return 1;
+  }
+
   // Read input
   OwningPtr<MemoryBuffer> InDoc;
   if (error_code ec = MemoryBuffer::getFileOrSTDIN(InputFileName, InDoc)) {
@@ -187,6 +536,11 @@ int main(int argc, char **argv) {
   
   
   if (CXXInput) {
+    if (Target == "llvm" || Target == "bytecode") {
+      errs() << "The " << Target << " target cannot be used with embedded SSP\n";
+      return 1;
+    }
+
     // Input is a CXX file, so first extract out the SSP
     OwningPtr<MemoryBuffer> CXXSource(InDoc.take());
 
@@ -312,7 +666,10 @@ int main(int argc, char **argv) {
           return 1;
         }
 
-        Reg.BE = new CudaBackEnd(P.getGrid());
+        Reg.BE = CreateBackEnd(P.getGrid());
+        if (!Reg.BE) {
+          return 1;
+        }
         Reg.BE->setMachine(Machine);
         
         SmallVector<StringRef, 1> Matches;
@@ -342,9 +699,27 @@ int main(int argc, char **argv) {
           Reg.TimeStepsExpr = "TS";
         }
 
+        // size attribute, for the tuning database
+        std::vector<unsigned> Size(ProblemSize.begin(), ProblemSize.end());
+        Regex SizeRE("size:[0-9]+(,[0-9]+)*");
+        Match = SizeRE.match(Lines[Reg.FirstLine], &Matches);
+
+        if (Match) {
+          SmallVector<StringRef,4> Comps;
+          Matches[0].substr(5).split(Comps, ",");
+
+          Size.clear();
+          for (unsigned ii = 0, ee = Comps.size(); ii != ee; ++ii) {
+            Size.push_back(atoi(Comps[ii].str().c_str()));
+          }
+        }
+
+        const TuningEntry *Tuned = LookupTuning(TheTuningDB, Reg.BE, Size);
+
         // block attribute
         Regex BlockRE("block:[0-9]+(,[0-9]+)*");
-        Match = BlockRE.match(Lines[Reg.FirstLine], &Matches);
+        bool  HasBlock = BlockRE.match(Lines[Reg.FirstLine], &Matches);
+        Match = HasBlock;
 
         if (Match) {
           SmallVector<StringRef,4> Comps;
@@ -361,7 +736,8 @@ int main(int argc, char **argv) {
 
         // tile attribute
         Regex TileRE("tile:[0-9]+(,[0-9]+)*");
-        Match = TileRE.match(Lines[Reg.FirstLine], &Matches);
+        bool  HasTile = TileRE.match(Lines[Reg.FirstLine], &Matches);
+        Match = HasTile;
 
         if (Match) {
           SmallVector<StringRef,4> Comps;
@@ -378,7 +754,8 @@ int main(int argc, char **argv) {
 
         // time attribute
         Regex TimeRE("time:[0-9]+(,[0-9]+)*");
-        Match = TimeRE.match(Lines[Reg.FirstLine], &Matches);
+        bool  HasTime = TimeRE.match(Lines[Reg.FirstLine], &Matches);
+        Match = HasTime;
 
         if (Match) {
           Reg.BE->setTimeTileSize(atoi(Matches[0].substr(5).str().c_str()));
@@ -386,11 +763,57 @@ int main(int argc, char **argv) {
           Reg.BE->setTimeTileSize(TimeTileSize);
         }
 
+        ApplyTuning(Reg.BE, Tuned, HasBlock, HasTile, HasTime);
+
+        // tiling attribute
+        Regex TilingRE("tiling:[a-z]+");
+        Match = TilingRE.match(Lines[Reg.FirstLine], &Matches);
+
+        if (!SetTilingStrategy(Reg.BE, Match ? Matches[0].substr(7)
+                                             : StringRef(Tiling))) {
+          return 1;
+        }
+
         Reg.BE->setVerbose(Verbose);
         Reg.BE->run();
+        if (!ValidateConfiguration(Reg.BE, Device)) {
+          return 1;
+        }
       }
     }
 
+    if (PrintCost && !EmbedPassThrough) {
+      for (unsigned i = 0, e = Regions.size(); i != e; ++i) {
+        Out->os() << "---\n";
+        CostModel::print(Regions[i].BE->getGrid(), Out->os());
+      }
+      Out->keep();
+      return 0;
+    }
+
+    if (Predict && !EmbedPassThrough) {
+      Out->os() << "[\n";
+      for (unsigned i = 0, e = Regions.size(); i != e; ++i) {
+        if (i != 0) Out->os() << ",\n";
+        PerfModel(*Regions[i].BE, TheMachine).print(Out->os());
+      }
+      Out->os() << "]\n";
+      Out->keep();
+      return 0;
+    }
+
+    if (CheckResources && !EmbedPassThrough) {
+      bool Feasible = true;
+      for (unsigned i = 0, e = Regions.size(); i != e; ++i) {
+        ResourceCheck RC(*Regions[i].BE, Device);
+        Out->os() << "---\n";
+        RC.print(Out->os());
+        Feasible &= RC.isFeasible();
+      }
+      Out->keep();
+      return Feasible ? 0 : 1;
+    }
+
     // Write output
     for (unsigned i = 0, e = Lines.size(); i != e; ++i) {
 
@@ -434,17 +857,43 @@ int main(int argc, char **argv) {
     }
     G.reset(P.getGrid());
 
-    CudaBackEnd BE(G.get());
-    BE.setTimeTileSize(TimeTileSize);
-    BE.setBlockSize(0, BlockSizeX);
-    BE.setBlockSize(1, BlockSizeY);
-    BE.setBlockSize(2, BlockSizeZ);
-    BE.setElements(0, ElementsX);
-    BE.setElements(1, ElementsY);
-    BE.setElements(2, ElementsZ);
-    BE.setVerbose(Verbose);
-    BE.run();
-    BE.codegen(Out->os());
+    OwningPtr<BackEnd> BE(CreateBackEnd(G.get()));
+    if (!BE) {
+      return 1;
+    }
+    BE->setMachine(Machine);
+    BE->setTimeTileSize(TimeTileSize);
+    BE->setBlockSize(0, BlockSizeX);
+    BE->setBlockSize(1, BlockSizeY);
+    BE->setBlockSize(2, BlockSizeZ);
+    BE->setElements(0, ElementsX);
+    BE->setElements(1, ElementsY);
+    BE->setElements(2, ElementsZ);
+    std::vector<unsigned> Size(ProblemSize.begin(), ProblemSize.end());
+    ApplyTuning(BE.get(), LookupTuning(TheTuningDB, BE.get(), Size), false,
+                false, false);
+    if (!SetTilingStrategy(BE.get(), Tiling)) {
+      return 1;
+    }
+    BE->setVerbose(Verbose);
+    BE->run();
+    if (!ValidateConfiguration(BE.get(), Device)) {
+      return 1;
+    }
+    if (PrintCost) {
+      CostModel::print(G.get(), Out->os());
+    } else if (Predict) {
+      PerfModel(*BE, TheMachine).print(Out->os());
+    } else if (CheckResources) {
+      ResourceCheck RC(*BE, Device);
+      RC.print(Out->os());
+      if (!RC.isFeasible()) {
+        Out->keep();
+        return 1;
+      }
+    } else {
+      BE->codegen(Out->os());
+    }
   }
   
   Out->keep();
@@ -0,0 +1,803 @@
+/*
+ * ottune.cpp: This file is part of the OverTile project.
+ *
+ * OverTile: Research compiler for overlapped tiling on GPU architectures
+ *
+ * Copyright (C) 2012, Ohio State University
+ *
+ * This program can be redistributed and/or modified under the terms
+ * of the license specified in the LICENSE.txt file at the root of the
+ * project.
+ *
+ * Contact: P Sadayappan <saday@cse.ohio-state.edu>
+ */
+
+/**
+ * @file: ottune.cpp
+ * @author: Justin Holewinski <justin.holewinski@gmail.com>
+ */
+
+#include "overtile/Parser/SSPParser.h"
+
+#include "overtile/Core/CostModel.h"
+#include "overtile/Core/Field.h"
+#include "overtile/Core/Function.h"
+#include "overtile/Core/Interpreter.h"
+#include "overtile/Core/OpenMPBackEnd.h"
+#include "overtile/Core/ResourceCheck.h"
+#include "overtile/Core/TuningDB.h"
+#include "overtile/Core/Types.h"
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/system_error.h"
+#include "llvm/Support/ToolOutputFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace llvm::sys;
+using namespace overtile;
+
+static cl::list<std::string>
+InputFileNames(cl::Positional, cl::desc("<input files>"), cl::OneOrMore);
+
+static cl::opt<std::string>
+OutputFileName("o", cl::desc("Specify output filename"),
+               cl::value_desc("filename"), cl::init("-"));
+
+static cl::list<unsigned>
+Size("size", cl::desc("Grid size to tune for, per dimension or one for all "
+                      "(default 4194304, 2048, or 256 points)"),
+     cl::value_desc("N,..."), cl::CommaSeparated);
+
+static cl::opt<unsigned>
+TimeSteps("steps", cl::desc("Time steps per run"),
+          cl::value_desc("N"), cl::init(16));
+
+static cl::list<std::string>
+ParamValues("param", cl::desc("Set program parameter <name> (default 1.0)"),
+            cl::value_desc("name=value"), cl::ZeroOrMore);
+
+static cl::opt<unsigned>
+MaxTime("max-time", cl::desc("Largest time tile size tried"),
+        cl::value_desc("N"), cl::init(8));
+
+static cl::opt<unsigned>
+MaxCandidates("max-candidates",
+              cl::desc("Configurations compiled and measured, picked by the "
+                       "surrogate model"),
+              cl::value_desc("N"), cl::init(27));
+
+static cl::opt<unsigned>
+Eta("eta", cl::desc("Keep 1/N of the configurations after every round"),
+    cl::value_desc("N"), cl::init(3));
+
+static cl::opt<unsigned>
+Reps("reps", cl::desc("Repetitions per configuration in the first round, "
+                      "multiplied by -eta in every later round"),
+     cl::value_desc("N"), cl::init(1));
+
+static cl::opt<unsigned>
+Warmups("warmup", cl::desc("Untimed runs per configuration"),
+        cl::value_desc("N"), cl::init(1));
+
+static cl::opt<unsigned>
+Cores("cores", cl::desc("Threads assumed by the surrogate model "
+                        "(default: online processors)"),
+      cl::value_desc("N"), cl::init(0));
+
+static cl::opt<unsigned>
+CacheKB("cache-kb", cl::desc("Cache per thread assumed by the surrogate "
+                             "model, 0 = unlimited"),
+        cl::value_desc("N"), cl::init(1024));
+
+static cl::opt<unsigned>
+VectorBits("vector-bits",
+           cl::desc("Vector width in bits of the generated code (0 = scalar; "
+                    "default: the widest vectors of the host)"),
+           cl::value_desc("N"), cl::init(0));
+
+static cl::opt<bool>
+FastMath("fast-math", cl::desc("Tune the -fast-math variant of the program"),
+         cl::init(false));
+
+static cl::opt<bool>
+FPContract("fp-contract", cl::desc("Tune the -fp-contract variant of the "
+                                   "program"),
+           cl::init(false));
+
+static cl::opt<std::string>
+CXX("cxx", cl::desc("Host compiler for the candidates"),
+    cl::value_desc("command"), cl::init("c++"));
+
+static cl::opt<std::string>
+CXXFlags("cxxflags", cl::desc("Flags for the host compiler"),
+         cl::value_desc("flags"),
+         cl::init("-O3 -march=native -ffp-contract=off -fopenmp"));
+
+static cl::opt<unsigned>
+Jobs("j", cl::desc("Candidates compiled in parallel (default: -cores)"),
+     cl::value_desc("N"), cl::init(0));
+
+static cl::opt<std::string>
+WorkDir("work-dir", cl::desc("Directory for the candidate sources and "
+                             "libraries (default: $TMPDIR or /tmp)"),
+        cl::value_desc("dir"), cl::init(""));
+
+static cl::opt<std::string>
+DBFile("db", cl::desc("Add the best configurations to the tuning database "
+                      "<file>, see otsc -tuning-db"),
+       cl::value_desc("file"), cl::init(""));
+
+static cl::opt<std::string>
+Machine("machine", cl::desc("Machine string of the database entries, as "
+                            "given to otsc -machine"),
+        cl::value_desc("machine"), cl::init(""));
+
+static cl::opt<bool>
+Verify("verify", cl::desc("Reject configurations whose results differ from "
+                          "the interpreter (default on)"),
+       cl::init(true));
+
+static cl::opt<bool>
+Verbose("v", cl::desc("Print every configuration measured"),
+        cl::init(false));
+
+
+namespace {
+
+/// Block sizes tried in dimension 0 and in all other dimensions.
+const unsigned InnerBlockSizes[] = { 8, 16, 32, 64, 128, 256, 512 };
+const unsigned OuterBlockSizes[] = { 4, 8, 16, 32, 64, 128, 256 };
+
+/// Weighted operations a core performs in the time it streams one byte from
+/// memory, used to weigh memory traffic against arithmetic.
+const double MemoryWeight = 4.0;
+
+/// Relative difference from the interpreter up to which results agree.
+const double Tolerance = 1e-4;
+
+/// Magnitude beyond which a program is considered to diverge.
+const double DivergenceLimit = 1e18;
+
+typedef void (*RunFunc)(int, void *const *, const int *, const double *);
+
+/// Libraries compiled so far.  The dynamic loader returns the library that
+/// is already loaded for a file name, so every library needs a new one.
+unsigned NumLibraries = 0;
+
+/// Candidate - A tile configuration and its measurements.
+struct Candidate {
+  Candidate()
+    : Time(1), Score(0.0), Seconds(0.0), Run(NULL) {}
+
+  std::vector<unsigned> Block;
+  std::vector<unsigned> Elements;
+  unsigned              Time;
+  /// Estimated cost per useful point and time step, lower is better.
+  double                Score;
+  /// Fastest run measured so far, or 0.
+  double                Seconds;
+  RunFunc               Run;
+
+  /// getAttributes - Returns the configuration as #pragma sdsl begin
+  /// attributes.
+  std::string getAttributes() const {
+    std::string        Ret;
+    raw_string_ostream OS(Ret);
+
+    OS << "block:";
+    for (unsigned i = 0, e = Block.size(); i != e; ++i) {
+      OS << (i == 0 ? "" : ",") << Block[i];
+    }
+    OS << " tile:";
+    for (unsigned i = 0, e = Elements.size(); i != e; ++i) {
+      OS << (i == 0 ? "" : ",") << Elements[i];
+    }
+    OS << " time:" << Time;
+    return OS.str();
+  }
+};
+
+struct ScoreOrder {
+  bool operator()(const Candidate &A, const Candidate &B) const {
+    return A.Score < B.Score;
+  }
+};
+
+struct SecondsOrder {
+  bool operator()(const Candidate *A, const Candidate *B) const {
+    return A->Seconds < B->Seconds;
+  }
+};
+
+double GetTime() {
+  struct timeval TV;
+  gettimeofday(&TV, NULL);
+  return TV.tv_sec + TV.tv_usec * 1e-6;
+}
+
+/// GetNumThreads - Returns -cores, or the number of online processors.
+unsigned GetNumThreads() {
+  if (Cores != 0) {
+    return Cores;
+  }
+  return std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+bool IsDouble(const ElementType *Ty) {
+  return isa<FP64Type>(Ty);
+}
+
+/**
+ * Tunes the tile configuration of one program for the cpu-omp target.
+ *
+ * The configurations are the block sizes in powers of two, one or two rows
+ * per loop iteration, and time tiles in powers of two up to -max-time.
+ * Tiles that ResourceCheck rejects, larger than the grid, or larger than
+ * OpenMPBackEnd::MaxTileSize are pruned.  The rest are ranked by a surrogate
+ * model of the redundant work, memory traffic, cache footprint, and load
+ * balance of their tiles, and the best -max-candidates are compiled into
+ * shared libraries and loaded into the process.  Successive halving then
+ * measures all of them, keeps the fastest 1/-eta, and measures those again
+ * with -eta times as many repetitions, until one is left.
+ */
+class Tuner {
+public:
+  Tuner(StringRef N, const std::string &S)
+    : Name(N), Source(S), NumConfigs(0) {}
+
+  /// tune - Finds the best configuration, writes it to \p OS, as a YAML
+  /// document of its own if \p Separate is set, and returns it in \p Best
+  /// as a tuning database entry.  Returns false if no configuration could
+  /// be measured.
+  bool tune(raw_ostream &OS, bool Separate, TuningEntry &Best);
+
+private:
+  Grid *parse() const;
+  bool setUp();
+  void enumerate(std::vector<Candidate> &Cands);
+  void addCandidates(Candidate &C, unsigned Dim, OpenMPBackEnd &BE,
+                     std::vector<Candidate> &Cands);
+  void compile(std::vector<Candidate> &Cands);
+  void reset();
+  double execute(const Candidate &C);
+  bool check() const;
+
+  std::string                     Name;
+  std::string                     Source;
+  OwningPtr<Grid>                 TheGrid;
+  PointCost                       Cost;
+  unsigned                        ScratchBytesPerPoint;
+  std::vector<int>                Dims;
+  std::vector<double>             Params;
+  std::vector<std::vector<char> > Pristine;
+  std::vector<std::vector<char> > Work;
+  std::vector<std::vector<char> > Reference;
+  std::vector<void*>              Ptrs;
+  std::vector<const Field*>       Fields;
+  unsigned                        NumConfigs;
+};
+
+Grid *Tuner::parse() const {
+  SourceMgr SM;
+  SSPParser P(MemoryBuffer::getMemBuffer(StringRef(Source), Name), SM);
+  if (error_code ec = P.parseBuffer()) {
+    return NULL;
+  }
+  return P.getGrid();
+}
+
+bool Tuner::setUp() {
+  TheGrid.reset(parse());
+  if (!TheGrid) {
+    errs() << Name << ": Abort due to errors\n";
+    return false;
+  }
+
+  unsigned NumDims = TheGrid->getNumDimensions();
+  if (Size.size() > 1 && Size.size() != NumDims) {
+    errs() << Name << ": -size needs 1 or " << NumDims << " values\n";
+    return false;
+  }
+  for (unsigned i = 0; i < NumDims; ++i) {
+    if (!Size.empty()) {
+      Dims.push_back(Size[Size.size() == 1 ? 0 : i]);
+    } else {
+      Dims.push_back(NumDims == 1 ? 4194304 : NumDims == 2 ? 2048 : 256);
+    }
+    if (Dims[i] <= 0) {
+      errs() << Name << ": -size must be positive\n";
+      return false;
+    }
+  }
+
+  typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+  const ParamList &PL = TheGrid->getParameters();
+  Params.assign(PL.size(), 1.0);
+  for (unsigned i = 0, e = ParamValues.size(); i != e; ++i) {
+    std::pair<StringRef, StringRef> NV = StringRef(ParamValues[i]).split('=');
+    unsigned Idx = 0;
+    ParamList::const_iterator I = PL.begin(), E = PL.end();
+    for (; I != E && I->first != NV.first; ++I, ++Idx) {}
+    if (I == E) {
+      errs() << Name << ": Unknown parameter '" << NV.first << "'\n";
+      return false;
+    }
+    Params[Idx] = std::atof(NV.second.str().c_str());
+  }
+
+  Cost = CostModel::getGridCost(TheGrid.get());
+
+  // Each thread keeps two copies of every updated field, see
+  // OpenMPBackEnd::computeTileSizes().
+  const std::list<Function*> &Functions = TheGrid->getFunctionList();
+  ScratchBytesPerPoint = 0;
+  for (std::list<Function*>::const_iterator I = Functions.begin(),
+         E = Functions.end(); I != E; ++I) {
+    ScratchBytesPerPoint +=
+      2 * (IsDouble((*I)->getOutput()->getElementType()) ? 8 : 4);
+  }
+
+  // Fill the fields with the same pseudo-random values in [0.5, 1.5) for
+  // every run.
+  size_t NumPoints = 1;
+  for (unsigned i = 0; i < NumDims; ++i) {
+    NumPoints *= Dims[i];
+  }
+
+  const std::list<Field*> &FieldList = TheGrid->getFieldList();
+  for (std::list<Field*>::const_iterator I = FieldList.begin(),
+         E = FieldList.end(); I != E; ++I) {
+    bool              Dbl  = IsDouble((*I)->getElementType());
+    std::vector<char> Data(NumPoints * (Dbl ? 8 : 4));
+    unsigned          Seed = 12345 + Fields.size();
+
+    for (size_t p = 0; p < NumPoints; ++p) {
+      Seed = Seed * 1103515245 + 12345;
+      double V = 0.5 + (Seed >> 8) / 16777216.0;
+      if (Dbl) {
+        reinterpret_cast<double*>(&Data[0])[p] = V;
+      } else {
+        reinterpret_cast<float*>(&Data[0])[p] = V;
+      }
+    }
+    Pristine.push_back(Data);
+    Fields.push_back(*I);
+  }
+  Work = Pristine;
+  for (unsigned f = 0, e = Work.size(); f != e; ++f) {
+    Ptrs.push_back(&Work[f][0]);
+  }
+
+  if (Verify) {
+    OwningPtr<Grid> G(parse());
+    Interpreter     Interp(G.get());
+    Interp.setFastMath(FastMath);
+    Interp.setContraction(FPContract);
+    Interp.run();
+    Interp.execute(TimeSteps, &Ptrs[0], &Dims[0],
+                   Params.empty() ? NULL : &Params[0]);
+    Reference = Work;
+  }
+  return true;
+}
+
+void Tuner::enumerate(std::vector<Candidate> &Cands) {
+  unsigned NumDims = TheGrid->getNumDimensions();
+
+  for (unsigned T = 1; T <= MaxTime; T *= 2) {
+    // The halo of a tile only depends on the time tile size.
+    OwningPtr<Grid> G(parse());
+    OpenMPBackEnd   BE(G.get());
+    BE.setTimeTileSize(T);
+    BE.run();
+
+    Candidate C;
+    C.Time = T;
+    C.Block.resize(NumDims);
+    C.Elements.assign(NumDims, 1);
+    addCandidates(C, 0, BE, Cands);
+  }
+}
+
+void Tuner::addCandidates(Candidate &C, unsigned Dim, OpenMPBackEnd &BE,
+                          std::vector<Candidate> &Cands) {
+  unsigned NumDims = TheGrid->getNumDimensions();
+
+  if (Dim < NumDims) {
+    const unsigned *Sizes    = Dim == 0 ? InnerBlockSizes : OuterBlockSizes;
+    unsigned        NumSizes = Dim == 0 ?
+      sizeof(InnerBlockSizes) / sizeof(InnerBlockSizes[0]) :
+      sizeof(OuterBlockSizes) / sizeof(OuterBlockSizes[0]);
+    // Dimension 1 is unrolled by the elements per thread.
+    unsigned        MaxElems = Dim == 1 ? 2 : 1;
+
+    for (unsigned s = 0; s < NumSizes; ++s) {
+      for (unsigned e = 1; e <= MaxElems; ++e) {
+        C.Block[Dim]    = Sizes[s];
+        C.Elements[Dim] = e;
+        addCandidates(C, Dim+1, BE, Cands);
+      }
+    }
+    return;
+  }
+
+  ++NumConfigs;
+
+  for (unsigned i = 0; i < NumDims; ++i) {
+    BE.setBlockSize(i, C.Block[i]);
+    BE.setElements(i, C.Elements[i]);
+  }
+  ResourceCheck RC(BE, NULL);
+  if (!RC.isFeasible()) {
+    return;
+  }
+
+  const KernelResources &KR = RC.getKernels()[0];
+
+  double Redundancy = 1.0;
+  double Tiles      = 1.0;
+  double TilePoints = 1.0;
+  for (unsigned i = 0; i < NumDims; ++i) {
+    int Tile = KR.TileSize[i];
+    int Halo = KR.HaloLeft[i] + KR.HaloRight[i];
+    int Real = KR.getUsefulPoints(i);
+
+    // A tile half the size already covers the grid.
+    if (Tile > (int)OpenMPBackEnd::MaxTileSize || Tile/2 - Halo >= Dims[i]) {
+      return;
+    }
+    Redundancy *= double(Tile) / Real;
+    Tiles      *= (Dims[i] + Real - 1) / Real;
+    TilePoints *= Tile;
+  }
+
+  double   Compute    = Redundancy * (Cost.WeightedFlops + Cost.Loads);
+  double   Memory     = MemoryWeight * Redundancy * Cost.getBytes() / C.Time;
+  double   Scratch    = TilePoints * ScratchBytesPerPoint;
+  unsigned NumThreads = GetNumThreads();
+
+  // Scratch that does not fit into the cache is streamed from memory.
+  if (CacheKB != 0 && Scratch > CacheKB * 1024.0) {
+    Compute *= Scratch / (CacheKB * 1024.0);
+  }
+
+  // The last round of tiles may leave threads idle.
+  double Rounds = std::ceil(Tiles / NumThreads);
+  C.Score = std::max(Compute, Memory) * Rounds * NumThreads / Tiles;
+  Cands.push_back(C);
+}
+
+void Tuner::compile(std::vector<Candidate> &Cands) {
+  std::string Dir = WorkDir;
+  if (Dir.empty()) {
+    const char *Tmp = getenv("TMPDIR");
+    Dir = Tmp ? Tmp : "/tmp";
+  }
+
+  unsigned NumJobs = Jobs != 0 ? unsigned(Jobs) : GetNumThreads();
+
+  std::vector<std::string> Bases;
+  for (unsigned c = 0, e = Cands.size(); c != e; ++c) {
+    std::string        Base;
+    raw_string_ostream BaseOS(Base);
+    BaseOS << Dir << "/ottune-" << getpid() << "-" << NumLibraries++;
+    Bases.push_back(BaseOS.str());
+
+    OwningPtr<Grid> G(parse());
+    OpenMPBackEnd   BE(G.get());
+    if (VectorBits.getNumOccurrences() > 0) {
+      BE.setVectorBits(VectorBits);
+    }
+    BE.setFastMath(FastMath);
+    BE.setContraction(FPContract);
+    BE.setTimeTileSize(Cands[c].Time);
+    for (unsigned i = 0, ie = Cands[c].Block.size(); i != ie; ++i) {
+      BE.setBlockSize(i, Cands[c].Block[i]);
+      BE.setElements(i, Cands[c].Elements[i]);
+    }
+    BE.run();
+
+    std::string                 Err;
+    OwningPtr<tool_output_file> Out(
+      new tool_output_file((Bases.back() + ".cpp").c_str(), Err));
+    if (!Err.empty()) {
+      errs() << Err << "\n";
+      continue;
+    }
+    raw_ostream &OS = Out->os();
+    BE.codegen(OS);
+
+    // Entry point with the calling convention of Interpreter::execute().
+    OS << "\nextern \"C\" void ot_tune_run(int TimeSteps, void *const *Fields, "
+       << "const int *Dims, const double *Params) {\n";
+    OS << "  ot_program_" << G->getName() << "(TimeSteps";
+    for (unsigned f = 0, fe = Fields.size(); f != fe; ++f) {
+      bool Dbl = IsDouble(Fields[f]->getElementType());
+      OS << ", (" << (Dbl ? "double" : "float") << "*)Fields[" << f << "]";
+    }
+    for (unsigned i = 0, ie = G->getNumDimensions(); i != ie; ++i) {
+      OS << ", Dims[" << i << "]";
+    }
+    typedef std::list<std::pair<std::string, const ElementType*> > ParamList;
+    const ParamList &PL  = G->getParameters();
+    unsigned         Idx = 0;
+    for (ParamList::const_iterator I = PL.begin(), E = PL.end(); I != E;
+         ++I, ++Idx) {
+      OS << ", (" << (IsDouble(I->second) ? "double" : "float") << ")Params["
+         << Idx << "]";
+    }
+    OS << ");\n";
+    OS << "}\n";
+    Out->keep();
+  }
+
+  // Every library exports the same names, so their references are bound
+  // within the library.
+  for (unsigned c = 0, e = Cands.size(); c < e; c += NumJobs) {
+    std::string Cmd;
+    for (unsigned j = c; j < e && j < c + NumJobs; ++j) {
+      Cmd += CXX + " " + CXXFlags + " -shared -fPIC -Wl,-Bsymbolic -o " +
+             Bases[j] + ".so " + Bases[j] + ".cpp > " + Bases[j] +
+             ".log 2>&1 & ";
+    }
+    Cmd += "wait";
+    if (Verbose) {
+      errs() << Cmd << "\n";
+    }
+    std::system(Cmd.c_str());
+  }
+
+  for (unsigned c = 0, e = Cands.size(); c != e; ++c) {
+    std::string    Err;
+    std::string    Lib = Bases[c] + ".so";
+    DynamicLibrary DL  = DynamicLibrary::getPermanentLibrary(Lib.c_str(), &Err);
+    if (DL.isValid()) {
+      Cands[c].Run = reinterpret_cast<RunFunc>(
+        DL.getAddressOfSymbol("ot_tune_run"));
+    }
+    if (!Cands[c].Run) {
+      errs() << Name << ": " << Cands[c].getAttributes()
+             << ": compilation failed, see " << Bases[c] << ".log\n";
+      continue;
+    }
+    std::remove(Lib.c_str());
+    std::remove((Bases[c] + ".cpp").c_str());
+    std::remove((Bases[c] + ".log").c_str());
+  }
+}
+
+void Tuner::reset() {
+  for (unsigned f = 0, e = Work.size(); f != e; ++f) {
+    std::copy(Pristine[f].begin(), Pristine[f].end(), Work[f].begin());
+  }
+}
+
+double Tuner::execute(const Candidate &C) {
+  reset();
+
+  // The generated code reports the time of its time loop on std::cerr,
+  // which excludes the copies to and from the host arrays.
+  std::ostringstream  Log;
+  std::streambuf     *Saved = std::cerr.rdbuf(Log.rdbuf());
+  double              Start = GetTime();
+  C.Run(TimeSteps, &Ptrs[0], &Dims[0], Params.empty() ? NULL : &Params[0]);
+  double              Wall  = GetTime() - Start;
+  std::cerr.rdbuf(Saved);
+
+  std::string Text = Log.str();
+  size_t      Pos  = Text.find("\nElapsed: ");
+  if (Pos != std::string::npos) {
+    return std::strtod(Text.c_str() + Pos + 10, NULL);
+  }
+  return Wall;
+}
+
+bool Tuner::check() const {
+  for (unsigned f = 0, e = Fields.size(); f != e; ++f) {
+    // Fields declared 'in' are not copied back to the host.
+    if (Fields[f]->getCopySemantic() == Field::CopyIn) continue;
+
+    bool   Dbl = IsDouble(Fields[f]->getElementType());
+    size_t N   = Work[f].size() / (Dbl ? 8 : 4);
+
+    for (size_t p = 0; p < N; ++p) {
+      double A, B;
+      if (Dbl) {
+        A = reinterpret_cast<const double*>(&Work[f][0])[p];
+        B = reinterpret_cast<const double*>(&Reference[f][0])[p];
+      } else {
+        A = reinterpret_cast<const float*>(&Work[f][0])[p];
+        B = reinterpret_cast<const float*>(&Reference[f][0])[p];
+      }
+      // Points at which the program diverges are not compared, since the
+      // precision of intermediate results decides where it overflows.
+      if (A == B || !(std::fabs(B) <= DivergenceLimit)) continue;
+      if (!(std::fabs(A - B) <= Tolerance * std::max(1.0, std::fabs(B)))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool Tuner::tune(raw_ostream &OS, bool Separate, TuningEntry &Entry) {
+  if (!setUp()) {
+    return false;
+  }
+
+  std::vector<Candidate> Cands;
+  enumerate(Cands);
+  unsigned NumFeasible = Cands.size();
+
+  std::stable_sort(Cands.begin(), Cands.end(), ScoreOrder());
+  if (Cands.size() > MaxCandidates) {
+    Cands.resize(MaxCandidates);
+  }
+  compile(Cands);
+
+  std::vector<Candidate*> Alive;
+  for (unsigned c = 0, e = Cands.size(); c != e; ++c) {
+    Candidate &C = Cands[c];
+    if (!C.Run) continue;
+
+    unsigned NumWarmups = std::max<unsigned>(Warmups, Verify ? 1 : 0);
+    bool     Correct    = true;
+    for (unsigned w = 0; w < NumWarmups; ++w) {
+      execute(C);
+      if (w == 0 && Verify) {
+        Correct = check();
+      }
+    }
+    if (!Correct) {
+      errs() << Name << ": " << C.getAttributes()
+             << ": results differ from the interpreter\n";
+      continue;
+    }
+    Alive.push_back(&C);
+  }
+
+  if (Alive.empty()) {
+    errs() << Name << ": No configuration could be measured\n";
+    return false;
+  }
+
+  unsigned NumMeasured = Alive.size();
+  unsigned NumReps     = std::max(1U, unsigned(Reps));
+  for (unsigned Round = 0; ; ++Round) {
+    for (unsigned c = 0, e = Alive.size(); c != e; ++c) {
+      Candidate *C = Alive[c];
+      for (unsigned r = 0; r < NumReps; ++r) {
+        double Seconds = execute(*C);
+        if (C->Seconds == 0.0 || Seconds < C->Seconds) {
+          C->Seconds = Seconds;
+        }
+      }
+      if (Verbose) {
+        errs() << Name << ": round " << Round << ": " << C->getAttributes()
+               << ": score " << format("%g", C->Score) << ", "
+               << format("%g", C->Seconds) << " s\n";
+      }
+    }
+    std::stable_sort(Alive.begin(), Alive.end(), SecondsOrder());
+    if (Alive.size() == 1) {
+      break;
+    }
+    Alive.resize(std::max(1U, unsigned(Alive.size() / std::max(2U,
+                                                              unsigned(Eta)))));
+    NumReps *= std::max(2U, unsigned(Eta));
+  }
+
+  const Candidate &Best   = *Alive.front();
+  double           Points = TimeSteps;
+  if (Separate) {
+    OS << "---\n";
+  }
+  OS << "program: " << TheGrid->getName() << "\n";
+  OS << "size: ";
+  for (unsigned i = 0, e = Dims.size(); i != e; ++i) {
+    OS << (i == 0 ? "" : ",") << Dims[i];
+    Points *= Dims[i];
+  }
+  OS << "\n";
+  OS << "time-steps: " << TimeSteps << "\n";
+  OS << "configurations: " << NumConfigs << "\n";
+  OS << "feasible: " << NumFeasible << "\n";
+  OS << "measured: " << NumMeasured << "\n";
+  OS << "best: \"" << Best.getAttributes() << "\"\n";
+  OS << "seconds: " << format("%g", Best.Seconds) << "\n";
+  OS << "gstencils: " << format("%g", Points / Best.Seconds / 1e9) << "\n";
+
+  Entry.Hash       = TuningDB::getGridHash(TheGrid.get());
+  Entry.Target     = "cpu-omp";
+  Entry.Machine    = Machine;
+  Entry.SizeBucket = TuningDB::getSizeBucket(uint64_t(Points / TimeSteps));
+  Entry.Block      = Best.Block;
+  Entry.Elements   = Best.Elements;
+  Entry.Time       = Best.Time;
+  Entry.Program    = TheGrid->getName();
+  return true;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+
+  // Error handling
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj       Y;
+
+  cl::ParseCommandLineOptions(argc, argv,
+                              "ottune - OverTile cpu-omp autotuner");
+
+  std::string Err;
+
+  OwningPtr<tool_output_file> Out(
+    new tool_output_file(OutputFileName.c_str(), Err));
+  if (!Err.empty()) {
+    errs() << Err << "\n";
+    return 1;
+  }
+
+  TuningDB DB;
+  if (!DBFile.empty()) {
+    OwningPtr<MemoryBuffer> Text;
+    if (!MemoryBuffer::getFileOrSTDIN(DBFile, Text) &&
+        !DB.parse(Text->getBuffer(), Err)) {
+      errs() << DBFile << ": " << Err << "\n";
+      return 1;
+    }
+  }
+
+  bool Failed = false;
+  for (unsigned i = 0, e = InputFileNames.size(); i != e; ++i) {
+    OwningPtr<MemoryBuffer> InDoc;
+    if (error_code ec = MemoryBuffer::getFileOrSTDIN(InputFileNames[i],
+                                                     InDoc)) {
+      errs() << "Unable to read " << InputFileNames[i] << ": "
+             << ec.message() << "\n";
+      return 1;
+    }
+
+    Tuner       T(InputFileNames[i], InDoc->getBuffer().str());
+    TuningEntry Best;
+    if (T.tune(Out->os(), e > 1, Best)) {
+      DB.insert(Best);
+    } else {
+      Failed = true;
+    }
+  }
+
+  if (!DBFile.empty()) {
+    OwningPtr<tool_output_file> DBOut(
+      new tool_output_file(DBFile.c_str(), Err));
+    if (!Err.empty()) {
+      errs() << Err << "\n";
+      return 1;
+    }
+    DB.print(DBOut->os());
+    DBOut->keep();
+  }
+
+  Out->keep();
+
+  return Failed ? 1 : 0;
+}